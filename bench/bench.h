@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ctp_latency.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ctp {
+namespace bench {
+
+// 阻止编译器把基准中的计算优化掉
+template <typename T> inline void DoNotOptimize(const T &value) {
+#if defined(_MSC_VER)
+  static_cast<void>(*reinterpret_cast<const volatile char *>(&value));
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// 单个基准的运行状态
+// 基准函数先完成准备工作，再以
+//   while (state.Next())
+//     for (std::uint64_t i = 0; i < state.BatchSize(); ++i) { ... }
+// 的形式循环。每批单独计时，直到总运行时间达到下限。
+class BenchState {
+public:
+  BenchState(std::uint64_t nMinTimeNs, std::uint64_t nBatchSize)
+      : m_nMinTimeNs(nMinTimeNs), m_nBatchSize(nBatchSize), m_nBatches(0),
+        m_nTotalTicks(0), m_nBatchBegin(0), m_nPauseBegin(0),
+        m_bRunning(false) {}
+
+  // 第一次调用Next()之前可修改每批的操作数
+  void SetBatchSize(std::uint64_t nBatchSize) { m_nBatchSize = nBatchSize; }
+  std::uint64_t BatchSize() const { return m_nBatchSize; }
+
+  bool Next() {
+    std::uint64_t nNow = ReadTsc();
+    if (m_bRunning) {
+      std::uint64_t nTicks = nNow - m_nBatchBegin;
+      m_nTotalTicks += nTicks;
+      ++m_nBatches;
+      // 每批的单次操作耗时，按皮秒记录以保留小数
+      m_histogram.Record(static_cast<std::uint64_t>(
+          TscClock::Instance().ToNs(nTicks) * 1000 / m_nBatchSize));
+      if (TscClock::Instance().ToNs(m_nTotalTicks) >=
+          static_cast<std::int64_t>(m_nMinTimeNs)) {
+        m_bRunning = false;
+        return false;
+      }
+    }
+    m_bRunning = true;
+    m_nBatchBegin = ReadTsc();
+    return true;
+  }
+
+  // 暂停计时，用于批与批之间的准备或收尾工作，之后必须调用ResumeTiming()
+  void PauseTiming() { m_nPauseBegin = ReadTsc(); }
+  void ResumeTiming() { m_nBatchBegin += ReadTsc() - m_nPauseBegin; }
+
+  std::uint64_t GetOperations() const { return m_nBatches * m_nBatchSize; }
+  double GetTotalNs() const {
+    return static_cast<double>(TscClock::Instance().ToNs(m_nTotalTicks));
+  }
+  const LatencyHistogram &GetHistogram() const { return m_histogram; }
+
+private:
+  std::uint64_t m_nMinTimeNs;
+  std::uint64_t m_nBatchSize;
+  std::uint64_t m_nBatches;
+  std::uint64_t m_nTotalTicks;
+  std::uint64_t m_nBatchBegin;
+  std::uint64_t m_nPauseBegin;
+  bool m_bRunning;
+  LatencyHistogram m_histogram;
+};
+
+using BenchFn = void (*)(BenchState &state);
+
+struct BenchCase {
+  const char *pszName;
+  BenchFn fn;
+};
+
+// 所有基准在静态初始化时登记
+std::vector<BenchCase> &Registry();
+
+struct BenchRegistrar {
+  BenchRegistrar(const char *pszName, BenchFn fn) {
+    Registry().push_back({pszName, fn});
+  }
+};
+
+} // namespace bench
+} // namespace ctp
+
+// 定义并登记一个基准，名称按"模块.场景"命名
+#define CTP_BENCH(id, name)                                                    \
+  static void ctpBench_##id(::ctp::bench::BenchState &state);                  \
+  static ::ctp::bench::BenchRegistrar ctpBenchRegistrar_##id(name,             \
+                                                             &ctpBench_##id);  \
+  static void ctpBench_##id(::ctp::bench::BenchState &state)
@@ -0,0 +1,96 @@
+#include "bench.h"
+
+#include "ctp_log.h"
+#include "ctp_synthetic_ticks.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <string>
+
+namespace ctp {
+namespace bench {
+
+namespace {
+
+std::string logDirectory() {
+  return (std::filesystem::temp_directory_path() / "ctp_bench_log").string();
+}
+
+void localTime(std::time_t nSeconds, std::tm &tmLocal) {
+#if defined(_WIN32)
+  localtime_s(&tmLocal, &nSeconds);
+#else
+  localtime_r(&nSeconds, &tmLocal);
+#endif
+}
+
+} // namespace
+
+// 同步写法：回调线程上格式化时间和内容，写入文件后立即刷新，
+// 与引入异步日志之前示例中的std::cout << ... << std::endl相当
+CTP_BENCH(logSyncStdio, "log.sync_stdio") {
+  SyntheticTickGenerator generator;
+  CThostFtdcDepthMarketDataField tick;
+  generator.Next(tick);
+  std::FILE *pFile = std::tmpfile();
+  if (!pFile)
+    return;
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      std::int64_t nNow =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count();
+      std::time_t nSeconds = static_cast<std::time_t>(nNow / 1000000000);
+      std::tm tmLocal;
+      localTime(nSeconds, tmLocal);
+      char szLine[256];
+      int nLength = std::snprintf(
+          szLine, sizeof(szLine),
+          "%02d:%02d:%02d.%06d [MD] %s last=%g vol=%d\n", tmLocal.tm_hour,
+          tmLocal.tm_min, tmLocal.tm_sec,
+          static_cast<int>((nNow / 1000) % 1000000), tick.InstrumentID,
+          tick.LastPrice, tick.Volume);
+      std::fwrite(szLine, 1, static_cast<std::size_t>(nLength), pFile);
+      std::fflush(pFile);
+    }
+  }
+  std::fclose(pFile);
+}
+
+// 异步日志：调用线程只拷贝原始参数。每批结束后停止计时并等后台线程写完，
+// 保证缓冲区不会写满，被丢弃的日志不会让结果偏快
+CTP_BENCH(logAsyncWrite, "log.async_write") {
+  SyntheticTickGenerator generator;
+  CThostFtdcDepthMarketDataField tick;
+  generator.Next(tick);
+
+  LoggerOptions options;
+  options.strDirectory = logDirectory();
+  options.strPrefix = "bench";
+  options.nFlushIntervalMs = 1;
+  Logger &logger = Logger::Instance();
+  if (!logger.Start(options))
+    return;
+
+  state.SetBatchSize(2048);
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i)
+      CTP_LOG_INFO("[MD] %s last=%g vol=%d", tick.InstrumentID,
+                   tick.LastPrice, tick.Volume);
+    state.PauseTiming();
+    logger.Stop();
+    logger.Start(options);
+    state.ResumeTiming();
+  }
+  logger.Stop();
+
+  std::error_code ec;
+  std::filesystem::remove_all(options.strDirectory, ec);
+}
+
+} // namespace bench
+} // namespace ctp
@@ -0,0 +1,155 @@
+#include "bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#ifndef CTP_BENCH_VERSION
+#define CTP_BENCH_VERSION "unknown"
+#endif
+
+namespace ctp {
+namespace bench {
+
+std::vector<BenchCase> &Registry() {
+  static std::vector<BenchCase> cases;
+  return cases;
+}
+
+} // namespace bench
+} // namespace ctp
+
+namespace {
+
+struct Result {
+  const char *pszName;
+  std::uint64_t nOperations;
+  double dNsPerOp;
+  double dP50Ns;
+  double dP99Ns;
+};
+
+const char *compilerName() {
+#if defined(__clang__)
+  return "clang " __clang_version__;
+#elif defined(__GNUC__)
+  return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  return "msvc";
+#else
+  return "unknown";
+#endif
+}
+
+void writeJson(std::FILE *pFile, const std::vector<Result> &results) {
+  std::time_t nNow = std::time(nullptr);
+  char szTime[32];
+  std::strftime(szTime, sizeof(szTime), "%Y-%m-%dT%H:%M:%SZ",
+                std::gmtime(&nNow));
+
+  std::fprintf(pFile,
+               "{\n  \"version\": \"%s\",\n  \"compiler\": \"%s\",\n"
+               "  \"timestamp\": \"%s\",\n  \"results\": [\n",
+               CTP_BENCH_VERSION, compilerName(), szTime);
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result &result = results[i];
+    std::fprintf(pFile,
+                 "    {\"name\": \"%s\", \"operations\": %llu, "
+                 "\"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, "
+                 "\"p50_ns\": %.3f, \"p99_ns\": %.3f}%s\n",
+                 result.pszName,
+                 static_cast<unsigned long long>(result.nOperations),
+                 result.dNsPerOp,
+                 result.dNsPerOp > 0 ? 1e9 / result.dNsPerOp : 0.0,
+                 result.dP50Ns, result.dP99Ns,
+                 i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(pFile, "  ]\n}\n");
+}
+
+void usage(const char *pszProgram) {
+  std::printf("Usage: %s [--filter <substring>] [--min-time-ms <ms>] "
+              "[--json <file|->] [--list]\n",
+              pszProgram);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const char *pszFilter = nullptr;
+  const char *pszJson = nullptr;
+  std::uint64_t nMinTimeMs = 500;
+  bool bList = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      pszFilter = argv[++i];
+    } else if (std::strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) {
+      nMinTimeMs = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      pszJson = argv[++i];
+    } else if (std::strcmp(argv[i], "--list") == 0) {
+      bList = true;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<ctp::bench::BenchCase> &cases = ctp::bench::Registry();
+  if (bList) {
+    for (const auto &benchCase : cases)
+      std::printf("%s\n", benchCase.pszName);
+    return 0;
+  }
+
+  // JSON写到标准输出时，表格改写到标准错误
+  std::FILE *pTable =
+      pszJson && std::strcmp(pszJson, "-") == 0 ? stderr : stdout;
+  std::fprintf(pTable, "%-40s %14s %12s %14s %12s %12s\n", "benchmark",
+               "operations", "ns/op", "ops/s", "p50 ns", "p99 ns");
+
+  std::vector<Result> results;
+  for (const auto &benchCase : cases) {
+    if (pszFilter && !std::strstr(benchCase.pszName, pszFilter))
+      continue;
+
+    ctp::bench::BenchState state(nMinTimeMs * 1000000, 1000);
+    benchCase.fn(state);
+
+    Result result;
+    result.pszName = benchCase.pszName;
+    result.nOperations = state.GetOperations();
+    result.dNsPerOp =
+        result.nOperations ? state.GetTotalNs() / result.nOperations : 0.0;
+    result.dP50Ns = state.GetHistogram().GetPercentile(50) / 1000.0;
+    result.dP99Ns = state.GetHistogram().GetPercentile(99) / 1000.0;
+    results.push_back(result);
+
+    std::fprintf(pTable, "%-40s %14llu %12.2f %14.0f %12.2f %12.2f\n",
+                 result.pszName,
+                 static_cast<unsigned long long>(result.nOperations),
+                 result.dNsPerOp,
+                 result.dNsPerOp > 0 ? 1e9 / result.dNsPerOp : 0.0,
+                 result.dP50Ns, result.dP99Ns);
+    std::fflush(pTable);
+  }
+
+  if (pszJson) {
+    std::FILE *pFile = std::strcmp(pszJson, "-") == 0
+                           ? stdout
+                           : std::fopen(pszJson, "w");
+    if (!pFile) {
+      std::fprintf(stderr, "Failed to open %s\n", pszJson);
+      return 1;
+    }
+    writeJson(pFile, results);
+    if (pFile != stdout)
+      std::fclose(pFile);
+  }
+  return 0;
+}
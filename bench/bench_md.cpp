@@ -0,0 +1,536 @@
+#include "bench.h"
+
+#include "ctp_broadcast_ring.h"
+#include "ctp_feed_arbiter.h"
+#include "ctp_md_bus.h"
+#include "ctp_md_dispatcher.h"
+#include "ctp_md_replay.h"
+#include "ctp_snapshot_table.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_synthetic_ticks.h"
+#include "ctp_tick.h"
+#include "ctp_tick_archive.h"
+#include "ctp_tick_journal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace ctp {
+namespace bench {
+
+namespace {
+
+// 预先生成的一组行情，基准循环中按序取用，避免把生成成本计入被测路径
+constexpr std::size_t kTickPool = 4096;
+
+std::vector<CThostFtdcDepthMarketDataField>
+makeTicks(SyntheticTickGenerator &generator) {
+  std::vector<CThostFtdcDepthMarketDataField> ticks(kTickPool);
+  for (auto &tick : ticks)
+    generator.Next(tick);
+  return ticks;
+}
+
+// 最小的行情处理器，只累计最新价
+class CountingSpi : public CThostFtdcMdSpi {
+public:
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override {
+    m_dSum += pDepthMarketData->LastPrice;
+    ++m_nCount;
+  }
+
+  double m_dSum = 0.0;
+  std::uint64_t m_nCount = 0;
+};
+
+// 规整并写入快照表，与策略侧常见的处理方式一致
+class NormalizingSpi : public CThostFtdcMdSpi {
+public:
+  NormalizingSpi(const TickNormalizer &normalizer, SnapshotTable &snapshots)
+      : m_normalizer(normalizer), m_snapshots(snapshots) {}
+
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override {
+    CompactTick tick;
+    if (m_normalizer.Normalize(*pDepthMarketData, tick))
+      m_snapshots.Update(tick);
+  }
+
+private:
+  const TickNormalizer &m_normalizer;
+  SnapshotTable &m_snapshots;
+};
+
+void runDispatcher(BenchState &state, bool bRecordLatency) {
+  SyntheticTickGenerator generator;
+  InstrumentTable table;
+  generator.Register(table);
+  TickNormalizer normalizer(table);
+  SnapshotTable snapshots;
+  NormalizingSpi handler(normalizer, snapshots);
+
+  MdDispatcherOptions options;
+  options.bRecordLatency = bRecordLatency;
+  MdDispatcher dispatcher(&handler, options);
+  dispatcher.Start();
+
+  // 基准线程扮演CTP回调线程，每批生成并投递行情后等待消费线程处理完
+  CThostFtdcDepthMarketDataField tick;
+  std::uint64_t nSent = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      generator.Next(tick);
+      dispatcher.OnRtnDepthMarketData(&tick);
+    }
+    nSent += state.BatchSize();
+    while (dispatcher.GetDispatchCount() + dispatcher.GetDropCount() < nSent)
+      std::this_thread::yield();
+  }
+  dispatcher.Stop();
+}
+
+// 检查仲裁器转发的行情逐合约严格递增，并计数
+class OrderCheckingSpi : public CThostFtdcMdSpi {
+public:
+  explicit OrderCheckingSpi(const InstrumentTable &table)
+      : m_table(table), m_last(table.Capacity()), m_nForwarded(0),
+        m_nDisorders(0) {}
+
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override {
+    ++m_nForwarded;
+    std::uint32_t nInstrument = m_table.Find(pDepthMarketData->InstrumentID);
+    if (nInstrument >= m_last.size()) {
+      ++m_nDisorders;
+      return;
+    }
+    Key key(std::atoi(pDepthMarketData->TradingDay),
+            TradingTimeKey(pDepthMarketData->UpdateTime,
+                           pDepthMarketData->UpdateMillisec),
+            pDepthMarketData->Volume);
+    if (!(m_last[nInstrument] < key))
+      ++m_nDisorders;
+    m_last[nInstrument] = key;
+  }
+
+  std::uint64_t GetForwardedCount() const { return m_nForwarded; }
+  std::uint64_t GetDisorderCount() const { return m_nDisorders; }
+
+private:
+  // (TradingDay, 时间, 成交量)
+  using Key = std::tuple<int, std::int32_t, int>;
+
+  const InstrumentTable &m_table;
+  std::vector<Key> m_last;
+  std::uint64_t m_nForwarded;
+  std::uint64_t m_nDisorders;
+};
+
+} // namespace
+
+// 经基类指针回调OnRtnDepthMarketData的开销
+CTP_BENCH(spiDispatchVirtual, "md.spi_dispatch_virtual") {
+  SyntheticTickGenerator generator;
+  auto ticks = makeTicks(generator);
+  CountingSpi spi;
+  // 经volatile指针取出，阻止编译器去虚化
+  CThostFtdcMdSpi *volatile pSpi = &spi;
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      pSpi->OnRtnDepthMarketData(&ticks[nNext]);
+      nNext = (nNext + 1) & (kTickPool - 1);
+    }
+  }
+  DoNotOptimize(spi.m_dSum);
+}
+
+// CTP线程上拷贝一笔原始行情
+CTP_BENCH(tickCopy, "md.tick_copy") {
+  SyntheticTickGenerator generator;
+  auto ticks = makeTicks(generator);
+  CThostFtdcDepthMarketDataField copy;
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      std::memcpy(&copy, &ticks[nNext], sizeof(copy));
+      DoNotOptimize(copy);
+      nNext = (nNext + 1) & (kTickPool - 1);
+    }
+  }
+}
+
+// 查合约下标并规整为CompactTick
+CTP_BENCH(tickNormalize, "md.tick_normalize") {
+  SyntheticTickGenerator generator;
+  auto ticks = makeTicks(generator);
+  InstrumentTable table;
+  generator.Register(table);
+  TickNormalizer normalizer(table);
+  CompactTick tick;
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      normalizer.Normalize(ticks[nNext], tick);
+      DoNotOptimize(tick);
+      nNext = (nNext + 1) & (kTickPool - 1);
+    }
+  }
+}
+
+// seqlock快照写入
+CTP_BENCH(snapshotUpdate, "md.snapshot_update") {
+  SyntheticTickGenerator generator;
+  auto ticks = makeTicks(generator);
+  InstrumentTable table;
+  generator.Register(table);
+  TickNormalizer normalizer(table);
+  std::vector<CompactTick> compact(kTickPool);
+  for (std::size_t i = 0; i < kTickPool; ++i)
+    normalizer.Normalize(ticks[i], compact[i]);
+  SnapshotTable snapshots;
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      snapshots.Update(compact[nNext]);
+      nNext = (nNext + 1) & (kTickPool - 1);
+    }
+  }
+}
+
+// 单线程入队后立即出队，衡量环形队列本身的指令开销
+CTP_BENCH(spscPushPop, "ring.spsc_push_pop") {
+  SpscRing<CompactTick> ring(1024);
+  CompactTick tick;
+  std::memset(&tick, 0, sizeof(tick));
+  CompactTick out;
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      tick.nVolume = static_cast<std::int32_t>(i);
+      ring.TryPush(tick);
+      ring.TryPop(out);
+      DoNotOptimize(out);
+    }
+  }
+}
+
+// 生产者与消费者各占一个线程时的吞吐
+CTP_BENCH(spscThroughput, "ring.spsc_throughput") {
+  SpscRing<CompactTick> ring(65536);
+  std::atomic<bool> bRunning(true);
+  std::atomic<std::uint64_t> nConsumed(0);
+  std::thread consumer([&] {
+    CompactTick out;
+    std::uint64_t nCount = 0;
+    while (bRunning.load(std::memory_order_relaxed)) {
+      if (ring.TryPop(out)) {
+        ++nCount;
+        nConsumed.store(nCount, std::memory_order_release);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  CompactTick tick;
+  std::memset(&tick, 0, sizeof(tick));
+  std::uint64_t nSent = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      while (!ring.TryPush(tick))
+        std::this_thread::yield();
+    }
+    nSent += state.BatchSize();
+    while (nConsumed.load(std::memory_order_acquire) < nSent)
+      std::this_thread::yield();
+  }
+  bRunning.store(false);
+  consumer.join();
+}
+
+// 单生产者多读者广播环的写入开销
+CTP_BENCH(broadcastPublish, "ring.broadcast_publish") {
+  BroadcastRing<CompactTick> ring(65536);
+  CompactTick tick;
+  std::memset(&tick, 0, sizeof(tick));
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      tick.nVolume = static_cast<std::int32_t>(i);
+      ring.Publish(tick);
+    }
+  }
+}
+
+// 规整后发布给一个订阅者并取出
+CTP_BENCH(busPublish, "md.bus_publish") {
+  SyntheticTickGenerator generator;
+  auto ticks = makeTicks(generator);
+  InstrumentTable table;
+  generator.Register(table);
+  MdBus bus(table);
+  MdSubscriber *pSubscriber = bus.AddSubscriber();
+  for (std::size_t i = 0; i < generator.GetInstrumentCount(); ++i)
+    bus.Subscribe(pSubscriber, static_cast<std::uint32_t>(i));
+  CompactTick out;
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      bus.Publish(ticks[nNext]);
+      pSubscriber->Poll(out);
+      DoNotOptimize(out);
+      nNext = (nNext + 1) & (kTickPool - 1);
+    }
+  }
+}
+
+// 合成行情源 -> MdDispatcher -> 规整 -> 快照，每笔耗时的倒数即ticks/s
+CTP_BENCH(e2eSyntheticTicks, "e2e.synthetic_ticks") {
+  runDispatcher(state, false);
+}
+
+// 同上，并打开MdDispatcher的延迟记录
+CTP_BENCH(e2eSyntheticTicksLatency, "e2e.synthetic_ticks_latency") {
+  runDispatcher(state, true);
+}
+
+// 用合成行情写一个交易日的日志
+bool writeSyntheticJournal(const std::string &strPath,
+                           SyntheticTickGenerator &generator,
+                           std::size_t nTicks) {
+  std::error_code ec;
+  std::filesystem::remove(strPath, ec);
+  TickJournalOptions options;
+  options.nInitialRecords = nTicks;
+  TickJournalWriter writer;
+  if (!writer.Open(strPath, "20240603", options))
+    return false;
+  CThostFtdcDepthMarketDataField tick;
+  for (std::size_t i = 0; i < nTicks; ++i) {
+    generator.Next(tick);
+    writer.Append(tick);
+  }
+  writer.Close();
+  return true;
+}
+
+constexpr std::size_t kArchiveTicks = 65536;
+
+// 把一个交易日的日志转换为列式归档，按行情计；结束时在stderr输出
+// 日志与归档的大小
+CTP_BENCH(archiveEncode, "md.archive_encode") {
+  const std::string strDirectory =
+      (std::filesystem::temp_directory_path() / "ctp_bench_archive").string();
+  std::error_code ec;
+  std::filesystem::create_directories(strDirectory, ec);
+  SyntheticTickGenerator generator;
+  InstrumentTable table;
+  generator.Register(table);
+  std::string strJournal =
+      TickJournalWriter::MakePath(strDirectory, "20240603");
+  TickJournalReader journal;
+  if (!writeSyntheticJournal(strJournal, generator, kArchiveTicks) ||
+      !journal.Open(strJournal)) {
+    std::fprintf(stderr, "md.archive_encode: cannot write %s\n",
+                 strJournal.c_str());
+    return;
+  }
+  TickNormalizer normalizer(table);
+  TickArchiveWriter writer(normalizer);
+  std::string strArchive =
+      TickArchiveWriter::MakePath(strDirectory, "20240603");
+  state.SetBatchSize(kArchiveTicks);
+
+  bool bOk = true;
+  while (state.Next())
+    bOk = writer.Write(journal, strArchive) && bOk;
+  if (bOk) {
+    // 日志文件按块预分配，按记录数计算大小
+    std::uint64_t nJournal =
+        journal.GetRecordCount() * sizeof(TickJournalRecord);
+    std::uint64_t nArchive = std::filesystem::file_size(strArchive, ec);
+    std::fprintf(stderr,
+                 "md.archive_encode: journal %llu bytes, archive %llu bytes "
+                 "(%.1fx)\n",
+                 static_cast<unsigned long long>(nJournal),
+                 static_cast<unsigned long long>(nArchive),
+                 static_cast<double>(nJournal) / nArchive);
+  } else {
+    std::fprintf(stderr, "md.archive_encode: cannot write %s\n",
+                 strArchive.c_str());
+  }
+  journal.Close();
+  std::filesystem::remove_all(strDirectory, ec);
+}
+
+// 逐合约解码归档的最新价列，按解出的一个int64_t计（8/ns = GB/s）；
+// 解码结果与原始行情不符时在stderr报告
+CTP_BENCH(archiveDecodeColumn, "md.archive_decode_column") {
+  const std::string strDirectory =
+      (std::filesystem::temp_directory_path() / "ctp_bench_archive_decode")
+          .string();
+  std::error_code ec;
+  std::filesystem::create_directories(strDirectory, ec);
+  SyntheticTickGenerator generator;
+  InstrumentTable table;
+  generator.Register(table);
+  TickNormalizer normalizer(table);
+  std::string strJournal =
+      TickJournalWriter::MakePath(strDirectory, "20240603");
+  std::string strArchive =
+      TickArchiveWriter::MakePath(strDirectory, "20240603");
+  TickJournalReader journal;
+  TickArchiveWriter writer(normalizer);
+  TickArchiveReader archive;
+  if (!writeSyntheticJournal(strJournal, generator, kArchiveTicks) ||
+      !journal.Open(strJournal) || !writer.Write(journal, strArchive) ||
+      !archive.Open(strArchive)) {
+    std::fprintf(stderr, "md.archive_decode_column: cannot write %s\n",
+                 strArchive.c_str());
+    return;
+  }
+
+  // 按日志顺序算出每个合约的最新价跳数，用于校验
+  std::vector<std::vector<std::int64_t>> vecExpected(
+      archive.GetInstrumentCount());
+  for (std::uint64_t i = 0; i < journal.GetRecordCount(); ++i) {
+    const CThostFtdcDepthMarketDataField &tick = journal.GetRecord(i).tick;
+    std::uint32_t nInstrument = archive.Find(tick.InstrumentID);
+    CompactTick compact;
+    if (nInstrument < vecExpected.size() && normalizer.Normalize(tick, compact))
+      vecExpected[nInstrument].push_back(compact.nLastPrice);
+  }
+  journal.Close();
+
+  std::vector<std::int64_t> vecValues(kArchiveTicks);
+  state.SetBatchSize(archive.GetTickCount());
+  bool bFailed = false;
+  while (state.Next()) {
+    for (std::uint32_t i = 0; i < archive.GetInstrumentCount(); ++i)
+      archive.ReadColumn(i, kTickColumnLastPrice, vecValues.data());
+    DoNotOptimize(vecValues[0]);
+  }
+  for (std::uint32_t i = 0; !bFailed && i < archive.GetInstrumentCount();
+       ++i) {
+    archive.ReadColumn(i, kTickColumnLastPrice, vecValues.data());
+    bFailed = vecExpected[i].size() != archive.GetInstrument(i).nTicks ||
+              !std::equal(vecExpected[i].begin(), vecExpected[i].end(),
+                          vecValues.begin());
+    if (bFailed)
+      std::fprintf(stderr, "md.archive_decode_column: instrument %u differs\n",
+                   i);
+  }
+  archive.Close();
+  std::filesystem::remove_all(strDirectory, ec);
+}
+
+// 两个ReplayMdApi回放同一组日志作为两个前置，经FeedArbiter合并，
+// 按每个前置收到的一笔行情计。日志包含两个交易日，次日的时间从头开始，
+// 每批结束后检查每笔行情恰好转发一次且逐合约递增。
+CTP_BENCH(feedArbiterReplay, "md.feed_arbiter_replay") {
+  constexpr std::size_t kTicksPerDay = 16384;
+  const std::string strDirectory =
+      (std::filesystem::temp_directory_path() / "ctp_bench_arbiter").string();
+  std::error_code ec;
+  std::filesystem::create_directories(strDirectory, ec);
+
+  InstrumentTable table;
+  std::vector<std::string> vecFiles;
+  std::vector<std::string> vecInstruments;
+  for (const char *pszTradingDay : {"20240603", "20240604"}) {
+    SyntheticTickGenerator generator;
+    generator.Register(table);
+    std::string strPath =
+        TickJournalWriter::MakePath(strDirectory, pszTradingDay);
+    std::filesystem::remove(strPath, ec);
+    TickJournalOptions journalOptions;
+    journalOptions.nInitialRecords = kTicksPerDay;
+    TickJournalWriter writer;
+    if (!writer.Open(strPath, pszTradingDay, journalOptions)) {
+      std::fprintf(stderr, "md.feed_arbiter_replay: cannot open %s\n",
+                   strPath.c_str());
+      return;
+    }
+    CThostFtdcDepthMarketDataField tick;
+    for (std::size_t i = 0; i < kTicksPerDay; ++i) {
+      generator.Next(tick);
+      std::memcpy(tick.TradingDay, pszTradingDay, sizeof(tick.TradingDay));
+      std::memcpy(tick.ActionDay, pszTradingDay, sizeof(tick.ActionDay));
+      if (vecFiles.empty() && i < generator.GetInstrumentCount())
+        vecInstruments.push_back(tick.InstrumentID);
+      writer.Append(tick);
+    }
+    writer.Close();
+    vecFiles.push_back(strPath);
+  }
+
+  ReplayMdApiOptions replayOptions;
+  replayOptions.vecJournalFiles = vecFiles;
+  FeedArbiterOptions options;
+  options.vecInstruments = vecInstruments;
+  options.bRecordLatency = false;
+  const std::uint64_t nTicks = kTicksPerDay * vecFiles.size();
+  state.SetBatchSize(nTicks * 2);
+
+  bool bFailed = false;
+  while (state.Next()) {
+    state.PauseTiming();
+    OrderCheckingSpi checker(table);
+    FeedArbiter arbiter(&checker, table, options);
+    ReplayMdApi *pApis[2];
+    for (ReplayMdApi *&pApi : pApis) {
+      pApi = ReplayMdApi::CreateReplayMdApi(replayOptions);
+      if (!pApi) {
+        std::fprintf(stderr, "md.feed_arbiter_replay: cannot replay\n");
+        return;
+      }
+      arbiter.AddFront(pApi, nullptr);
+    }
+    arbiter.Start();
+    state.ResumeTiming();
+
+    for (ReplayMdApi *pApi : pApis)
+      pApi->Init();
+    for (ReplayMdApi *pApi : pApis) {
+      while (!pApi->IsFinished())
+        std::this_thread::yield();
+    }
+    arbiter.Stop();
+
+    state.PauseTiming();
+    for (ReplayMdApi *pApi : pApis)
+      pApi->Release();
+    if (!bFailed && (checker.GetForwardedCount() != nTicks ||
+                     checker.GetDisorderCount() != 0)) {
+      std::fprintf(stderr,
+                   "md.feed_arbiter_replay: forwarded %llu of %llu, "
+                   "%llu out of order\n",
+                   static_cast<unsigned long long>(
+                       checker.GetForwardedCount()),
+                   static_cast<unsigned long long>(nTicks),
+                   static_cast<unsigned long long>(
+                       checker.GetDisorderCount()));
+      bFailed = true;
+    }
+    state.ResumeTiming();
+  }
+  std::filesystem::remove_all(strDirectory, ec);
+}
+
+} // namespace bench
+} // namespace ctp
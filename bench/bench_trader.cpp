@@ -0,0 +1,214 @@
+#include "bench.h"
+
+#include "ThostFtdcUserApiDataType.h"
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+#include "ctp_order_state.h"
+#include "ctp_request_tracker.h"
+#include "ctp_risk_gate.h"
+#include "ctp_synthetic_ticks.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ctp {
+namespace bench {
+
+namespace {
+
+// 无符号整数转十进制字符串，返回写入的字符数
+inline std::size_t formatUnsigned(char *pszBuffer, std::uint32_t nValue) {
+  char szDigits[10];
+  std::size_t nLength = 0;
+  do {
+    szDigits[nLength++] = static_cast<char>('0' + nValue % 10);
+    nValue /= 10;
+  } while (nValue);
+  for (std::size_t i = 0; i < nLength; ++i)
+    pszBuffer[i] = szDigits[nLength - 1 - i];
+  pszBuffer[nLength] = '\0';
+  return nLength;
+}
+
+// 下单中不随每笔变化的字段
+void fillStaticFields(CThostFtdcInputOrderField &order) {
+  std::strncpy(order.BrokerID, "9999", sizeof(order.BrokerID) - 1);
+  std::strncpy(order.InvestorID, "000001", sizeof(order.InvestorID) - 1);
+  std::strncpy(order.UserID, "000001", sizeof(order.UserID) - 1);
+  std::strncpy(order.ExchangeID, "SHFE", sizeof(order.ExchangeID) - 1);
+  order.OrderPriceType = THOST_FTDC_OPT_LimitPrice;
+  order.CombHedgeFlag[0] = THOST_FTDC_HF_Speculation;
+  order.TimeCondition = THOST_FTDC_TC_GFD;
+  order.VolumeCondition = THOST_FTDC_VC_AV;
+  order.MinVolume = 1;
+  order.ContingentCondition = THOST_FTDC_CC_Immediately;
+  order.ForceCloseReason = THOST_FTDC_FCC_NotForceClose;
+}
+
+} // namespace
+
+// 常见写法：每笔清零后逐字段填写，OrderRef用snprintf格式化
+CTP_BENCH(inputOrderBuild, "trader.input_order_build") {
+  CThostFtdcInputOrderField order;
+  std::uint32_t nOrderRef = 1;
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      std::memset(&order, 0, sizeof(order));
+      fillStaticFields(order);
+      std::strncpy(order.InstrumentID, "rb2410",
+                   sizeof(order.InstrumentID) - 1);
+      std::snprintf(order.OrderRef, sizeof(order.OrderRef), "%u",
+                    nOrderRef++);
+      order.Direction = (i & 1) ? THOST_FTDC_D_Sell : THOST_FTDC_D_Buy;
+      order.CombOffsetFlag[0] = THOST_FTDC_OF_Open;
+      order.LimitPrice = 3500.0 + static_cast<double>(i & 15);
+      order.VolumeTotalOriginal = 1;
+      order.RequestID = static_cast<int>(nOrderRef);
+      DoNotOptimize(order);
+    }
+  }
+}
+
+// 预先填好不变字段的模板，每笔只拷贝并改写变化的字段
+CTP_BENCH(inputOrderTemplate, "trader.input_order_template") {
+  CThostFtdcInputOrderField orderTemplate;
+  std::memset(&orderTemplate, 0, sizeof(orderTemplate));
+  fillStaticFields(orderTemplate);
+  std::strncpy(orderTemplate.InstrumentID, "rb2410",
+               sizeof(orderTemplate.InstrumentID) - 1);
+  orderTemplate.CombOffsetFlag[0] = THOST_FTDC_OF_Open;
+  orderTemplate.VolumeTotalOriginal = 1;
+
+  CThostFtdcInputOrderField order;
+  std::uint32_t nOrderRef = 1;
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      std::memcpy(&order, &orderTemplate, sizeof(order));
+      formatUnsigned(order.OrderRef, nOrderRef++);
+      order.Direction = (i & 1) ? THOST_FTDC_D_Sell : THOST_FTDC_D_Buy;
+      order.LimitPrice = 3500.0 + static_cast<double>(i & 15);
+      order.RequestID = static_cast<int>(nOrderRef);
+      DoNotOptimize(order);
+    }
+  }
+}
+
+// 已知委托的状态回报更新
+CTP_BENCH(orderStateRtnOrder, "trader.order_state_rtn_order") {
+  constexpr std::size_t kOrders = 1024;
+  SyntheticTickGenerator generator(8);
+  InstrumentTable table;
+  generator.Register(table);
+  OrderStateEngine engine(table);
+
+  std::vector<CThostFtdcOrderField> orders(kOrders);
+  for (std::size_t i = 0; i < kOrders; ++i) {
+    CThostFtdcOrderField &order = orders[i];
+    std::memset(&order, 0, sizeof(order));
+    std::snprintf(order.InstrumentID, sizeof(order.InstrumentID), "%s",
+                  table.GetInstrumentID(i % table.Size()));
+    std::strncpy(order.ExchangeID, "SHFE", sizeof(order.ExchangeID) - 1);
+    formatUnsigned(order.OrderRef, static_cast<std::uint32_t>(i + 1));
+    std::snprintf(order.OrderSysID, sizeof(order.OrderSysID), "%12zu", i);
+    order.FrontID = 1;
+    order.SessionID = 1;
+    order.Direction = THOST_FTDC_D_Buy;
+    order.CombOffsetFlag[0] = THOST_FTDC_OF_Open;
+    order.LimitPrice = 3500.0;
+    order.VolumeTotalOriginal = 10;
+    order.OrderSubmitStatus = THOST_FTDC_OSS_Accepted;
+    order.OrderStatus = THOST_FTDC_OST_NoTradeQueueing;
+    order.VolumeTotal = 10;
+    engine.OnRtnOrder(order);
+  }
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      CThostFtdcOrderField &order = orders[nNext];
+      // 成交量不能回退，否则会被当作重放的旧回报直接忽略
+      order.OrderStatus = (i & 1) ? THOST_FTDC_OST_PartTradedQueueing
+                                  : THOST_FTDC_OST_NoTradeQueueing;
+      DoNotOptimize(engine.OnRtnOrder(order));
+      nNext = (nNext + 1) & (kOrders - 1);
+    }
+  }
+}
+
+// 请求关联：分配RequestID并占用槽位，两段应答拷入槽位缓冲区后回调完成
+CTP_BENCH(requestTrackerRsp, "trader.request_tracker_rsp") {
+  RequestTracker tracker;
+  CThostFtdcInvestorPositionField position;
+  std::memset(&position, 0, sizeof(position));
+  CThostFtdcRspInfoField rspInfo;
+  std::memset(&rspInfo, 0, sizeof(rspInfo));
+  std::uint64_t nRows = 0;
+  RequestCallback fnCallback = [](void *pContext,
+                                  const RequestResult &result) {
+    *static_cast<std::uint64_t *>(pContext) += result.nRows;
+  };
+
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      int nRequestID = tracker.Begin(fnCallback, &nRows);
+      tracker.OnRsp(&position, &rspInfo, nRequestID, false);
+      tracker.OnRsp(&position, &rspInfo, nRequestID, true);
+    }
+  }
+  DoNotOptimize(nRows);
+}
+
+// 报单前风控：每笔通过全部规则并计入在途报单，随后按报单被拒移出，
+// 保持在途列表长度不变；对手方向挂着4笔不交叉的在途报单
+CTP_BENCH(riskGateCheck, "trader.risk_gate_check") {
+  constexpr std::size_t kInstruments = 8;
+  SyntheticTickGenerator generator(kInstruments);
+  InstrumentTable table;
+  generator.Register(table);
+  OrderStateEngine engine(table);
+  RiskGateOptions options;
+  // 频率计数照常走CAS，但不会触发限制
+  options.nMaxOrdersPerSecond = 0xFFFFFFFFu;
+  RiskGate gate(table, engine, options);
+  gate.SetSession(1, 1);
+
+  std::vector<CThostFtdcInputOrderField> orders(kInstruments);
+  for (std::uint32_t n = 0; n < kInstruments; ++n) {
+    gate.OnTick(n, 5000.0, 2000.0);
+    CThostFtdcInputOrderField &order = orders[n];
+    std::memset(&order, 0, sizeof(order));
+    fillStaticFields(order);
+    std::snprintf(order.InstrumentID, sizeof(order.InstrumentID), "%s",
+                  table.GetInstrumentID(n));
+    order.Direction = THOST_FTDC_D_Sell;
+    order.CombOffsetFlag[0] = THOST_FTDC_OF_Open;
+    order.VolumeTotalOriginal = 1;
+    for (std::uint32_t i = 0; i < 4; ++i) {
+      formatUnsigned(order.OrderRef, n * 100 + i + 1);
+      order.LimitPrice = 3600.0 + i;
+      gate.CheckOrder(order);
+    }
+    formatUnsigned(order.OrderRef, n * 100 + 99);
+    order.Direction = THOST_FTDC_D_Buy;
+    order.LimitPrice = 3500.0;
+  }
+
+  std::size_t nNext = 0;
+  while (state.Next()) {
+    for (std::uint64_t i = 0; i < state.BatchSize(); ++i) {
+      const CThostFtdcInputOrderField &order = orders[nNext];
+      DoNotOptimize(gate.CheckOrder(order));
+      gate.OnInsertRejected(order);
+      nNext = (nNext + 1) & (kInstruments - 1);
+    }
+  }
+  if (gate.GetPassedOrderCount() == 0 ||
+      gate.GetRejectCount(RiskReject::SelfTrade) != 0)
+    std::fprintf(stderr, "trader.risk_gate_check: unexpected rejects\n");
+}
+
+} // namespace bench
+} // namespace ctp
@@ -0,0 +1,365 @@
+#include "ThostFtdcMdApi.h"
+#include "ctp_log.h"
+#include "ctp_shm_md.h"
+#include "ctp_subscription_manager.h"
+#include "ctp_synthetic_ticks.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+volatile std::sig_atomic_t g_bStop = 0;
+
+void onSignal(int) { g_bStop = 1; }
+
+struct DaemonOptions {
+  std::string strPath = ctp::kShmMdDefaultPath;
+  std::size_t nRingCapacity = 65536;
+  // 合成行情
+  std::size_t nSynthetic = 0;
+  std::uint64_t nRate = 10000; // 每秒行情数，0表示不限速
+  // CTP行情前置
+  const char *pszFront = nullptr;
+  const char *pszBrokerID = "";
+  const char *pszUserID = "";
+  const char *pszInstruments = nullptr; // "rb2510:1,cu2510:10"
+  bool bClient = false;
+  int nSeconds = 0; // 运行时长，0表示直到收到信号
+};
+
+std::int64_t steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 与发布方心跳相同的系统时钟
+std::int64_t systemNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool expired(const DaemonOptions &options, std::int64_t nStartNs) {
+  return g_bStop || (options.nSeconds > 0 &&
+                     steadyNanos() - nStartNs >=
+                         static_cast<std::int64_t>(options.nSeconds) *
+                             1000000000);
+}
+
+// 行情前置会话：登录后订阅，回调线程上直接写入共享内存
+class MdRelay : public CThostFtdcMdSpi {
+public:
+  MdRelay(const DaemonOptions &options, ctp::ShmMdPublisher &publisher)
+      : m_options(options), m_publisher(publisher), m_pMdApi(nullptr),
+        m_nRequestID(0) {}
+
+  void SetMdApi(CThostFtdcMdApi *pApi) {
+    m_pMdApi = pApi;
+    m_subscriptions.SetMdApi(pApi);
+  }
+  ctp::SubscriptionManager &GetSubscriptions() { return m_subscriptions; }
+
+  void OnFrontConnected() override {
+    CTP_LOG_INFO("[Daemon] Connected to %s, logging in", m_options.pszFront);
+    CThostFtdcReqUserLoginField login;
+    std::memset(&login, 0, sizeof(login));
+    std::strncpy(login.BrokerID, m_options.pszBrokerID,
+                 sizeof(login.BrokerID) - 1);
+    std::strncpy(login.UserID, m_options.pszUserID, sizeof(login.UserID) - 1);
+    // 密码只从环境变量读取，不出现在命令行里
+    if (const char *pszPassword = std::getenv("CTP_PASSWORD"))
+      std::strncpy(login.Password, pszPassword, sizeof(login.Password) - 1);
+    m_pMdApi->ReqUserLogin(&login, ++m_nRequestID);
+  }
+
+  void OnFrontDisconnected(int nReason) override {
+    CTP_LOG_WARN("[Daemon] Disconnected, reason: 0x%x", nReason);
+    m_subscriptions.OnDisconnected();
+  }
+
+  void OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                      CThostFtdcRspInfoField *pRspInfo, int /*nRequestID*/,
+                      bool /*bIsLast*/) override {
+    if (pRspInfo && pRspInfo->ErrorID != 0) {
+      CTP_LOG_ERROR("[Daemon] Login failed, ErrorID: %d, ErrorMsg: %s",
+                    pRspInfo->ErrorID, pRspInfo->ErrorMsg);
+      return;
+    }
+    CTP_LOG_INFO("[Daemon] Login successful, Trading Day: %s",
+                 pRspUserLogin ? pRspUserLogin->TradingDay : "");
+    m_subscriptions.OnLogin();
+  }
+
+  void
+  OnRspSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                     CThostFtdcRspInfoField *pRspInfo, int /*nRequestID*/,
+                     bool bIsLast) override {
+    m_subscriptions.OnRspSubMarketData(pSpecificInstrument, pRspInfo, bIsLast);
+  }
+
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override {
+    if (pDepthMarketData)
+      m_publisher.Publish(*pDepthMarketData);
+  }
+
+private:
+  const DaemonOptions &m_options;
+  ctp::ShmMdPublisher &m_publisher;
+  CThostFtdcMdApi *m_pMdApi;
+  ctp::SubscriptionManager m_subscriptions;
+  int m_nRequestID;
+};
+
+// 合约表须在发布前建好："rb2510:1,cu2510:10"，价位缺省为1
+bool parseInstruments(const char *pszList, ctp::InstrumentTable &table,
+                      std::vector<std::string> &instrumentIDs) {
+  std::string strList = pszList;
+  std::size_t nBegin = 0;
+  while (nBegin <= strList.size()) {
+    std::size_t nEnd = strList.find(',', nBegin);
+    if (nEnd == std::string::npos)
+      nEnd = strList.size();
+    std::string strItem = strList.substr(nBegin, nEnd - nBegin);
+    nBegin = nEnd + 1;
+    if (strItem.empty())
+      continue;
+    double dPriceTick = 1.0;
+    std::size_t nColon = strItem.find(':');
+    if (nColon != std::string::npos) {
+      dPriceTick = std::atof(strItem.c_str() + nColon + 1);
+      strItem.resize(nColon);
+    }
+    if (table.Add(strItem.c_str(), dPriceTick) == ctp::kInvalidInstrument)
+      return false;
+    instrumentIDs.push_back(strItem);
+  }
+  return !instrumentIDs.empty();
+}
+
+void printPublisherStats(const ctp::ShmMdPublisher &publisher,
+                         std::uint64_t &nLastPublished) {
+  std::uint64_t nPublished = publisher.GetPublishedCount();
+  std::printf("[Daemon] published %llu ticks (%llu/s)\n",
+              static_cast<unsigned long long>(nPublished),
+              static_cast<unsigned long long>(nPublished - nLastPublished));
+  std::fflush(stdout);
+  nLastPublished = nPublished;
+}
+
+int runSynthetic(const DaemonOptions &options) {
+  ctp::SyntheticTickGenerator generator(options.nSynthetic);
+  ctp::InstrumentTable table;
+  generator.Register(table);
+  ctp::TickNormalizer normalizer(table);
+  ctp::ShmMdPublisher publisher(normalizer);
+  ctp::ShmMdOptions shmOptions;
+  shmOptions.nRingCapacity = options.nRingCapacity;
+  if (!publisher.Open(options.strPath, shmOptions)) {
+    std::fprintf(stderr, "Failed to create %s\n", options.strPath.c_str());
+    return 1;
+  }
+
+  CThostFtdcDepthMarketDataField tick;
+  const std::int64_t nStartNs = steadyNanos();
+  std::int64_t nNextReportNs = nStartNs + 1000000000;
+  std::uint64_t nGenerated = 0;
+  std::uint64_t nLastPublished = 0;
+  while (!expired(options, nStartNs)) {
+    std::int64_t nNowNs = steadyNanos();
+    // 按时间补齐应当发出的行情数，每批最多1000笔
+    std::uint64_t nTarget =
+        options.nRate
+            ? static_cast<std::uint64_t>(
+                  static_cast<double>(nNowNs - nStartNs) * 1e-9 * options.nRate)
+            : nGenerated + 1000;
+    if (nTarget > nGenerated + 1000)
+      nTarget = nGenerated + 1000;
+    for (; nGenerated < nTarget; ++nGenerated) {
+      generator.Next(tick);
+      publisher.Publish(tick);
+    }
+    if (nNowNs >= nNextReportNs) {
+      publisher.Heartbeat();
+      printPublisherStats(publisher, nLastPublished);
+      nNextReportNs += 1000000000;
+    }
+    if (options.nRate)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  publisher.Close();
+  return 0;
+}
+
+int runFront(const DaemonOptions &options) {
+  ctp::InstrumentTable table;
+  std::vector<std::string> instrumentIDs;
+  if (!options.pszInstruments ||
+      !parseInstruments(options.pszInstruments, table, instrumentIDs)) {
+    std::fprintf(stderr,
+                 "--instruments is required, e.g. rb2510:1,cu2510:10\n");
+    return 1;
+  }
+  ctp::TickNormalizer normalizer(table);
+  ctp::ShmMdPublisher publisher(normalizer);
+  ctp::ShmMdOptions shmOptions;
+  shmOptions.nRingCapacity = options.nRingCapacity;
+  if (!publisher.Open(options.strPath, shmOptions)) {
+    std::fprintf(stderr, "Failed to create %s\n", options.strPath.c_str());
+    return 1;
+  }
+
+  CThostFtdcMdApi *pMdApi = CThostFtdcMdApi::CreateFtdcMdApi("./md_flow/");
+  if (!pMdApi) {
+    std::fprintf(stderr, "Failed to create market data API\n");
+    return 1;
+  }
+  MdRelay relay(options, publisher);
+  relay.SetMdApi(pMdApi);
+  for (const std::string &strID : instrumentIDs)
+    relay.GetSubscriptions().Add(strID.c_str());
+  pMdApi->RegisterSpi(&relay);
+  pMdApi->RegisterFront(const_cast<char *>(options.pszFront));
+  pMdApi->Init();
+
+  const std::int64_t nStartNs = steadyNanos();
+  std::uint64_t nLastPublished = 0;
+  while (!expired(options, nStartNs)) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    publisher.Heartbeat();
+    printPublisherStats(publisher, nLastPublished);
+  }
+  pMdApi->RegisterSpi(nullptr);
+  pMdApi->Release();
+  publisher.Close();
+  return 0;
+}
+
+// 读者：打印每秒读取的行情数、缺口与积压，发布方重启后自动重新连接。
+// 发布方正常退出时置位nClosed；异常退出后由新发布方替换的文件每秒按inode
+// 检查一次，心跳超时而文件未被替换时只提示，继续读旧文件
+int runClient(const DaemonOptions &options) {
+  ctp::ShmMdClient client;
+  const std::int64_t nStartNs = steadyNanos();
+  std::int64_t nNextReportNs = nStartNs + 1000000000;
+  std::uint64_t nLastConsumed = 0;
+  bool bReplaced = false;
+  ctp::CompactTick tick;
+  while (!expired(options, nStartNs)) {
+    if (!client.IsOpen() || client.IsPublisherClosed() || bReplaced) {
+      bReplaced = false;
+      if (!client.Open(options.strPath)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      nLastConsumed = 0;
+      std::printf("[Client] attached to %s, %zu instruments\n",
+                  options.strPath.c_str(),
+                  client.GetInstrumentTable().Size());
+    }
+
+    if (!client.Poll(tick))
+      std::this_thread::yield();
+
+    std::int64_t nNowNs = steadyNanos();
+    if (nNowNs >= nNextReportNs) {
+      bReplaced = client.IsReplaced();
+      if (!bReplaced && client.IsPublisherStale())
+        std::printf("[Client] publisher heartbeat is %llds old\n",
+                    static_cast<long long>(
+                        (systemNanos() - client.GetHeartbeatNs()) /
+                        1000000000));
+      ctp::ShmMdClientStats stats = client.GetStats();
+      ctp::CompactTick latest;
+      std::int32_t nLastPrice =
+          client.ReadSnapshot(0, latest) ? latest.nLastPrice : 0;
+      std::printf("[Client] consumed %llu (%llu/s), gaps %llu, lost %llu, "
+                  "lag %llu, instrument 0 last %d ticks\n",
+                  static_cast<unsigned long long>(stats.nConsumed),
+                  static_cast<unsigned long long>(stats.nConsumed -
+                                                  nLastConsumed),
+                  static_cast<unsigned long long>(stats.nGaps),
+                  static_cast<unsigned long long>(stats.nLost),
+                  static_cast<unsigned long long>(stats.nLag), nLastPrice);
+      std::fflush(stdout);
+      nLastConsumed = stats.nConsumed;
+      nNextReportNs += 1000000000;
+    }
+  }
+  return 0;
+}
+
+void usage(const char *pszProgram) {
+  std::printf(
+      "Usage:\n"
+      "  %s --synthetic <instruments> [--rate <ticks/s>] [options]\n"
+      "  %s --front <tcp://host:port> --broker <id> --user <id>\n"
+      "     --instruments <id:tick,...> [options]   (password: CTP_PASSWORD)\n"
+      "  %s --client [options]\n"
+      "Options:\n"
+      "  --shm <path>       shared memory file (default %s)\n"
+      "  --ring <slots>     broadcast ring capacity (default 65536)\n"
+      "  --seconds <n>      exit after n seconds (default: until SIGINT)\n",
+      pszProgram, pszProgram, pszProgram, ctp::kShmMdDefaultPath);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  DaemonOptions options;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+      options.strPath = argv[++i];
+    } else if (std::strcmp(argv[i], "--ring") == 0 && i + 1 < argc) {
+      options.nRingCapacity = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) {
+      options.nSynthetic = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+      options.nRate = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--front") == 0 && i + 1 < argc) {
+      options.pszFront = argv[++i];
+    } else if (std::strcmp(argv[i], "--broker") == 0 && i + 1 < argc) {
+      options.pszBrokerID = argv[++i];
+    } else if (std::strcmp(argv[i], "--user") == 0 && i + 1 < argc) {
+      options.pszUserID = argv[++i];
+    } else if (std::strcmp(argv[i], "--instruments") == 0 && i + 1 < argc) {
+      options.pszInstruments = argv[++i];
+    } else if (std::strcmp(argv[i], "--client") == 0) {
+      options.bClient = true;
+    } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      options.nSeconds = std::atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  ctp::LoggerOptions logOptions;
+  logOptions.strPrefix = "md_daemon";
+  logOptions.bConsole = true;
+  ctp::Logger::Instance().Start(logOptions);
+
+  int nResult;
+  if (options.bClient) {
+    nResult = runClient(options);
+  } else if (options.nSynthetic > 0) {
+    nResult = runSynthetic(options);
+  } else if (options.pszFront) {
+    nResult = runFront(options);
+  } else {
+    usage(argv[0]);
+    nResult = 1;
+  }
+  ctp::Logger::Instance().Stop();
+  return nResult;
+}
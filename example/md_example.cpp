@@ -1,61 +1,65 @@
 #include "ThostFtdcMdApi.h"
+#include "ctp_latency.h"
+#include "ctp_log.h"
+#include "ctp_md_dispatcher.h"
+#include "ctp_reflect.h"
+#include "ctp_request_tracker.h"
+#include "ctp_subscription_manager.h"
+#include "ctp_thread_placement.h"
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
-#include <string>
 #include <thread>
-#include <vector>
 
 
 // 行情示例实现
 class MdExample : public CThostFtdcMdSpi {
 private:
   CThostFtdcMdApi *m_pMdApi;
-  int m_nRequestID;
+  // 原子分配RequestID，可被多个线程并发调用
+  ctp::RequestTracker m_requests;
+  // 订阅集合，断线重连登录后自动重放已确认的合约
+  ctp::SubscriptionManager m_subscriptions;
 
 public:
-  MdExample() : m_pMdApi(nullptr), m_nRequestID(0) {}
+  MdExample() : m_pMdApi(nullptr) {
+    // 示例：订阅一些常见合约的行情
+    // 注意：这里只是示例，实际合约代码需要根据市场情况确定
+    m_subscriptions.Add({
+        "IF2501", // 沪深300股指期货
+        "IC2501", // 中证500股指期货
+        "IH2501", // 上证50股指期货
+        "TF2501", // 5年期国债期货
+        "T2501"   // 10年期国债期货
+    });
+  }
 
-  void SetMdApi(CThostFtdcMdApi *pApi) { m_pMdApi = pApi; }
+  void SetMdApi(CThostFtdcMdApi *pApi) {
+    m_pMdApi = pApi;
+    m_subscriptions.SetMdApi(pApi);
+  }
 
-  int GetNextRequestID() { return ++m_nRequestID; }
+  int GetNextRequestID() { return m_requests.NextRequestID(); }
 
   // 前置机连接成功
   void OnFrontConnected() override {
-    std::cout << "[MD] Connected to front server successfully" << std::endl;
+    CTP_LOG_INFO("[MD] Connected to front server successfully");
 
     // 连接成功后可以进行用户登录
-    std::cout << "[MD] Ready for login..." << std::endl;
+    CTP_LOG_INFO("[MD] Ready for login...");
   }
 
   // 前置机连接断开
   void OnFrontDisconnected(int nReason) override {
-    std::cout << "[MD] Disconnected from front server, reason: ";
-    switch (nReason) {
-    case 0x1001:
-      std::cout << "Network read failed" << std::endl;
-      break;
-    case 0x1002:
-      std::cout << "Network write failed" << std::endl;
-      break;
-    case 0x2001:
-      std::cout << "Heartbeat timeout" << std::endl;
-      break;
-    case 0x2002:
-      std::cout << "Heartbeat send failed" << std::endl;
-      break;
-    case 0x2003:
-      std::cout << "Wrong heartbeat message" << std::endl;
-      break;
-    default:
-      std::cout << "Unknown reason (" << nReason << ")" << std::endl;
-      break;
-    }
+    CTP_LOG_WARN("[MD] Disconnected from front server, reason: %s (0x%x)",
+                 disconnectReason(nReason), nReason);
+    m_subscriptions.OnDisconnected();
   }
 
   // 心跳超时警告
   void OnHeartBeatWarning(int nTimeLapse) override {
-    std::cout << "[MD] Heartbeat warning, time elapsed: " << nTimeLapse
-              << " seconds" << std::endl;
+    CTP_LOG_WARN("[MD] Heartbeat warning, time elapsed: %d seconds",
+                 nTimeLapse);
   }
 
   // 用户登录响应
@@ -63,22 +67,19 @@ public:
                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                       bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
-      std::cout << "[MD] Login successful" << std::endl;
+      CTP_LOG_INFO("[MD] Login successful");
       if (pRspUserLogin) {
-        std::cout << "[MD] Trading Day: " << pRspUserLogin->TradingDay
-                  << std::endl;
-        std::cout << "[MD] Session ID: " << pRspUserLogin->SessionID
-                  << std::endl;
+        CTP_LOG_INFO("[MD] Trading Day: %s", pRspUserLogin->TradingDay);
+        CTP_LOG_INFO("[MD] Session ID: %d", pRspUserLogin->SessionID);
       }
 
       // 登录成功后可以订阅行情
-      subscribeMarketData();
+      m_subscriptions.OnLogin();
 
     } else {
-      std::cout << "[MD] Login failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1)
-                << ", ErrorMsg: " << (pRspInfo ? pRspInfo->ErrorMsg : "Unknown")
-                << std::endl;
+      CTP_LOG_ERROR("[MD] Login failed, ErrorID: %d, ErrorMsg: %s",
+                    pRspInfo ? pRspInfo->ErrorID : -1,
+                    pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
     }
   }
 
@@ -86,7 +87,7 @@ public:
   void OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
                        CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                        bool bIsLast) override {
-    std::cout << "[MD] User logout response received" << std::endl;
+    CTP_LOG_INFO("[MD] User logout response received");
   }
 
   // 订阅行情响应
@@ -96,15 +97,16 @@ public:
                      bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
       if (pSpecificInstrument) {
-        std::cout << "[MD] Subscribe market data successful for: "
-                  << pSpecificInstrument->InstrumentID << std::endl;
+        CTP_LOG_INFO("[MD] Subscribe market data successful for: %s",
+                     pSpecificInstrument->InstrumentID);
       }
     } else {
-      std::cout << "[MD] Subscribe market data failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1)
-                << ", ErrorMsg: " << (pRspInfo ? pRspInfo->ErrorMsg : "Unknown")
-                << std::endl;
+      CTP_LOG_ERROR("[MD] Subscribe market data failed, ErrorID: %d, "
+                    "ErrorMsg: %s",
+                    pRspInfo ? pRspInfo->ErrorID : -1,
+                    pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
     }
+    m_subscriptions.OnRspSubMarketData(pSpecificInstrument, pRspInfo, bIsLast);
   }
 
   // 取消订阅行情响应
@@ -114,53 +116,26 @@ public:
                        bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
       if (pSpecificInstrument) {
-        std::cout << "[MD] Unsubscribe market data successful for: "
-                  << pSpecificInstrument->InstrumentID << std::endl;
+        CTP_LOG_INFO("[MD] Unsubscribe market data successful for: %s",
+                     pSpecificInstrument->InstrumentID);
       }
     } else {
-      std::cout << "[MD] Unsubscribe market data failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1) << std::endl;
+      CTP_LOG_ERROR("[MD] Unsubscribe market data failed, ErrorID: %d",
+                    pRspInfo ? pRspInfo->ErrorID : -1);
     }
+    m_subscriptions.OnRspUnSubMarketData(pSpecificInstrument, pRspInfo,
+                                         bIsLast);
   }
 
-  // 深度行情通知
+  // 深度行情通知（由MdDispatcher的消费线程回调，不占用CTP网络线程）
   void OnRtnDepthMarketData(
       CThostFtdcDepthMarketDataField *pDepthMarketData) override {
-    if (pDepthMarketData) {
-      std::cout << "[MD] Market Data for " << pDepthMarketData->InstrumentID
-                << ":" << std::endl;
-      std::cout << "  Update Time: " << pDepthMarketData->UpdateTime
-                << std::endl;
-      std::cout << "  Last Price: " << pDepthMarketData->LastPrice << std::endl;
-      std::cout << "  Volume: " << pDepthMarketData->Volume << std::endl;
-      std::cout << "  Turnover: " << pDepthMarketData->Turnover << std::endl;
-      std::cout << "  Open Interest: " << pDepthMarketData->OpenInterest
-                << std::endl;
-
-      // 买卖档位信息
-      std::cout << "  Bid1: " << pDepthMarketData->BidPrice1 << " x "
-                << pDepthMarketData->BidVolume1 << std::endl;
-      std::cout << "  Ask1: " << pDepthMarketData->AskPrice1 << " x "
-                << pDepthMarketData->AskVolume1 << std::endl;
-
-      // 更多档位信息...
-      if (pDepthMarketData->BidPrice2 > 0) {
-        std::cout << "  Bid2: " << pDepthMarketData->BidPrice2 << " x "
-                  << pDepthMarketData->BidVolume2 << std::endl;
-      }
-      if (pDepthMarketData->AskPrice2 > 0) {
-        std::cout << "  Ask2: " << pDepthMarketData->AskPrice2 << " x "
-                  << pDepthMarketData->AskVolume2 << std::endl;
-      }
-
-      std::cout << "  Upper Limit: " << pDepthMarketData->UpperLimitPrice
-                << std::endl;
-      std::cout << "  Lower Limit: " << pDepthMarketData->LowerLimitPrice
-                << std::endl;
-      std::cout << "  Settlement Price: " << pDepthMarketData->SettlementPrice
-                << std::endl;
-      std::cout << "  -------------------" << std::endl;
-    }
+    if (!pDepthMarketData)
+      return;
+    // 字段列表来自生成的反射描述，写入栈上的缓冲区，不做堆分配
+    char szJson[2048];
+    if (ctp::WriteJson(*pDepthMarketData, szJson, sizeof(szJson)))
+      CTP_LOG_INFO("[MD] Market Data: %s", szJson);
   }
 
   // 订阅询价响应
@@ -169,52 +144,36 @@ public:
                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                       bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
-      std::cout << "[MD] Subscribe for quote response successful" << std::endl;
+      CTP_LOG_INFO("[MD] Subscribe for quote response successful");
     } else {
-      std::cout << "[MD] Subscribe for quote response failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1) << std::endl;
+      CTP_LOG_ERROR("[MD] Subscribe for quote response failed, ErrorID: %d",
+                    pRspInfo ? pRspInfo->ErrorID : -1);
     }
   }
 
   // 询价通知
   void OnRtnForQuoteRsp(CThostFtdcForQuoteRspField *pForQuoteRsp) override {
     if (pForQuoteRsp) {
-      std::cout << "[MD] For Quote Response:" << std::endl;
-      std::cout << "  Instrument: " << pForQuoteRsp->InstrumentID << std::endl;
-      std::cout << "  Quote ID: " << pForQuoteRsp->ForQuoteSysID << std::endl;
+      CTP_LOG_INFO("[MD] For Quote Response: Instrument: %s, Quote ID: %s",
+                   pForQuoteRsp->InstrumentID, pForQuoteRsp->ForQuoteSysID);
     }
   }
 
 private:
-  // 订阅行情数据
-  void subscribeMarketData() {
-    if (!m_pMdApi)
-      return;
-
-    // 示例：订阅一些常见合约的行情
-    // 注意：这里只是示例，实际合约代码需要根据市场情况确定
-    std::vector<std::string> instruments = {
-        "IF2501", // 沪深300股指期货
-        "IC2501", // 中证500股指期货
-        "IH2501", // 上证50股指期货
-        "TF2501", // 5年期国债期货
-        "T2501"   // 10年期国债期货
-    };
-
-    // 转换为CTP API需要的格式
-    std::vector<char *> instrumentIDs;
-    for (auto &instrument : instruments) {
-      instrumentIDs.push_back(const_cast<char *>(instrument.c_str()));
-    }
-
-    int ret = m_pMdApi->SubscribeMarketData(instrumentIDs.data(),
-                                            instrumentIDs.size());
-    if (ret == 0) {
-      std::cout << "[MD] Subscribe market data request sent for "
-                << instrumentIDs.size() << " instruments" << std::endl;
-    } else {
-      std::cout << "[MD] Subscribe market data request failed, ret = " << ret
-                << std::endl;
+  static const char *disconnectReason(int nReason) {
+    switch (nReason) {
+    case 0x1001:
+      return "Network read failed";
+    case 0x1002:
+      return "Network write failed";
+    case 0x2001:
+      return "Heartbeat timeout";
+    case 0x2002:
+      return "Heartbeat send failed";
+    case 0x2003:
+      return "Wrong heartbeat message";
+    default:
+      return "Unknown reason";
     }
   }
 };
@@ -224,6 +183,14 @@ extern "C" {
 void RunMdExample() {
   std::cout << "\n=== Market Data Example ===" << std::endl;
 
+  // 回调中的日志由后台线程格式化并写入文件，不阻塞CTP线程；
+  // 示例同时输出到控制台
+  ctp::LoggerOptions logOptions;
+  logOptions.bConsole = true;
+  ctp::Logger::Instance().Start(logOptions);
+  // 分发器记录的各阶段延迟定期写入./log/latency.txt
+  ctp::LatencyRecorder::Instance().Start();
+
   // 创建行情API
   CThostFtdcMdApi *pMdApi = CThostFtdcMdApi::CreateFtdcMdApi("./md_flow/");
   if (!pMdApi) {
@@ -235,15 +202,28 @@ void RunMdExample() {
   MdExample mdSpi;
   mdSpi.SetMdApi(pMdApi);
 
+  // 行情经分发器转到独立线程处理，CTP回调线程只负责入队
+  // 设置CTP_MD_CPUS（如"3"）可把消费线程绑定到指定CPU
+  ctp::MdDispatcherOptions dispatcherOptions;
+  if (const char *pszCpus = std::getenv("CTP_MD_CPUS"))
+    ctp::ParseCpuList(pszCpus, dispatcherOptions.consumerPlacement.cpus);
+  ctp::MdDispatcher dispatcher(&mdSpi, dispatcherOptions);
+  dispatcher.Start();
+
   // 注册SPI
-  pMdApi->RegisterSpi(&mdSpi);
+  pMdApi->RegisterSpi(&dispatcher);
 
   std::cout << "Market Data API initialized successfully" << std::endl;
   std::cout << "In production, you would:" << std::endl;
   std::cout << "1. Register front server: "
                "pMdApi->RegisterFront(\"tcp://server:port\");"
             << std::endl;
-  std::cout << "2. Initialize: pMdApi->Init();" << std::endl;
+  std::cout << "2. Initialize and capture CTP threads: "
+               "auto tids = ctp::InitAndCaptureThreads(pMdApi);"
+            << std::endl;
+  std::cout << "   Pin them: ctp::ApplyThreadPlacement(tids, placement, "
+               "\"md.api\");"
+            << std::endl;
   std::cout << "3. Wait for connection and perform login" << std::endl;
   std::cout << "4. Subscribe to market data for specific instruments"
             << std::endl;
@@ -253,6 +233,10 @@ void RunMdExample() {
 
   // 释放资源
   pMdApi->Release();
-  std::cout << "Market Data API released" << std::endl;
+  dispatcher.Stop();
+  ctp::LatencyRecorder::Instance().Stop();
+  std::cout << "Market Data API released, dispatched "
+            << dispatcher.GetDispatchCount() << " ticks, dropped "
+            << dispatcher.GetDropCount() << std::endl;
 }
 }
\ No newline at end of file
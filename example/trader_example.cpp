@@ -1,60 +1,217 @@
 #include "ThostFtdcTraderApi.h"
+#include "ctp_log.h"
+#ifndef _WIN32
+#include "ctp_instrument_cache.h"
+#include "ctp_trader_checkpoint.h"
+#endif
+#include "ctp_order_state.h"
+#include "ctp_query_scheduler.h"
+#include "ctp_request_tracker.h"
+#include "ctp_risk_gate.h"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 
 // 交易示例实现
 class TraderExample : public CThostFtdcTraderSpi {
 private:
   CThostFtdcTraderApi *m_pTraderApi;
-  int m_nRequestID;
+  // 原子分配RequestID，并把应答关联回发起请求的调用方
+  ctp::RequestTracker m_requests;
+  // 所有ReqQry*经由调度器按流控节奏发送
+  std::unique_ptr<ctp::QueryScheduler> m_pScheduler;
+  // 报单、持仓与盈亏状态，只在CTP回调线程上访问
+  ctp::InstrumentTable m_instruments;
+  ctp::OrderStateEngine m_orderState;
+  // 报单前风控，在途报单由报单回报维护
+  ctp::RiskGate m_riskGate;
+  // 登录应答，报单与撤单从中取经纪公司、投资者和本会话的OrderRef起点
+  CThostFtdcRspUserLoginField m_login;
+  int m_nNextOrderRef;
+#ifndef _WIN32
+  // 按交易日持久化的合约与费率缓存，重启时无需重新分页查询
+  ctp::InstrumentCache m_instrumentCache;
+  // 私有流日志与检查点，重启后以RESUME续接而不是QUICK丢单
+  ctp::TraderCheckpoint m_checkpoint;
+#endif
 
 public:
-  TraderExample() : m_pTraderApi(nullptr), m_nRequestID(0) {}
+  TraderExample()
+      : m_pTraderApi(nullptr), m_orderState(m_instruments),
+        m_riskGate(m_instruments, m_orderState), m_login(),
+        m_nNextOrderRef(1)
+#ifndef _WIN32
+        ,
+        m_checkpoint(m_orderState, m_instruments)
+#endif
+  {
+  }
+
+  // Init()之前调用：恢复上次的报单与持仓状态，返回私有流的订阅模式
+  THOST_TE_RESUME_TYPE OpenCheckpoint(const char *pszFlowPath) {
+#ifndef _WIN32
+    TThostFtdcDateType szTradingDay;
+    expectedTradingDay(szTradingDay);
+    return m_checkpoint.Open(pszFlowPath, szTradingDay);
+#else
+    (void)pszFlowPath;
+    return THOST_TERT_QUICK;
+#endif
+  }
+
+  void SetTraderApi(CThostFtdcTraderApi *pApi) {
+    m_pTraderApi = pApi;
+    m_pScheduler.reset(pApi ? new ctp::QueryScheduler(pApi) : nullptr);
+  }
 
-  void SetTraderApi(CThostFtdcTraderApi *pApi) { m_pTraderApi = pApi; }
+  void Stop() {
+    if (m_pScheduler)
+      m_pScheduler->Stop();
+  }
+
+  int GetNextRequestID() { return m_requests.NextRequestID(); }
 
-  int GetNextRequestID() { return ++m_nRequestID; }
+  // 报限价单，先经风控检查。风控与报单回报共用状态，须在CTP回调线程上调用，
+  // 例如在OnRtnOrder/OnRtnTrade中根据成交情况补单
+  bool InsertLimitOrder(const char *pszInstrumentID, const char *pszExchangeID,
+                        char cDirection, char cOffsetFlag, double dPrice,
+                        int nVolume) {
+    if (!m_pTraderApi)
+      return false;
+    CThostFtdcInputOrderField order = {};
+    std::strncpy(order.BrokerID, m_login.BrokerID, sizeof(order.BrokerID) - 1);
+    std::strncpy(order.InvestorID, m_login.UserID,
+                 sizeof(order.InvestorID) - 1);
+    std::strncpy(order.UserID, m_login.UserID, sizeof(order.UserID) - 1);
+    std::strncpy(order.InstrumentID, pszInstrumentID,
+                 sizeof(order.InstrumentID) - 1);
+    std::strncpy(order.ExchangeID, pszExchangeID, sizeof(order.ExchangeID) - 1);
+    std::snprintf(order.OrderRef, sizeof(order.OrderRef), "%d",
+                  m_nNextOrderRef);
+    order.OrderPriceType = THOST_FTDC_OPT_LimitPrice;
+    order.Direction = cDirection;
+    order.CombOffsetFlag[0] = cOffsetFlag;
+    order.CombHedgeFlag[0] = THOST_FTDC_HF_Speculation;
+    order.LimitPrice = dPrice;
+    order.VolumeTotalOriginal = nVolume;
+    order.TimeCondition = THOST_FTDC_TC_GFD;
+    order.VolumeCondition = THOST_FTDC_VC_AV;
+    order.MinVolume = 1;
+    order.ContingentCondition = THOST_FTDC_CC_Immediately;
+    order.ForceCloseReason = THOST_FTDC_FCC_NotForceClose;
+
+    ctp::RiskReject eReject = m_riskGate.CheckOrder(order);
+    if (eReject != ctp::RiskReject::None) {
+      CTP_LOG_WARN("[Risk] Order rejected: %s %s",
+                   ctp::GetRiskRejectName(eReject), pszInstrumentID);
+      return false;
+    }
+    ++m_nNextOrderRef;
+    order.RequestID = GetNextRequestID();
+    if (m_pTraderApi->ReqOrderInsert(&order, order.RequestID) != 0) {
+      // 未发出的报单不会有回报，从在途报单中移除
+      m_riskGate.OnInsertRejected(order);
+      return false;
+    }
+    return true;
+  }
+
+  // 撤单，只受撤单频率限制；线程要求同InsertLimitOrder()
+  bool CancelOrder(const ctp::OrderState &order) {
+    if (!m_pTraderApi || !order.IsActive())
+      return false;
+    CThostFtdcInputOrderActionField action = {};
+    std::strncpy(action.BrokerID, m_login.BrokerID,
+                 sizeof(action.BrokerID) - 1);
+    std::strncpy(action.InvestorID, m_login.UserID,
+                 sizeof(action.InvestorID) - 1);
+    std::strncpy(action.UserID, m_login.UserID, sizeof(action.UserID) - 1);
+    std::strncpy(action.InstrumentID,
+                 m_instruments.GetInstrumentID(order.nInstrument),
+                 sizeof(action.InstrumentID) - 1);
+    std::memcpy(action.ExchangeID, order.szExchangeID,
+                sizeof(action.ExchangeID));
+    std::memcpy(action.OrderRef, order.szOrderRef, sizeof(action.OrderRef));
+    action.FrontID = order.nFrontID;
+    action.SessionID = order.nSessionID;
+    action.ActionFlag = THOST_FTDC_AF_Delete;
+
+    ctp::RiskReject eReject = m_riskGate.CheckCancel(action);
+    if (eReject != ctp::RiskReject::None) {
+      CTP_LOG_WARN("[Risk] Cancel rejected: %s %s",
+                   ctp::GetRiskRejectName(eReject), action.InstrumentID);
+      return false;
+    }
+    action.RequestID = GetNextRequestID();
+    return m_pTraderApi->ReqOrderAction(&action, action.RequestID) == 0;
+  }
+
+  // 查询合约的最小变动价位与涨跌停价交给风控，登录后对持仓合约自动调用，
+  // 其他合约须在报单前调用，之前的报单以UnknownInstrument或NoPriceLimits
+  // 拒绝。应答成功时回调在CTP回调线程上，与报单回报同一线程；
+  // 发送失败时可能在调度线程上，此时不访问风控
+  void QueryPriceLimits(const std::string &strInstrument) {
+    if (!m_pScheduler)
+      return;
+    CThostFtdcQryInstrumentField req = {};
+    std::strncpy(req.InstrumentID, strInstrument.c_str(),
+                 sizeof(req.InstrumentID) - 1);
+    m_pScheduler->Submit(
+        req, ctp::QueryPriority::Normal,
+        [this](const std::vector<CThostFtdcInstrumentField> &instruments,
+               const CThostFtdcRspInfoField &rspInfo) {
+          if (rspInfo.ErrorID != 0 || instruments.empty())
+            return;
+          const CThostFtdcInstrumentField &instrument = instruments.front();
+          m_instruments.Add(instrument.InstrumentID, instrument.PriceTick);
+          CThostFtdcQryDepthMarketDataField reqMd = {};
+          std::memcpy(reqMd.InstrumentID, instrument.InstrumentID,
+                      sizeof(reqMd.InstrumentID));
+          m_pScheduler->Submit(
+              reqMd, ctp::QueryPriority::Normal,
+              [this](const std::vector<CThostFtdcDepthMarketDataField> &ticks,
+                     const CThostFtdcRspInfoField &mdRspInfo) {
+                if (mdRspInfo.ErrorID != 0)
+                  return;
+                for (const auto &tick : ticks)
+                  m_riskGate.OnTick(m_instruments.Find(tick.InstrumentID),
+                                    tick.UpperLimitPrice,
+                                    tick.LowerLimitPrice);
+              });
+        });
+  }
 
   // 前置机连接成功
   void OnFrontConnected() override {
-    std::cout << "[Trader] Connected to front server successfully" << std::endl;
+    CTP_LOG_INFO("[Trader] Connected to front server successfully");
 
     // 连接成功后，可以进行用户认证
     // 在实际应用中，这里应该调用认证接口
-    std::cout << "[Trader] Ready for authentication..." << std::endl;
+    CTP_LOG_INFO("[Trader] Ready for authentication...");
   }
 
   // 前置机连接断开
   void OnFrontDisconnected(int nReason) override {
-    std::cout << "[Trader] Disconnected from front server, reason: ";
-    switch (nReason) {
-    case 0x1001:
-      std::cout << "Network read failed" << std::endl;
-      break;
-    case 0x1002:
-      std::cout << "Network write failed" << std::endl;
-      break;
-    case 0x2001:
-      std::cout << "Heartbeat timeout" << std::endl;
-      break;
-    case 0x2002:
-      std::cout << "Heartbeat send failed" << std::endl;
-      break;
-    case 0x2003:
-      std::cout << "Wrong heartbeat message" << std::endl;
-      break;
-    default:
-      std::cout << "Unknown reason (" << nReason << ")" << std::endl;
-      break;
-    }
+    CTP_LOG_WARN("[Trader] Disconnected from front server, reason: %s (0x%x)",
+                 disconnectReason(nReason), nReason);
+    if (m_pScheduler)
+      m_pScheduler->OnFrontDisconnected();
+    m_requests.OnFrontDisconnected();
   }
 
   // 心跳超时警告
   void OnHeartBeatWarning(int nTimeLapse) override {
-    std::cout << "[Trader] Heartbeat warning, time elapsed: " << nTimeLapse
-              << " seconds" << std::endl;
+    CTP_LOG_WARN("[Trader] Heartbeat warning, time elapsed: %d seconds",
+                 nTimeLapse);
   }
 
   // 客户端认证响应
@@ -62,13 +219,13 @@ public:
                          CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                          bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
-      std::cout << "[Trader] Authentication successful" << std::endl;
+      CTP_LOG_INFO("[Trader] Authentication successful");
       // 认证成功后可以进行用户登录
     } else {
-      std::cout << "[Trader] Authentication failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1)
-                << ", ErrorMsg: " << (pRspInfo ? pRspInfo->ErrorMsg : "Unknown")
-                << std::endl;
+      CTP_LOG_ERROR("[Trader] Authentication failed, ErrorID: %d, "
+                    "ErrorMsg: %s",
+                    pRspInfo ? pRspInfo->ErrorID : -1,
+                    pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
     }
   }
 
@@ -77,24 +234,31 @@ public:
                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                       bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
-      std::cout << "[Trader] Login successful" << std::endl;
+      CTP_LOG_INFO("[Trader] Login successful");
       if (pRspUserLogin) {
-        std::cout << "[Trader] Trading Day: " << pRspUserLogin->TradingDay
-                  << std::endl;
-        std::cout << "[Trader] Session ID: " << pRspUserLogin->SessionID
-                  << std::endl;
-        std::cout << "[Trader] Front ID: " << pRspUserLogin->FrontID
-                  << std::endl;
+        CTP_LOG_INFO("[Trader] Trading Day: %s, Session ID: %d, Front ID: %d",
+                     pRspUserLogin->TradingDay, pRspUserLogin->SessionID,
+                     pRspUserLogin->FrontID);
+        m_riskGate.SetSession(pRspUserLogin->FrontID,
+                              pRspUserLogin->SessionID);
+        m_login = *pRspUserLogin;
+        m_nNextOrderRef = std::atoi(pRspUserLogin->MaxOrderRef) + 1;
+#ifndef _WIN32
+        m_checkpoint.OnLogin(pRspUserLogin->TradingDay);
+#endif
       }
 
       // 登录成功后可以查询账户信息、持仓信息等
+      if (m_pScheduler)
+        m_pScheduler->Start();
       queryTradingAccount();
+      if (pRspUserLogin)
+        queryInvestorPosition(*pRspUserLogin);
 
     } else {
-      std::cout << "[Trader] Login failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1)
-                << ", ErrorMsg: " << (pRspInfo ? pRspInfo->ErrorMsg : "Unknown")
-                << std::endl;
+      CTP_LOG_ERROR("[Trader] Login failed, ErrorID: %d, ErrorMsg: %s",
+                    pRspInfo ? pRspInfo->ErrorID : -1,
+                    pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
     }
   }
 
@@ -102,26 +266,72 @@ public:
   void OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
                        CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                        bool bIsLast) override {
-    std::cout << "[Trader] User logout response received" << std::endl;
+    CTP_LOG_INFO("[Trader] User logout response received");
   }
 
-  // 查询资金账户响应
+  // 查询资金账户响应，交给调度器拼装后回调
   void OnRspQryTradingAccount(CThostFtdcTradingAccountField *pTradingAccount,
                               CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                               bool bIsLast) override {
-    if (pRspInfo && pRspInfo->ErrorID == 0) {
-      if (pTradingAccount) {
-        std::cout << "[Trader] Trading Account Info:" << std::endl;
-        std::cout << "  Account ID: " << pTradingAccount->AccountID
-                  << std::endl;
-        std::cout << "  Available: " << pTradingAccount->Available << std::endl;
-        std::cout << "  Balance: " << pTradingAccount->Balance << std::endl;
-        std::cout << "  Margin: " << pTradingAccount->CurrMargin << std::endl;
-      }
-    } else {
-      std::cout << "[Trader] Query trading account failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1) << std::endl;
-    }
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pTradingAccount, pRspInfo, nRequestID, bIsLast);
+  }
+
+  // 查询持仓响应
+  void
+  OnRspQryInvestorPosition(CThostFtdcInvestorPositionField *pInvestorPosition,
+                           CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                           bool bIsLast) override {
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pInvestorPosition, pRspInfo, nRequestID, bIsLast);
+  }
+
+  // 合约与费率查询响应，由InstrumentCache经调度器发起
+  void OnRspQryInstrument(CThostFtdcInstrumentField *pInstrument,
+                          CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                          bool bIsLast) override {
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pInstrument, pRspInfo, nRequestID, bIsLast);
+  }
+
+  void OnRspQryInstrumentCommissionRate(
+      CThostFtdcInstrumentCommissionRateField *pInstrumentCommissionRate,
+      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+      bool bIsLast) override {
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pInstrumentCommissionRate, pRspInfo, nRequestID,
+                          bIsLast);
+  }
+
+  void OnRspQryInstrumentMarginRate(
+      CThostFtdcInstrumentMarginRateField *pInstrumentMarginRate,
+      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+      bool bIsLast) override {
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pInstrumentMarginRate, pRspInfo, nRequestID,
+                          bIsLast);
+  }
+
+  // 涨跌停价查询响应
+  void OnRspQryDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData,
+      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+      bool bIsLast) override {
+    if (m_pScheduler)
+      m_pScheduler->OnRsp(pDepthMarketData, pRspInfo, nRequestID, bIsLast);
+  }
+
+  // 错误应答
+  void OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) override {
+    if (m_pScheduler &&
+        m_pScheduler->OnRspError(pRspInfo, nRequestID, bIsLast))
+      return;
+    if (m_requests.OnRspError(pRspInfo, nRequestID, bIsLast))
+      return;
+    CTP_LOG_ERROR("[Trader] Error response, ErrorID: %d, ErrorMsg: %s",
+                  pRspInfo ? pRspInfo->ErrorID : -1,
+                  pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
   }
 
   // 报单录入响应
@@ -129,52 +339,172 @@ public:
                         CThostFtdcRspInfoField *pRspInfo, int nRequestID,
                         bool bIsLast) override {
     if (pRspInfo && pRspInfo->ErrorID == 0) {
-      std::cout << "[Trader] Order insert successful" << std::endl;
+      CTP_LOG_INFO("[Trader] Order insert successful");
     } else {
-      std::cout << "[Trader] Order insert failed, ErrorID: "
-                << (pRspInfo ? pRspInfo->ErrorID : -1)
-                << ", ErrorMsg: " << (pRspInfo ? pRspInfo->ErrorMsg : "Unknown")
-                << std::endl;
+      if (pInputOrder)
+        m_riskGate.OnInsertRejected(*pInputOrder);
+      CTP_LOG_ERROR("[Trader] Order insert failed, ErrorID: %d, ErrorMsg: %s",
+                    pRspInfo ? pRspInfo->ErrorID : -1,
+                    pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
     }
   }
 
   // 报单通知
   void OnRtnOrder(CThostFtdcOrderField *pOrder) override {
-    if (pOrder) {
-      std::cout << "[Trader] Order notification:" << std::endl;
-      std::cout << "  Instrument: " << pOrder->InstrumentID << std::endl;
-      std::cout << "  Direction: " << pOrder->Direction << std::endl;
-      std::cout << "  Volume: " << pOrder->VolumeTotalOriginal << std::endl;
-      std::cout << "  Price: " << pOrder->LimitPrice << std::endl;
-      std::cout << "  Status: " << pOrder->OrderStatus << std::endl;
-    }
+    if (!pOrder)
+      return;
+    m_instruments.Add(pOrder->InstrumentID);
+#ifndef _WIN32
+    const ctp::OrderState *pState = m_checkpoint.OnRtnOrder(*pOrder);
+#else
+    const ctp::OrderState *pState = m_orderState.OnRtnOrder(*pOrder);
+#endif
+    if (!pState)
+      return;
+    m_riskGate.OnOrder(*pState);
+    CTP_LOG_INFO("[Trader] Order notification: Instrument: %s, "
+                 "Direction: %c, Volume: %d/%d, Price: %g, Status: %c%s",
+                 pOrder->InstrumentID, pState->cDirection,
+                 pState->nVolumeTraded, pState->nVolumeTotalOriginal,
+                 pState->dLimitPrice, pState->cOrderStatus,
+                 pState->IsActive() ? "" : " (done)");
   }
 
   // 成交通知
   void OnRtnTrade(CThostFtdcTradeField *pTrade) override {
-    if (pTrade) {
-      std::cout << "[Trader] Trade notification:" << std::endl;
-      std::cout << "  Instrument: " << pTrade->InstrumentID << std::endl;
-      std::cout << "  Direction: " << pTrade->Direction << std::endl;
-      std::cout << "  Volume: " << pTrade->Volume << std::endl;
-      std::cout << "  Price: " << pTrade->Price << std::endl;
-      std::cout << "  Trade Time: " << pTrade->TradeTime << std::endl;
-    }
+    if (!pTrade)
+      return;
+    std::uint32_t nInstrument = m_instruments.Add(pTrade->InstrumentID);
+#ifndef _WIN32
+    if (!m_checkpoint.OnRtnTrade(*pTrade))
+      return;
+#else
+    if (!m_orderState.OnRtnTrade(*pTrade))
+      return;
+#endif
+    const ctp::PositionState &position = m_orderState.GetPosition(nInstrument);
+    CTP_LOG_INFO("[Trader] Trade notification: Instrument: %s, "
+                 "Direction: %c, Volume: %d, Price: %g, Trade Time: %s, "
+                 "Position: %d/%d, Realized PnL: %.2f",
+                 pTrade->InstrumentID, pTrade->Direction, pTrade->Volume,
+                 pTrade->Price, pTrade->TradeTime, position.nLongPosition,
+                 position.nShortPosition, position.dRealizedPnL);
   }
 
 private:
-  // 查询资金账户
+  // 查询资金账户，被流控退回时由调度器自动重试
   void queryTradingAccount() {
-    if (!m_pTraderApi)
+    if (!m_pScheduler)
       return;
 
-    CThostFtdcQryTradingAccountField req = {0};
-    int ret = m_pTraderApi->ReqQryTradingAccount(&req, GetNextRequestID());
-    if (ret == 0) {
-      std::cout << "[Trader] Query trading account request sent" << std::endl;
-    } else {
-      std::cout << "[Trader] Query trading account request failed, ret = "
-                << ret << std::endl;
+    CThostFtdcQryTradingAccountField req = {};
+    m_pScheduler->Submit(
+        req, ctp::QueryPriority::High,
+        [](const std::vector<CThostFtdcTradingAccountField> &accounts,
+           const CThostFtdcRspInfoField &rspInfo) {
+          if (rspInfo.ErrorID != 0) {
+            CTP_LOG_ERROR("[Trader] Query trading account failed, "
+                          "ErrorID: %d",
+                          rspInfo.ErrorID);
+            return;
+          }
+          for (const auto &account : accounts)
+            CTP_LOG_INFO("[Trader] Trading Account Info: Account ID: %s, "
+                         "Available: %.2f, Balance: %.2f, Margin: %.2f",
+                         account.AccountID, account.Available,
+                         account.Balance, account.CurrMargin);
+        });
+  }
+
+  // 查询持仓，多段应答由调度器拼成一个结果
+  // 持仓到达后刷新合约缓存，只查询持仓合约的费率
+  void queryInvestorPosition(const CThostFtdcRspUserLoginField &login) {
+    if (!m_pScheduler)
+      return;
+
+    CThostFtdcQryInvestorPositionField req = {};
+    m_pScheduler->Submit(
+        req, ctp::QueryPriority::Normal,
+        [this,
+         login](const std::vector<CThostFtdcInvestorPositionField> &positions,
+                const CThostFtdcRspInfoField &rspInfo) {
+          std::vector<std::string> vecInstruments;
+          if (rspInfo.ErrorID != 0) {
+            CTP_LOG_ERROR("[Trader] Query investor position failed, "
+                          "ErrorID: %d",
+                          rspInfo.ErrorID);
+          } else {
+            CTP_LOG_INFO("[Trader] %d position records received",
+                         static_cast<int>(positions.size()));
+            for (const auto &position : positions) {
+              if (std::find(vecInstruments.begin(), vecInstruments.end(),
+                            position.InstrumentID) == vecInstruments.end())
+                vecInstruments.emplace_back(position.InstrumentID);
+            }
+          }
+          refreshInstrumentCache(login, vecInstruments);
+          for (const std::string &strInstrument : vecInstruments)
+            QueryPriceLimits(strInstrument);
+        });
+  }
+
+  // 映射当日的合约缓存，只在后台补齐缺失的部分
+  // 费率只查询vecRateInstruments，为空时不查询：逐合约查询全市场的费率
+  // 按每秒1次的流控需要数小时
+  void refreshInstrumentCache(const CThostFtdcRspUserLoginField &login,
+                              const std::vector<std::string> &vecInstruments) {
+#ifndef _WIN32
+    if (!m_pScheduler)
+      return;
+    if (!m_instrumentCache.IsOpen() ||
+        std::strcmp(m_instrumentCache.GetTradingDay(), login.TradingDay) != 0) {
+      if (!m_instrumentCache.Open("./trader_flow/", login.TradingDay))
+        return;
+    }
+    CTP_LOG_INFO("[Trader] %zu instruments cached for %s",
+                 m_instrumentCache.GetCount(), login.TradingDay);
+    ctp::InstrumentCacheRefreshOptions options;
+    options.strBrokerID = login.BrokerID;
+    options.strInvestorID = login.UserID;
+    options.bQueryRates = !vecInstruments.empty();
+    options.vecRateInstruments = vecInstruments;
+    m_instrumentCache.Refresh(*m_pScheduler, options);
+#else
+    (void)login;
+    (void)vecInstruments;
+#endif
+  }
+
+  // 按自然日推算本次登录的交易日：18点之后算下一天，周末顺延到周一。
+  // 不考虑节假日，实际应用应查交易日历；推算错误时检查点只是退回RESTART
+  static void expectedTradingDay(TThostFtdcDateType &szTradingDay) {
+    std::time_t nNow = std::time(nullptr);
+    std::tm tm = *std::localtime(&nNow);
+    if (tm.tm_hour >= 18)
+      ++tm.tm_mday;
+    tm.tm_hour = 12;
+    std::mktime(&tm);
+    if (tm.tm_wday == 6 || tm.tm_wday == 0) {
+      tm.tm_mday += tm.tm_wday == 6 ? 2 : 1;
+      std::mktime(&tm);
+    }
+    std::strftime(szTradingDay, sizeof(szTradingDay), "%Y%m%d", &tm);
+  }
+
+  static const char *disconnectReason(int nReason) {
+    switch (nReason) {
+    case 0x1001:
+      return "Network read failed";
+    case 0x1002:
+      return "Network write failed";
+    case 0x2001:
+      return "Heartbeat timeout";
+    case 0x2002:
+      return "Heartbeat send failed";
+    case 0x2003:
+      return "Wrong heartbeat message";
+    default:
+      return "Unknown reason";
     }
   }
 };
@@ -184,6 +514,12 @@ extern "C" {
 void RunTraderExample() {
   std::cout << "\n=== Trader Example ===" << std::endl;
 
+  // 回调中的日志由后台线程格式化并写入文件，不阻塞CTP线程；
+  // 示例同时输出到控制台
+  ctp::LoggerOptions logOptions;
+  logOptions.bConsole = true;
+  ctp::Logger::Instance().Start(logOptions);
+
   // 创建交易API
   CThostFtdcTraderApi *pTraderApi =
       CThostFtdcTraderApi::CreateFtdcTraderApi("./trader_flow/");
@@ -199,8 +535,8 @@ void RunTraderExample() {
   // 注册SPI
   pTraderApi->RegisterSpi(&traderSpi);
 
-  // 设置订阅模式
-  pTraderApi->SubscribePrivateTopic(THOST_TERT_QUICK);
+  // 设置订阅模式：私有流从检查点续接
+  pTraderApi->SubscribePrivateTopic(traderSpi.OpenCheckpoint("./trader_flow/"));
   pTraderApi->SubscribePublicTopic(THOST_TERT_QUICK);
 
   std::cout << "Trader API initialized successfully" << std::endl;
@@ -211,11 +547,15 @@ void RunTraderExample() {
   std::cout << "2. Initialize: pTraderApi->Init();" << std::endl;
   std::cout << "3. Wait for connection and perform authentication/login"
             << std::endl;
+  std::cout << "4. Trade from the callback thread: "
+               "traderSpi.InsertLimitOrder(...) / CancelOrder(...)"
+            << std::endl;
 
   // 模拟一些延迟
   std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
   // 释放资源
+  traderSpi.Stop();
   pTraderApi->Release();
   std::cout << "Trader API released" << std::endl;
 }
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ctp_instrument_table.h"
+#include "ctp_tick.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ctp {
+
+// 一根K线，价格为最小变动价位的整数倍（见TickNormalizer::ToPrice）
+struct Bar {
+  std::uint32_t nInstrument;
+  std::int32_t nStartTime; // TradingTimeKey，含
+  std::int32_t nEndTime;   // TradingTimeKey，不含
+  std::int32_t nOpen;
+  std::int32_t nHigh;
+  std::int32_t nLow;
+  std::int32_t nClose;
+  std::int32_t nTickCount;
+  std::int64_t nVolume;   // 由累计成交量的差分得到
+  double dTurnover;       // 由累计成交额的差分得到
+  std::int64_t nOpenInterest; // 收盘时的持仓量
+};
+
+// 交易时段[nStart, nEnd)，均为TradingTimeKey
+struct BarSession {
+  std::int32_t nStart;
+  std::int32_t nEnd;
+};
+
+struct BarEngineOptions {
+  // K线周期（毫秒），按交易日零点对齐
+  std::vector<std::int32_t> vecIntervalsMs = {1000, 60000, 300000};
+  // 交易时段，为空时不区分时段
+  // 时段开始前nSessionGraceMs内的行情（集合竞价）并入首根K线，时段结束后
+  // nSessionGraceMs内的行情（收盘行情）并入末根K线，其余时段外行情只更新
+  // 累计量基准。
+  std::vector<BarSession> vecSessions;
+  std::int32_t nSessionGraceMs = 60000;
+  // Advance()按时间收K线时额外等待的毫秒数，给各合约行情的先后差留出余量
+  std::int32_t nCloseDelayMs = 0;
+};
+
+class BarEngineSpi {
+public:
+  virtual ~BarEngineSpi() {}
+  // 批量交付同一周期内收盘的K线，pBars在回调返回前有效
+  virtual void OnBarsClosed(std::int32_t nIntervalMs, const Bar *pBars,
+                            std::size_t nCount) = 0;
+};
+
+// 多周期增量K线引擎
+// 同时维护所有合约、所有周期的K线。每个周期的数据按字段分列存放
+// （struct-of-arrays），按时间收K线时对全部合约做一次连续的比较扫描。
+// OnTick()只更新当前K线，被新行情挤出的K线先进入待交付队列，由Advance()或
+// Flush()统一批量回调。
+// 某合约进入新交易日（其自身时间大幅回退或累计成交量回退）时，先收掉该合约
+// 的全部K线并重置累计量基准，其它合约不受影响；首次见到的合约以当前累计量
+// 为基准，不计入成交量。
+// 非线程安全，应由单一线程驱动。
+class BarEngine {
+public:
+  BarEngine(BarEngineSpi *pSpi, const InstrumentTable &table,
+            const BarEngineOptions &options = {});
+
+  BarEngine(const BarEngine &) = delete;
+  BarEngine &operator=(const BarEngine &) = delete;
+
+  void OnTick(const CompactTick &tick);
+
+  // 收掉结束时间（加nCloseDelayMs）不晚于nNow的K线，并交付所有待交付的K线
+  void Advance(std::int32_t nNow);
+  // 以目前见到的最新行情时间调用Advance
+  void Advance() { Advance(m_nLatestTime); }
+  // 收掉全部K线并交付，用于收盘或停止
+  void Flush();
+
+  // 读取正在形成的K线，没有时返回false
+  bool GetCurrentBar(std::size_t nInterval, std::uint32_t nInstrument,
+                     Bar &bar) const;
+
+  std::size_t GetIntervalCount() const { return m_series.size(); }
+  std::int32_t GetIntervalMs(std::size_t nInterval) const {
+    return m_series[nInterval].nIntervalMs;
+  }
+
+private:
+  // 一个周期下全部合约的当前K线
+  struct Series {
+    std::int32_t nIntervalMs;
+    std::vector<std::int32_t> nStart; // kNoBar表示没有正在形成的K线
+    std::vector<std::int32_t> nOpen;
+    std::vector<std::int32_t> nHigh;
+    std::vector<std::int32_t> nLow;
+    std::vector<std::int32_t> nClose;
+    std::vector<std::int32_t> nTickCount;
+    std::vector<std::int64_t> nVolume;
+    std::vector<double> dTurnover;
+    std::vector<std::int64_t> nOpenInterest;
+    // 已收K线的结束时间，迟到的行情不会再生成更早的K线
+    std::vector<std::int32_t> nClosedUntil;
+    std::vector<std::uint8_t> bExpired; // Advance()的扫描结果
+    std::vector<Bar> pending;           // 待交付
+  };
+
+  bool mapToSession(std::int32_t &nTime) const;
+  void close(Series &series, std::uint32_t nInstrument);
+  void closeInstrument(std::uint32_t nInstrument);
+  void deliver();
+
+  BarEngineSpi *m_pSpi;
+  const InstrumentTable &m_table;
+  BarEngineOptions m_options;
+  std::vector<Series> m_series;
+
+  // 每个合约的累计量基准
+  std::vector<std::int32_t> m_lastVolume; // -1表示尚未见到行情
+  std::vector<double> m_lastTurnover;
+  std::vector<std::int32_t> m_lastTime;
+
+  std::int32_t m_nLatestTime;
+};
+
+} // namespace ctp
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ctp_spsc_ring.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace ctp {
+
+// 单生产者广播环形队列
+// 生产者从不等待：队列满时直接覆盖最旧的元素。每个读者自行维护读取序号，
+// 读到被覆盖的位置时得到Overrun，由读者决定跳到哪里继续。
+// 每个槽位带有seqlock序号（写入中为奇数，写完为2*(序号+1)），读者据此判断
+// 槽位中是否正是它要的那个序号，因此任意数量的读者都能无锁读取。
+template <typename T> class BroadcastRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "BroadcastRing element must be trivially copyable");
+
+public:
+  enum class ReadResult {
+    Ok,
+    Empty,  // 该序号尚未写入
+    Overrun // 该序号已被覆盖
+  };
+
+  explicit BroadcastRing(std::size_t nCapacity)
+      : m_nWriteSeq(0), m_nMask(roundUpPow2(nCapacity) - 1),
+        m_pSlots(nullptr) {
+    std::size_t nBytes = sizeof(Slot) * (m_nMask + 1);
+    m_pSlots = static_cast<Slot *>(
+        ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+    // 预先触页；槽位序号为0表示从未写入
+    std::memset(static_cast<void *>(m_pSlots), 0, nBytes);
+  }
+
+  ~BroadcastRing() {
+    ::operator delete(m_pSlots, std::align_val_t(kCacheLineSize));
+  }
+
+  BroadcastRing(const BroadcastRing &) = delete;
+  BroadcastRing &operator=(const BroadcastRing &) = delete;
+
+  // 生产者：写入一个元素
+  void Publish(const T &item) {
+    const std::uint64_t nSeq = m_nWriteSeq.load(std::memory_order_relaxed);
+    Slot &slot = m_pSlots[nSeq & m_nMask];
+    slot.nSeq.store(2 * nSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::uint64_t nWords[kWords] = {};
+    std::memcpy(nWords, &item, sizeof(T));
+    for (std::size_t i = 0; i < kWords; ++i)
+      slot.nWords[i].store(nWords[i], std::memory_order_relaxed);
+
+    slot.nSeq.store(2 * nSeq + 2, std::memory_order_release);
+    m_nWriteSeq.store(nSeq + 1, std::memory_order_release);
+  }
+
+  // 读者：读取序号为nSeq的元素
+  ReadResult Read(std::uint64_t nSeq, T &item) const {
+    const Slot &slot = m_pSlots[nSeq & m_nMask];
+    const std::uint64_t nExpected = 2 * nSeq + 2;
+    std::uint64_t nWords[kWords];
+    for (;;) {
+      const std::uint64_t nBegin = slot.nSeq.load(std::memory_order_acquire);
+      if (nBegin < nExpected)
+        return ReadResult::Empty;
+      if (nBegin > nExpected)
+        return ReadResult::Overrun;
+      for (std::size_t i = 0; i < kWords; ++i)
+        nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.nSeq.load(std::memory_order_relaxed) == nBegin)
+        break;
+      CpuRelax();
+    }
+    std::memcpy(static_cast<void *>(&item), nWords, sizeof(T));
+    return ReadResult::Ok;
+  }
+
+  // 下一个将要写入的序号，即已写入的元素总数
+  std::uint64_t GetWriteSeq() const {
+    return m_nWriteSeq.load(std::memory_order_acquire);
+  }
+
+  // 当前仍可读取的最旧序号
+  std::uint64_t GetOldestSeq() const {
+    const std::uint64_t nWriteSeq = GetWriteSeq();
+    return nWriteSeq > Capacity() ? nWriteSeq - Capacity() : 0;
+  }
+
+  std::size_t Capacity() const { return m_nMask + 1; }
+
+private:
+  static constexpr std::size_t kWords = (sizeof(T) + 7) / 8;
+
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<std::uint64_t> nSeq;
+    std::atomic<std::uint64_t> nWords[kWords];
+  };
+
+  static std::size_t roundUpPow2(std::size_t n) {
+    std::size_t nResult = 2;
+    while (nResult < n)
+      nResult <<= 1;
+    return nResult;
+  }
+
+  // 生产者独占的缓存行
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> m_nWriteSeq;
+
+  // 只读共享的缓存行
+  alignas(kCacheLineSize) const std::size_t m_nMask;
+  Slot *m_pSlots;
+};
+
+} // namespace ctp
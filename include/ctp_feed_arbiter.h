@@ -0,0 +1,173 @@
+#pragma once
+
+#include "ThostFtdcMdApi.h"
+#include "ctp_instrument_table.h"
+#include "ctp_md_dispatcher.h"
+#include "ctp_spsc_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ctp {
+
+// 单个FeedArbiter支持的最大前置数
+constexpr std::size_t kMaxFeedFronts = 8;
+
+struct FeedArbiterOptions {
+  // 各前置连接后使用同一组账号登录
+  std::string strBrokerID;
+  std::string strUserID;
+  std::string strPassword;
+  // 登录后订阅的合约，须已登记在InstrumentTable中
+  std::vector<std::string> vecInstruments;
+  // 向LatencyRecorder记录各前置落后于首达前置的时间（md.arbiter.lag.<名称>）
+  bool bRecordLatency = true;
+  // 赢得仲裁的行情经此队列交给转发线程
+  std::size_t nRingCapacity = 65536;
+  MdWaitMode eWaitMode = MdWaitMode::Blocking;
+  // Blocking模式下进入休眠前的自旋次数
+  int nSpinCount = 1000;
+};
+
+struct FeedFrontStats {
+  std::string strName;
+  bool bConnected;
+  bool bLoggedIn;
+  std::uint64_t nReceived;    // 收到的行情数
+  std::uint64_t nWins;        // 率先到达并被转发的行情数
+  std::uint64_t nDuplicates;  // 与已转发行情相同而被丢弃的行情数
+  std::uint64_t nStale;       // 比已转发行情更旧而被丢弃的行情数
+  std::uint64_t nUnknown;     // 合约未登记的行情数
+  std::uint64_t nDisconnects; // 断线次数
+  double dWinRate;            // nWins / (nWins + nDuplicates + nStale)
+  std::uint64_t nLagSamples;  // 测得落后时间的重复行情数
+  double dMeanLagNs;
+  std::int64_t nMaxLagNs;
+};
+
+// 多前置行情仲裁器
+// 同一账号并行连接多个行情前置，每个前置一个CThostFtdcMdApi。仲裁器为每个
+// 前置提供独立的SPI，负责登录和订阅，并把各前置的OnRtnDepthMarketData合并：
+// 以(合约, TradingDay, UpdateTime, UpdateMillisec, Volume)标识一笔行情，每个
+// 合约保存一个高水位，只有比高水位新的行情才转发给pHandler，其余作为重复或
+// 过期丢弃。TradingDay更大的行情开始新的交易日，更小的按过期丢弃；TradingDay
+// 为空时改用ActionDay。比较和入队在同一把合约自旋锁内完成，同一合约转发给
+// pHandler的行情严格按高水位递增。
+// 赢家只把行情拷贝进预分配的环形队列，由仲裁器自己的转发线程依次回调
+// pHandler的OnRtnDepthMarketData，前置线程不会在锁上等待用户回调；因此
+// pHandler不必再经过MdDispatcher。
+// 前置的登录、订阅等会话回调由仲裁器处理并记录日志，不转发给pHandler。
+class FeedArbiter {
+public:
+  FeedArbiter(CThostFtdcMdSpi *pHandler, const InstrumentTable &table,
+              const FeedArbiterOptions &options = {});
+  ~FeedArbiter();
+
+  FeedArbiter(const FeedArbiter &) = delete;
+  FeedArbiter &operator=(const FeedArbiter &) = delete;
+
+  // 启动/停止转发线程，Stop()会先排空队列中已有的行情
+  // 应在各前置Init()之前Start()，否则队列满后的行情被丢弃。
+  void Start();
+  void Stop();
+
+  // 登记一个前置并把内部SPI注册给pApi，应在pApi->Init()之前调用
+  // 返回前置编号，超过kMaxFeedFronts时返回-1。
+  int AddFront(CThostFtdcMdApi *pApi, const char *pszName);
+
+  std::size_t GetFrontCount() const {
+    return m_nFronts.load(std::memory_order_acquire);
+  }
+  FeedFrontStats GetFrontStats(std::size_t nFront) const;
+  // 转发给pHandler的行情数
+  std::uint64_t GetForwardedCount() const {
+    return m_nForwarded.load(std::memory_order_relaxed);
+  }
+  // 赢得仲裁但因队列满而被丢弃的行情数
+  std::uint64_t GetDropCount() const {
+    return m_nDropped.load(std::memory_order_relaxed);
+  }
+  std::size_t GetQueueSize() const { return m_ring.Size(); }
+
+  // 清空所有合约的高水位，例如行情源的TradingDay字段不可靠时手动切换交易日
+  void Reset();
+
+  // 前置nFront收到一笔行情，返回是否赢得仲裁并进入转发队列
+  // 供各前置的SPI调用，也可用于在测试中直接注入行情。
+  bool OnFrontTick(std::size_t nFront,
+                   CThostFtdcDepthMarketDataField *pDepthMarketData);
+
+private:
+  class FrontSpi;
+
+  struct alignas(kCacheLineSize) Front {
+    std::string strName;
+    CThostFtdcMdApi *pApi;
+    std::unique_ptr<FrontSpi> pSpi;
+    int nLagMetric;
+    int nRequestID;
+    // 只由该前置的回调线程写入
+    alignas(kCacheLineSize) std::atomic<std::uint64_t> nReceived;
+    std::atomic<std::uint64_t> nWins;
+    std::atomic<std::uint64_t> nDuplicates;
+    std::atomic<std::uint64_t> nStale;
+    std::atomic<std::uint64_t> nUnknown;
+    std::atomic<std::uint64_t> nDisconnects;
+    std::atomic<std::uint64_t> nLagSamples;
+    std::atomic<std::int64_t> nLagSumNs;
+    std::atomic<std::int64_t> nLagMaxNs;
+    std::atomic<bool> bConnected;
+    std::atomic<bool> bLoggedIn;
+  };
+
+  // 每个合约一条缓存行，bLock保护其余字段
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<bool> bLock;
+    // 已转发的最新行情所属交易日（YYYYMMDD）和(时间, 成交量)
+    std::uint32_t nTradingDay;
+    std::uint64_t nHighWater;
+    // 高水位首达时刻的ReadTsc()，用于计算后到前置的落后
+    std::uint64_t nWinTsc;
+  };
+
+  static std::uint64_t makeKey(const CThostFtdcDepthMarketDataField &tick);
+
+  bool enqueue(const CThostFtdcDepthMarketDataField &tick);
+  void run();
+  bool drain();
+  void waitForData();
+  void recordLag(Front &front, const Slot &slot, std::uint64_t nNow);
+  void login(Front &front);
+  void subscribe(Front &front);
+
+  CThostFtdcMdSpi *m_pHandler;
+  const InstrumentTable &m_table;
+  FeedArbiterOptions m_options;
+  std::size_t m_nSlots;
+  Slot *m_pSlots;
+
+  std::unique_ptr<Front> m_fronts[kMaxFeedFronts];
+  std::atomic<std::size_t> m_nFronts;
+
+  // 各前置线程持此锁写入队列，只保护一次拷贝，不跨越用户回调
+  alignas(kCacheLineSize) std::atomic<bool> m_bQueueLock;
+  std::atomic<std::uint64_t> m_nDropped;
+  SpscRing<CThostFtdcDepthMarketDataField> m_ring;
+
+  std::thread m_thread;
+  std::atomic<bool> m_bRunning;
+  // Blocking模式的休眠/唤醒
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::atomic<bool> m_bSleeping;
+  std::atomic<std::uint64_t> m_nForwarded;
+};
+
+} // namespace ctp
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_query_scheduler.h"
+#include "ctp_spsc_ring.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ctp {
+
+// "CTPINST1"
+constexpr std::uint64_t kInstrumentCacheMagic = 0x3154534E49505443ull;
+constexpr std::uint32_t kInstrumentCacheVersion = 1;
+// 单个缓存文件的合约容量上限
+constexpr std::uint32_t kMaxInstrumentCacheCapacity = 1u << 24;
+
+// InstrumentCacheEntry::nFlags / nFreshFlags的位
+constexpr std::uint32_t kCacheHasInstrument = 1u << 0;
+constexpr std::uint32_t kCacheHasCommissionRate = 1u << 1;
+constexpr std::uint32_t kCacheHasMarginRate = 1u << 2;
+
+// 一个合约的全部元数据
+struct InstrumentCacheEntry {
+  CThostFtdcInstrumentField instrument;
+  CThostFtdcInstrumentCommissionRateField commissionRate;
+  CThostFtdcInstrumentMarginRateField marginRate;
+  std::uint32_t nFlags;      // 已有数据的字段
+  std::uint32_t nFreshFlags; // 本交易日已从前置刷新过的字段
+};
+
+// 缓存文件头，占用文件的第一页
+struct InstrumentCacheHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nHeaderSize;
+  std::uint32_t nEntrySize; // sizeof(InstrumentCacheEntry)，用于识别CTP版本差异
+  std::uint32_t nSlotSize;
+  std::uint32_t nCapacity;
+  std::uint32_t nBuckets;
+  TThostFtdcDateType szTradingDay;
+  char szPadding[3];
+  std::atomic<std::uint32_t> nCount;
+  // 本交易日已完整查询过一次合约列表
+  std::atomic<std::uint32_t> bInstrumentsComplete;
+};
+
+struct InstrumentCacheOptions {
+  // 新建文件时的合约容量，文件按此一次性分配（稀疏文件，不占实际磁盘），
+  // 不超过kMaxInstrumentCacheCapacity
+  std::uint32_t nCapacity = 32768;
+  // 当日文件不存在时，以目录下最近一个交易日的文件为初值（已到期合约除外），
+  // 这些数据标记为未刷新，由Refresh()在后台逐步更新
+  bool bSeedFromPrevious = true;
+};
+
+struct InstrumentCacheRefreshOptions {
+  std::string strBrokerID;
+  std::string strInvestorID;
+  // 是否逐合约查询手续费率和保证金率
+  bool bQueryRates = true;
+  // 只查询这些合约的费率，为空时查询缓存中的所有合约。
+  // 每个合约两次查询，按QueryScheduler的默认节奏（每秒1次），全市场上万个
+  // 合约（含期权）需要数小时，应只列出交易或持仓的合约
+  std::vector<std::string> vecRateInstruments;
+  TThostFtdcHedgeFlagType chHedgeFlag = THOST_FTDC_HF_Speculation;
+  QueryPriority ePriority = QueryPriority::Low;
+};
+
+// 按交易日持久化的合约元数据缓存
+// 文件布局：文件头 | 开放寻址哈希索引 | 定长槽位。启动时直接mmap当日文件，
+// 不做任何解析即可查询；Refresh()经QueryScheduler在后台增量刷新：当日已
+// 完整查询过的合约列表不再重复查询，费率只查询本交易日尚未刷新过的合约。
+// 每个槽位以seqlock保护，刷新与查询可并发进行；写入方之间以互斥锁串行。
+// 仅支持Linux/Unix（mmap）。
+class InstrumentCache {
+public:
+  InstrumentCache();
+  ~InstrumentCache();
+
+  InstrumentCache(const InstrumentCache &) = delete;
+  InstrumentCache &operator=(const InstrumentCache &) = delete;
+
+  // 打开<strDirectory>/instruments_<TradingDay>.cache，不存在或版本不符时新建
+  bool Open(const std::string &strDirectory, const char *pszTradingDay,
+            const InstrumentCacheOptions &options = {});
+  void Close();
+  bool IsOpen() const { return m_pBase != nullptr; }
+
+  const char *GetTradingDay() const;
+  std::size_t GetCount() const;
+  // 合约列表是否已在本交易日完整刷新
+  bool IsInstrumentListFresh() const;
+
+  // 查询合约元数据，拷贝一份一致的副本
+  bool Find(const char *pszInstrumentID, InstrumentCacheEntry &entry) const;
+  // 按插入顺序遍历，nIndex < GetCount()
+  bool GetEntry(std::size_t nIndex, InstrumentCacheEntry &entry) const;
+
+  // 写入一条应答，合约不存在时新建；缓存已满时返回false
+  bool UpdateInstrument(const CThostFtdcInstrumentField &instrument);
+  bool
+  UpdateCommissionRate(const char *pszInstrumentID,
+                       const CThostFtdcInstrumentCommissionRateField &rate);
+  bool UpdateMarginRate(const char *pszInstrumentID,
+                        const CThostFtdcInstrumentMarginRateField &rate);
+
+  // 经scheduler提交刷新查询后立即返回，应答到达后写入缓存
+  // 缓存须在scheduler停止或所有查询完成之前保持打开。
+  void Refresh(QueryScheduler &scheduler,
+               const InstrumentCacheRefreshOptions &options);
+  // 已提交、尚未完成的刷新查询数
+  std::size_t GetPendingRefreshCount() const {
+    return m_nPendingRefresh.load(std::memory_order_acquire);
+  }
+
+  // 异步写回磁盘，bWait为true时等待完成
+  void Flush(bool bWait = false);
+
+  // <strDirectory>/instruments_<TradingDay>.cache
+  static std::string MakePath(const std::string &strDirectory,
+                              const char *pszTradingDay);
+
+private:
+  static constexpr std::size_t kWords =
+      (sizeof(InstrumentCacheEntry) + 7) / 8;
+
+  // 合约代码在发布后不再改变，负载按8字节原子字保存
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<std::uint64_t> nSeq;
+    TThostFtdcInstrumentIDType szInstrumentID;
+    std::atomic<std::uint64_t> nWords[kWords];
+  };
+
+  // 哈希桶，nSlot为槽位下标+1，0表示空
+  struct Bucket {
+    std::atomic<std::uint32_t> nSlot;
+    std::uint32_t nHash;
+  };
+
+  static std::uint32_t hash(const char *pszInstrumentID);
+
+  InstrumentCacheHeader *header() const {
+    return reinterpret_cast<InstrumentCacheHeader *>(m_pBase);
+  }
+
+  bool openExisting(const std::string &strPath, const char *pszTradingDay);
+  bool create(const std::string &strPath, const char *pszTradingDay,
+              std::uint32_t nCapacity);
+  bool map(int fd, std::size_t nSize);
+  // 清理写入中断的槽位
+  void repair(const std::string &strPath);
+  void seed(const std::string &strDirectory, const char *pszTradingDay);
+  std::int64_t findSlot(const char *pszInstrumentID) const;
+  std::int64_t insertSlot(const char *pszInstrumentID);
+  void readSlot(const Slot &slot, InstrumentCacheEntry &entry) const;
+  void writeSlot(Slot &slot, const InstrumentCacheEntry &entry);
+  // 调用方须持有m_writeMutex
+  bool update(const char *pszInstrumentID, std::uint32_t nFlag,
+              const void *pField);
+  void refreshRates(QueryScheduler &scheduler,
+                    const InstrumentCacheRefreshOptions &options);
+  void finishRefresh();
+
+  char *m_pBase;
+  std::size_t m_nMappedSize;
+  Bucket *m_pBuckets;
+  Slot *m_pSlots;
+  std::uint32_t m_nBucketMask;
+  std::uint32_t m_nCapacity;
+
+  std::mutex m_writeMutex;
+  std::atomic<std::size_t> m_nPendingRefresh;
+};
+
+} // namespace ctp
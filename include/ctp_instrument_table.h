@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace ctp {
+
+constexpr std::uint32_t kInvalidInstrument = 0xFFFFFFFFu;
+
+// 合约驻留表
+// 在订阅阶段把InstrumentID登记为从0开始的稠密下标，之后行情路由只需一次开放
+// 寻址查找即可得到数组下标，不再需要strcmp或字符串map。
+// Add()只应在订阅阶段（单线程）调用；表建好后Find()可被多个线程并发调用。
+class InstrumentTable {
+public:
+  explicit InstrumentTable(std::size_t nMaxInstruments = 8192);
+
+  // 登记合约并返回下标，已登记则返回原下标，表满时返回kInvalidInstrument
+  std::uint32_t Add(const char *pszInstrumentID, double dPriceTick = 0.0);
+
+  // 查找合约下标，未登记时返回kInvalidInstrument
+  std::uint32_t Find(const char *pszInstrumentID) const {
+    std::uint32_t nHash = hash(pszInstrumentID);
+    for (std::size_t i = nHash & m_nBucketMask;; i = (i + 1) & m_nBucketMask) {
+      const Bucket &bucket = m_buckets[i];
+      if (bucket.nIndex == kInvalidInstrument)
+        return kInvalidInstrument;
+      if (bucket.nHash == nHash &&
+          std::strncmp(m_instruments[bucket.nIndex].szInstrumentID,
+                       pszInstrumentID, sizeof(TThostFtdcInstrumentIDType)) ==
+              0)
+        return bucket.nIndex;
+    }
+  }
+
+  const char *GetInstrumentID(std::uint32_t nIndex) const {
+    return m_instruments[nIndex].szInstrumentID;
+  }
+
+  // 最小变动价位，用于价格与整数跳数之间的换算
+  double GetPriceTick(std::uint32_t nIndex) const {
+    return m_instruments[nIndex].dPriceTick;
+  }
+  double GetInversePriceTick(std::uint32_t nIndex) const {
+    return m_instruments[nIndex].dInvPriceTick;
+  }
+  void SetPriceTick(std::uint32_t nIndex, double dPriceTick);
+
+  std::size_t Size() const { return m_instruments.size(); }
+  std::size_t Capacity() const { return m_nMaxInstruments; }
+
+private:
+  struct Bucket {
+    std::uint32_t nHash;
+    std::uint32_t nIndex;
+  };
+
+  struct Instrument {
+    TThostFtdcInstrumentIDType szInstrumentID;
+    double dPriceTick;
+    double dInvPriceTick;
+  };
+
+  // FNV-1a
+  static std::uint32_t hash(const char *pszInstrumentID) {
+    std::uint32_t nHash = 2166136261u;
+    for (std::size_t i = 0;
+         i < sizeof(TThostFtdcInstrumentIDType) && pszInstrumentID[i]; ++i) {
+      nHash ^= static_cast<unsigned char>(pszInstrumentID[i]);
+      nHash *= 16777619u;
+    }
+    return nHash;
+  }
+
+  std::size_t m_nMaxInstruments;
+  std::size_t m_nBucketMask;
+  std::vector<Bucket> m_buckets;
+  std::vector<Instrument> m_instruments;
+};
+
+} // namespace ctp
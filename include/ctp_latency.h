@@ -0,0 +1,319 @@
+#pragma once
+
+#include "ctp_spsc_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace ctp {
+
+// 读取时间戳计数器，开销在十几个时钟周期以内
+// x86读TSC，aarch64读虚拟计数器，其他平台退化为steady_clock的纳秒数。
+inline std::uint64_t ReadTsc() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t nTicks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(nTicks));
+  return nTicks;
+#else
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// 时间戳计数器与纳秒、系统时间之间的换算
+// 首次调用Instance()时用约10毫秒校准频率，之后换算只是一次乘法。
+class TscClock {
+public:
+  static TscClock &Instance();
+
+  std::int64_t ToNs(std::uint64_t nTicks) const {
+    return static_cast<std::int64_t>(static_cast<double>(nTicks) *
+                                     m_dNsPerTick);
+  }
+  std::int64_t ElapsedNs(std::uint64_t nBegin, std::uint64_t nEnd) const {
+    return nEnd > nBegin ? ToNs(nEnd - nBegin) : 0;
+  }
+  // 计数器读数对应的系统时间（自1970年以来的纳秒数）
+  std::int64_t ToWallNs(std::uint64_t nTicks) const {
+    double dTicks =
+        static_cast<double>(nTicks) - static_cast<double>(m_nAnchorTsc);
+    return m_nAnchorWallNs + static_cast<std::int64_t>(dTicks * m_dNsPerTick);
+  }
+  double GetNsPerTick() const { return m_dNsPerTick; }
+
+private:
+  TscClock();
+
+  double m_dNsPerTick;
+  std::uint64_t m_nAnchorTsc;
+  std::int64_t m_nAnchorWallNs;
+};
+
+// 把系统时间换算为交易所所在时区（北京时间）的交易日内毫秒时间，
+// 与TradingTimeKey的定义相同：夜盘（18:00及之后）记为负值。
+// 减去行情的TradingTimeKey(UpdateTime, UpdateMillisec)即为交易所到本地的延迟
+// （含两端时钟偏差）。
+inline std::int32_t LocalTradingTimeKey(std::int64_t nWallNs) {
+  constexpr std::int64_t kDayMs = 24 * 3600 * 1000;
+  std::int64_t nMs = (nWallNs / 1000000 + 8 * 3600 * 1000) % kDayMs;
+  if (nMs >= 18 * 3600 * 1000)
+    nMs -= kDayMs;
+  return static_cast<std::int32_t>(nMs);
+}
+
+// 两个TradingTimeKey之差，跨越午夜的差值折回到±12小时内
+inline std::int32_t TradingTimeDiffMs(std::int32_t nLater,
+                                      std::int32_t nEarlier) {
+  constexpr std::int32_t kDayMs = 24 * 3600 * 1000;
+  std::int32_t nDiff = nLater - nEarlier;
+  if (nDiff >= kDayMs / 2)
+    nDiff -= kDayMs;
+  else if (nDiff < -kDayMs / 2)
+    nDiff += kDayMs;
+  return nDiff;
+}
+
+// 对数-线性分桶的延迟直方图（HDR），单位纳秒
+// 每个2的幂区间分为64个子桶，相对误差不超过1/64；超过kMaxValue的值记为
+// kMaxValue。本类不是线程安全的，用于快照与合并。
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits = 6;
+  static constexpr std::uint64_t kMaxValue = (1ull << 40) - 1; // 约18分钟
+  static constexpr std::size_t kBucketCount =
+      (40 - kSubBucketBits + 1) << kSubBucketBits;
+
+  LatencyHistogram();
+
+  void Record(std::uint64_t nValue) { Record(nValue, 1); }
+  void Record(std::uint64_t nValue, std::uint64_t nCount);
+  void Merge(const LatencyHistogram &other);
+  // this = this - other，other须是this的早期快照
+  void Subtract(const LatencyHistogram &other);
+  void Reset();
+
+  std::uint64_t GetCount() const { return m_nCount; }
+  std::uint64_t GetMin() const { return m_nCount ? m_nMin : 0; }
+  std::uint64_t GetMax() const { return m_nMax; }
+  double GetMean() const {
+    return m_nCount ? static_cast<double>(m_nSum) / m_nCount : 0.0;
+  }
+  // dPercentile取0~100，返回所在桶的上界
+  std::uint64_t GetPercentile(double dPercentile) const;
+
+  static std::size_t BucketOf(std::uint64_t nValue) {
+    if (nValue > kMaxValue)
+      nValue = kMaxValue;
+    if (nValue < (2ull << kSubBucketBits))
+      return static_cast<std::size_t>(nValue);
+    int nShift = highestBit(nValue) - kSubBucketBits;
+    return (static_cast<std::size_t>(nShift) << kSubBucketBits) +
+           static_cast<std::size_t>(nValue >> nShift);
+  }
+  static std::uint64_t BucketUpperBound(std::size_t nBucket);
+
+private:
+  friend class LatencyRecorder;
+
+  static int highestBit(std::uint64_t nValue) {
+#if defined(_MSC_VER)
+    unsigned long nIndex;
+    _BitScanReverse64(&nIndex, nValue);
+    return static_cast<int>(nIndex);
+#else
+    return 63 - __builtin_clzll(nValue);
+#endif
+  }
+
+  std::vector<std::uint64_t> m_counts;
+  std::uint64_t m_nCount;
+  std::uint64_t m_nSum;
+  std::uint64_t m_nMin;
+  std::uint64_t m_nMax;
+};
+
+constexpr int kMaxLatencyMetrics = 64;
+constexpr int kInvalidLatencyMetric = -1;
+
+struct LatencyRecorderOptions {
+  // 为空时不启动后台线程，只能通过Snapshot()/Dump()读取
+  std::string strFile = "./log/latency.txt";
+  // 合并各线程直方图并追加写入文件的周期
+  int nIntervalMs = 10000;
+};
+
+// 延迟记录器
+// 每个记录线程拥有自己的一组直方图（首次记录某个指标时分配），热路径只做
+// 无锁的单写者更新；后台线程定期合并所有线程的直方图，把本周期的分位数追加
+// 写入文件，Stop()时再写一次全程统计。
+class LatencyRecorder {
+public:
+  static LatencyRecorder &Instance();
+
+  // 按名称登记指标并返回编号，已登记则返回原编号，已满时返回
+  // kInvalidLatencyMetric
+  int Register(const char *pszName);
+  const char *GetMetricName(int nMetric) const;
+  int GetMetricCount() const {
+    return m_nMetrics.load(std::memory_order_acquire);
+  }
+
+  void Record(int nMetric, std::int64_t nNs) {
+    if (nMetric < 0 || nMetric >= kMaxLatencyMetrics)
+      return;
+    Shard *pShard = t_pShard ? t_pShard : registerThread();
+    Histogram *pHistogram =
+        pShard->histograms[nMetric].load(std::memory_order_relaxed);
+    if (!pHistogram)
+      pHistogram = pShard->allocate(nMetric);
+    pHistogram->Record(nNs > 0 ? static_cast<std::uint64_t>(nNs) : 0);
+  }
+  // 记录两次ReadTsc()之间的耗时
+  void RecordTsc(int nMetric, std::uint64_t nBegin, std::uint64_t nEnd) {
+    Record(nMetric, TscClock::Instance().ElapsedNs(nBegin, nEnd));
+  }
+
+  // 合并所有线程的直方图
+  void Snapshot(int nMetric, LatencyHistogram &histogram) const;
+  // 输出全部指标的全程统计
+  void Dump(std::FILE *pFile) const;
+
+  bool Start(const LatencyRecorderOptions &options = {});
+  void Stop();
+
+private:
+  // 单写者直方图：只由所属线程更新，合并线程按relaxed读取
+  struct Histogram {
+    std::atomic<std::uint64_t> nCounts[LatencyHistogram::kBucketCount];
+    std::atomic<std::uint64_t> nSum;
+    std::atomic<std::uint64_t> nMin;
+    std::atomic<std::uint64_t> nMax;
+
+    void Record(std::uint64_t nValue) {
+      std::atomic<std::uint64_t> &nBucket =
+          nCounts[LatencyHistogram::BucketOf(nValue)];
+      nBucket.store(nBucket.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+      nSum.store(nSum.load(std::memory_order_relaxed) + nValue,
+                 std::memory_order_relaxed);
+      if (nValue < nMin.load(std::memory_order_relaxed))
+        nMin.store(nValue, std::memory_order_relaxed);
+      if (nValue > nMax.load(std::memory_order_relaxed))
+        nMax.store(nValue, std::memory_order_relaxed);
+    }
+  };
+
+  struct Shard {
+    std::atomic<Histogram *> histograms[kMaxLatencyMetrics];
+
+    Shard();
+    ~Shard();
+    Histogram *allocate(int nMetric);
+  };
+
+  LatencyRecorder();
+  ~LatencyRecorder();
+
+  LatencyRecorder(const LatencyRecorder &) = delete;
+  LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+  Shard *registerThread();
+  void run();
+  void write(std::FILE *pFile, const char *pszTitle,
+             const std::vector<LatencyHistogram> &histograms) const;
+
+  static thread_local Shard *t_pShard;
+
+  // 线程退出后其直方图仍保留在统计中
+  mutable std::mutex m_mutex; // 保护m_shards和指标登记
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  char m_szNames[kMaxLatencyMetrics][48];
+  std::atomic<int> m_nMetrics;
+
+  LatencyRecorderOptions m_options;
+  std::thread m_thread;
+  std::mutex m_stopMutex;
+  std::condition_variable m_stopCond;
+  bool m_bRunning;
+};
+
+// 作用域计时：析构时记录从构造开始的耗时
+class LatencyScope {
+public:
+  explicit LatencyScope(int nMetric)
+      : m_nMetric(nMetric), m_nBegin(ReadTsc()) {}
+  ~LatencyScope() {
+    LatencyRecorder::Instance().RecordTsc(m_nMetric, m_nBegin, ReadTsc());
+  }
+
+  LatencyScope(const LatencyScope &) = delete;
+  LatencyScope &operator=(const LatencyScope &) = delete;
+
+private:
+  int m_nMetric;
+  std::uint64_t m_nBegin;
+};
+
+// 报单延迟跟踪
+// ReqOrderInsert前调用OnInsert(OrderRef)，在回报中调用OnRtnOrder/OnRtnTrade，
+// 分别记录报单到首个OnRtnOrder、到首笔OnRtnTrade的耗时。按OrderRef对容量取模
+// 放入固定槽位，不做堆分配；OnInsert与回报可以在不同线程。
+class OrderLatencyTracker {
+public:
+  explicit OrderLatencyTracker(std::size_t nCapacity = 4096);
+  ~OrderLatencyTracker();
+
+  OrderLatencyTracker(const OrderLatencyTracker &) = delete;
+  OrderLatencyTracker &operator=(const OrderLatencyTracker &) = delete;
+
+  // 登录后设置本会话的FrontID/SessionID，用于过滤其他会话的报单回报
+  void SetSession(int nFrontID, int nSessionID) {
+    m_nFrontID.store(nFrontID, std::memory_order_relaxed);
+    m_nSessionID.store(nSessionID, std::memory_order_relaxed);
+  }
+
+  void OnInsert(const char *pszOrderRef);
+  void OnRtnOrder(int nFrontID, int nSessionID, const char *pszOrderRef);
+  // 成交回报不含FrontID/SessionID，只按OrderRef匹配
+  void OnRtnTrade(const char *pszOrderRef);
+
+private:
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<std::uint64_t> nOrderRef; // 0表示空闲
+    std::atomic<std::uint64_t> nInsertTsc;
+    std::atomic<bool> bOrderSeen;
+    std::atomic<bool> bTradeSeen;
+  };
+
+  static std::uint64_t parseOrderRef(const char *pszOrderRef);
+  Slot *find(std::uint64_t nOrderRef) const;
+
+  std::size_t m_nMask;
+  Slot *m_pSlots;
+  std::atomic<int> m_nFrontID;
+  std::atomic<int> m_nSessionID;
+  int m_nInsertToOrder;
+  int m_nInsertToTrade;
+};
+
+} // namespace ctp
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "ctp_thread_placement.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ctp {
+
+enum class LogLevel : std::uint8_t { Debug = 0, Info, Warn, Error };
+
+struct LoggerOptions {
+  std::string strDirectory = "./log";
+  std::string strPrefix = "ctp";
+  // 单个文件的大小上限，超过后滚动到同一天的下一个序号
+  std::size_t nMaxFileSize = 256u << 20;
+  // 每个线程的缓冲区大小（向上取整为2的幂）
+  std::size_t nThreadBufferSize = 1u << 20;
+  LogLevel eMinLevel = LogLevel::Info;
+  // 后台线程的空闲休眠与刷盘间隔
+  int nFlushIntervalMs = 10;
+  // 同时输出到标准输出
+  bool bConsole = false;
+  // 后台线程的CPU与调度策略，通常放在远离行情/交易线程的核上
+  ThreadPlacement placement;
+};
+
+// 调用点的静态信息，由CTP_LOG宏为每个调用点生成一份
+struct LogSite {
+  LogLevel eLevel;
+  const char *pszFile;
+  int nLine;
+  const char *pszFormat;
+};
+
+namespace detail {
+
+// 参数编码：热路径上只拷贝原始字节，格式化推迟到后台线程
+template <typename T, typename Enable = void> struct LogArg;
+
+template <typename T>
+struct LogArg<T, typename std::enable_if<std::is_arithmetic<T>::value ||
+                                         std::is_enum<T>::value>::type> {
+  using Stored = T;
+  static std::size_t Size(const T &) { return sizeof(T); }
+  static char *Encode(char *p, const T &value) {
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+  }
+  static const char *Decode(const char *p, Stored &value) {
+    std::memcpy(&value, p, sizeof(T));
+    return p + sizeof(T);
+  }
+};
+
+// 字符串按长度前缀+内容（含结尾0）存储，解码时直接指向缓冲区
+struct LogString {
+  using Stored = const char *;
+  static std::size_t Size(std::size_t nLength) {
+    return sizeof(std::uint32_t) + nLength + 1;
+  }
+  static char *Encode(char *p, const char *pszValue, std::size_t nLength) {
+    std::uint32_t nStored = static_cast<std::uint32_t>(nLength);
+    std::memcpy(p, &nStored, sizeof(nStored));
+    p += sizeof(nStored);
+    std::memcpy(p, pszValue, nLength);
+    p[nLength] = '\0';
+    return p + nLength + 1;
+  }
+  static const char *Decode(const char *p, Stored &value) {
+    std::uint32_t nLength;
+    std::memcpy(&nLength, p, sizeof(nLength));
+    value = p + sizeof(nLength);
+    return value + nLength + 1;
+  }
+};
+
+// CTP结构体中的定长字符数组
+template <std::size_t N> struct LogArg<char[N]> : LogString {
+  static std::size_t Size(const char (&value)[N]) {
+    return LogString::Size(strnlen(value, N));
+  }
+  static char *Encode(char *p, const char (&value)[N]) {
+    return LogString::Encode(p, value, strnlen(value, N));
+  }
+};
+
+template <> struct LogArg<const char *> : LogString {
+  static std::size_t Size(const char *value) {
+    return LogString::Size(value ? std::strlen(value) : 0);
+  }
+  static char *Encode(char *p, const char *value) {
+    return value ? LogString::Encode(p, value, std::strlen(value))
+                 : LogString::Encode(p, "", 0);
+  }
+};
+
+template <> struct LogArg<char *> : LogArg<const char *> {};
+
+template <> struct LogArg<const void *> {
+  using Stored = const void *;
+  static std::size_t Size(const void *) { return sizeof(const void *); }
+  static char *Encode(char *p, const void *value) {
+    std::memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+  }
+  static const char *Decode(const char *p, Stored &value) {
+    std::memcpy(&value, p, sizeof(value));
+    return p + sizeof(value);
+  }
+};
+
+template <typename T> struct LogArg<T *> : LogArg<const void *> {};
+
+template <typename T>
+using LogArgOf = LogArg<typename std::remove_cv<T>::type>;
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif
+
+template <typename... Args, std::size_t... I>
+int formatArgs(const char *pszFormat, const char *pArgs, char *pOut,
+               std::size_t nOut, std::index_sequence<I...>) {
+  std::tuple<typename LogArgOf<Args>::Stored...> values;
+  (void)pArgs;
+  (void)std::initializer_list<int>{
+      (pArgs = LogArgOf<Args>::Decode(pArgs, std::get<I>(values)), 0)...};
+  return std::snprintf(pOut, nOut, pszFormat, std::get<I>(values)...);
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+// 后台线程调用：把记录中的原始参数按调用点的格式串格式化
+using LogFormatFn = int (*)(const char *pszFormat, const char *pArgs,
+                            char *pOut, std::size_t nOut);
+
+template <typename... Args>
+int formatRecord(const char *pszFormat, const char *pArgs, char *pOut,
+                 std::size_t nOut) {
+  return formatArgs<Args...>(pszFormat, pArgs, pOut, nOut,
+                             std::index_sequence_for<Args...>{});
+}
+
+// 记录头，记录整体按8字节对齐
+struct LogRecordHeader {
+  std::uint32_t nSize;    // 含记录头在内的总长度
+  std::uint32_t bPadding; // 非0表示缓冲区尾部的填充
+  const LogSite *pSite;
+  LogFormatFn pfnFormat;
+  std::int64_t nTimestamp; // 自1970年以来的纳秒数
+};
+
+// 每线程的单生产者/单消费者字节环形缓冲区
+class LogBuffer {
+public:
+  LogBuffer(std::size_t nSize, std::uint32_t nThreadID);
+  ~LogBuffer();
+
+  LogBuffer(const LogBuffer &) = delete;
+  LogBuffer &operator=(const LogBuffer &) = delete;
+
+  // 生产者：预留nBytes（已按8字节对齐）连续空间，空间不足时返回nullptr
+  char *Reserve(std::size_t nBytes) {
+    std::uint64_t nWrite = m_nWritePos.load(std::memory_order_relaxed);
+    std::size_t nOffset = static_cast<std::size_t>(nWrite & m_nMask);
+    std::size_t nToEnd = m_nSize - nOffset;
+    std::size_t nNeed = nBytes <= nToEnd ? nBytes : nToEnd + nBytes;
+    if (nWrite + nNeed - m_nCachedReadPos > m_nSize) {
+      m_nCachedReadPos = m_nReadPos.load(std::memory_order_acquire);
+      if (nWrite + nNeed - m_nCachedReadPos > m_nSize)
+        return nullptr;
+    }
+    if (nBytes > nToEnd) {
+      // 尾部空间不足，写入填充记录后从头开始
+      LogRecordHeader *pPad = reinterpret_cast<LogRecordHeader *>(
+          m_pData + nOffset);
+      pPad->nSize = static_cast<std::uint32_t>(nToEnd);
+      pPad->bPadding = 1;
+      m_nPendingPos = nWrite + nToEnd;
+      return m_pData;
+    }
+    m_nPendingPos = nWrite;
+    return m_pData + nOffset;
+  }
+
+  // 生产者：提交Reserve()得到的记录
+  void Commit(std::size_t nBytes) {
+    m_nWritePos.store(m_nPendingPos + nBytes, std::memory_order_release);
+  }
+
+  // 生产者：标记一次写入的开始与结束。标记与Logger::Stop()都是seq_cst
+  // 操作：要么写入方看到已停止而放弃，要么后台线程等到标记清除再最后排空
+  void BeginWrite() { m_bWriting.exchange(true, std::memory_order_seq_cst); }
+  void EndWrite() { m_bWriting.store(false, std::memory_order_release); }
+  bool IsWriting() const {
+    return m_bWriting.load(std::memory_order_seq_cst);
+  }
+
+  // 消费者：依次处理所有已提交的记录，返回处理的记录数
+  template <typename Fn> std::size_t Drain(Fn &&fn) {
+    std::uint64_t nRead = m_nReadPos.load(std::memory_order_relaxed);
+    const std::uint64_t nWrite = m_nWritePos.load(std::memory_order_acquire);
+    std::size_t nCount = 0;
+    while (nRead != nWrite) {
+      const LogRecordHeader *pHeader = reinterpret_cast<const LogRecordHeader *>(
+          m_pData + (nRead & m_nMask));
+      if (!pHeader->bPadding) {
+        fn(*pHeader, reinterpret_cast<const char *>(pHeader + 1));
+        ++nCount;
+      }
+      nRead += pHeader->nSize;
+    }
+    m_nReadPos.store(nRead, std::memory_order_release);
+    return nCount;
+  }
+
+  bool Empty() const {
+    return m_nReadPos.load(std::memory_order_acquire) ==
+           m_nWritePos.load(std::memory_order_acquire);
+  }
+
+  std::uint32_t GetThreadID() const { return m_nThreadID; }
+
+  // 所属线程退出后由后台线程排空并释放
+  std::atomic<bool> bRetired;
+
+private:
+  alignas(64) std::atomic<std::uint64_t> m_nWritePos;
+  std::uint64_t m_nCachedReadPos;
+  std::uint64_t m_nPendingPos;
+  std::atomic<bool> m_bWriting;
+
+  alignas(64) std::atomic<std::uint64_t> m_nReadPos;
+
+  alignas(64) char *m_pData;
+  std::size_t m_nSize;
+  std::size_t m_nMask;
+  std::uint32_t m_nThreadID;
+};
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 1, 2)))
+#endif
+inline void
+checkLogFormat(const char *, ...) {
+}
+
+} // namespace detail
+
+// 异步日志
+// 热路径只把调用点指针、时间戳和参数原始字节写入本线程的无锁缓冲区；
+// 格式化和文件I/O都在后台线程完成，按日期和文件大小滚动。缓冲区满时丢弃
+// 该条日志并计数，绝不阻塞调用线程。
+class Logger {
+public:
+  static Logger &Instance();
+
+  // 启动后台线程，已启动时直接返回true
+  bool Start(const LoggerOptions &options = {});
+  // 排空所有缓冲区后停止后台线程；调用之后的日志被丢弃，不计入丢弃数
+  void Stop();
+
+  bool IsEnabled(LogLevel eLevel) const {
+    return m_bRunning.load(std::memory_order_relaxed) &&
+           eLevel >= m_eMinLevel;
+  }
+
+  // 因缓冲区满而丢弃的日志条数
+  std::uint64_t GetDropCount() const {
+    return m_nDropped.load(std::memory_order_relaxed);
+  }
+
+  template <typename... Args>
+  void Write(const LogSite &site, const Args &...args) {
+    detail::LogBuffer *pBuffer = t_pBuffer ? t_pBuffer : registerThread();
+    if (!pBuffer)
+      return;
+    // Stop()开始后不再写入，否则可能落在最后一次排空之后而丢失
+    pBuffer->BeginWrite();
+    if (!m_bRunning.load(std::memory_order_seq_cst)) {
+      pBuffer->EndWrite();
+      return;
+    }
+
+    std::size_t nBytes = sizeof(detail::LogRecordHeader);
+    (void)std::initializer_list<int>{
+        (nBytes += detail::LogArgOf<Args>::Size(args), 0)...};
+    nBytes = (nBytes + 7) & ~static_cast<std::size_t>(7);
+
+    char *p = pBuffer->Reserve(nBytes);
+    if (!p) {
+      pBuffer->EndWrite();
+      m_nDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    detail::LogRecordHeader *pHeader =
+        reinterpret_cast<detail::LogRecordHeader *>(p);
+    pHeader->nSize = static_cast<std::uint32_t>(nBytes);
+    pHeader->bPadding = 0;
+    pHeader->pSite = &site;
+    pHeader->pfnFormat =
+        &detail::formatRecord<typename std::remove_cv<Args>::type...>;
+    pHeader->nTimestamp =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    p += sizeof(detail::LogRecordHeader);
+    (void)std::initializer_list<int>{
+        (p = detail::LogArgOf<Args>::Encode(p, args), 0)...};
+    pBuffer->Commit(nBytes);
+    pBuffer->EndWrite();
+  }
+
+private:
+  Logger();
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  detail::LogBuffer *registerThread();
+  void run();
+  bool drainAll();
+  // 等待所有线程上已开始的写入完成
+  void waitWriters();
+  void writeRecord(std::uint32_t nThreadID,
+                   const detail::LogRecordHeader &header, const char *pArgs);
+  bool openFile(int nDate);
+
+  static thread_local detail::LogBuffer *t_pBuffer;
+
+  LoggerOptions m_options;
+  LogLevel m_eMinLevel;
+  std::atomic<bool> m_bRunning;
+  std::atomic<std::uint64_t> m_nDropped;
+
+  std::mutex m_mutex; // 保护m_buffers
+  std::vector<std::unique_ptr<detail::LogBuffer>> m_buffers;
+
+  std::thread m_thread;
+  std::FILE *m_pFile;
+  int m_nFileDate;
+  int m_nFileIndex;
+  std::size_t m_nFileSize;
+};
+
+} // namespace ctp
+
+// 用法与printf相同，参数只支持算术类型、指针和字符串（含CTP定长字符数组）
+#define CTP_LOG(level, fmt, ...)                                               \
+  do {                                                                         \
+    ::ctp::Logger &ctpLogger_ = ::ctp::Logger::Instance();                     \
+    if (ctpLogger_.IsEnabled(level)) {                                         \
+      static const ::ctp::LogSite ctpLogSite_ = {level, __FILE__, __LINE__,    \
+                                                 fmt};                         \
+      if (false)                                                               \
+        ::ctp::detail::checkLogFormat(fmt, ##__VA_ARGS__);                     \
+      ctpLogger_.Write(ctpLogSite_, ##__VA_ARGS__);                            \
+    }                                                                          \
+  } while (0)
+
+#define CTP_LOG_DEBUG(fmt, ...)                                                \
+  CTP_LOG(::ctp::LogLevel::Debug, fmt, ##__VA_ARGS__)
+#define CTP_LOG_INFO(fmt, ...) CTP_LOG(::ctp::LogLevel::Info, fmt, ##__VA_ARGS__)
+#define CTP_LOG_WARN(fmt, ...) CTP_LOG(::ctp::LogLevel::Warn, fmt, ##__VA_ARGS__)
+#define CTP_LOG_ERROR(fmt, ...)                                                \
+  CTP_LOG(::ctp::LogLevel::Error, fmt, ##__VA_ARGS__)
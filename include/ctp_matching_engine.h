@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+#include "ctp_tick.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ctp {
+
+// 撮合结果回调，在调用InsertOrder/CancelOrder/OnMarketData的线程上同步触发
+class MatchingEngineSpi {
+public:
+  virtual ~MatchingEngineSpi() {}
+  // 报单状态变化，每次变化回调一次完整的报单
+  virtual void OnOrder(const CThostFtdcOrderField &order) = 0;
+  virtual void OnTrade(const CThostFtdcTradeField &trade) = 0;
+};
+
+// 价格-时间优先的模拟撮合引擎
+// 每个合约维护一个由模拟报单组成的订单簿，同时记住最近一笔行情的五档盘口：
+// - 新报单先与订单簿中对手方的模拟报单按价格-时间优先撮合，再按对手方
+//   盘口逐档成交（成交价为盘口价，同一笔行情内已被吃掉的量不会重复成交）；
+// - 剩余部分按TimeCondition挂单（GFD）或撤销（IOC），FOK（VC_CV）不能
+//   全部成交时整笔撤销，市价单按IOC处理；
+// - 挂单在新行情到来时，若对手盘口价格穿过挂单价或最新价穿过挂单价，
+//   以挂单价成交。
+// 非线程安全，应由单一线程驱动。
+class MatchingEngine {
+public:
+  MatchingEngine(MatchingEngineSpi *pSpi, const char *pszTradingDay,
+                 std::size_t nMaxInstruments = 8192);
+
+  MatchingEngine(const MatchingEngine &) = delete;
+  MatchingEngine &operator=(const MatchingEngine &) = delete;
+
+  // 受理返回0；否则返回CTP错误码并填写pRspInfo，不产生回报
+  int InsertOrder(const CThostFtdcInputOrderField &inputOrder, int nFrontID,
+                  int nSessionID, CThostFtdcRspInfoField *pRspInfo);
+  // 按OrderSysID或FrontID+SessionID+OrderRef撤单
+  int CancelOrder(const CThostFtdcInputOrderActionField &inputOrderAction,
+                  CThostFtdcRspInfoField *pRspInfo);
+
+  void OnMarketData(const CThostFtdcDepthMarketDataField &tick);
+
+  const std::vector<CThostFtdcOrderField> &GetOrders() const {
+    return m_orders;
+  }
+  const std::vector<CThostFtdcTradeField> &GetTrades() const {
+    return m_trades;
+  }
+
+private:
+  struct Level {
+    double dPrice;
+    int nVolume; // 扣除本笔行情中已被模拟报单成交的量
+  };
+
+  struct Book {
+    std::map<double, std::deque<std::uint32_t>, std::greater<double>> bids;
+    std::map<double, std::deque<std::uint32_t>> asks;
+    Level bidLevels[kTickDepth];
+    Level askLevels[kTickDepth];
+    double dLastPrice;
+    // 本交易日已有成交，dLastPrice可用于判断穿价（价格本身可以为零或负）
+    bool bHasLastPrice;
+    bool bHasTick;
+  };
+
+  std::uint32_t findOrder(const CThostFtdcInputOrderActionField &action) const;
+  int availableVolume(const Book &book, const CThostFtdcOrderField &order,
+                      double dLimit) const;
+  void matchIncoming(Book &book, std::uint32_t nOrder, double dLimit);
+  template <typename Side>
+  void matchResting(Book &book, Side &side, bool bBuy);
+  void fill(std::uint32_t nOrder, int nVolume, double dPrice);
+  void rest(Book &book, std::uint32_t nOrder);
+  void cancel(std::uint32_t nOrder, const char *pszStatusMsg);
+  void stamp(CThostFtdcOrderField &order);
+  static std::string orderRefKey(int nFrontID, int nSessionID,
+                                 const char *pszOrderRef);
+
+  MatchingEngineSpi *m_pSpi;
+  TThostFtdcDateType m_szTradingDay;
+  InstrumentTable m_instruments;
+  std::vector<Book> m_books;
+
+  std::vector<CThostFtdcOrderField> m_orders;
+  std::vector<std::uint32_t> m_orderBooks; // 报单所在的合约下标
+  std::vector<CThostFtdcTradeField> m_trades;
+  std::unordered_map<std::string, std::uint32_t> m_orderRefIndex;
+  std::unordered_map<std::string, std::uint32_t> m_orderSysIndex;
+  int m_nSequenceNo;
+};
+
+} // namespace ctp
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_broadcast_ring.h"
+#include "ctp_instrument_table.h"
+#include "ctp_snapshot_table.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_tick.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ctp {
+
+// 单个MdBus支持的最大订阅者数，每个合约的订阅者集合是一个64位的位图
+constexpr std::size_t kMaxMdSubscribers = 64;
+
+// 订阅者处理不过来时的策略
+enum class MdSlowConsumerPolicy {
+  Block,      // 队列满时发布方等待，不丢行情，但会拖慢所有订阅者
+  DropOldest, // 队列满时覆盖最旧的行情
+  Conflate    // 每个合约只保留最新一笔，未读取的旧行情被合并
+};
+
+struct MdSubscriberOptions {
+  MdSlowConsumerPolicy ePolicy = MdSlowConsumerPolicy::DropOldest;
+  // Block/DropOldest的队列容量；Conflate按合约数分配，不使用该项
+  std::size_t nQueueCapacity = 4096;
+};
+
+struct MdSubscriberStats {
+  std::uint64_t nPublished; // 路由给该订阅者的行情数
+  std::uint64_t nConsumed;  // 已被取走的行情数
+  std::uint64_t nDropped;   // DropOldest：被覆盖的行情数
+  std::uint64_t nConflated; // Conflate：被更新的行情合并掉的数目
+  std::uint64_t nBlocked;   // Block：发布方因队列满而等待的次数
+  std::size_t nLag;         // 当前积压
+  std::size_t nMaxLag;      // 取行情时观察到的最大积压
+};
+
+class MdBus;
+
+// 订阅者队列
+// 由MdBus创建并持有。Poll()只能由该订阅者的单一消费线程调用。
+class MdSubscriber {
+public:
+  MdSubscriber(const MdSubscriber &) = delete;
+  MdSubscriber &operator=(const MdSubscriber &) = delete;
+
+  // 取出下一笔行情，没有新行情时返回false
+  bool Poll(CompactTick &tick);
+
+  // 当前积压：Block/DropOldest为队列中的行情数，Conflate为有新行情的合约数
+  std::size_t GetLag() const;
+
+  MdSubscriberStats GetStats() const;
+
+  std::size_t GetID() const { return m_nID; }
+  MdSlowConsumerPolicy GetPolicy() const { return m_options.ePolicy; }
+
+private:
+  friend class MdBus;
+
+  MdSubscriber(std::size_t nID, const MdSubscriberOptions &options,
+               std::size_t nMaxInstruments);
+
+  // 发布线程调用
+  void push(const CompactTick &tick);
+
+  std::size_t m_nID;
+  MdSubscriberOptions m_options;
+
+  // 按策略只分配其中一种
+  std::unique_ptr<SpscRing<CompactTick>> m_pQueue;
+  std::unique_ptr<BroadcastRing<CompactTick>> m_pRing;
+  std::unique_ptr<SnapshotTable> m_pLatest;
+  std::unique_ptr<SpscRing<std::uint32_t>> m_pDirtyQueue;
+  std::unique_ptr<std::atomic<bool>[]> m_pDirty;
+  std::vector<std::uint64_t> m_lastVersions; // Conflate：已交付的快照序号
+
+  // 发布线程写
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> m_nPublished;
+  std::atomic<std::uint64_t> m_nConflated;
+  std::atomic<std::uint64_t> m_nBlocked;
+
+  // 消费线程写
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> m_nConsumed;
+  std::atomic<std::uint64_t> m_nDropped;
+  std::atomic<std::size_t> m_nMaxLag;
+  std::uint64_t m_nReadSeq; // DropOldest：下一个读取序号
+};
+
+// 多订阅者行情总线
+// 在一个进程内把行情分发给多个策略。每个订阅者登记自己关心的合约并拥有独立
+// 的有界无锁队列；每个合约预先算好订阅者位图，发布一笔行情只需读一次位图，
+// 并对每个感兴趣的订阅者各拷贝一次。
+// Publish()只能由单一线程调用（MD SPI回调线程或MdDispatcher的消费线程）。
+// AddSubscriber/Subscribe/Unsubscribe可在任意线程调用，与发布并发安全；
+// 订阅者在MdBus析构前一直有效。
+class MdBus {
+public:
+  explicit MdBus(const InstrumentTable &table);
+  ~MdBus();
+
+  MdBus(const MdBus &) = delete;
+  MdBus &operator=(const MdBus &) = delete;
+
+  // 新建订阅者，超过kMaxMdSubscribers时返回nullptr
+  MdSubscriber *AddSubscriber(const MdSubscriberOptions &options = {});
+
+  // 按合约下标登记/取消过滤条件
+  bool Subscribe(MdSubscriber *pSubscriber, std::uint32_t nInstrument);
+  bool Unsubscribe(MdSubscriber *pSubscriber, std::uint32_t nInstrument);
+  // 按InstrumentID登记，合约须已登记在InstrumentTable中
+  bool Subscribe(MdSubscriber *pSubscriber, const char *pszInstrumentID);
+  bool Unsubscribe(MdSubscriber *pSubscriber, const char *pszInstrumentID);
+
+  // 发布一笔行情，没有订阅者的合约直接跳过。
+  // 合约下标超出InstrumentTable容量时丢弃、计数并返回false
+  bool Publish(const CompactTick &tick) {
+    if (tick.nInstrument >= m_nMaxInstruments) {
+      m_nInvalid.store(m_nInvalid.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+      return false;
+    }
+    std::uint64_t nMask =
+        m_pRoutes[tick.nInstrument].load(std::memory_order_acquire);
+    while (nMask) {
+      m_pSubscribers[lowestBit(nMask)]->push(tick);
+      nMask &= nMask - 1;
+    }
+    return true;
+  }
+
+  // 发布原始行情，只有存在订阅者时才做规整；合约未登记时返回false
+  bool Publish(const CThostFtdcDepthMarketDataField &tick);
+
+  std::size_t GetSubscriberCount() const {
+    return m_nSubscribers.load(std::memory_order_acquire);
+  }
+  MdSubscriber *GetSubscriber(std::size_t nID) const {
+    return nID < GetSubscriberCount() ? m_pSubscribers[nID] : nullptr;
+  }
+  // 因合约下标越界被丢弃的行情数
+  std::uint64_t GetInvalidCount() const {
+    return m_nInvalid.load(std::memory_order_relaxed);
+  }
+
+private:
+  static unsigned lowestBit(std::uint64_t nMask) {
+#if defined(_MSC_VER)
+    unsigned long nIndex;
+    _BitScanForward64(&nIndex, nMask);
+    return static_cast<unsigned>(nIndex);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(nMask));
+#endif
+  }
+
+  const InstrumentTable &m_table;
+  TickNormalizer m_normalizer;
+  std::size_t m_nMaxInstruments;
+
+  // 合约下标 -> 订阅者位图
+  std::unique_ptr<std::atomic<std::uint64_t>[]> m_pRoutes;
+  MdSubscriber *m_pSubscribers[kMaxMdSubscribers];
+  std::atomic<std::size_t> m_nSubscribers;
+  // 只由发布线程写入
+  std::atomic<std::uint64_t> m_nInvalid;
+  std::mutex m_mutex; // 串行化AddSubscriber
+};
+
+} // namespace ctp
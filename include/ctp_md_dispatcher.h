@@ -0,0 +1,136 @@
+#pragma once
+
+#include "ThostFtdcMdApi.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_thread_placement.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace ctp {
+
+// 消费线程的等待方式
+enum class MdWaitMode {
+  BusyPoll, // 忙轮询，延迟最低，独占一个CPU核
+  Blocking  // 队列空时休眠，由生产者按需唤醒
+};
+
+struct MdDispatcherOptions {
+  std::size_t nRingCapacity = 65536;
+  MdWaitMode eWaitMode = MdWaitMode::Blocking;
+  // Blocking模式下进入休眠前的自旋次数
+  int nSpinCount = 1000;
+  // 向LatencyRecorder记录交易所到回调、排队和处理耗时
+  bool bRecordLatency = true;
+  // 消费线程的CPU与调度策略；CPU都在同一NUMA节点时队列内存也迁移到该节点
+  ThreadPlacement consumerPlacement;
+};
+
+// 行情分发器
+// 注册给CThostFtdcMdApi作为SPI。OnRtnDepthMarketData只把行情拷贝进预分配的
+// SPSC环形队列后立即返回，由独立的消费线程依次回调pHandler的
+// OnRtnDepthMarketData。其余低频回调（连接、登录、订阅应答等）仍在CTP线程上
+// 直接转发给pHandler。
+class MdDispatcher : public CThostFtdcMdSpi {
+public:
+  explicit MdDispatcher(CThostFtdcMdSpi *pHandler,
+                        const MdDispatcherOptions &options = {});
+  ~MdDispatcher();
+
+  MdDispatcher(const MdDispatcher &) = delete;
+  MdDispatcher &operator=(const MdDispatcher &) = delete;
+
+  // 启动/停止消费线程，Stop()会先排空队列中已有的行情
+  void Start();
+  void Stop();
+
+  // 队列当前占用
+  std::size_t GetQueueSize() const { return m_ring.Size(); }
+  std::size_t GetQueueCapacity() const { return m_ring.Capacity(); }
+  // 队列占用的历史最高值
+  std::size_t GetQueueHighWater() const {
+    return m_nHighWater.load(std::memory_order_relaxed);
+  }
+  // 队列满而被丢弃的行情数
+  std::uint64_t GetDropCount() const {
+    return m_nDropped.load(std::memory_order_relaxed);
+  }
+  // 已交给pHandler处理的行情数
+  std::uint64_t GetDispatchCount() const {
+    return m_nDispatched.load(std::memory_order_relaxed);
+  }
+
+  // CThostFtdcMdSpi
+  void OnFrontConnected() override;
+  void OnFrontDisconnected(int nReason) override;
+  void OnHeartBeatWarning(int nTimeLapse) override;
+  void OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                      bool bIsLast) override;
+  void OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                       bool bIsLast) override;
+  void OnRspQryMulticastInstrument(
+      CThostFtdcMulticastInstrumentField *pMulticastInstrument,
+      CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) override;
+  void OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) override;
+  void
+  OnRspSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                     CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                     bool bIsLast) override;
+  void
+  OnRspUnSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                       bool bIsLast) override;
+  void
+  OnRspSubForQuoteRsp(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                      bool bIsLast) override;
+  void
+  OnRspUnSubForQuoteRsp(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                        CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                        bool bIsLast) override;
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override;
+  void OnRtnForQuoteRsp(CThostFtdcForQuoteRspField *pForQuoteRsp) override;
+
+private:
+  struct Entry {
+    CThostFtdcDepthMarketDataField tick;
+    std::uint64_t nRecvTsc; // CTP回调时刻的ReadTsc()
+  };
+
+  void run();
+  bool drain();
+  void waitForData();
+  void recordLatency(const Entry &entry, std::uint64_t nBegin,
+                     std::uint64_t nEnd);
+
+  CThostFtdcMdSpi *m_pHandler;
+  MdDispatcherOptions m_options;
+  SpscRing<Entry> m_ring;
+
+  // LatencyRecorder中的指标编号
+  int m_nExchangeLatency;
+  int m_nQueueLatency;
+  int m_nHandlerLatency;
+
+  std::thread m_thread;
+  std::atomic<bool> m_bRunning;
+
+  // Blocking模式的休眠/唤醒
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::atomic<bool> m_bSleeping;
+
+  std::atomic<std::size_t> m_nHighWater;
+  std::atomic<std::uint64_t> m_nDropped;
+  std::atomic<std::uint64_t> m_nDispatched;
+};
+
+} // namespace ctp
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "ThostFtdcMdApi.h"
+#include "ctp_instrument_table.h"
+#include "ctp_tick_journal.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ctp {
+
+// 回放速度
+enum class ReplaySpeed {
+  AsFastAsPossible, // 不做节拍控制，用于测量SPI的最大吞吐
+  RealTime,         // 按录制时的接收时间间隔回放
+  Multiple          // 按dSpeedMultiple倍速回放
+};
+
+struct ReplayMdApiOptions {
+  // 按顺序回放的行情日志（TickJournalWriter生成的ticks_<TradingDay>.jnl）
+  std::vector<std::string> vecJournalFiles;
+  ReplaySpeed eSpeed = ReplaySpeed::AsFastAsPossible;
+  double dSpeedMultiple = 1.0;
+  // 整组日志重复回放的次数
+  int nRepeat = 1;
+  // 首次订阅应答之后才开始推送行情，避免订阅前的行情被过滤掉
+  bool bWaitForSubscribe = true;
+};
+
+// 基于行情日志的CThostFtdcMdApi回放实现
+// 与CreateFtdcMdApi返回的对象用法相同：RegisterSpi、Init后依次回调
+// OnFrontConnected、OnRspUserLogin、OnRspSubMarketData，随后在回放线程上
+// 推送已订阅合约的OnRtnDepthMarketData。日志中的合约在创建时一次性编号，
+// 订阅过滤只是按编号查一个标志位。
+// 可以在回调中调用Release()：回放线程停止推送，回调返回后由回放线程自行释放。
+class ReplayMdApi final : public CThostFtdcMdApi {
+public:
+  // 打开日志失败时返回nullptr
+  static ReplayMdApi *CreateReplayMdApi(const ReplayMdApiOptions &options);
+
+  ReplayMdApi(const ReplayMdApi &) = delete;
+  ReplayMdApi &operator=(const ReplayMdApi &) = delete;
+
+  // 已推送给SPI的行情数
+  std::uint64_t GetDeliveredCount() const {
+    return m_nDelivered.load(std::memory_order_relaxed);
+  }
+  // 日志中的行情总数（单次回放）
+  std::uint64_t GetRecordCount() const { return m_nRecordCount; }
+  // 从开始推送到回放结束（或当前）的耗时，纳秒
+  std::int64_t GetElapsedNanos() const;
+  // 所有日志是否已回放完毕
+  bool IsFinished() const {
+    return m_bFinished.load(std::memory_order_acquire);
+  }
+
+  // CThostFtdcMdApi
+  void Release() override;
+  void Init() override;
+  int Join() override;
+  const char *GetTradingDay() override;
+  void GetFrontInfo(CThostFtdcFrontInfoField *pFrontInfo) override;
+  void RegisterFront(char *pszFrontAddress) override;
+  void RegisterNameServer(char *pszNsAddress) override;
+  void
+  RegisterFensUserInfo(CThostFtdcFensUserInfoField *pFensUserInfo) override;
+  void RegisterSpi(CThostFtdcMdSpi *pSpi) override;
+  int SubscribeMarketData(char *ppInstrumentID[], int nCount) override;
+  int UnSubscribeMarketData(char *ppInstrumentID[], int nCount) override;
+  int SubscribeForQuoteRsp(char *ppInstrumentID[], int nCount) override;
+  int UnSubscribeForQuoteRsp(char *ppInstrumentID[], int nCount) override;
+  int ReqUserLogin(CThostFtdcReqUserLoginField *pReqUserLoginField,
+                   int nRequestID) override;
+  int ReqUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                    int nRequestID) override;
+  int ReqQryMulticastInstrument(
+      CThostFtdcQryMulticastInstrumentField *pQryMulticastInstrument,
+      int nRequestID) override;
+
+private:
+  // 请求在调用线程上入队，由回放线程依次应答
+  struct Event {
+    enum Type {
+      UserLogin,
+      UserLogout,
+      SubMarketData,
+      UnSubMarketData,
+      SubForQuoteRsp,
+      UnSubForQuoteRsp
+    };
+    Type eType;
+    int nRequestID;
+    bool bIsLast;
+    CThostFtdcSpecificInstrumentField instrument;
+    CThostFtdcUserLogoutField user;
+  };
+
+  explicit ReplayMdApi(const ReplayMdApiOptions &options);
+  ~ReplayMdApi();
+
+  bool open();
+  void run();
+  bool replayJournal(const TickJournalReader &reader,
+                     const std::vector<std::uint32_t> &vecIndices);
+  bool processEvents();
+  void handleEvent(const Event &event);
+  int pushInstruments(Event::Type eType, char *ppInstrumentID[], int nCount,
+                      int nRequestID);
+  void pushEvent(const Event &event);
+  void waitForStart();
+
+  ReplayMdApiOptions m_options;
+  CThostFtdcMdSpi *m_pSpi;
+
+  std::vector<std::unique_ptr<TickJournalReader>> m_readers;
+  // 每条记录对应的合约编号，创建时预先计算
+  std::vector<std::vector<std::uint32_t>> m_indices;
+  // 按日志中的合约数创建
+  std::unique_ptr<InstrumentTable> m_pInstruments;
+  std::unique_ptr<std::atomic<bool>[]> m_pSubscribed;
+  std::uint64_t m_nRecordCount;
+
+  std::thread m_thread;
+  std::atomic<bool> m_bRunning;
+  // 在回放线程的回调中调用了Release()，线程退出前释放自身
+  bool m_bReleaseOnExit;
+  std::atomic<bool> m_bFinished;
+  bool m_bLoggedIn;
+  bool m_bSubscribed;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<Event> m_events;
+  // 行情循环中只检查该标志，有请求时才加锁取出
+  std::atomic<bool> m_bHasEvents;
+
+  std::atomic<std::uint64_t> m_nDelivered;
+  std::atomic<std::int64_t> m_nStartNanos;
+  std::atomic<std::int64_t> m_nEndNanos;
+  // 回放线程正在回放的日志下标，GetTradingDay()可在任意线程读取
+  std::atomic<std::size_t> m_nJournal;
+};
+
+} // namespace ctp
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_tick.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ctp {
+
+constexpr std::uint32_t kInvalidOrder = 0xFFFFFFFFu;
+
+// 一笔报单的最新状态
+struct OrderState {
+  // 主键：FrontID + SessionID + OrderRef
+  // nOrderRef为parseOrderRef()得到的键，纯数字时即十进制值
+  std::int32_t nFrontID;
+  std::int32_t nSessionID;
+  std::uint64_t nOrderRef;
+  std::uint32_t nInstrument; // InstrumentTable下标，未登记时为kInvalidInstrument
+  char cDirection;
+  char cOffsetFlag;     // CombOffsetFlag[0]
+  char cOrderStatus;
+  char cSubmitStatus;
+  std::int32_t nVolumeTotalOriginal;
+  std::int32_t nVolumeTraded; // 以OnRtnOrder为准
+  std::int32_t nVolumeTotal;
+  std::int32_t nTradeVolume; // 由OnRtnTrade累计，可能先于OnRtnOrder到达
+  double dLimitPrice;
+  double dTradeAmount; // 成交价×成交量之和，用于计算成交均价
+  TThostFtdcExchangeIDType szExchangeID;
+  TThostFtdcOrderSysIDType szOrderSysID;
+  TThostFtdcOrderRefType szOrderRef;
+
+  // 报单仍在交易所排队或尚未被交易所确认
+  bool IsActive() const {
+    if (cSubmitStatus == THOST_FTDC_OSS_InsertRejected)
+      return false;
+    return cOrderStatus != THOST_FTDC_OST_AllTraded &&
+           cOrderStatus != THOST_FTDC_OST_Canceled &&
+           cOrderStatus != THOST_FTDC_OST_PartTradedNotQueueing &&
+           cOrderStatus != THOST_FTDC_OST_NoTradeNotQueueing;
+  }
+  double GetAverageTradePrice() const {
+    return nTradeVolume > 0 ? dTradeAmount / nTradeVolume : 0.0;
+  }
+};
+
+// 一个合约的持仓与盈亏，固定一条缓存行
+// 持仓成本按开仓价计算（价格×手数，不含合约乘数），平仓按持仓均价结转。
+struct alignas(kCacheLineSize) PositionState {
+  std::int32_t nLongPosition;
+  std::int32_t nLongToday; // 其中今仓
+  std::int32_t nShortPosition;
+  std::int32_t nShortToday;
+  std::int32_t nVolumeMultiple;
+  double dLongCost;
+  double dShortCost;
+  double dLastPrice; // 最近一笔行情或成交的价格，用于计算浮动盈亏
+  double dRealizedPnL;
+  double dUnrealizedPnL;
+
+  std::int32_t GetNetPosition() const { return nLongPosition - nShortPosition; }
+  double GetLongAveragePrice() const {
+    return nLongPosition > 0 ? dLongCost / nLongPosition : 0.0;
+  }
+  double GetShortAveragePrice() const {
+    return nShortPosition > 0 ? dShortCost / nShortPosition : 0.0;
+  }
+};
+
+static_assert(sizeof(PositionState) == kCacheLineSize,
+              "PositionState must fit in one cache line");
+
+// 已处理成交的键，同一成交被重复推送（断线重连、重放私有流）时据此去重
+// 自成交时买卖双方的TradeID相同，因此键中包含买卖方向。
+struct TradeKey {
+  TThostFtdcExchangeIDType szExchangeID;
+  TThostFtdcTradeIDType szTradeID;
+  char cDirection;
+  char cReserved;
+};
+
+struct OrderStateEngineOptions {
+  // 报单池容量，一个交易日内的报单数（含其他会话的报单回报）不能超过该值
+  std::size_t nMaxOrders = 65536;
+  // 成交去重表容量，超出后的成交不再去重
+  std::size_t nMaxTrades = 131072;
+  // 先于OnRtnOrder到达、暂存待记入报单的成交笔数（按报单合并），
+  // 超出时丢弃最早的一笔
+  std::size_t nMaxUnmatchedTrades = 256;
+};
+
+// 报单与持仓状态引擎
+// 由OnRtnOrder/OnRtnTrade/行情驱动：
+// - 报单存放在预分配的报单池中，以(FrontID, SessionID, OrderRef)为键的开放
+//   寻址表定位，另以(ExchangeID, OrderSysID)建立索引，供成交回报找到报单；
+//   成交先于带OrderSysID的OnRtnOrder到达时暂存，建立索引时再记入报单；
+// - 持仓与已实现/浮动盈亏存放在按InstrumentTable下标排列的平坦数组中，
+//   每笔成交和行情增量更新。
+// 构造之后的所有更新都不做堆分配。非线程安全，交易回报与行情须由同一线程
+// 送入（例如经MdDispatcher转到交易回调线程），或由调用方加锁。
+class OrderStateEngine {
+public:
+  OrderStateEngine(const InstrumentTable &table,
+                   const OrderStateEngineOptions &options = {});
+  ~OrderStateEngine();
+
+  OrderStateEngine(const OrderStateEngine &) = delete;
+  OrderStateEngine &operator=(const OrderStateEngine &) = delete;
+
+  // 合约乘数，默认为1；盈亏按此换算为金额
+  void SetVolumeMultiple(std::uint32_t nInstrument, int nVolumeMultiple);
+  // 登录后按查询到的持仓初始化，同一合约的多条记录累加
+  bool LoadPosition(const CThostFtdcInvestorPositionField &position);
+
+  // 返回更新后的报单，报单池已满时返回nullptr
+  // 已结束的报单不会被重放的旧回报改回活动状态。
+  const OrderState *OnRtnOrder(const CThostFtdcOrderField &order);
+  // 更新持仓与盈亏，重复的成交或合约未登记时返回false
+  bool OnRtnTrade(const CThostFtdcTradeField &trade);
+  // 按最新价重算浮动盈亏
+  void OnTick(const CompactTick &tick) {
+    if (tick.nInstrument < m_nInstruments && tick.nLastPrice != kInvalidTicks)
+      mark(m_pPositions[tick.nInstrument],
+           tick.nLastPrice * m_table.GetPriceTick(tick.nInstrument));
+  }
+  void OnTick(std::uint32_t nInstrument, double dLastPrice) {
+    if (nInstrument < m_nInstruments)
+      mark(m_pPositions[nInstrument], dLastPrice);
+  }
+
+  const OrderState *FindOrder(int nFrontID, int nSessionID,
+                              const char *pszOrderRef) const;
+  const OrderState *FindOrder(const char *pszExchangeID,
+                              const char *pszOrderSysID) const;
+  const OrderState &GetOrder(std::uint32_t nOrder) const {
+    return m_pOrders[nOrder];
+  }
+  // 报单按首次出现的顺序编号
+  std::size_t GetOrderCount() const { return m_nOrders; }
+  std::size_t GetOrderCapacity() const { return m_nMaxOrders; }
+
+  const PositionState &GetPosition(std::uint32_t nInstrument) const {
+    return m_pPositions[nInstrument];
+  }
+  double GetTotalRealizedPnL() const;
+  double GetTotalUnrealizedPnL() const;
+
+  // 报单池已满而被丢弃的报单回报数
+  std::uint64_t GetDroppedCount() const { return m_nDropped; }
+  // 合约未登记而被忽略的成交数
+  std::uint64_t GetUnknownTradeCount() const { return m_nUnknownTrades; }
+  // 重复推送而被忽略的成交数
+  std::uint64_t GetDuplicateTradeCount() const { return m_nDuplicateTrades; }
+  // 暂存区已满而未能记入报单的成交数（持仓照常更新）
+  std::uint64_t GetUnmatchedDroppedCount() const {
+    return m_nUnmatchedDropped;
+  }
+  std::size_t GetTradeCount() const { return m_nTrades; }
+
+  // 换日时清空报单、成交记录和暂存的成交，今仓转为昨仓，已实现盈亏清零
+  void Reset();
+
+private:
+  // 检查点直接保存和恢复内部数组
+  friend class TraderCheckpoint;
+  // 风控以相同的OrderRef解析规则记录在途报单
+  friend class RiskGate;
+
+  // 含非数字字符的OrderRef以哈希为键，用最高位标记
+  static constexpr std::uint64_t kHashedOrderRef = 1ull << 63;
+
+  // 尚未找到报单的成交，按(ExchangeID, OrderSysID)合并
+  struct UnmatchedTrade {
+    TThostFtdcExchangeIDType szExchangeID;
+    TThostFtdcOrderSysIDType szOrderSysID;
+    std::int32_t nVolume;
+    double dAmount;
+  };
+
+  static std::uint64_t parseOrderRef(const char *pszOrderRef);
+  // 键相同的两个OrderRef是否为同一报单，哈希键须核对原串
+  static bool sameOrderRef(std::uint64_t nOrderRef, const char *pszLeft,
+                           const char *pszRight);
+  static std::uint32_t hashOrderKey(int nFrontID, int nSessionID,
+                                    std::uint64_t nOrderRef);
+  static std::uint32_t hashSysKey(const char *pszExchangeID,
+                                  const char *pszOrderSysID);
+  static std::uint32_t hashTradeKey(const TradeKey &key);
+
+  std::uint32_t findOrder(int nFrontID, int nSessionID,
+                          std::uint64_t nOrderRef, const char *pszOrderRef,
+                          std::size_t &nBucket) const;
+  std::uint32_t findSysOrder(const char *pszExchangeID,
+                             const char *pszOrderSysID,
+                             std::size_t &nBucket) const;
+  std::uint32_t findTrade(const TradeKey &key, std::size_t &nBucket) const;
+  // 记录成交键，已存在时返回false
+  bool addTrade(const TradeKey &key);
+  void addUnmatched(const CThostFtdcTradeField &trade);
+  // 报单刚建立OrderSysID索引时，记入此前暂存的成交
+  void creditUnmatched(OrderState &order);
+  void close(std::int32_t &nPosition, std::int32_t &nToday, double &dCost,
+             char cOffsetFlag, int nVolume, double dPrice, bool bLong,
+             PositionState &position);
+  void mark(PositionState &position, double dLastPrice) {
+    position.dLastPrice = dLastPrice;
+    position.dUnrealizedPnL =
+        (dLastPrice * position.nLongPosition - position.dLongCost +
+         position.dShortCost - dLastPrice * position.nShortPosition) *
+        position.nVolumeMultiple;
+  }
+
+  const InstrumentTable &m_table;
+  std::size_t m_nInstruments;
+  std::size_t m_nMaxOrders;
+  std::size_t m_nBucketMask;
+
+  OrderState *m_pOrders;
+  std::size_t m_nOrders;
+  // 两张索引表存放报单编号，空桶为kInvalidOrder
+  std::uint32_t *m_pOrderBuckets;
+  std::uint32_t *m_pSysBuckets;
+  PositionState *m_pPositions;
+
+  std::size_t m_nMaxTrades;
+  std::size_t m_nTradeBucketMask;
+  TradeKey *m_pTrades;
+  std::size_t m_nTrades;
+  std::uint32_t *m_pTradeBuckets;
+
+  // 暂存的成交只在成交与报单回报乱序时短暂存在，数量很少，顺序查找
+  std::size_t m_nMaxUnmatched;
+  UnmatchedTrade *m_pUnmatched;
+  std::size_t m_nUnmatched;
+
+  std::uint64_t m_nDropped;
+  std::uint64_t m_nUnknownTrades;
+  std::uint64_t m_nDuplicateTrades;
+  std::uint64_t m_nUnmatchedDropped;
+};
+
+} // namespace ctp
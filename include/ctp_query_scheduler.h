@@ -0,0 +1,302 @@
+#pragma once
+
+#include "ThostFtdcTraderApi.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+// 查询调度器支持的查询（查询名, 请求结构体, 应答结构体）
+// 需要其他ReqQry*时在此追加一行，并为请求结构体添加AppendQueryKey重载。
+#define CTP_QUERY_SCHEDULER_QUERIES(X)                                         \
+  X(TradingAccount, CThostFtdcQryTradingAccountField,                          \
+    CThostFtdcTradingAccountField)                                             \
+  X(InvestorPosition, CThostFtdcQryInvestorPositionField,                      \
+    CThostFtdcInvestorPositionField)                                           \
+  X(Order, CThostFtdcQryOrderField, CThostFtdcOrderField)                      \
+  X(Trade, CThostFtdcQryTradeField, CThostFtdcTradeField)                      \
+  X(Instrument, CThostFtdcQryInstrumentField, CThostFtdcInstrumentField)       \
+  X(InstrumentMarginRate, CThostFtdcQryInstrumentMarginRateField,              \
+    CThostFtdcInstrumentMarginRateField)                                       \
+  X(InstrumentCommissionRate, CThostFtdcQryInstrumentCommissionRateField,      \
+    CThostFtdcInstrumentCommissionRateField)                                   \
+  X(DepthMarketData, CThostFtdcQryDepthMarketDataField,                        \
+    CThostFtdcDepthMarketDataField)
+
+namespace ctp {
+
+// ReqQry*返回的流控错误码
+constexpr int kQryRetNotConnected = -1;   // 网络连接失败
+constexpr int kQryRetTooManyPending = -2; // 未处理请求超过许可数
+constexpr int kQryRetTooFrequent = -3;    // 每秒发送请求数超过许可数
+// 调度器生成的错误码：在途查询超过nInFlightTimeoutMs仍未收到最后一段应答
+constexpr int kQryErrorTimeout = -100;
+
+enum class QueryPriority { High = 0, Normal = 1, Low = 2 };
+
+struct QuerySchedulerOptions {
+  // 令牌桶：每秒补充的令牌数和桶容量
+  double dQueriesPerSecond = 1.0;
+  double dBurst = 1.0;
+  // 返回-2时等待多久再重试（在途查询应答后也会立即重试）
+  int nRetryDelayMs = 200;
+  // 调度器使用的RequestID起点，避免与应用自己的请求冲突
+  int nFirstRequestID = 1000000;
+  // 在途查询距发出或上一段应答超过该时间即以kQryErrorTimeout失败，0表示不限
+  int nInFlightTimeoutMs = 30000;
+};
+
+// 合并查询用的键：逐个追加有意义的请求字段，字符串只取到NUL为止，
+// NUL之后的残留字节和已废弃的reserve字段不影响合并
+template <std::size_t N>
+inline void AppendQueryKeyField(std::string &strKey, const char (&szField)[N]) {
+  strKey.append(szField, strnlen(szField, N));
+  strKey.push_back('\0');
+}
+inline void AppendQueryKeyField(std::string &strKey, char cField) {
+  strKey.push_back(cField);
+}
+
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryTradingAccountField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.CurrencyID);
+  AppendQueryKeyField(strKey, req.BizType);
+  AppendQueryKeyField(strKey, req.AccountID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryInvestorPositionField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.InvestUnitID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryOrderField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.OrderSysID);
+  AppendQueryKeyField(strKey, req.InsertTimeStart);
+  AppendQueryKeyField(strKey, req.InsertTimeEnd);
+  AppendQueryKeyField(strKey, req.InvestUnitID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryTradeField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.TradeID);
+  AppendQueryKeyField(strKey, req.TradeTimeStart);
+  AppendQueryKeyField(strKey, req.TradeTimeEnd);
+  AppendQueryKeyField(strKey, req.InvestUnitID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryInstrumentField &req) {
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+  AppendQueryKeyField(strKey, req.ExchangeInstID);
+  AppendQueryKeyField(strKey, req.ProductID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryInstrumentMarginRateField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.HedgeFlag);
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.InvestUnitID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+}
+inline void
+AppendQueryKey(std::string &strKey,
+               const CThostFtdcQryInstrumentCommissionRateField &req) {
+  AppendQueryKeyField(strKey, req.BrokerID);
+  AppendQueryKeyField(strKey, req.InvestorID);
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.InvestUnitID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+}
+inline void AppendQueryKey(std::string &strKey,
+                           const CThostFtdcQryDepthMarketDataField &req) {
+  AppendQueryKeyField(strKey, req.ExchangeID);
+  AppendQueryKeyField(strKey, req.InstrumentID);
+  AppendQueryKeyField(strKey, req.ProductClass);
+}
+
+// 查询类型 -> 对应的ReqQry*方法和应答结构体
+template <typename Qry> struct QueryTraits;
+
+#define CTP_QUERY_SCHEDULER_TRAITS(Name, Qry, Rsp)                             \
+  template <> struct QueryTraits<Qry> {                                        \
+    using Response = Rsp;                                                      \
+    static int Send(CThostFtdcTraderApi *pApi, Qry *pReq, int nRequestID) {    \
+      return pApi->ReqQry##Name(pReq, nRequestID);                             \
+    }                                                                          \
+  };
+CTP_QUERY_SCHEDULER_QUERIES(CTP_QUERY_SCHEDULER_TRAITS)
+#undef CTP_QUERY_SCHEDULER_TRAITS
+
+// 流控感知的查询调度器
+// 所有ReqQry*经由调度器排队发送：
+// - 按优先级排队，同时最多一笔查询在途；
+// - 尚未发出的相同查询（类型与请求内容都相同）合并为一笔，应答分发给每个调用方；
+// - 按令牌桶节奏发送，返回-2/-3时自动重新排队重试；
+// - 断线或返回-1时暂停发送，查询保留在队列中，重新登录后调用Start()恢复；
+// - 在途查询超过nInFlightTimeoutMs没有应答时以kQryErrorTimeout失败；
+// - 把多段bIsLast应答拼成一个结果，在最后一段到达时一次性回调。
+// 应用需要在对应的OnRspQry*和OnRspError中调用OnRsp/OnRspError把应答交给
+// 调度器，在OnFrontDisconnected中调用OnFrontDisconnected让在途查询重发。
+// 回调在CTP回调线程或调度线程上触发，不持有调度器内部锁。
+class QueryScheduler {
+public:
+  template <typename Rsp>
+  using Callback = std::function<void(const std::vector<Rsp> &results,
+                                      const CThostFtdcRspInfoField &rspInfo)>;
+
+  QueryScheduler(CThostFtdcTraderApi *pApi,
+                 const QuerySchedulerOptions &options = {});
+  ~QueryScheduler();
+
+  QueryScheduler(const QueryScheduler &) = delete;
+  QueryScheduler &operator=(const QueryScheduler &) = delete;
+
+  // 登录成功后启动调度线程，断线重连并重新登录后再次调用以恢复发送；
+  // Stop()丢弃尚未完成的查询
+  void Start();
+  void Stop();
+
+  // 提交查询，callback在全部应答到达后调用一次
+  template <typename Qry>
+  void Submit(const Qry &req, QueryPriority ePriority,
+              Callback<typename QueryTraits<Qry>::Response> callback) {
+    std::string strKey(typeid(Qry).name());
+    strKey.push_back('\0');
+    AppendQueryKey(strKey, req);
+    submit(std::move(strKey), ePriority,
+           [&req]() -> Job * { return new TypedJob<Qry>(req); },
+           [&callback](Job *pJob) {
+             static_cast<TypedJob<Qry> *>(pJob)->callbacks.push_back(
+                 std::move(callback));
+           });
+  }
+
+  // 由OnRspQry*转交应答，属于调度器发出的查询时返回true
+  template <typename Rsp>
+  bool OnRsp(Rsp *pRsp, CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+             bool bIsLast) {
+    return onRsp(&typeid(Rsp), pRsp, pRspInfo, nRequestID, bIsLast);
+  }
+  bool OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) {
+    return onRsp(nullptr, nullptr, pRspInfo, nRequestID, bIsLast);
+  }
+  // 断线后在途查询不会再有应答，重新排到队首，并暂停发送直到Start()
+  void OnFrontDisconnected();
+
+  std::size_t GetPendingCount() const;
+  // 实际发出的查询数（含被流控退回的尝试）
+  std::uint64_t GetSentCount() const {
+    return m_nSent.load(std::memory_order_relaxed);
+  }
+  // 被合并掉的重复查询数
+  std::uint64_t GetCoalescedCount() const {
+    return m_nCoalesced.load(std::memory_order_relaxed);
+  }
+  // 返回-2/-3而重试的次数
+  std::uint64_t GetThrottledCount() const {
+    return m_nThrottled.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Job {
+    virtual ~Job() {}
+    virtual int Send(CThostFtdcTraderApi *pApi, int nRequestID) = 0;
+    virtual const std::type_info &ResponseType() const = 0;
+    virtual void Append(const void *pRsp) = 0;
+    virtual void Reset() = 0;
+    virtual void Complete(const CThostFtdcRspInfoField &rspInfo) = 0;
+
+    std::string strKey;
+    QueryPriority ePriority;
+  };
+
+  template <typename Qry> struct TypedJob : Job {
+    using Rsp = typename QueryTraits<Qry>::Response;
+
+    explicit TypedJob(const Qry &qry) : req(qry) {}
+
+    int Send(CThostFtdcTraderApi *pApi, int nRequestID) override {
+      Qry copy = req;
+      return QueryTraits<Qry>::Send(pApi, &copy, nRequestID);
+    }
+    const std::type_info &ResponseType() const override {
+      return typeid(Rsp);
+    }
+    void Append(const void *pRsp) override {
+      results.push_back(*static_cast<const Rsp *>(pRsp));
+    }
+    void Reset() override { results.clear(); }
+    void Complete(const CThostFtdcRspInfoField &rspInfo) override {
+      for (auto &callback : callbacks)
+        if (callback)
+          callback(results, rspInfo);
+    }
+
+    Qry req;
+    std::vector<Rsp> results;
+    std::vector<Callback<Rsp>> callbacks;
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  void submit(std::string &&strKey, QueryPriority ePriority,
+              const std::function<Job *()> &fnCreate,
+              const std::function<void(Job *)> &fnAddCallback);
+  bool onRsp(const std::type_info *pType, const void *pRsp,
+             CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast);
+  void run();
+  void refill(Clock::time_point now);
+  // 以调度器生成的错误结束一笔查询，回调时释放锁
+  void fail(std::unique_ptr<Job> pJob, int nErrorID, const char *pszMsg,
+            std::unique_lock<std::mutex> &lock);
+
+  CThostFtdcTraderApi *m_pApi;
+  QuerySchedulerOptions m_options;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<std::unique_ptr<Job>> m_queues[3]; // 按QueryPriority下标
+  std::unique_ptr<Job> m_pInFlight;
+  int m_nInFlightRequestID;
+  Clock::time_point m_inFlightDeadline; // 距发出或上一段应答的时限
+  CThostFtdcRspInfoField m_inFlightRspInfo;
+  int m_nNextRequestID;
+
+  double m_dTokens;
+  Clock::time_point m_lastRefill;
+  Clock::time_point m_notBefore; // 流控退回后的最早重试时间
+
+  std::thread m_thread;
+  bool m_bRunning;
+  bool m_bPaused; // 未连接或未登录，暂不发送
+
+  std::atomic<std::uint64_t> m_nSent;
+  std::atomic<std::uint64_t> m_nCoalesced;
+  std::atomic<std::uint64_t> m_nThrottled;
+};
+
+} // namespace ctp
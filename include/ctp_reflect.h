@@ -0,0 +1,387 @@
+#pragma once
+
+#include "ctp_reflect_fields.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace ctp {
+
+// 由Reflect<T>描述字段的结构体
+template <typename T, typename = void> struct IsReflected : std::false_type {};
+template <typename T>
+struct IsReflected<T, decltype(void(Reflect<T>::kFieldCount))>
+    : std::true_type {};
+
+// 以(字段名, 字段引用)依次调用visitor
+// 字段名与成员指针都是编译期常量，内联后每个字段展开为一段直线代码。
+template <typename T, typename Visitor>
+constexpr void ForEachField(T &obj, Visitor &&visitor) {
+  Reflect<std::remove_const_t<T>>::ForEachField(
+      [&](const char *pszName, auto pMember) {
+        visitor(pszName, obj.*pMember);
+      });
+}
+
+// 以(字段名, lhs的字段, rhs的字段)依次调用visitor
+template <typename T, typename Visitor>
+constexpr void ForEachFieldPair(const T &lhs, const T &rhs,
+                                Visitor &&visitor) {
+  Reflect<T>::ForEachField([&](const char *pszName, auto pMember) {
+    visitor(pszName, lhs.*pMember, rhs.*pMember);
+  });
+}
+
+namespace detail {
+
+// CTP字段只有四类：定长字符串char[N]、单字符标志char、整数int/short和double
+template <typename F> struct ReflectField;
+
+template <std::size_t N> struct ReflectField<char[N]> {
+  // 编码为长度前缀加有效字节
+  using LengthType =
+      std::conditional_t<(N <= 256), std::uint8_t, std::uint16_t>;
+  static constexpr std::size_t kMaxEncodedSize = sizeof(LengthType) + N - 1;
+};
+template <> struct ReflectField<char> {
+  static constexpr std::size_t kMaxEncodedSize = 1;
+};
+template <> struct ReflectField<short> {
+  static constexpr std::size_t kMaxEncodedSize = sizeof(short);
+};
+template <> struct ReflectField<int> {
+  static constexpr std::size_t kMaxEncodedSize = sizeof(int);
+};
+template <> struct ReflectField<double> {
+  static constexpr std::size_t kMaxEncodedSize = sizeof(double);
+};
+
+template <typename P> struct ReflectMember;
+template <typename C, typename M> struct ReflectMember<M C::*> {
+  using Type = M;
+};
+
+// CTP以DBL_MAX表示无效值
+inline bool IsValidDouble(double dValue) {
+  return std::fabs(dValue) < DBL_MAX;
+}
+
+inline bool NeedsCsvQuote(const char *pszValue, std::size_t nLength) {
+  for (std::size_t i = 0; i < nLength; ++i) {
+    char c = pszValue[i];
+    if (c == ',' || c == '"' || c == '\n' || c == '\r')
+      return true;
+  }
+  return false;
+}
+
+} // namespace detail
+
+// 编码后的最大字节数，编译期常量
+template <typename T> constexpr std::size_t MaxEncodedSize() {
+  std::size_t nSize = 0;
+  Reflect<T>::ForEachField([&](const char *, auto pMember) {
+    using M = typename detail::ReflectMember<decltype(pMember)>::Type;
+    nSize += detail::ReflectField<M>::kMaxEncodedSize;
+  });
+  return nSize;
+}
+
+// 定长缓冲区上的顺序写入器，不做堆分配
+// 空间不足时停止写入并记下溢出，由调用方检查Overflow()。
+class FieldWriter {
+public:
+  FieldWriter(char *pBuffer, std::size_t nSize)
+      : m_pBegin(pBuffer), m_pPos(pBuffer), m_pEnd(pBuffer + nSize),
+        m_bOverflow(false) {}
+
+  void Put(char c) {
+    if (m_pPos < m_pEnd)
+      *m_pPos++ = c;
+    else
+      m_bOverflow = true;
+  }
+  void Put(const void *pData, std::size_t nSize) {
+    if (static_cast<std::size_t>(m_pEnd - m_pPos) >= nSize) {
+      std::memcpy(m_pPos, pData, nSize);
+      m_pPos += nSize;
+    } else {
+      m_bOverflow = true;
+    }
+  }
+  template <std::size_t N> void PutLiteral(const char (&szText)[N]) {
+    Put(szText, N - 1);
+  }
+  void PutInt(long long nValue) {
+    std::to_chars_result result = std::to_chars(m_pPos, m_pEnd, nValue);
+    if (result.ec == std::errc())
+      m_pPos = result.ptr;
+    else
+      m_bOverflow = true;
+  }
+  // 输出能精确还原的最短十进制表示
+  void PutDouble(double dValue) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::to_chars_result result = std::to_chars(m_pPos, m_pEnd, dValue);
+    if (result.ec == std::errc())
+      m_pPos = result.ptr;
+    else
+      m_bOverflow = true;
+#else
+    std::size_t nLeft = static_cast<std::size_t>(m_pEnd - m_pPos);
+    int n = std::snprintf(m_pPos, nLeft, "%.17g", dValue);
+    if (n >= 0 && static_cast<std::size_t>(n) < nLeft)
+      m_pPos += n;
+    else
+      m_bOverflow = true;
+#endif
+  }
+
+  // 溢出时返回0，否则在有空间时补结尾的'\0'（不计入长度）
+  std::size_t Finish() {
+    if (m_bOverflow)
+      return 0;
+    if (m_pPos < m_pEnd)
+      *m_pPos = '\0';
+    return static_cast<std::size_t>(m_pPos - m_pBegin);
+  }
+
+  std::size_t Size() const {
+    return static_cast<std::size_t>(m_pPos - m_pBegin);
+  }
+  bool Overflow() const { return m_bOverflow; }
+
+private:
+  char *m_pBegin;
+  char *m_pPos;
+  char *m_pEnd;
+  bool m_bOverflow;
+};
+
+// 二进制编码：按字段顺序，字符串为长度前缀加有效字节，数值为主机字节序
+// 比整个结构体紧凑得多，适合落盘和进程间传递。返回写入的字节数，空间不足时
+// 返回0；缓冲区不小于MaxEncodedSize<T>()时不会失败。
+template <typename T>
+std::size_t Encode(const T &obj, char *pBuffer, std::size_t nSize) {
+  FieldWriter writer(pBuffer, nSize);
+  ForEachField(obj, [&](const char *, const auto &value) {
+    using F = std::remove_cv_t<std::remove_reference_t<decltype(value)>>;
+    if constexpr (std::is_array_v<F>) {
+      using L = typename detail::ReflectField<F>::LengthType;
+      L nLength = static_cast<L>(strnlen(value, sizeof(F) - 1));
+      writer.Put(&nLength, sizeof(nLength));
+      writer.Put(value, nLength);
+    } else {
+      writer.Put(&value, sizeof(value));
+    }
+  });
+  return writer.Overflow() ? 0 : writer.Size();
+}
+
+// 解码Encode()的输出，字符串字段的剩余部分清零
+// 返回读取的字节数，数据不完整或字符串超长时返回0。
+template <typename T>
+std::size_t Decode(const char *pBuffer, std::size_t nSize, T &obj) {
+  const char *p = pBuffer;
+  const char *pEnd = pBuffer + nSize;
+  bool bOk = true;
+  ForEachField(obj, [&](const char *, auto &value) {
+    using F = std::remove_reference_t<decltype(value)>;
+    if (!bOk)
+      return;
+    if constexpr (std::is_array_v<F>) {
+      using L = typename detail::ReflectField<F>::LengthType;
+      L nLength;
+      if (pEnd - p < static_cast<std::ptrdiff_t>(sizeof(L))) {
+        bOk = false;
+        return;
+      }
+      std::memcpy(&nLength, p, sizeof(L));
+      p += sizeof(L);
+      if (nLength >= sizeof(F) || pEnd - p < nLength) {
+        bOk = false;
+        return;
+      }
+      std::memcpy(value, p, nLength);
+      std::memset(value + nLength, 0, sizeof(F) - nLength);
+      p += nLength;
+    } else {
+      if (pEnd - p < static_cast<std::ptrdiff_t>(sizeof(F))) {
+        bOk = false;
+        return;
+      }
+      std::memcpy(&value, p, sizeof(F));
+      p += sizeof(F);
+    }
+  });
+  return bOk ? static_cast<std::size_t>(p - pBuffer) : 0;
+}
+
+// 以JSON格式写出单个字段值
+// 字符串按原样输出（CTP的中文为GBK编码），只转义引号、反斜杠和控制字符；
+// 无效的double（DBL_MAX）输出为null。
+template <typename F> void WriteJsonValue(FieldWriter &writer, const F &value) {
+  if constexpr (std::is_array_v<F>) {
+    writer.Put('"');
+    for (std::size_t i = 0; i < sizeof(F) && value[i]; ++i) {
+      char c = value[i];
+      if (c == '"' || c == '\\') {
+        writer.Put('\\');
+        writer.Put(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        static const char kHex[] = "0123456789abcdef";
+        writer.PutLiteral("\\u00");
+        writer.Put(kHex[(c >> 4) & 0xF]);
+        writer.Put(kHex[c & 0xF]);
+      } else {
+        writer.Put(c);
+      }
+    }
+    writer.Put('"');
+  } else if constexpr (std::is_same_v<F, char>) {
+    writer.Put('"');
+    if (value == '"' || value == '\\')
+      writer.Put('\\');
+    if (value)
+      writer.Put(value);
+    writer.Put('"');
+  } else if constexpr (std::is_floating_point_v<F>) {
+    if (detail::IsValidDouble(value))
+      writer.PutDouble(value);
+    else
+      writer.PutLiteral("null");
+  } else {
+    writer.PutInt(value);
+  }
+}
+
+// 写出一行JSON对象，返回长度（不含结尾的'\0'），空间不足时返回0
+template <typename T>
+std::size_t WriteJson(const T &obj, char *pBuffer, std::size_t nSize) {
+  FieldWriter writer(pBuffer, nSize);
+  writer.Put('{');
+  bool bFirst = true;
+  ForEachField(obj, [&](const char *pszName, const auto &value) {
+    if (!bFirst)
+      writer.Put(',');
+    bFirst = false;
+    writer.Put('"');
+    writer.Put(pszName, std::strlen(pszName));
+    writer.PutLiteral("\":");
+    WriteJsonValue(writer, value);
+  });
+  writer.Put('}');
+  return writer.Finish();
+}
+
+// 写出CSV表头（字段名），不含换行
+template <typename T>
+std::size_t WriteCsvHeader(char *pBuffer, std::size_t nSize) {
+  FieldWriter writer(pBuffer, nSize);
+  bool bFirst = true;
+  Reflect<T>::ForEachField([&](const char *pszName, auto) {
+    if (!bFirst)
+      writer.Put(',');
+    bFirst = false;
+    writer.Put(pszName, std::strlen(pszName));
+  });
+  return writer.Finish();
+}
+
+// 写出一行CSV，不含换行；无效的double输出为空
+template <typename T>
+std::size_t WriteCsv(const T &obj, char *pBuffer, std::size_t nSize) {
+  FieldWriter writer(pBuffer, nSize);
+  bool bFirst = true;
+  ForEachField(obj, [&](const char *, const auto &value) {
+    using F = std::remove_cv_t<std::remove_reference_t<decltype(value)>>;
+    if (!bFirst)
+      writer.Put(',');
+    bFirst = false;
+    if constexpr (std::is_array_v<F>) {
+      std::size_t nLength = strnlen(value, sizeof(F));
+      if (detail::NeedsCsvQuote(value, nLength)) {
+        writer.Put('"');
+        for (std::size_t i = 0; i < nLength; ++i) {
+          if (value[i] == '"')
+            writer.Put('"');
+          writer.Put(value[i]);
+        }
+        writer.Put('"');
+      } else {
+        writer.Put(value, nLength);
+      }
+    } else if constexpr (std::is_same_v<F, char>) {
+      if (value == ',' || value == '"') {
+        writer.Put('"');
+        if (value == '"')
+          writer.Put('"');
+        writer.Put(value);
+        writer.Put('"');
+      } else if (value) {
+        writer.Put(value);
+      }
+    } else if constexpr (std::is_floating_point_v<F>) {
+      if (detail::IsValidDouble(value))
+        writer.PutDouble(value);
+    } else {
+      writer.PutInt(value);
+    }
+  });
+  return writer.Finish();
+}
+
+// 两个字段值是否相同：字符串比较到'\0'为止，数值按位比较
+template <typename F> bool FieldEquals(const F &lhs, const F &rhs) {
+  if constexpr (std::is_array_v<F>)
+    return std::strncmp(lhs, rhs, sizeof(F)) == 0;
+  else
+    return std::memcmp(&lhs, &rhs, sizeof(F)) == 0;
+}
+
+// 逐字段比较两个快照，对每个不同的字段以(字段名, 旧值, 新值)调用visitor
+// 返回不同字段的个数。
+template <typename T, typename Visitor>
+std::size_t DiffFields(const T &before, const T &after, Visitor &&visitor) {
+  std::size_t nDiffs = 0;
+  ForEachFieldPair(before, after,
+                   [&](const char *pszName, const auto &lhs, const auto &rhs) {
+                     if (!FieldEquals(lhs, rhs)) {
+                       ++nDiffs;
+                       visitor(pszName, lhs, rhs);
+                     }
+                   });
+  return nDiffs;
+}
+
+// 把两个快照的差异写成JSON：{"字段":[旧值,新值],...}
+template <typename T>
+std::size_t WriteDiffJson(const T &before, const T &after, char *pBuffer,
+                          std::size_t nSize) {
+  FieldWriter writer(pBuffer, nSize);
+  writer.Put('{');
+  bool bFirst = true;
+  DiffFields(before, after,
+             [&](const char *pszName, const auto &lhs, const auto &rhs) {
+               if (!bFirst)
+                 writer.Put(',');
+               bFirst = false;
+               writer.Put('"');
+               writer.Put(pszName, std::strlen(pszName));
+               writer.PutLiteral("\":[");
+               WriteJsonValue(writer, lhs);
+               writer.Put(',');
+               WriteJsonValue(writer, rhs);
+               writer.Put(']');
+             });
+  writer.Put('}');
+  return writer.Finish();
+}
+
+} // namespace ctp
@@ -0,0 +1,471 @@
+// 由scripts/gen_ctp_reflect.py根据ThostFtdcUserApiStruct.h生成，请勿手工修改
+// 升级CTP API后重新生成：
+//   python3 scripts/gen_ctp_reflect.py <api目录>/ThostFtdcUserApiStruct.h
+//       > include/ctp_reflect_fields.h
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+
+#include <cstddef>
+
+namespace ctp {
+
+// 结构体的字段描述，以(字段名, 成员指针)依次调用visitor
+template <typename T> struct Reflect;
+
+template <> struct Reflect<CThostFtdcRspInfoField> {
+  using Type = CThostFtdcRspInfoField;
+  static constexpr const char *kName = "CThostFtdcRspInfoField";
+  static constexpr std::size_t kFieldCount = 2;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("ErrorID", &Type::ErrorID);
+    visitor("ErrorMsg", &Type::ErrorMsg);
+  }
+};
+
+template <> struct Reflect<CThostFtdcRspUserLoginField> {
+  using Type = CThostFtdcRspUserLoginField;
+  static constexpr const char *kName = "CThostFtdcRspUserLoginField";
+  static constexpr std::size_t kFieldCount = 16;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("TradingDay", &Type::TradingDay);
+    visitor("LoginTime", &Type::LoginTime);
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("UserID", &Type::UserID);
+    visitor("SystemName", &Type::SystemName);
+    visitor("FrontID", &Type::FrontID);
+    visitor("SessionID", &Type::SessionID);
+    visitor("MaxOrderRef", &Type::MaxOrderRef);
+    visitor("SHFETime", &Type::SHFETime);
+    visitor("DCETime", &Type::DCETime);
+    visitor("CZCETime", &Type::CZCETime);
+    visitor("FFEXTime", &Type::FFEXTime);
+    visitor("INETime", &Type::INETime);
+    visitor("GFEXTime", &Type::GFEXTime);
+    visitor("LoginDRIdentityID", &Type::LoginDRIdentityID);
+    visitor("UserDRIdentityID", &Type::UserDRIdentityID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcSpecificInstrumentField> {
+  using Type = CThostFtdcSpecificInstrumentField;
+  static constexpr const char *kName = "CThostFtdcSpecificInstrumentField";
+  static constexpr std::size_t kFieldCount = 1;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcDepthMarketDataField> {
+  using Type = CThostFtdcDepthMarketDataField;
+  static constexpr const char *kName = "CThostFtdcDepthMarketDataField";
+  static constexpr std::size_t kFieldCount = 46;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("TradingDay", &Type::TradingDay);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("LastPrice", &Type::LastPrice);
+    visitor("PreSettlementPrice", &Type::PreSettlementPrice);
+    visitor("PreClosePrice", &Type::PreClosePrice);
+    visitor("PreOpenInterest", &Type::PreOpenInterest);
+    visitor("OpenPrice", &Type::OpenPrice);
+    visitor("HighestPrice", &Type::HighestPrice);
+    visitor("LowestPrice", &Type::LowestPrice);
+    visitor("Volume", &Type::Volume);
+    visitor("Turnover", &Type::Turnover);
+    visitor("OpenInterest", &Type::OpenInterest);
+    visitor("ClosePrice", &Type::ClosePrice);
+    visitor("SettlementPrice", &Type::SettlementPrice);
+    visitor("UpperLimitPrice", &Type::UpperLimitPrice);
+    visitor("LowerLimitPrice", &Type::LowerLimitPrice);
+    visitor("PreDelta", &Type::PreDelta);
+    visitor("CurrDelta", &Type::CurrDelta);
+    visitor("UpdateTime", &Type::UpdateTime);
+    visitor("UpdateMillisec", &Type::UpdateMillisec);
+    visitor("BidPrice1", &Type::BidPrice1);
+    visitor("BidVolume1", &Type::BidVolume1);
+    visitor("AskPrice1", &Type::AskPrice1);
+    visitor("AskVolume1", &Type::AskVolume1);
+    visitor("BidPrice2", &Type::BidPrice2);
+    visitor("BidVolume2", &Type::BidVolume2);
+    visitor("AskPrice2", &Type::AskPrice2);
+    visitor("AskVolume2", &Type::AskVolume2);
+    visitor("BidPrice3", &Type::BidPrice3);
+    visitor("BidVolume3", &Type::BidVolume3);
+    visitor("AskPrice3", &Type::AskPrice3);
+    visitor("AskVolume3", &Type::AskVolume3);
+    visitor("BidPrice4", &Type::BidPrice4);
+    visitor("BidVolume4", &Type::BidVolume4);
+    visitor("AskPrice4", &Type::AskPrice4);
+    visitor("AskVolume4", &Type::AskVolume4);
+    visitor("BidPrice5", &Type::BidPrice5);
+    visitor("BidVolume5", &Type::BidVolume5);
+    visitor("AskPrice5", &Type::AskPrice5);
+    visitor("AskVolume5", &Type::AskVolume5);
+    visitor("AveragePrice", &Type::AveragePrice);
+    visitor("ActionDay", &Type::ActionDay);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("ExchangeInstID", &Type::ExchangeInstID);
+    visitor("BandingUpperPrice", &Type::BandingUpperPrice);
+    visitor("BandingLowerPrice", &Type::BandingLowerPrice);
+  }
+};
+
+template <> struct Reflect<CThostFtdcForQuoteRspField> {
+  using Type = CThostFtdcForQuoteRspField;
+  static constexpr const char *kName = "CThostFtdcForQuoteRspField";
+  static constexpr std::size_t kFieldCount = 6;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("TradingDay", &Type::TradingDay);
+    visitor("ForQuoteSysID", &Type::ForQuoteSysID);
+    visitor("ForQuoteTime", &Type::ForQuoteTime);
+    visitor("ActionDay", &Type::ActionDay);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInputOrderField> {
+  using Type = CThostFtdcInputOrderField;
+  static constexpr const char *kName = "CThostFtdcInputOrderField";
+  static constexpr std::size_t kFieldCount = 30;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OrderRef", &Type::OrderRef);
+    visitor("UserID", &Type::UserID);
+    visitor("OrderPriceType", &Type::OrderPriceType);
+    visitor("Direction", &Type::Direction);
+    visitor("CombOffsetFlag", &Type::CombOffsetFlag);
+    visitor("CombHedgeFlag", &Type::CombHedgeFlag);
+    visitor("LimitPrice", &Type::LimitPrice);
+    visitor("VolumeTotalOriginal", &Type::VolumeTotalOriginal);
+    visitor("TimeCondition", &Type::TimeCondition);
+    visitor("GTDDate", &Type::GTDDate);
+    visitor("VolumeCondition", &Type::VolumeCondition);
+    visitor("MinVolume", &Type::MinVolume);
+    visitor("ContingentCondition", &Type::ContingentCondition);
+    visitor("StopPrice", &Type::StopPrice);
+    visitor("ForceCloseReason", &Type::ForceCloseReason);
+    visitor("IsAutoSuspend", &Type::IsAutoSuspend);
+    visitor("BusinessUnit", &Type::BusinessUnit);
+    visitor("RequestID", &Type::RequestID);
+    visitor("UserForceClose", &Type::UserForceClose);
+    visitor("IsSwapOrder", &Type::IsSwapOrder);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("AccountID", &Type::AccountID);
+    visitor("CurrencyID", &Type::CurrencyID);
+    visitor("ClientID", &Type::ClientID);
+    visitor("MacAddress", &Type::MacAddress);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("IPAddress", &Type::IPAddress);
+  }
+};
+
+template <> struct Reflect<CThostFtdcOrderField> {
+  using Type = CThostFtdcOrderField;
+  static constexpr const char *kName = "CThostFtdcOrderField";
+  static constexpr std::size_t kFieldCount = 62;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OrderRef", &Type::OrderRef);
+    visitor("UserID", &Type::UserID);
+    visitor("OrderPriceType", &Type::OrderPriceType);
+    visitor("Direction", &Type::Direction);
+    visitor("CombOffsetFlag", &Type::CombOffsetFlag);
+    visitor("CombHedgeFlag", &Type::CombHedgeFlag);
+    visitor("LimitPrice", &Type::LimitPrice);
+    visitor("VolumeTotalOriginal", &Type::VolumeTotalOriginal);
+    visitor("TimeCondition", &Type::TimeCondition);
+    visitor("GTDDate", &Type::GTDDate);
+    visitor("VolumeCondition", &Type::VolumeCondition);
+    visitor("MinVolume", &Type::MinVolume);
+    visitor("ContingentCondition", &Type::ContingentCondition);
+    visitor("StopPrice", &Type::StopPrice);
+    visitor("ForceCloseReason", &Type::ForceCloseReason);
+    visitor("IsAutoSuspend", &Type::IsAutoSuspend);
+    visitor("BusinessUnit", &Type::BusinessUnit);
+    visitor("RequestID", &Type::RequestID);
+    visitor("OrderLocalID", &Type::OrderLocalID);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("ParticipantID", &Type::ParticipantID);
+    visitor("ClientID", &Type::ClientID);
+    visitor("TraderID", &Type::TraderID);
+    visitor("InstallID", &Type::InstallID);
+    visitor("OrderSubmitStatus", &Type::OrderSubmitStatus);
+    visitor("NotifySequence", &Type::NotifySequence);
+    visitor("TradingDay", &Type::TradingDay);
+    visitor("SettlementID", &Type::SettlementID);
+    visitor("OrderSysID", &Type::OrderSysID);
+    visitor("OrderSource", &Type::OrderSource);
+    visitor("OrderStatus", &Type::OrderStatus);
+    visitor("OrderType", &Type::OrderType);
+    visitor("VolumeTraded", &Type::VolumeTraded);
+    visitor("VolumeTotal", &Type::VolumeTotal);
+    visitor("InsertDate", &Type::InsertDate);
+    visitor("InsertTime", &Type::InsertTime);
+    visitor("ActiveTime", &Type::ActiveTime);
+    visitor("SuspendTime", &Type::SuspendTime);
+    visitor("UpdateTime", &Type::UpdateTime);
+    visitor("CancelTime", &Type::CancelTime);
+    visitor("ActiveTraderID", &Type::ActiveTraderID);
+    visitor("ClearingPartID", &Type::ClearingPartID);
+    visitor("SequenceNo", &Type::SequenceNo);
+    visitor("FrontID", &Type::FrontID);
+    visitor("SessionID", &Type::SessionID);
+    visitor("UserProductInfo", &Type::UserProductInfo);
+    visitor("StatusMsg", &Type::StatusMsg);
+    visitor("UserForceClose", &Type::UserForceClose);
+    visitor("ActiveUserID", &Type::ActiveUserID);
+    visitor("BrokerOrderSeq", &Type::BrokerOrderSeq);
+    visitor("RelativeOrderSysID", &Type::RelativeOrderSysID);
+    visitor("ZCETotalTradedVolume", &Type::ZCETotalTradedVolume);
+    visitor("IsSwapOrder", &Type::IsSwapOrder);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("AccountID", &Type::AccountID);
+    visitor("CurrencyID", &Type::CurrencyID);
+    visitor("MacAddress", &Type::MacAddress);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("ExchangeInstID", &Type::ExchangeInstID);
+    visitor("IPAddress", &Type::IPAddress);
+  }
+};
+
+template <> struct Reflect<CThostFtdcTradeField> {
+  using Type = CThostFtdcTradeField;
+  static constexpr const char *kName = "CThostFtdcTradeField";
+  static constexpr std::size_t kFieldCount = 31;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OrderRef", &Type::OrderRef);
+    visitor("UserID", &Type::UserID);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("TradeID", &Type::TradeID);
+    visitor("Direction", &Type::Direction);
+    visitor("OrderSysID", &Type::OrderSysID);
+    visitor("ParticipantID", &Type::ParticipantID);
+    visitor("ClientID", &Type::ClientID);
+    visitor("TradingRole", &Type::TradingRole);
+    visitor("OffsetFlag", &Type::OffsetFlag);
+    visitor("HedgeFlag", &Type::HedgeFlag);
+    visitor("Price", &Type::Price);
+    visitor("Volume", &Type::Volume);
+    visitor("TradeDate", &Type::TradeDate);
+    visitor("TradeTime", &Type::TradeTime);
+    visitor("TradeType", &Type::TradeType);
+    visitor("PriceSource", &Type::PriceSource);
+    visitor("TraderID", &Type::TraderID);
+    visitor("OrderLocalID", &Type::OrderLocalID);
+    visitor("ClearingPartID", &Type::ClearingPartID);
+    visitor("BusinessUnit", &Type::BusinessUnit);
+    visitor("SequenceNo", &Type::SequenceNo);
+    visitor("TradingDay", &Type::TradingDay);
+    visitor("SettlementID", &Type::SettlementID);
+    visitor("BrokerOrderSeq", &Type::BrokerOrderSeq);
+    visitor("TradeSource", &Type::TradeSource);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("ExchangeInstID", &Type::ExchangeInstID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInputOrderActionField> {
+  using Type = CThostFtdcInputOrderActionField;
+  static constexpr const char *kName = "CThostFtdcInputOrderActionField";
+  static constexpr std::size_t kFieldCount = 16;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OrderRef", &Type::OrderRef);
+    visitor("RequestID", &Type::RequestID);
+    visitor("FrontID", &Type::FrontID);
+    visitor("SessionID", &Type::SessionID);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("OrderSysID", &Type::OrderSysID);
+    visitor("ActionFlag", &Type::ActionFlag);
+    visitor("LimitPrice", &Type::LimitPrice);
+    visitor("VolumeChange", &Type::VolumeChange);
+    visitor("UserID", &Type::UserID);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("MacAddress", &Type::MacAddress);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("IPAddress", &Type::IPAddress);
+  }
+};
+
+template <> struct Reflect<CThostFtdcOrderActionField> {
+  using Type = CThostFtdcOrderActionField;
+  static constexpr const char *kName = "CThostFtdcOrderActionField";
+  static constexpr std::size_t kFieldCount = 16;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OrderRef", &Type::OrderRef);
+    visitor("RequestID", &Type::RequestID);
+    visitor("FrontID", &Type::FrontID);
+    visitor("SessionID", &Type::SessionID);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("OrderSysID", &Type::OrderSysID);
+    visitor("ActionFlag", &Type::ActionFlag);
+    visitor("LimitPrice", &Type::LimitPrice);
+    visitor("VolumeChange", &Type::VolumeChange);
+    visitor("ActionDate", &Type::ActionDate);
+    visitor("ActionTime", &Type::ActionTime);
+    visitor("StatusMsg", &Type::StatusMsg);
+    visitor("UserID", &Type::UserID);
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcTradingAccountField> {
+  using Type = CThostFtdcTradingAccountField;
+  static constexpr const char *kName = "CThostFtdcTradingAccountField";
+  static constexpr std::size_t kFieldCount = 10;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("AccountID", &Type::AccountID);
+    visitor("PreBalance", &Type::PreBalance);
+    visitor("CurrMargin", &Type::CurrMargin);
+    visitor("CloseProfit", &Type::CloseProfit);
+    visitor("PositionProfit", &Type::PositionProfit);
+    visitor("Balance", &Type::Balance);
+    visitor("Available", &Type::Available);
+    visitor("Commission", &Type::Commission);
+    visitor("TradingDay", &Type::TradingDay);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInvestorPositionField> {
+  using Type = CThostFtdcInvestorPositionField;
+  static constexpr const char *kName = "CThostFtdcInvestorPositionField";
+  static constexpr std::size_t kFieldCount = 12;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("PosiDirection", &Type::PosiDirection);
+    visitor("HedgeFlag", &Type::HedgeFlag);
+    visitor("PositionDate", &Type::PositionDate);
+    visitor("YdPosition", &Type::YdPosition);
+    visitor("Position", &Type::Position);
+    visitor("TodayPosition", &Type::TodayPosition);
+    visitor("PositionCost", &Type::PositionCost);
+    visitor("OpenCost", &Type::OpenCost);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInstrumentField> {
+  using Type = CThostFtdcInstrumentField;
+  static constexpr const char *kName = "CThostFtdcInstrumentField";
+  static constexpr std::size_t kFieldCount = 31;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("InstrumentName", &Type::InstrumentName);
+    visitor("ProductClass", &Type::ProductClass);
+    visitor("DeliveryYear", &Type::DeliveryYear);
+    visitor("DeliveryMonth", &Type::DeliveryMonth);
+    visitor("MaxMarketOrderVolume", &Type::MaxMarketOrderVolume);
+    visitor("MinMarketOrderVolume", &Type::MinMarketOrderVolume);
+    visitor("MaxLimitOrderVolume", &Type::MaxLimitOrderVolume);
+    visitor("MinLimitOrderVolume", &Type::MinLimitOrderVolume);
+    visitor("VolumeMultiple", &Type::VolumeMultiple);
+    visitor("PriceTick", &Type::PriceTick);
+    visitor("CreateDate", &Type::CreateDate);
+    visitor("OpenDate", &Type::OpenDate);
+    visitor("ExpireDate", &Type::ExpireDate);
+    visitor("StartDelivDate", &Type::StartDelivDate);
+    visitor("EndDelivDate", &Type::EndDelivDate);
+    visitor("InstLifePhase", &Type::InstLifePhase);
+    visitor("IsTrading", &Type::IsTrading);
+    visitor("PositionType", &Type::PositionType);
+    visitor("PositionDateType", &Type::PositionDateType);
+    visitor("LongMarginRatio", &Type::LongMarginRatio);
+    visitor("ShortMarginRatio", &Type::ShortMarginRatio);
+    visitor("MaxMarginSideAlgorithm", &Type::MaxMarginSideAlgorithm);
+    visitor("StrikePrice", &Type::StrikePrice);
+    visitor("OptionsType", &Type::OptionsType);
+    visitor("UnderlyingMultiple", &Type::UnderlyingMultiple);
+    visitor("CombinationType", &Type::CombinationType);
+    visitor("InstrumentID", &Type::InstrumentID);
+    visitor("ExchangeInstID", &Type::ExchangeInstID);
+    visitor("ProductID", &Type::ProductID);
+    visitor("UnderlyingInstrID", &Type::UnderlyingInstrID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInstrumentCommissionRateField> {
+  using Type = CThostFtdcInstrumentCommissionRateField;
+  static constexpr const char *kName =
+      "CThostFtdcInstrumentCommissionRateField";
+  static constexpr std::size_t kFieldCount = 13;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("InvestorRange", &Type::InvestorRange);
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("OpenRatioByMoney", &Type::OpenRatioByMoney);
+    visitor("OpenRatioByVolume", &Type::OpenRatioByVolume);
+    visitor("CloseRatioByMoney", &Type::CloseRatioByMoney);
+    visitor("CloseRatioByVolume", &Type::CloseRatioByVolume);
+    visitor("CloseTodayRatioByMoney", &Type::CloseTodayRatioByMoney);
+    visitor("CloseTodayRatioByVolume", &Type::CloseTodayRatioByVolume);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("BizType", &Type::BizType);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+template <> struct Reflect<CThostFtdcInstrumentMarginRateField> {
+  using Type = CThostFtdcInstrumentMarginRateField;
+  static constexpr const char *kName = "CThostFtdcInstrumentMarginRateField";
+  static constexpr std::size_t kFieldCount = 12;
+
+  template <typename Visitor>
+  static constexpr void ForEachField(Visitor &&visitor) {
+    visitor("InvestorRange", &Type::InvestorRange);
+    visitor("BrokerID", &Type::BrokerID);
+    visitor("InvestorID", &Type::InvestorID);
+    visitor("HedgeFlag", &Type::HedgeFlag);
+    visitor("LongMarginRatioByMoney", &Type::LongMarginRatioByMoney);
+    visitor("LongMarginRatioByVolume", &Type::LongMarginRatioByVolume);
+    visitor("ShortMarginRatioByMoney", &Type::ShortMarginRatioByMoney);
+    visitor("ShortMarginRatioByVolume", &Type::ShortMarginRatioByVolume);
+    visitor("IsRelative", &Type::IsRelative);
+    visitor("ExchangeID", &Type::ExchangeID);
+    visitor("InvestUnitID", &Type::InvestUnitID);
+    visitor("InstrumentID", &Type::InstrumentID);
+  }
+};
+
+} // namespace ctp
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace ctp {
+
+// 一笔请求的完整应答
+struct RequestResult {
+  int nRequestID;
+  CThostFtdcRspInfoField rspInfo; // 第一段出错应答的错误信息，成功时ErrorID为0
+  const void *pRows;              // 所有bIsLast分段应答的数据，按到达顺序排列
+  std::size_t nRowSize;
+  std::size_t nRows;
+  bool bTruncated;          // 应答缓冲区不足，多出的行被丢弃
+  std::int64_t nLatencyNs;  // 从分配RequestID到最后一段应答的耗时
+
+  template <typename T> const T *Rows() const {
+    return static_cast<const T *>(pRows);
+  }
+};
+
+// 完成回调，在CTP回调线程上触发；result在回调返回后失效
+using RequestCallback = void (*)(void *pContext, const RequestResult &result);
+
+struct RequestTrackerOptions {
+  // 槽位数，向上取整为2的幂；同时在途的请求数不能超过该值
+  std::size_t nCapacity = 256;
+  // 每个槽位预分配的应答缓冲区字节数
+  std::size_t nRowBufferBytes = 32768;
+};
+
+class RequestTracker;
+
+// 可等待的请求句柄，析构时释放槽位
+class RequestFuture {
+public:
+  RequestFuture() : m_pTracker(nullptr), m_nRequestID(-1) {}
+  RequestFuture(RequestFuture &&other) noexcept
+      : m_pTracker(other.m_pTracker), m_nRequestID(other.m_nRequestID) {
+    other.m_pTracker = nullptr;
+  }
+  RequestFuture &operator=(RequestFuture &&other) noexcept;
+  ~RequestFuture() { Release(); }
+
+  RequestFuture(const RequestFuture &) = delete;
+  RequestFuture &operator=(const RequestFuture &) = delete;
+
+  // 分配槽位失败时无效
+  bool IsValid() const { return m_pTracker != nullptr; }
+  int GetRequestID() const { return m_nRequestID; }
+
+  // 等待最后一段应答，超时返回false
+  bool Wait(std::chrono::nanoseconds timeout);
+  // Wait()返回true之后调用，结果在Release()之前有效
+  const RequestResult &Get() const;
+  // 放弃结果并释放槽位，应答未到时槽位在应答到达后释放
+  void Release();
+
+private:
+  friend class RequestTracker;
+  RequestFuture(RequestTracker *pTracker, int nRequestID)
+      : m_pTracker(pTracker), m_nRequestID(nRequestID) {}
+
+  RequestTracker *m_pTracker;
+  int m_nRequestID;
+};
+
+// 请求关联表
+// 原子地分配RequestID，并按nRequestID对容量取模放入固定的槽位表，每笔请求
+// 不做堆分配。OnRsp*把应答交给OnRsp()，分段应答按到达顺序拷贝进槽位预分配的
+// 缓冲区，最后一段到达时调用回调或唤醒等待的RequestFuture。
+// Begin/BeginFuture可被任意多个线程并发调用；OnRsp/OnFrontDisconnected
+// 只应在CTP回调线程上调用。
+class RequestTracker {
+public:
+  explicit RequestTracker(const RequestTrackerOptions &options = {});
+  ~RequestTracker();
+
+  RequestTracker(const RequestTracker &) = delete;
+  RequestTracker &operator=(const RequestTracker &) = delete;
+
+  // 只分配RequestID，不跟踪应答
+  int NextRequestID() {
+    return m_nNextRequestID.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // 分配RequestID并占用槽位，应答完成时调用fnCallback；槽位全部占用时返回-1
+  int Begin(RequestCallback fnCallback, void *pContext);
+  // 分配RequestID并返回可等待的句柄
+  RequestFuture BeginFuture();
+  // 请求发送失败时调用，之后不会再有回调；BeginFuture()的请求以
+  // ErrorID=-1完成，槽位在RequestFuture释放时回收
+  void Cancel(int nRequestID);
+
+  // 由OnRsp*转交应答，RequestID未被跟踪时返回false
+  template <typename T>
+  bool OnRsp(const T *pRow, const CThostFtdcRspInfoField *pRspInfo,
+             int nRequestID, bool bIsLast) {
+    return onRsp(pRow, sizeof(T), pRspInfo, nRequestID, bIsLast);
+  }
+  bool OnRspError(const CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) {
+    return onRsp(nullptr, 0, pRspInfo, nRequestID, bIsLast);
+  }
+  // 断线后在途请求不会再有应答，以ErrorID=-1完成所有在途请求
+  void OnFrontDisconnected();
+
+  std::size_t Capacity() const { return m_nMask + 1; }
+  // 在途请求数
+  std::size_t GetPendingCount() const {
+    return m_nPending.load(std::memory_order_relaxed);
+  }
+  // 因槽位全部占用而分配失败的次数
+  std::uint64_t GetRejectedCount() const {
+    return m_nRejected.load(std::memory_order_relaxed);
+  }
+
+private:
+  friend class RequestFuture;
+
+  enum SlotState : std::uint32_t {
+    kFree,
+    kClaiming,   // 正在由Begin填写
+    kPending,    // 等待应答
+    kCompleting, // 回调线程正在调用完成回调
+    kDone,       // 已完成，等待RequestFuture取走
+    kAbandoned   // RequestFuture已放弃，应答到达后释放
+  };
+
+  // 槽位状态与占用它的RequestID合在一个原子量中，每次状态转换都用CAS同时
+  // 比较两者，槽位被其他请求复用后旧RequestID的操作一律失败
+  static std::uint64_t makeTag(int nRequestID, SlotState eState) {
+    return static_cast<std::uint64_t>(static_cast<std::uint32_t>(nRequestID))
+               << 32 |
+           eState;
+  }
+  static int tagRequestID(std::uint64_t nTag) {
+    return static_cast<int>(static_cast<std::uint32_t>(nTag >> 32));
+  }
+  static SlotState tagState(std::uint64_t nTag) {
+    return static_cast<SlotState>(nTag & 0xFFFFFFFFu);
+  }
+
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<std::uint64_t> nTag;
+    // 由RequestFuture持有；这类槽位的状态转换都在mutex内进行
+    std::atomic<bool> bFuture;
+    RequestCallback fnCallback;
+    void *pContext;
+    std::int64_t nBeginNs;
+    RequestResult result;
+    std::mutex mutex;
+    std::condition_variable cond;
+  };
+
+  int claim(RequestCallback fnCallback, void *pContext, bool bFuture);
+  bool onRsp(const void *pRow, std::size_t nRowSize,
+             const CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+             bool bIsLast);
+  // 以pError（可为空）完成nRequestID，已完成或槽位已被复用时返回false
+  bool complete(Slot &slot, int nRequestID,
+                const CThostFtdcRspInfoField *pError);
+  void free(Slot &slot);
+  Slot &slotOf(int nRequestID) const {
+    return m_pSlots[static_cast<unsigned>(nRequestID) & m_nMask];
+  }
+  static std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  std::size_t m_nMask;
+  std::size_t m_nRowBufferBytes;
+  Slot *m_pSlots;
+  char *m_pBuffers;
+
+  alignas(kCacheLineSize) std::atomic<int> m_nNextRequestID;
+  std::atomic<std::size_t> m_nPending;
+  std::atomic<std::uint64_t> m_nRejected;
+};
+
+} // namespace ctp
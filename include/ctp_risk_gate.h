@@ -0,0 +1,235 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+#include "ctp_latency.h"
+#include "ctp_order_state.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_tick.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ctp {
+
+// 风控拒绝原因，也是拒绝计数的下标
+enum class RiskReject : std::uint8_t {
+  None = 0,
+  UnknownInstrument, // 合约未在InstrumentTable中登记
+  OrderVolume,       // 单笔报单量超限
+  NetPosition,       // 净持仓（含在途报单）超限
+  PriceBand,         // 报单价格超出涨跌停板
+  NoPriceLimits,     // 尚未收到该合约的涨跌停价
+  SelfTrade,         // 与本账户的在途反向报单价格交叉
+  WorkingOrders,     // 该合约同一方向经本风控报出的在途报单过多
+  OrderRate,         // 每秒报单数超限
+  CancelRate,        // 每秒撤单数超限
+  Count
+};
+
+const char *GetRiskRejectName(RiskReject eReject);
+
+// 每个合约每个方向跟踪的在途报单数，也是经本风控报出的在途报单上限
+constexpr std::size_t kRiskMaxWorkingOrders = 8;
+
+// 按自然秒计数的频率限制，无锁，可以被多个线程共享
+// 秒序号和计数打包在一个64位原子变量中，每次占用名额只需一次CAS。
+class RiskRateLimiter {
+public:
+  // nMaxPerSecond为0时不限制
+  explicit RiskRateLimiter(std::uint32_t nMaxPerSecond = 0)
+      : m_nMaxPerSecond(nMaxPerSecond), m_nState(0) {}
+
+  void SetMaxPerSecond(std::uint32_t nMaxPerSecond) {
+    m_nMaxPerSecond = nMaxPerSecond;
+  }
+  std::uint32_t GetMaxPerSecond() const { return m_nMaxPerSecond; }
+
+  // nNowNs所在的一秒内尚有名额时占用一个并返回true
+  bool TryAcquire(std::int64_t nNowNs) {
+    if (m_nMaxPerSecond == 0)
+      return true;
+    std::uint64_t nSecond = secondOf(nNowNs);
+    std::uint64_t nState = m_nState.load(std::memory_order_relaxed);
+    for (;;) {
+      std::uint64_t nCount =
+          (nState >> 32) == nSecond ? nState & 0xFFFFFFFFu : 0;
+      if (nCount >= m_nMaxPerSecond)
+        return false;
+      if (m_nState.compare_exchange_weak(nState,
+                                         (nSecond << 32) | (nCount + 1),
+                                         std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+  // nNowNs所在的一秒内已占用的名额
+  std::uint32_t GetCount(std::int64_t nNowNs) const {
+    std::uint64_t nState = m_nState.load(std::memory_order_relaxed);
+    return (nState >> 32) == secondOf(nNowNs)
+               ? static_cast<std::uint32_t>(nState & 0xFFFFFFFFu)
+               : 0;
+  }
+
+private:
+  static std::uint64_t secondOf(std::int64_t nNowNs) {
+    return static_cast<std::uint64_t>(nNowNs / 1000000000) & 0xFFFFFFFFu;
+  }
+
+  std::uint32_t m_nMaxPerSecond;
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> m_nState;
+};
+
+struct RiskGateOptions {
+  // 各合约的默认限额，可用SetLimits()逐个覆盖；0表示不限
+  std::int32_t nMaxOrderVolume = 100;
+  std::int32_t nMaxNetPosition = 500;
+  // 账户级频率限制；0表示不限
+  std::uint32_t nMaxOrdersPerSecond = 50;
+  std::uint32_t nMaxCancelsPerSecond = 50;
+  // 尚未收到涨跌停价的合约是否拒绝报单
+  bool bRequirePriceLimits = true;
+};
+
+// 在途报单，nVolume为剩余未成交量
+struct RiskWorkingOrder {
+  std::int32_t nPrice; // 跳数，市价单买为INT32_MAX、卖为INT32_MIN + 1
+  std::int32_t nVolume;
+  std::int32_t nFrontID;
+  std::int32_t nSessionID;
+  std::uint64_t nOrderRef; // OrderStateEngine的OrderRef键
+  TThostFtdcOrderRefType szOrderRef; // 哈希键须核对原串
+  bool bOwn; // 经本风控报出，计入WorkingOrders上限
+};
+
+// 一个合约的风控状态
+// 限额、涨跌停与在途量在第一条缓存行，在途报单按方向紧凑存放在其后。
+struct alignas(kCacheLineSize) RiskInstrumentState {
+  std::int32_t nMaxOrderVolume;
+  std::int32_t nMaxNetPosition;
+  std::int32_t nUpperLimit; // 跳数，kInvalidTicks表示尚未收到行情
+  std::int32_t nLowerLimit;
+  std::int32_t nWorkingVolume[2]; // 买、卖方向在途报单的剩余量之和
+  std::uint32_t nWorkingCount[2];
+  std::uint32_t nOwnCount[2]; // 其中bOwn的报单数
+  RiskWorkingOrder working[2][kRiskMaxWorkingOrders];
+};
+
+// 报单前风控
+// 按InstrumentTable下标排列的平坦数组保存各合约的限额、最新涨跌停价和在途
+// 报单，依次检查：单笔报单量、净持仓（OrderStateEngine的持仓加同方向在途量）、
+// 涨跌停板、自成交和每秒报单/撤单数。检查只读写本合约的几条缓存行和频率计数，
+// 不加锁也不做堆分配。
+// 通过检查的报单立即计入在途报单，之后由OnOrder()/OnInsertRejected()更新。
+// 除RiskRateLimiter外非线程安全，报单检查、交易回报与行情须在同一线程，
+// 与OrderStateEngine的要求相同。
+class RiskGate {
+public:
+  RiskGate(const InstrumentTable &table, const OrderStateEngine &engine,
+           const RiskGateOptions &options = {});
+  ~RiskGate();
+
+  RiskGate(const RiskGate &) = delete;
+  RiskGate &operator=(const RiskGate &) = delete;
+
+  // 覆盖单个合约的限额，0表示不限
+  void SetLimits(std::uint32_t nInstrument, std::int32_t nMaxOrderVolume,
+                 std::int32_t nMaxNetPosition);
+  // 登录后设置本会话，CheckOrder()据此记录在途报单的键
+  void SetSession(int nFrontID, int nSessionID) {
+    m_nFrontID = nFrontID;
+    m_nSessionID = nSessionID;
+  }
+  // 多个RiskGate（例如每个策略线程一个）共享账户级的频率限制，
+  // 传nullptr恢复使用自己的计数器
+  void SetRateLimiters(RiskRateLimiter *pOrderLimiter,
+                       RiskRateLimiter *pCancelLimiter);
+
+  // 更新涨跌停价
+  void OnTick(const CompactTick &tick) {
+    if (tick.nInstrument < m_nInstruments) {
+      RiskInstrumentState &state = m_pStates[tick.nInstrument];
+      state.nUpperLimit = tick.nUpperLimitPrice;
+      state.nLowerLimit = tick.nLowerLimitPrice;
+    }
+  }
+  void OnTick(std::uint32_t nInstrument, double dUpperLimitPrice,
+              double dLowerLimitPrice);
+
+  // 由OrderStateEngine::OnRtnOrder()返回的报单状态驱动，
+  // 结束的报单移出在途列表，其他会话的报单同样参与自成交检查。
+  // 价格无法换算为跳数的其他会话报单（市价单的LimitPrice为0、最小变动价位
+  // 未知）不跟踪，计入GetUntrackedCount()
+  void OnOrder(const OrderState &order);
+  // OnRspOrderInsert/OnErrRtnOrderInsert报错时移除该笔在途报单
+  void OnInsertRejected(const CThostFtdcInputOrderField &order);
+
+  // 检查报单，通过时返回RiskReject::None并计入在途报单
+  // 报单须已填写OrderRef，用于匹配之后的报单回报。
+  RiskReject CheckOrder(const CThostFtdcInputOrderField &order,
+                        std::int64_t nNowNs);
+  RiskReject CheckOrder(const CThostFtdcInputOrderField &order) {
+    return CheckOrder(order, TscClock::Instance().ToNs(ReadTsc()));
+  }
+  // 检查撤单，只限制频率
+  RiskReject CheckCancel(const CThostFtdcInputOrderActionField &action,
+                         std::int64_t nNowNs);
+  RiskReject CheckCancel(const CThostFtdcInputOrderActionField &action) {
+    return CheckCancel(action, TscClock::Instance().ToNs(ReadTsc()));
+  }
+
+  const RiskInstrumentState &GetState(std::uint32_t nInstrument) const {
+    return m_pStates[nInstrument];
+  }
+  std::uint64_t GetRejectCount(RiskReject eReject) const {
+    return m_nRejects[static_cast<std::size_t>(eReject)];
+  }
+  std::uint64_t GetPassedOrderCount() const { return m_nPassedOrders; }
+  std::uint64_t GetPassedCancelCount() const { return m_nPassedCancels; }
+  // 价格无法换算、在途列表已满或被本会话报单挤出而未被跟踪的
+  // 其他会话报单数
+  std::uint64_t GetUntrackedCount() const { return m_nUntracked; }
+
+  // 换日时清空在途报单与涨跌停价，限额保留
+  void Reset();
+
+private:
+  static int sideOf(char cDirection) {
+    return cDirection == THOST_FTDC_D_Sell ? 1 : 0;
+  }
+  RiskReject reject(RiskReject eReject) {
+    ++m_nRejects[static_cast<std::size_t>(eReject)];
+    return eReject;
+  }
+  // 查找在途报单，未找到时返回kRiskMaxWorkingOrders
+  static std::uint32_t findWorking(const RiskInstrumentState &state, int nSide,
+                                   int nFrontID, int nSessionID,
+                                   std::uint64_t nOrderRef,
+                                   const char *pszOrderRef);
+  static void removeWorking(RiskInstrumentState &state, int nSide,
+                            std::uint32_t nSlot);
+  // 取一个空闲的在途报单位置，列表已满时挤出一笔其他会话的报单；
+  // 没有可用位置时返回kRiskMaxWorkingOrders
+  std::uint32_t allocWorking(RiskInstrumentState &state, int nSide);
+
+  const InstrumentTable &m_table;
+  const OrderStateEngine &m_engine;
+  std::size_t m_nInstruments;
+  RiskInstrumentState *m_pStates;
+  bool m_bRequirePriceLimits;
+  int m_nFrontID;
+  int m_nSessionID;
+
+  RiskRateLimiter m_orderLimiter;
+  RiskRateLimiter m_cancelLimiter;
+  RiskRateLimiter *m_pOrderLimiter;
+  RiskRateLimiter *m_pCancelLimiter;
+
+  std::uint64_t m_nRejects[static_cast<std::size_t>(RiskReject::Count)];
+  std::uint64_t m_nPassedOrders;
+  std::uint64_t m_nPassedCancels;
+  std::uint64_t m_nUntracked;
+};
+
+} // namespace ctp
@@ -0,0 +1,423 @@
+#pragma once
+
+#if __cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error "ctp_session.h requires C++20, configure with -DCTP_ENABLE_CXX20=ON"
+#endif
+
+#include "ThostFtdcMdApi.h"
+#include "ThostFtdcTraderApi.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ctp {
+
+// 会话操作的本地错误码，其余非零值为CTP的ErrorID或Req*的返回值
+constexpr int kSessionTimeout = -100;      // 等待应答超时
+constexpr int kSessionCanceled = -101;     // 被Cancel()取消
+constexpr int kSessionDisconnected = -102; // 等待期间连接断开
+
+// 惰性启动的协程任务，co_await时才开始执行，结束后恢复等待方
+template <typename T = void> class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation;
+  bool bDetached = false;
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      TaskPromiseBase &promise = handle.promise();
+      if (promise.continuation)
+        return promise.continuation;
+      if (promise.bDetached)
+        handle.destroy();
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  // 本库不使用异常
+  void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T> struct TaskPromise : TaskPromiseBase {
+  std::optional<T> value;
+  Task<T> get_return_object() noexcept;
+  template <typename U> void return_value(U &&result) {
+    value.emplace(std::forward<U>(result));
+  }
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+template <typename T> class Task {
+public:
+  using promise_type = detail::TaskPromise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() noexcept : m_handle(nullptr) {}
+  explicit Task(Handle handle) noexcept : m_handle(handle) {}
+  Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (m_handle)
+        m_handle.destroy();
+      m_handle = std::exchange(other.m_handle, {});
+    }
+    return *this;
+  }
+  ~Task() {
+    if (m_handle)
+      m_handle.destroy();
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> continuation) noexcept {
+    m_handle.promise().continuation = continuation;
+    return m_handle;
+  }
+  T await_resume() {
+    if constexpr (!std::is_void_v<T>)
+      return std::move(*m_handle.promise().value);
+  }
+
+  // 交出协程帧，执行结束后自行销毁
+  Handle Detach() noexcept {
+    m_handle.promise().bDetached = true;
+    return std::exchange(m_handle, {});
+  }
+
+private:
+  Handle m_handle;
+};
+
+namespace detail {
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// 单线程执行器
+// 所有协程都在调用Run()的线程上恢复；CTP回调线程只通过Post()投递，不会
+// 直接执行协程。定时器只能在执行线程上添加。
+class SessionExecutor {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  SessionExecutor();
+  ~SessionExecutor();
+
+  SessionExecutor(const SessionExecutor &) = delete;
+  SessionExecutor &operator=(const SessionExecutor &) = delete;
+
+  // 任意线程：投递一个待执行的任务或协程
+  void Post(std::function<void()> fnTask);
+  void Post(std::coroutine_handle<> handle) {
+    Post([handle]() { handle.resume(); });
+  }
+  // 任意线程：在执行器上启动一个协程，协程结束后自行销毁
+  void Spawn(Task<void> task);
+
+  // 在当前线程上运行，直到Stop()
+  void Run();
+  // 任意线程：让Run()返回，尚未执行的任务被丢弃
+  void Stop();
+
+  // 执行线程：在指定时刻执行fnTask
+  void CallAt(Clock::time_point due, std::function<void()> fnTask);
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_bStopped;
+
+  // 只在执行线程上访问
+  std::multimap<Clock::time_point, std::function<void()>> m_timers;
+};
+
+// 会话的等待表
+// 记录挂起在某个键（RequestID或固定的操作键）上的协程，应答到达时把结果写入
+// 协程帧并投递到执行器恢复。超时在执行器上判定，与应答之间谁先到谁生效。
+// 挂起中的协程帧被销毁时，Awaiter析构会注销等待项，已投递的恢复随之作废。
+class SessionCore {
+public:
+  SessionCore(SessionExecutor &executor, std::chrono::milliseconds timeout)
+      : m_executor(executor), m_defaultTimeout(timeout), m_nNextSeq(0),
+        m_nNextRequestID(1) {}
+
+  SessionCore(const SessionCore &) = delete;
+  SessionCore &operator=(const SessionCore &) = delete;
+
+  class Awaiter {
+  public:
+    // fnIssue发出请求并返回Req*的返回值，非零时不挂起直接返回该值；
+    // fnCleanup（可为空）在Awaiter析构时调用，用于清理该次调用的状态
+    Awaiter(SessionCore &core, int nKey, std::function<int()> fnIssue,
+            std::chrono::milliseconds timeout,
+            std::function<void()> fnCleanup = nullptr)
+        : m_pCore(&core), m_nKey(nKey), m_fnIssue(std::move(fnIssue)),
+          m_fnCleanup(std::move(fnCleanup)), m_timeout(timeout), m_nSeq(0),
+          m_nResult(0), m_bReady(false) {}
+    // 无需等待，直接得到结果
+    explicit Awaiter(int nResult)
+        : m_pCore(nullptr), m_nKey(0), m_timeout(0), m_nSeq(0),
+          m_nResult(nResult), m_bReady(true) {}
+    Awaiter(Awaiter &&other) noexcept
+        : m_pCore(std::exchange(other.m_pCore, nullptr)),
+          m_nKey(other.m_nKey), m_fnIssue(std::move(other.m_fnIssue)),
+          m_fnCleanup(std::exchange(other.m_fnCleanup, nullptr)),
+          m_timeout(other.m_timeout), m_nSeq(std::exchange(other.m_nSeq, 0)),
+          m_nResult(other.m_nResult), m_bReady(other.m_bReady) {}
+    ~Awaiter();
+
+    Awaiter(const Awaiter &) = delete;
+    Awaiter &operator=(const Awaiter &) = delete;
+    Awaiter &operator=(Awaiter &&) = delete;
+
+    bool await_ready() const noexcept { return m_bReady; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    int await_resume() noexcept {
+      m_nSeq = 0;
+      return m_nResult;
+    }
+
+  private:
+    SessionCore *m_pCore;
+    int m_nKey;
+    std::function<int()> m_fnIssue;
+    std::function<void()> m_fnCleanup;
+    std::chrono::milliseconds m_timeout;
+    std::uint64_t m_nSeq; // 挂起期间的等待项序号，恢复后清零
+    int m_nResult;
+    bool m_bReady;
+  };
+
+  // 任意线程：以nResult恢复挂起在nKey上的全部协程
+  void Complete(int nKey, int nResult);
+  // 任意线程：以nResult恢复除nExceptKey外的全部协程
+  void CompleteAll(int nResult, int nExceptKey);
+
+  int NextRequestID() {
+    return m_nNextRequestID.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::chrono::milliseconds ResolveTimeout(std::chrono::milliseconds timeout) {
+    return timeout.count() > 0 ? timeout : m_defaultTimeout;
+  }
+  SessionExecutor &GetExecutor() { return m_executor; }
+
+private:
+  struct Waiter {
+    std::uint64_t nSeq;
+    std::coroutine_handle<> handle;
+    int *pResult; // 指向挂起协程帧中的Awaiter
+  };
+
+  std::uint64_t add(int nKey, std::coroutine_handle<> handle, int *pResult);
+  bool remove(int nKey, std::uint64_t nSeq);
+  void expire(int nKey, std::uint64_t nSeq);
+  // 挂起中的Awaiter析构：注销等待项或作废已投递的恢复
+  void forget(int nKey, std::uint64_t nSeq);
+  // 在执行器上恢复已完成的等待项，期间被forget()的不再恢复
+  void resume(std::uint64_t nSeq, std::coroutine_handle<> handle);
+  void post(std::vector<Waiter> &&waiters);
+
+  SessionExecutor &m_executor;
+  std::chrono::milliseconds m_defaultTimeout;
+  std::mutex m_mutex;
+  std::multimap<int, Waiter> m_waiters;
+  std::unordered_set<std::uint64_t> m_resuming; // 已完成、等待恢复的序号
+  std::uint64_t m_nNextSeq;
+  std::atomic<int> m_nNextRequestID;
+};
+
+struct TraderSessionOptions {
+  std::string strFrontAddress; // 为空时不调用RegisterFront，由调用方注册
+  std::string strBrokerID;
+  std::string strUserID;
+  std::string strPassword;
+  std::string strAppID;
+  std::string strAuthCode;
+  std::string strUserProductInfo;
+  // 每个操作的默认超时
+  std::chrono::milliseconds timeout = std::chrono::seconds(10);
+};
+
+// 可co_await的交易会话
+// 注册为pApi的SPI，把连接、认证、登录等回调转换为协程结果。其余回调
+// （报单、成交等）可由派生类重写。会话须在执行器停止之后销毁。
+class TraderSession : public CThostFtdcTraderSpi {
+public:
+  TraderSession(SessionExecutor &executor, CThostFtdcTraderApi *pApi,
+                const TraderSessionOptions &options);
+
+  TraderSession(const TraderSession &) = delete;
+  TraderSession &operator=(const TraderSession &) = delete;
+
+  // 首次调用时Init()，等待OnFrontConnected；已连接时立即返回0
+  SessionCore::Awaiter Connect(std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter Authenticate(std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter Login(std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter
+  ConfirmSettlement(std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter Logout(std::chrono::milliseconds timeout = {});
+
+  // 以kSessionCanceled恢复所有等待中的操作
+  void Cancel() { m_core.CompleteAll(kSessionCanceled, 0); }
+
+  bool IsConnected() const {
+    return m_bConnected.load(std::memory_order_acquire);
+  }
+  // 最近一次登录成功的应答，在Login()返回0之后读取
+  const CThostFtdcRspUserLoginField &GetLoginInfo() const {
+    return m_loginInfo;
+  }
+  CThostFtdcTraderApi *GetApi() const { return m_pApi; }
+
+  // CThostFtdcTraderSpi
+  void OnFrontConnected() override;
+  void OnFrontDisconnected(int nReason) override;
+  void OnRspAuthenticate(CThostFtdcRspAuthenticateField *pRspAuthenticateField,
+                         CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                         bool bIsLast) override;
+  void OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                      bool bIsLast) override;
+  void OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                       bool bIsLast) override;
+  void OnRspSettlementInfoConfirm(
+      CThostFtdcSettlementInfoConfirmField *pSettlementInfoConfirm,
+      CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) override;
+  void OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) override;
+
+private:
+  CThostFtdcTraderApi *m_pApi;
+  TraderSessionOptions m_options;
+  SessionCore m_core;
+  std::atomic<bool> m_bInitialized;
+  std::atomic<bool> m_bConnected;
+  CThostFtdcRspUserLoginField m_loginInfo;
+};
+
+struct MdSessionOptions {
+  std::string strFrontAddress; // 为空时不调用RegisterFront，由调用方注册
+  std::string strBrokerID;
+  std::string strUserID;
+  std::string strPassword;
+  std::chrono::milliseconds timeout = std::chrono::seconds(10);
+};
+
+// 可co_await的行情会话
+// 行情回调OnRtnDepthMarketData由派生类重写。会话须在执行器停止之后销毁。
+class MdSession : public CThostFtdcMdSpi {
+public:
+  MdSession(SessionExecutor &executor, CThostFtdcMdApi *pApi,
+            const MdSessionOptions &options);
+
+  MdSession(const MdSession &) = delete;
+  MdSession &operator=(const MdSession &) = delete;
+
+  SessionCore::Awaiter Connect(std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter Login(std::chrono::milliseconds timeout = {});
+  // 等待列表中每个合约的订阅应答，返回第一个错误。每次调用单独跟踪，
+  // 超时或取消后该次调用的合约不再影响之后的调用。不带合约的错误应答使
+  // 最早的一次调用整体失败
+  SessionCore::Awaiter Subscribe(const std::vector<std::string> &instruments,
+                                 std::chrono::milliseconds timeout = {});
+  SessionCore::Awaiter Unsubscribe(const std::vector<std::string> &instruments,
+                                   std::chrono::milliseconds timeout = {});
+
+  void Cancel() { m_core.CompleteAll(kSessionCanceled, 0); }
+
+  bool IsConnected() const {
+    return m_bConnected.load(std::memory_order_acquire);
+  }
+  const CThostFtdcRspUserLoginField &GetLoginInfo() const {
+    return m_loginInfo;
+  }
+  CThostFtdcMdApi *GetApi() const { return m_pApi; }
+
+  // CThostFtdcMdSpi
+  void OnFrontConnected() override;
+  void OnFrontDisconnected(int nReason) override;
+  void OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                      CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                      bool bIsLast) override;
+  void
+  OnRspSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                     CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                     bool bIsLast) override;
+  void
+  OnRspUnSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                       CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                       bool bIsLast) override;
+  void OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                  bool bIsLast) override;
+
+private:
+  // 一次订阅/退订调用：待应答的合约，全部应答后完成
+  struct Pending {
+    bool bSubscribe;
+    std::vector<std::string> instruments;
+    int nError;
+  };
+
+  SessionCore::Awaiter subscribe(const std::vector<std::string> &instruments,
+                                 bool bSubscribe,
+                                 std::chrono::milliseconds timeout);
+  void acknowledge(bool bSubscribe,
+                   CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                   CThostFtdcRspInfoField *pRspInfo);
+
+  CThostFtdcMdApi *m_pApi;
+  MdSessionOptions m_options;
+  SessionCore m_core;
+  std::atomic<bool> m_bInitialized;
+  std::atomic<bool> m_bConnected;
+  CThostFtdcRspUserLoginField m_loginInfo;
+
+  std::mutex m_mutex;
+  // 按调用键排序，键递增分配，应答匹配同方向最早的含该合约的调用
+  std::map<int, Pending> m_pending;
+};
+
+} // namespace ctp
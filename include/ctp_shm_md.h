@@ -0,0 +1,218 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+#include "ctp_spsc_ring.h"
+#include "ctp_tick.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ctp {
+
+// "CTPSHMD1"
+constexpr std::uint64_t kShmMdMagic = 0x31444D4853505443ull;
+constexpr std::uint32_t kShmMdVersion = 1;
+
+constexpr const char *kShmMdDefaultPath = "/dev/shm/ctp_md";
+
+// 发布方约每秒心跳一次，超过该时间未更新视为已异常退出
+constexpr std::int64_t kShmMdHeartbeatTimeoutNs = 3000000000;
+
+// 共享内存文件头，占用第一页
+// 其后依次为合约目录、最新快照区和广播环。
+struct ShmMdHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nHeaderSize;
+  std::uint32_t nTickSize;     // sizeof(CompactTick)
+  std::uint32_t nSlotSize;     // sizeof(ShmMdSlot)
+  std::uint64_t nRingCapacity; // 2的幂
+  std::uint64_t nMaxInstruments;
+  std::uint64_t nInstrumentOffset;
+  std::uint64_t nSnapshotOffset;
+  std::uint64_t nRingOffset;
+  std::uint64_t nFileSize;
+  std::int64_t nEpoch; // 发布方创建文件的时间，每次启动都不同
+  std::int32_t nPublisherPid;
+  std::uint32_t nReserved;
+  std::atomic<std::uint32_t> nInstruments; // 已发布的合约目录项数
+  std::atomic<std::uint32_t> nClosed;      // 发布方已正常退出
+  std::atomic<std::int64_t> nHeartbeatNs;  // 最近一次心跳的系统时间
+  // 发布方独占的缓存行：下一个将要写入的序号
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> nWriteSeq;
+};
+
+// 合约目录项，下标即CompactTick::nInstrument
+struct ShmMdInstrument {
+  TThostFtdcInstrumentIDType szInstrumentID;
+  char szPadding[7];
+  double dPriceTick;
+};
+
+// 广播环和快照区共用的seqlock槽位，与BroadcastRing/SnapshotTable的槽位相同
+// 广播环：序号为2*(写入序号+1)，写入中为奇数；
+// 快照区：每次更新加2，写入中为奇数，0表示从未写入。
+struct alignas(kCacheLineSize) ShmMdSlot {
+  std::atomic<std::uint64_t> nSeq;
+  std::atomic<std::uint64_t> nWords[sizeof(CompactTick) / 8];
+};
+
+struct ShmMdOptions {
+  // 广播环容量，向上取整为2的幂；读者落后超过该数目时出现缺口
+  std::size_t nRingCapacity = 65536;
+  // 0表示取InstrumentTable的容量
+  std::size_t nMaxInstruments = 0;
+};
+
+// 共享内存行情发布方
+// 持有CTP行情会话的进程把规整后的行情写入/dev/shm下的一个文件：一个单生产者
+// 广播环（满时覆盖最旧的行情）和一个按合约下标排列的最新快照区，本机任意多个
+// 进程以只读方式映射后无锁读取，不经过内核或套接字。
+// 文件先以临时名建好再改名，已连接的旧读者仍映射着旧文件，Close()时置位
+// nClosed，读者据此重新打开；发布方异常退出时不会置位，读者由心跳超时或
+// IsReplaced()发现。
+// Publish()只能由单一线程调用；InstrumentTable中新登记的合约在发布其第一笔
+// 行情之前写入合约目录。
+class ShmMdPublisher {
+public:
+  explicit ShmMdPublisher(const TickNormalizer &normalizer);
+  ~ShmMdPublisher();
+
+  ShmMdPublisher(const ShmMdPublisher &) = delete;
+  ShmMdPublisher &operator=(const ShmMdPublisher &) = delete;
+
+  bool Open(const std::string &strPath, const ShmMdOptions &options = {});
+  // 标记关闭并删除文件，已映射的读者仍可读完剩余行情
+  void Close();
+  bool IsOpen() const { return m_pHeader != nullptr; }
+
+  // 写入广播环并更新快照；合约下标超出容量时返回false
+  bool Publish(const CompactTick &tick);
+  // 规整后发布，合约未登记时返回false
+  bool Publish(const CThostFtdcDepthMarketDataField &tick);
+
+  // 把InstrumentTable中新登记的合约写入目录，返回目录项总数
+  std::size_t SyncInstruments();
+  // 更新心跳时间，由发布进程定期（例如每秒）调用
+  void Heartbeat();
+
+  // 已发布的行情数，可在其他线程读取
+  std::uint64_t GetPublishedCount() const {
+    return m_pHeader ? m_pHeader->nWriteSeq.load(std::memory_order_acquire)
+                     : m_nWriteSeq;
+  }
+  // 合约未登记或超出容量而未发布的行情数，只在发布线程上读取
+  std::uint64_t GetDroppedCount() const { return m_nDropped; }
+
+private:
+  const TickNormalizer &m_normalizer;
+  std::string m_strPath;
+  char *m_pBase;
+  std::size_t m_nMappedSize;
+  ShmMdHeader *m_pHeader;
+  ShmMdInstrument *m_pInstruments;
+  ShmMdSlot *m_pSnapshots;
+  ShmMdSlot *m_pRing;
+  std::uint64_t m_nMask;
+  std::uint64_t m_nWriteSeq;
+  std::uint32_t m_nInstruments;
+  std::uint32_t m_nMaxInstruments;
+  std::uint64_t m_nDropped;
+};
+
+struct ShmMdClientStats {
+  std::uint64_t nConsumed; // 已读取的行情数
+  std::uint64_t nGaps;     // 因落后被覆盖而跳过的次数
+  std::uint64_t nLost;     // 跳过的行情数
+  std::uint64_t nLag;      // 当前积压
+};
+
+// 共享内存行情读者
+// 只读映射发布方的文件，按自己的读取序号消费广播环。落后超过环容量时跳过
+// 被覆盖的部分并计入缺口，之后可用ReadSnapshot()补齐各合约的最新状态。
+// 合约目录同步到本地的InstrumentTable，下标与发布方一致。
+// Poll()只能由单一线程调用；ReadSnapshot()可被多个线程并发调用。
+class ShmMdClient {
+public:
+  ShmMdClient();
+  ~ShmMdClient();
+
+  ShmMdClient(const ShmMdClient &) = delete;
+  ShmMdClient &operator=(const ShmMdClient &) = delete;
+
+  // 从最新位置开始读取；发布方尚未创建文件时返回false
+  bool Open(const std::string &strPath = kShmMdDefaultPath);
+  void Close();
+  bool IsOpen() const { return m_pHeader != nullptr; }
+
+  // 取出下一笔行情，没有新行情时返回false
+  bool Poll(CompactTick &tick);
+
+  // 从仍可读取的最旧行情或最新位置开始读取
+  void SeekOldest();
+  void SeekLatest();
+  std::uint64_t GetReadSeq() const { return m_nReadSeq; }
+
+  // 拷贝一致的最新快照，从未写入过时返回false
+  // 槽位停在写入中且发布方心跳已超时（发布方在写入途中退出）时同样返回false，
+  // 不会无限自旋。
+  bool ReadSnapshot(std::uint32_t nInstrument, CompactTick &tick,
+                    std::uint64_t *pVersion = nullptr) const;
+  // 快照当前序号，0表示从未写入
+  std::uint64_t GetSnapshotVersion(std::uint32_t nInstrument) const {
+    return nInstrument < m_nMaxInstruments
+               ? m_pSnapshots[nInstrument].nSeq.load(
+                     std::memory_order_acquire) &
+                     ~1ull
+               : 0;
+  }
+
+  // 同步发布方新增的合约，返回本地已知的合约数
+  std::size_t RefreshInstruments();
+  const InstrumentTable &GetInstrumentTable() const { return *m_pTable; }
+
+  ShmMdClientStats GetStats() const;
+  // 发布方已正常退出，需要重新Open()
+  bool IsPublisherClosed() const {
+    return m_pHeader &&
+           m_pHeader->nClosed.load(std::memory_order_acquire) != 0;
+  }
+  // 发布方最近一次心跳的系统时间，可据此判断发布方是否异常退出
+  std::int64_t GetHeartbeatNs() const {
+    return m_pHeader
+               ? m_pHeader->nHeartbeatNs.load(std::memory_order_relaxed)
+               : 0;
+  }
+  std::int64_t GetEpoch() const { return m_pHeader ? m_pHeader->nEpoch : 0; }
+  // 心跳超过nTimeoutNs未更新
+  bool IsPublisherStale(
+      std::int64_t nTimeoutNs = kShmMdHeartbeatTimeoutNs) const;
+  // 路径上的文件已被删除或替换为新发布方的文件，需要重新Open()。
+  // 每次调用一次stat()，适合按秒检查，不要放在Poll()循环里。
+  bool IsReplaced() const;
+
+private:
+  std::string m_strPath;
+  std::uint64_t m_nDevice; // 所映射文件的设备号与inode
+  std::uint64_t m_nInode;
+  const char *m_pBase;
+  std::size_t m_nMappedSize;
+  const ShmMdHeader *m_pHeader;
+  const ShmMdInstrument *m_pInstruments;
+  const ShmMdSlot *m_pSnapshots;
+  const ShmMdSlot *m_pRing;
+  std::uint64_t m_nMask;
+  std::uint32_t m_nMaxInstruments;
+  std::unique_ptr<InstrumentTable> m_pTable;
+
+  std::uint64_t m_nReadSeq;
+  std::uint64_t m_nConsumed;
+  std::uint64_t m_nGaps;
+  std::uint64_t m_nLost;
+};
+
+} // namespace ctp
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "ThostFtdcTraderApi.h"
+#include "ctp_matching_engine.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 模拟柜台不支持的请求（方法名, 请求结构体），统一返回-1
+#define CTP_SIM_TRADER_UNSUPPORTED_REQUESTS(X) \
+  X(ReqUserPasswordUpdate, CThostFtdcUserPasswordUpdateField) \
+  X(ReqTradingAccountPasswordUpdate, \
+    CThostFtdcTradingAccountPasswordUpdateField) \
+  X(ReqUserAuthMethod, CThostFtdcReqUserAuthMethodField) \
+  X(ReqGenUserCaptcha, CThostFtdcReqGenUserCaptchaField) \
+  X(ReqGenUserText, CThostFtdcReqGenUserTextField) \
+  X(ReqUserLoginWithCaptcha, CThostFtdcReqUserLoginWithCaptchaField) \
+  X(ReqUserLoginWithText, CThostFtdcReqUserLoginWithTextField) \
+  X(ReqUserLoginWithOTP, CThostFtdcReqUserLoginWithOTPField) \
+  X(ReqParkedOrderInsert, CThostFtdcParkedOrderField) \
+  X(ReqParkedOrderAction, CThostFtdcParkedOrderActionField) \
+  X(ReqQryMaxOrderVolume, CThostFtdcQryMaxOrderVolumeField) \
+  X(ReqRemoveParkedOrder, CThostFtdcRemoveParkedOrderField) \
+  X(ReqRemoveParkedOrderAction, CThostFtdcRemoveParkedOrderActionField) \
+  X(ReqExecOrderInsert, CThostFtdcInputExecOrderField) \
+  X(ReqExecOrderAction, CThostFtdcInputExecOrderActionField) \
+  X(ReqForQuoteInsert, CThostFtdcInputForQuoteField) \
+  X(ReqQuoteInsert, CThostFtdcInputQuoteField) \
+  X(ReqQuoteAction, CThostFtdcInputQuoteActionField) \
+  X(ReqBatchOrderAction, CThostFtdcInputBatchOrderActionField) \
+  X(ReqOptionSelfCloseInsert, CThostFtdcInputOptionSelfCloseField) \
+  X(ReqOptionSelfCloseAction, CThostFtdcInputOptionSelfCloseActionField) \
+  X(ReqCombActionInsert, CThostFtdcInputCombActionField) \
+  X(ReqQryInvestor, CThostFtdcQryInvestorField) \
+  X(ReqQryTradingCode, CThostFtdcQryTradingCodeField) \
+  X(ReqQryInstrumentMarginRate, CThostFtdcQryInstrumentMarginRateField) \
+  X(ReqQryInstrumentCommissionRate, \
+    CThostFtdcQryInstrumentCommissionRateField) \
+  X(ReqQryUserSession, CThostFtdcQryUserSessionField) \
+  X(ReqQryExchange, CThostFtdcQryExchangeField) \
+  X(ReqQryProduct, CThostFtdcQryProductField) \
+  X(ReqQryInstrument, CThostFtdcQryInstrumentField) \
+  X(ReqQryDepthMarketData, CThostFtdcQryDepthMarketDataField) \
+  X(ReqQryTraderOffer, CThostFtdcQryTraderOfferField) \
+  X(ReqQrySettlementInfo, CThostFtdcQrySettlementInfoField) \
+  X(ReqQryTransferBank, CThostFtdcQryTransferBankField) \
+  X(ReqQryInvestorPositionDetail, CThostFtdcQryInvestorPositionDetailField) \
+  X(ReqQryNotice, CThostFtdcQryNoticeField) \
+  X(ReqQrySettlementInfoConfirm, CThostFtdcQrySettlementInfoConfirmField) \
+  X(ReqQryInvestorPositionCombineDetail, \
+    CThostFtdcQryInvestorPositionCombineDetailField) \
+  X(ReqQryCFMMCTradingAccountKey, CThostFtdcQryCFMMCTradingAccountKeyField) \
+  X(ReqQryEWarrantOffset, CThostFtdcQryEWarrantOffsetField) \
+  X(ReqQryInvestorProductGroupMargin, \
+    CThostFtdcQryInvestorProductGroupMarginField) \
+  X(ReqQryExchangeMarginRate, CThostFtdcQryExchangeMarginRateField) \
+  X(ReqQryExchangeMarginRateAdjust, \
+    CThostFtdcQryExchangeMarginRateAdjustField) \
+  X(ReqQryExchangeRate, CThostFtdcQryExchangeRateField) \
+  X(ReqQrySecAgentACIDMap, CThostFtdcQrySecAgentACIDMapField) \
+  X(ReqQryProductExchRate, CThostFtdcQryProductExchRateField) \
+  X(ReqQryProductGroup, CThostFtdcQryProductGroupField) \
+  X(ReqQryMMInstrumentCommissionRate, \
+    CThostFtdcQryMMInstrumentCommissionRateField) \
+  X(ReqQryMMOptionInstrCommRate, CThostFtdcQryMMOptionInstrCommRateField) \
+  X(ReqQryInstrumentOrderCommRate, CThostFtdcQryInstrumentOrderCommRateField) \
+  X(ReqQrySecAgentTradingAccount, CThostFtdcQryTradingAccountField) \
+  X(ReqQrySecAgentCheckMode, CThostFtdcQrySecAgentCheckModeField) \
+  X(ReqQrySecAgentTradeInfo, CThostFtdcQrySecAgentTradeInfoField) \
+  X(ReqQryOptionInstrTradeCost, CThostFtdcQryOptionInstrTradeCostField) \
+  X(ReqQryOptionInstrCommRate, CThostFtdcQryOptionInstrCommRateField) \
+  X(ReqQryExecOrder, CThostFtdcQryExecOrderField) \
+  X(ReqQryForQuote, CThostFtdcQryForQuoteField) \
+  X(ReqQryQuote, CThostFtdcQryQuoteField) \
+  X(ReqQryOptionSelfClose, CThostFtdcQryOptionSelfCloseField) \
+  X(ReqQryInvestUnit, CThostFtdcQryInvestUnitField) \
+  X(ReqQryCombInstrumentGuard, CThostFtdcQryCombInstrumentGuardField) \
+  X(ReqQryCombAction, CThostFtdcQryCombActionField) \
+  X(ReqQryTransferSerial, CThostFtdcQryTransferSerialField) \
+  X(ReqQryAccountregister, CThostFtdcQryAccountregisterField) \
+  X(ReqQryContractBank, CThostFtdcQryContractBankField) \
+  X(ReqQryParkedOrder, CThostFtdcQryParkedOrderField) \
+  X(ReqQryParkedOrderAction, CThostFtdcQryParkedOrderActionField) \
+  X(ReqQryTradingNotice, CThostFtdcQryTradingNoticeField) \
+  X(ReqQryBrokerTradingParams, CThostFtdcQryBrokerTradingParamsField) \
+  X(ReqQryBrokerTradingAlgos, CThostFtdcQryBrokerTradingAlgosField) \
+  X(ReqQueryCFMMCTradingAccountToken, \
+    CThostFtdcQueryCFMMCTradingAccountTokenField) \
+  X(ReqFromBankToFutureByFuture, CThostFtdcReqTransferField) \
+  X(ReqFromFutureToBankByFuture, CThostFtdcReqTransferField) \
+  X(ReqQueryBankAccountMoneyByFuture, CThostFtdcReqQueryAccountField) \
+  X(ReqQryClassifiedInstrument, CThostFtdcQryClassifiedInstrumentField) \
+  X(ReqQryCombPromotionParam, CThostFtdcQryCombPromotionParamField) \
+  X(ReqQryRiskSettleInvstPosition, CThostFtdcQryRiskSettleInvstPositionField) \
+  X(ReqQryRiskSettleProductStatus, CThostFtdcQryRiskSettleProductStatusField) \
+  X(ReqQrySPBMFutureParameter, CThostFtdcQrySPBMFutureParameterField) \
+  X(ReqQrySPBMOptionParameter, CThostFtdcQrySPBMOptionParameterField) \
+  X(ReqQrySPBMIntraParameter, CThostFtdcQrySPBMIntraParameterField) \
+  X(ReqQrySPBMInterParameter, CThostFtdcQrySPBMInterParameterField) \
+  X(ReqQrySPBMPortfDefinition, CThostFtdcQrySPBMPortfDefinitionField) \
+  X(ReqQrySPBMInvestorPortfDef, CThostFtdcQrySPBMInvestorPortfDefField) \
+  X(ReqQryInvestorPortfMarginRatio, \
+    CThostFtdcQryInvestorPortfMarginRatioField) \
+  X(ReqQryInvestorProdSPBMDetail, CThostFtdcQryInvestorProdSPBMDetailField) \
+  X(ReqQryInvestorCommoditySPMMMargin, \
+    CThostFtdcQryInvestorCommoditySPMMMarginField) \
+  X(ReqQryInvestorCommodityGroupSPMMMargin, \
+    CThostFtdcQryInvestorCommodityGroupSPMMMarginField) \
+  X(ReqQrySPMMInstParam, CThostFtdcQrySPMMInstParamField) \
+  X(ReqQrySPMMProductParam, CThostFtdcQrySPMMProductParamField) \
+  X(ReqQrySPBMAddOnInterParameter, CThostFtdcQrySPBMAddOnInterParameterField) \
+  X(ReqQryRCAMSCombProductInfo, CThostFtdcQryRCAMSCombProductInfoField) \
+  X(ReqQryRCAMSInstrParameter, CThostFtdcQryRCAMSInstrParameterField) \
+  X(ReqQryRCAMSIntraParameter, CThostFtdcQryRCAMSIntraParameterField) \
+  X(ReqQryRCAMSInterParameter, CThostFtdcQryRCAMSInterParameterField) \
+  X(ReqQryRCAMSShortOptAdjustParam, \
+    CThostFtdcQryRCAMSShortOptAdjustParamField) \
+  X(ReqQryRCAMSInvestorCombPosition, \
+    CThostFtdcQryRCAMSInvestorCombPositionField) \
+  X(ReqQryInvestorProdRCAMSMargin, CThostFtdcQryInvestorProdRCAMSMarginField) \
+  X(ReqQryRULEInstrParameter, CThostFtdcQryRULEInstrParameterField) \
+  X(ReqQryRULEIntraParameter, CThostFtdcQryRULEIntraParameterField) \
+  X(ReqQryRULEInterParameter, CThostFtdcQryRULEInterParameterField) \
+  X(ReqQryInvestorProdRULEMargin, CThostFtdcQryInvestorProdRULEMarginField) \
+  X(ReqQryInvestorPortfSetting, CThostFtdcQryInvestorPortfSettingField) \
+  X(ReqQryInvestorInfoCommRec, CThostFtdcQryInvestorInfoCommRecField) \
+  X(ReqQryCombLeg, CThostFtdcQryCombLegField) \
+  X(ReqOffsetSetting, CThostFtdcInputOffsetSettingField) \
+  X(ReqCancelOffsetSetting, CThostFtdcInputOffsetSettingField) \
+  X(ReqQryOffsetSetting, CThostFtdcQryOffsetSettingField)
+
+namespace ctp {
+
+struct SimTraderOptions {
+  // 交易日，为空时取当天日期
+  std::string strTradingDay;
+  int nFrontID = 1;
+  int nSessionID = 1;
+  // 请求从API到达撮合引擎的延迟
+  std::int64_t nRequestLatencyNs = 20000;
+  // 回报从撮合引擎回到SPI的延迟
+  std::int64_t nResponseLatencyNs = 20000;
+  // 每次在上述延迟上额外增加[0, nLatencyJitterNs)的随机延迟
+  std::int64_t nLatencyJitterNs = 0;
+  // 资金查询返回的静态权益
+  double dInitialBalance = 10000000.0;
+};
+
+// 模拟交易前置
+// 实现CThostFtdcTraderApi，报单由进程内的MatchingEngine撮合，不需要连接
+// 交易所即可驱动OnRspOrderInsert/OnRtnOrder/OnRtnTrade等回调。撮合用的行情
+// 通过FeedMarketData()传入，通常直接在策略的OnRtnDepthMarketData中调用，
+// 使撮合与策略看到同一份行情。
+// 所有请求和回报按注入的延迟排入一个时间队列，由模拟线程依次执行，回调
+// 都发生在该线程上；同类事件（请求、回报）的顺序不会因随机抖动而颠倒。
+class SimTraderApi final : public CThostFtdcTraderApi,
+                           private MatchingEngineSpi {
+public:
+  static SimTraderApi *CreateSimTraderApi(const SimTraderOptions &options = {});
+
+  SimTraderApi(const SimTraderApi &) = delete;
+  SimTraderApi &operator=(const SimTraderApi &) = delete;
+
+  // 撮合用行情，可在任意线程调用
+  void FeedMarketData(const CThostFtdcDepthMarketDataField &tick);
+
+  // CThostFtdcTraderApi
+  void Release() override;
+  // 登出后可以再次Init()开始新的模拟会话
+  void Init() override;
+  // 阻塞到模拟会话结束：ReqUserLogout的应答回调返回之后，或者Release()
+  int Join() override;
+  const char *GetTradingDay() override;
+  void GetFrontInfo(CThostFtdcFrontInfoField *pFrontInfo) override;
+  void RegisterFront(char *pszFrontAddress) override;
+  void RegisterNameServer(char *pszNsAddress) override;
+  void
+  RegisterFensUserInfo(CThostFtdcFensUserInfoField *pFensUserInfo) override;
+  void RegisterSpi(CThostFtdcTraderSpi *pSpi) override;
+  void SubscribePrivateTopic(THOST_TE_RESUME_TYPE nResumeType) override;
+  void SubscribePublicTopic(THOST_TE_RESUME_TYPE nResumeType) override;
+  int RegisterUserSystemInfo(
+      CThostFtdcUserSystemInfoField *pUserSystemInfo) override;
+  int SubmitUserSystemInfo(
+      CThostFtdcUserSystemInfoField *pUserSystemInfo) override;
+  int RegisterWechatUserSystemInfo(
+      CThostFtdcWechatUserSystemInfoField *pUserSystemInfo) override;
+  int SubmitWechatUserSystemInfo(
+      CThostFtdcWechatUserSystemInfoField *pUserSystemInfo) override;
+  int ReqAuthenticate(CThostFtdcReqAuthenticateField *pReqAuthenticate,
+                      int nRequestID) override;
+  int ReqUserLogin(CThostFtdcReqUserLoginField *pReqUserLogin,
+                   int nRequestID) override;
+  int ReqUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                    int nRequestID) override;
+  int ReqOrderInsert(CThostFtdcInputOrderField *pInputOrder,
+                     int nRequestID) override;
+  int ReqOrderAction(CThostFtdcInputOrderActionField *pInputOrderAction,
+                     int nRequestID) override;
+  int ReqSettlementInfoConfirm(
+      CThostFtdcSettlementInfoConfirmField *pSettlementInfoConfirm,
+      int nRequestID) override;
+  int ReqQryOrder(CThostFtdcQryOrderField *pQryOrder, int nRequestID) override;
+  int ReqQryTrade(CThostFtdcQryTradeField *pQryTrade, int nRequestID) override;
+  int ReqQryInvestorPosition(
+      CThostFtdcQryInvestorPositionField *pQryInvestorPosition,
+      int nRequestID) override;
+  int ReqQryTradingAccount(CThostFtdcQryTradingAccountField *pQryTradingAccount,
+                           int nRequestID) override;
+
+#define CTP_SIM_TRADER_DECLARE_UNSUPPORTED(Method, Field)                     \
+  int Method(Field *, int) override { return -1; }
+  CTP_SIM_TRADER_UNSUPPORTED_REQUESTS(CTP_SIM_TRADER_DECLARE_UNSUPPORTED)
+#undef CTP_SIM_TRADER_DECLARE_UNSUPPORTED
+
+private:
+  struct Job {
+    std::int64_t nDue;
+    std::uint64_t nSeq;
+    std::function<void()> fnRun;
+  };
+
+  struct JobLater {
+    bool operator()(const Job &lhs, const Job &rhs) const {
+      return lhs.nDue != rhs.nDue ? lhs.nDue > rhs.nDue : lhs.nSeq > rhs.nSeq;
+    }
+  };
+
+  // 按合约汇总的持仓
+  struct Position {
+    int nLong = 0;
+    int nShort = 0;
+    double dLongCost = 0.0;
+    double dShortCost = 0.0;
+  };
+
+  explicit SimTraderApi(const SimTraderOptions &options);
+  ~SimTraderApi();
+
+  void run();
+  void scheduleRequest(std::function<void()> fnRun);
+  void scheduleResponse(std::function<void()> fnRun);
+  void schedule(std::int64_t nLatency, std::int64_t &nLastDue,
+                std::function<void()> fnRun);
+
+  // MatchingEngineSpi，在模拟线程上调用
+  void OnOrder(const CThostFtdcOrderField &order) override;
+  void OnTrade(const CThostFtdcTradeField &trade) override;
+
+  SimTraderOptions m_options;
+  CThostFtdcTraderSpi *m_pSpi;
+  TThostFtdcDateType m_szTradingDay;
+
+  // 以下状态只在模拟线程上访问
+  MatchingEngine m_engine;
+  std::map<std::string, Position> m_positions;
+
+  std::thread m_thread;
+  bool m_bRunning;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::priority_queue<Job, std::vector<Job>, JobLater> m_jobs;
+  std::uint64_t m_nSeq;
+  std::int64_t m_nLastRequestDue;
+  std::int64_t m_nLastResponseDue;
+  std::minstd_rand m_random;
+};
+
+} // namespace ctp
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ctp_spsc_ring.h"
+#include "ctp_tick.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ctp {
+
+// 最新行情快照表
+// 每个合约（InstrumentTable下标）占一个按缓存行对齐的槽位，行情线程以seqlock
+// 方式覆盖写入，任意数量的读线程无锁读取一致的副本。写入方从不等待读者，
+// 读者只在与写入重叠时重试。
+// 每个槽位的序号在每次更新后加2（写入过程中为奇数），读者据此判断快照自上次
+// 读取以来是否变化。同一槽位只能有一个写入线程。
+class SnapshotTable {
+public:
+  explicit SnapshotTable(std::size_t nMaxInstruments = 8192);
+  ~SnapshotTable();
+
+  SnapshotTable(const SnapshotTable &) = delete;
+  SnapshotTable &operator=(const SnapshotTable &) = delete;
+
+  // 写入方：覆盖tick.nInstrument对应的快照，合约下标超出容量时返回false
+  bool Update(const CompactTick &tick) {
+    if (tick.nInstrument >= m_nCapacity)
+      return false;
+    Slot &slot = m_pSlots[tick.nInstrument];
+    const std::uint64_t nSeq = slot.nSeq.load(std::memory_order_relaxed);
+    slot.nSeq.store(nSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::uint64_t nWords[kWords];
+    std::memcpy(nWords, &tick, sizeof(tick));
+    for (std::size_t i = 0; i < kWords; ++i)
+      slot.nWords[i].store(nWords[i], std::memory_order_relaxed);
+
+    slot.nSeq.store(nSeq + 2, std::memory_order_release);
+    return true;
+  }
+
+  // 读者：拷贝一致的快照，从未写入过或下标超出容量时返回false
+  // pVersion非空时返回该快照的序号。
+  bool Read(std::uint32_t nInstrument, CompactTick &tick,
+            std::uint64_t *pVersion = nullptr) const {
+    if (nInstrument >= m_nCapacity)
+      return false;
+    const Slot &slot = m_pSlots[nInstrument];
+    std::uint64_t nWords[kWords];
+    std::uint64_t nBegin;
+    for (;;) {
+      nBegin = slot.nSeq.load(std::memory_order_acquire);
+      if (nBegin & 1) {
+        CpuRelax();
+        continue;
+      }
+      for (std::size_t i = 0; i < kWords; ++i)
+        nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.nSeq.load(std::memory_order_relaxed) == nBegin)
+        break;
+    }
+    if (nBegin == 0)
+      return false;
+    std::memcpy(&tick, nWords, sizeof(tick));
+    if (pVersion)
+      *pVersion = nBegin;
+    return true;
+  }
+
+  // 读者：仅当快照相对nVersion有变化时拷贝并更新nVersion
+  bool ReadIfChanged(std::uint32_t nInstrument, CompactTick &tick,
+                     std::uint64_t &nVersion) const {
+    if (GetVersion(nInstrument) == nVersion)
+      return false;
+    return Read(nInstrument, tick, &nVersion);
+  }
+
+  // 槽位当前序号，0表示从未写入；只读一个原子量，可用于廉价地轮询变化
+  std::uint64_t GetVersion(std::uint32_t nInstrument) const {
+    if (nInstrument >= m_nCapacity)
+      return 0;
+    return m_pSlots[nInstrument].nSeq.load(std::memory_order_acquire) & ~1ull;
+  }
+
+  std::size_t Capacity() const { return m_nCapacity; }
+
+private:
+  static constexpr std::size_t kWords = sizeof(CompactTick) / 8;
+
+  // 负载按8字节原子字保存，读写并发时不构成数据竞争
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<std::uint64_t> nSeq;
+    std::atomic<std::uint64_t> nWords[kWords];
+  };
+
+  std::size_t m_nCapacity;
+  Slot *m_pSlots;
+};
+
+} // namespace ctp
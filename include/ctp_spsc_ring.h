@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace ctp {
+
+// 缓存行大小，用于隔离生产者/消费者各自修改的字段
+constexpr std::size_t kCacheLineSize = 64;
+
+// 自旋等待时让出流水线，降低对同核超线程的干扰
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// 单生产者/单消费者无锁环形队列
+// 容量向上取整为2的幂，槽位在构造时一次性分配并预先触页，运行期间不再分配内存。
+template <typename T> class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscRing element must be trivially copyable");
+
+public:
+  explicit SpscRing(std::size_t nCapacity)
+      : m_nHead(0), m_nCachedTail(0), m_nTail(0), m_nCachedHead(0),
+        m_nMask(roundUpPow2(nCapacity) - 1), m_pSlots(nullptr) {
+    std::size_t nBytes = sizeof(T) * (m_nMask + 1);
+    m_pSlots = static_cast<T *>(
+        ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+    // 预先触页，避免首轮写入时在行情线程上产生缺页中断
+    std::memset(static_cast<void *>(m_pSlots), 0, nBytes);
+  }
+
+  ~SpscRing() {
+    ::operator delete(m_pSlots, std::align_val_t(kCacheLineSize));
+  }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  // 生产者：写入一个元素，队列满时返回false
+  bool TryPush(const T &item) {
+    const std::size_t nTail = m_nTail.load(std::memory_order_relaxed);
+    if (nTail - m_nCachedHead > m_nMask) {
+      m_nCachedHead = m_nHead.load(std::memory_order_acquire);
+      if (nTail - m_nCachedHead > m_nMask)
+        return false;
+    }
+    std::memcpy(static_cast<void *>(&m_pSlots[nTail & m_nMask]), &item,
+                sizeof(T));
+    m_nTail.store(nTail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 生产者：取得下一个空槽位原地写入，写完后调用Commit()发布；
+  // 队列满时返回nullptr
+  T *Reserve() {
+    const std::size_t nTail = m_nTail.load(std::memory_order_relaxed);
+    if (nTail - m_nCachedHead > m_nMask) {
+      m_nCachedHead = m_nHead.load(std::memory_order_acquire);
+      if (nTail - m_nCachedHead > m_nMask)
+        return nullptr;
+    }
+    return &m_pSlots[nTail & m_nMask];
+  }
+
+  // 生产者：发布Reserve()得到的槽位
+  void Commit() {
+    m_nTail.store(m_nTail.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+  // 消费者：查看队首元素，队列空时返回nullptr
+  // 返回的指针在调用Pop()之前保持有效。
+  const T *Front() {
+    const std::size_t nHead = m_nHead.load(std::memory_order_relaxed);
+    if (nHead == m_nCachedTail) {
+      m_nCachedTail = m_nTail.load(std::memory_order_acquire);
+      if (nHead == m_nCachedTail)
+        return nullptr;
+    }
+    return &m_pSlots[nHead & m_nMask];
+  }
+
+  // 消费者：丢弃队首元素，必须在Front()返回非空之后调用
+  void Pop() {
+    m_nHead.store(m_nHead.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+  // 消费者：取出队首元素，队列空时返回false
+  bool TryPop(T &item) {
+    const T *pFront = Front();
+    if (!pFront)
+      return false;
+    std::memcpy(static_cast<void *>(&item), pFront, sizeof(T));
+    Pop();
+    return true;
+  }
+
+  // 当前队列中的元素个数（任意线程可读，结果为近似值）
+  std::size_t Size() const {
+    const std::size_t nHead = m_nHead.load(std::memory_order_acquire);
+    const std::size_t nTail = m_nTail.load(std::memory_order_acquire);
+    return nTail - nHead;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  std::size_t Capacity() const { return m_nMask + 1; }
+
+  // 槽位所在的内存区间，可用于绑定到消费线程的NUMA节点
+  void *GetStorage() const { return m_pSlots; }
+  std::size_t GetStorageSize() const { return sizeof(T) * (m_nMask + 1); }
+
+private:
+  static std::size_t roundUpPow2(std::size_t n) {
+    std::size_t nResult = 2;
+    while (nResult < n)
+      nResult <<= 1;
+    return nResult;
+  }
+
+  // 消费者独占的缓存行
+  alignas(kCacheLineSize) std::atomic<std::size_t> m_nHead;
+  std::size_t m_nCachedTail;
+
+  // 生产者独占的缓存行
+  alignas(kCacheLineSize) std::atomic<std::size_t> m_nTail;
+  std::size_t m_nCachedHead;
+
+  // 只读共享的缓存行
+  alignas(kCacheLineSize) const std::size_t m_nMask;
+  T *m_pSlots;
+};
+
+} // namespace ctp
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ThostFtdcMdApi.h"
+#include "ctp_instrument_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ctp {
+
+struct SubscriptionManagerOptions {
+  // 合约池容量，池在构造时一次性分配
+  std::size_t nMaxInstruments = 8192;
+  // 单次SubscribeMarketData/UnSubscribeMarketData的合约数上限
+  std::size_t nBatchSize = 500;
+};
+
+// 单个合约在前置上的订阅状态
+enum class SubscriptionState : std::uint8_t {
+  None,        // 前置上未订阅
+  Pending,     // 已发送订阅，等待应答
+  Active,      // 订阅已确认
+  Unsubscribe, // 已发送退订，等待应答
+  Failed       // 订阅应答返回错误，不再自动重试
+};
+
+struct SubscriptionStats {
+  std::size_t nDesired;   // 期望订阅的合约数
+  std::size_t nActive;    // 已确认的合约数
+  std::size_t nPending;   // 等待订阅应答的合约数
+  std::size_t nFailed;    // 订阅失败的合约数
+  std::uint64_t nBatches; // 已发送的订阅/退订请求数
+};
+
+// 行情订阅管理器
+// 维护期望订阅的合约集合与前置上已确认的集合，差异部分按nBatchSize分批调用
+// SubscribeMarketData/UnSubscribeMarketData。合约代码保存在构造时分配的连续
+// 字符池中，地址稳定，可直接作为char*数组传给API，发送时不再分配内存。
+// 断线后前置上的订阅全部失效：重新登录时只重放断线前已确认的合约，以及仍在
+// 等待应答、尚未失败的合约；订阅失败的合约需调用Retry()才会重新发送。
+// 所有接口可在任意线程调用，内部以互斥锁保护（均为低频操作）。
+class SubscriptionManager {
+public:
+  explicit SubscriptionManager(const SubscriptionManagerOptions &options = {});
+
+  SubscriptionManager(const SubscriptionManager &) = delete;
+  SubscriptionManager &operator=(const SubscriptionManager &) = delete;
+
+  void SetMdApi(CThostFtdcMdApi *pApi);
+
+  // 加入/移出期望集合，已登录时立即发送差异；合约池满时Add返回false
+  bool Add(const char *pszInstrumentID);
+  bool Add(const std::vector<const char *> &instrumentIDs);
+  bool Remove(const char *pszInstrumentID);
+  // 重新订阅所有失败的合约
+  void Retry();
+
+  // 会话事件，由SPI的对应回调转发
+  // OnLogin()发送差异并返回API的错误码（0表示全部发送成功）。
+  int OnLogin();
+  void OnDisconnected();
+  void
+  OnRspSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                     CThostFtdcRspInfoField *pRspInfo, bool bIsLast);
+  void
+  OnRspUnSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                       CThostFtdcRspInfoField *pRspInfo, bool bIsLast);
+
+  SubscriptionState GetState(const char *pszInstrumentID) const;
+  SubscriptionStats GetStats() const;
+
+private:
+  // 调用方须持有m_mutex
+  bool add(const char *pszInstrumentID);
+  int flush();
+  int sendBatch(bool bSubscribe);
+  std::size_t completeOldestBatch(SubscriptionState eFrom,
+                                  SubscriptionState eTo);
+
+  SubscriptionManagerOptions m_options;
+  CThostFtdcMdApi *m_pApi;
+  bool m_bLoggedIn;
+
+  // 合约代码池，下标与m_table一致
+  std::unique_ptr<TThostFtdcInstrumentIDType[]> m_pIDs;
+  InstrumentTable m_table;
+  std::vector<bool> m_desired;
+  std::vector<SubscriptionState> m_states;
+  // 各合约最近一次发送所在的请求序号，用于不带合约的应答
+  std::vector<std::uint64_t> m_batchOf;
+  // 预分配的批量指针数组
+  std::vector<char *> m_batch;
+  std::vector<std::uint32_t> m_batchIndices;
+  std::uint64_t m_nBatches;
+
+  mutable std::mutex m_mutex;
+};
+
+} // namespace ctp
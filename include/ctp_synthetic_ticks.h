@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ctp {
+
+// 本地合成行情源，供基准测试与行情守护进程的合成模式使用
+// 为若干虚构合约生成字段齐全的深度行情：价格按最小变动价位随机游走，
+// 五档盘口围绕最新价展开，时间每笔推进500毫秒。不依赖CTP前置。
+class SyntheticTickGenerator {
+public:
+  explicit SyntheticTickGenerator(std::size_t nInstruments = 64,
+                                  std::uint64_t nSeed = 20240601)
+      : m_nSeed(nSeed), m_nNext(0), m_nMillis(9 * 3600 * 1000) {
+    m_states.resize(nInstruments);
+    for (std::size_t i = 0; i < nInstruments; ++i) {
+      State &state = m_states[i];
+      std::snprintf(state.szInstrumentID, sizeof(state.szInstrumentID),
+                    "sy%04zu", i);
+      state.dPriceTick = (i % 3 == 0) ? 0.2 : 1.0;
+      state.nLastTicks = 10000 + static_cast<std::int32_t>(i) * 10;
+      state.nVolume = 0;
+    }
+  }
+
+  // 把全部合约登记到表中，返回成功登记的数目
+  std::size_t Register(InstrumentTable &table) const {
+    std::size_t nCount = 0;
+    for (const State &state : m_states) {
+      if (table.Add(state.szInstrumentID, state.dPriceTick) !=
+          kInvalidInstrument)
+        ++nCount;
+    }
+    return nCount;
+  }
+
+  std::size_t GetInstrumentCount() const { return m_states.size(); }
+
+  // 依次轮转合约，生成下一笔行情
+  void Next(CThostFtdcDepthMarketDataField &tick) {
+    State &state = m_states[m_nNext];
+    if (++m_nNext == m_states.size()) {
+      m_nNext = 0;
+      m_nMillis += 500;
+    }
+
+    std::uint64_t nRand = random();
+    state.nLastTicks += static_cast<std::int32_t>(nRand % 5) - 2;
+    std::int32_t nVolume = 1 + static_cast<std::int32_t>((nRand >> 8) % 20);
+    state.nVolume += nVolume;
+
+    std::memset(&tick, 0, sizeof(tick));
+    std::memcpy(tick.InstrumentID, state.szInstrumentID,
+                sizeof(tick.InstrumentID));
+    std::memcpy(tick.TradingDay, "20240603", 9);
+    std::memcpy(tick.ActionDay, "20240603", 9);
+    std::memcpy(tick.ExchangeID, "SHFE", 5);
+
+    const double dTick = state.dPriceTick;
+    const double dLast = state.nLastTicks * dTick;
+    tick.LastPrice = dLast;
+    tick.UpperLimitPrice = (state.nLastTicks + 1000) * dTick;
+    tick.LowerLimitPrice = (state.nLastTicks - 1000) * dTick;
+    tick.Volume = state.nVolume;
+    tick.Turnover = dLast * state.nVolume;
+    tick.OpenInterest = 100000.0 + static_cast<double>(nRand % 1000);
+
+    std::uint32_t nSeconds = m_nMillis / 1000;
+    std::snprintf(tick.UpdateTime, sizeof(tick.UpdateTime), "%02u:%02u:%02u",
+                  nSeconds / 3600 % 24, nSeconds / 60 % 60, nSeconds % 60);
+    tick.UpdateMillisec = m_nMillis % 1000;
+
+    double *pBid[] = {&tick.BidPrice1, &tick.BidPrice2, &tick.BidPrice3,
+                      &tick.BidPrice4, &tick.BidPrice5};
+    double *pAsk[] = {&tick.AskPrice1, &tick.AskPrice2, &tick.AskPrice3,
+                      &tick.AskPrice4, &tick.AskPrice5};
+    int *pBidVolume[] = {&tick.BidVolume1, &tick.BidVolume2, &tick.BidVolume3,
+                         &tick.BidVolume4, &tick.BidVolume5};
+    int *pAskVolume[] = {&tick.AskVolume1, &tick.AskVolume2, &tick.AskVolume3,
+                         &tick.AskVolume4, &tick.AskVolume5};
+    for (int i = 0; i < 5; ++i) {
+      *pBid[i] = (state.nLastTicks - 1 - i) * dTick;
+      *pAsk[i] = (state.nLastTicks + 1 + i) * dTick;
+      *pBidVolume[i] = 1 + static_cast<int>((nRand >> (16 + i * 4)) & 15);
+      *pAskVolume[i] = 1 + static_cast<int>((nRand >> (36 + i * 4)) & 15);
+    }
+  }
+
+private:
+  struct State {
+    TThostFtdcInstrumentIDType szInstrumentID;
+    double dPriceTick;
+    std::int32_t nLastTicks;
+    std::int32_t nVolume;
+  };
+
+  // splitmix64
+  std::uint64_t random() {
+    std::uint64_t z = (m_nSeed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  std::vector<State> m_states;
+  std::uint64_t m_nSeed;
+  std::size_t m_nNext;
+  std::uint32_t m_nMillis;
+};
+
+} // namespace ctp
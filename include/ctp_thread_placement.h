@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ctp {
+
+// 线程调度策略
+enum class ThreadSchedPolicy {
+  Inherit,   // 不修改
+  Other,     // SCHED_OTHER
+  Fifo,      // SCHED_FIFO，需要CAP_SYS_NICE或相应的rtprio限额
+  RoundRobin // SCHED_RR
+};
+
+// 线程放置配置
+struct ThreadPlacement {
+  // 允许运行的CPU编号，为空时不修改亲和性
+  std::vector<int> cpus;
+  ThreadSchedPolicy ePolicy = ThreadSchedPolicy::Inherit;
+  // Fifo/RoundRobin的优先级（1-99），Other忽略该项
+  int nPriority = 0;
+
+  bool Empty() const {
+    return cpus.empty() && ePolicy == ThreadSchedPolicy::Inherit;
+  }
+};
+
+// 解析"2,4-6"形式的CPU列表，格式错误时返回false
+bool ParseCpuList(const char *pszCpuList, std::vector<int> &cpus);
+
+// 内核线程ID（gettid），与/proc/self/task下的目录名一致
+int GetOsThreadId();
+
+// 当前进程的全部线程ID
+std::vector<int> ListProcessThreads();
+
+// 对线程nTid应用放置配置，nTid为0表示调用线程
+// 亲和性和调度策略分别设置，任一失败都返回false并记录日志。
+bool ApplyThreadPlacement(int nTid, const ThreadPlacement &placement,
+                          const char *pszLabel);
+// 对一组线程应用相同的配置，返回成功的线程数
+std::size_t ApplyThreadPlacement(const std::vector<int> &tids,
+                                 const ThreadPlacement &placement,
+                                 const char *pszLabel);
+
+// 记录线程当前的名称、亲和性、调度策略、所在CPU与NUMA节点
+void LogThreadPlacement(int nTid, const char *pszLabel);
+std::string DescribeThreadPlacement(int nTid);
+
+// NUMA拓扑，无法识别时返回-1/1
+int GetNumaNodeOfCpu(int nCpu);
+int GetNumaNodeCount();
+// 配置中全部CPU属于同一节点时返回该节点，否则返回-1
+int GetNumaNodeOfPlacement(const ThreadPlacement &placement);
+// 调用线程当前所在的NUMA节点
+int GetCurrentNumaNode();
+
+// 把已分配的内存迁移并绑定到nNode，只处理区间内完整的页
+// 常驻内存会被移动，此后的缺页也在该节点上分配。
+bool BindMemoryToNumaNode(void *pMemory, std::size_t nBytes, int nNode);
+
+// 线程集合快照
+// 在CThostFtdcMdApi/CThostFtdcTraderApi::Init()前构造，Init()后调用
+// GetNewThreads()即可得到API内部新建的网络和回调线程。期间其他模块新建的线程
+// 也会被计入，应在日志、分发器等线程启动之后再调用Init()。
+class ThreadSnapshot {
+public:
+  ThreadSnapshot();
+
+  // 等到连续nSettleMs内不再出现新线程（最多nTimeoutMs）后返回新增的线程
+  std::vector<int> GetNewThreads(int nSettleMs = 100,
+                                 int nTimeoutMs = 2000) const;
+
+private:
+  std::vector<int> m_tids;
+};
+
+// 调用pApi->Init()并返回其新建的线程
+template <typename Api>
+std::vector<int> InitAndCaptureThreads(Api *pApi, int nSettleMs = 100) {
+  ThreadSnapshot snapshot;
+  pApi->Init();
+  return snapshot.GetNewThreads(nSettleMs);
+}
+
+} // namespace ctp
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+#include "ctp_instrument_table.h"
+
+#include <cstdint>
+
+namespace ctp {
+
+// 盘口档位数
+constexpr int kTickDepth = 5;
+
+// 无效价格（CTP用DBL_MAX表示的空档位、未设置的涨跌停等）对应的跳数
+constexpr std::int32_t kInvalidTicks = INT32_MIN;
+
+// 交易日内的毫秒时间
+// 夜盘（18:00及之后）记为负值，使得同一交易日内从夜盘到日盘单调递增。
+inline std::int32_t TradingTimeKey(const char *pszUpdateTime,
+                                   int nUpdateMillisec) {
+  // UpdateTime格式为"HH:MM:SS"
+  int nHour = (pszUpdateTime[0] - '0') * 10 + (pszUpdateTime[1] - '0');
+  int nMinute = (pszUpdateTime[3] - '0') * 10 + (pszUpdateTime[4] - '0');
+  int nSecond = (pszUpdateTime[6] - '0') * 10 + (pszUpdateTime[7] - '0');
+  std::int32_t nKey =
+      ((nHour * 60 + nMinute) * 60 + nSecond) * 1000 + nUpdateMillisec;
+  if (nHour >= 18)
+    nKey -= 24 * 3600 * 1000;
+  return nKey;
+}
+
+// 紧凑行情记录，固定128字节（两条缓存行）
+// 只保留策略实际读取的字段，价格统一换算为最小变动价位的整数倍。
+struct alignas(64) CompactTick {
+  std::uint32_t nInstrument; // InstrumentTable下标
+  std::int32_t nTime;        // TradingTimeKey
+  std::int32_t nLastPrice;
+  std::int32_t nUpperLimitPrice;
+  std::int32_t nLowerLimitPrice;
+  std::int32_t nVolume; // 当日累计成交量
+  double dTurnover;     // 当日累计成交额
+  std::int64_t nOpenInterest;
+  std::int32_t nBidPrice[kTickDepth];
+  std::int32_t nAskPrice[kTickDepth];
+  std::int32_t nBidVolume[kTickDepth];
+  std::int32_t nAskVolume[kTickDepth];
+};
+
+static_assert(sizeof(CompactTick) == 128, "CompactTick must be 128 bytes");
+
+// 行情规整器
+// 把CThostFtdcDepthMarketDataField转换为CompactTick，合约下标和最小变动价位
+// 来自订阅时建立的InstrumentTable。
+class TickNormalizer {
+public:
+  explicit TickNormalizer(const InstrumentTable &table) : m_table(table) {}
+
+  // 合约未登记时返回false
+  bool Normalize(const CThostFtdcDepthMarketDataField &src,
+                 CompactTick &dst) const;
+
+  // 已知合约下标时跳过查表
+  void Normalize(std::uint32_t nInstrument,
+                 const CThostFtdcDepthMarketDataField &src,
+                 CompactTick &dst) const;
+
+  std::int32_t ToTicks(std::uint32_t nInstrument, double dPrice) const;
+  double ToPrice(std::uint32_t nInstrument, std::int32_t nTicks) const;
+
+  const InstrumentTable &GetInstrumentTable() const { return m_table; }
+
+private:
+  const InstrumentTable &m_table;
+};
+
+} // namespace ctp
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "ctp_tick.h"
+#include "ctp_tick_journal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ctp {
+
+// "CTPARCH1"
+constexpr std::uint64_t kTickArchiveMagic = 0x3148435241505443ull;
+constexpr std::uint32_t kTickArchiveVersion = 1;
+
+// 每个小块的值数，小块内各自选择位宽
+constexpr std::uint32_t kTickArchiveMiniBlock = 256;
+
+// 归档的列，与CompactTick的字段一一对应
+enum TickColumn : std::uint32_t {
+  kTickColumnTime,
+  kTickColumnLastPrice,
+  kTickColumnUpperLimitPrice,
+  kTickColumnLowerLimitPrice,
+  kTickColumnVolume,
+  kTickColumnTurnover, // 以0.01为单位取整
+  kTickColumnOpenInterest,
+  // 以下四组各kTickDepth列，按档位排列
+  kTickColumnBidPrice,
+  kTickColumnAskPrice = kTickColumnBidPrice + kTickDepth,
+  kTickColumnBidVolume = kTickColumnAskPrice + kTickDepth,
+  kTickColumnAskVolume = kTickColumnBidVolume + kTickDepth,
+  kTickColumnCount = kTickColumnAskVolume + kTickDepth
+};
+
+constexpr std::uint32_t TickColumnBit(std::uint32_t nColumn) {
+  return 1u << nColumn;
+}
+constexpr std::uint32_t kAllTickColumns = (1u << kTickColumnCount) - 1;
+
+// 文件头，其后依次为各数据块、合约目录和块目录
+struct TickArchiveHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nHeaderSize;
+  std::uint32_t nColumns;
+  std::uint32_t nTicksPerBlock;
+  TThostFtdcDateType szTradingDay;
+  char szPadding[7];
+  std::uint64_t nInstruments;
+  std::uint64_t nBlocks;
+  std::uint64_t nTicks;
+  std::uint64_t nInstrumentOffset; // 合约目录在文件中的偏移
+  std::uint64_t nBlockOffset;      // 块目录在文件中的偏移
+  std::uint64_t nFileSize;
+};
+
+// 合约目录项，同一合约的数据块在块目录中连续且按时间排列
+struct TickArchiveInstrument {
+  TThostFtdcInstrumentIDType szInstrumentID;
+  char szPadding[7];
+  double dPriceTick;
+  std::uint64_t nTicks;
+  std::uint32_t nFirstBlock;
+  std::uint32_t nBlocks;
+};
+
+// 块目录项
+// 块内每列依次为：各小块的位宽（每个小块一字节，补齐到8字节）| 各小块数据。
+// 第i个值属于第i%4路，与同一路的上一个值做差分，差值经zigzag编码后按小块
+// 位宽打包，小块内按路交错存放。解包和前缀和都是4路同时进行，循环可以被
+// 向量化。
+struct TickArchiveBlock {
+  std::uint64_t nOffset; // 块数据在文件中的偏移
+  std::uint32_t nInstrument;
+  std::uint32_t nCount;
+  std::int32_t nFirstTime;
+  std::int32_t nLastTime;
+  std::int64_t nBase[kTickColumnCount]; // 各列首值
+  // 各列相对nOffset的偏移，末项为块长度
+  std::uint32_t nColumnOffset[kTickColumnCount + 1];
+};
+
+struct TickArchiveOptions {
+  // 每个数据块的最大行情数，取kTickArchiveMiniBlock的整数倍
+  std::uint32_t nTicksPerBlock = 8192;
+};
+
+// 把一个交易日的行情日志转换为按合约分块的列式归档
+// 价格按InstrumentTable中的最小变动价位换算为跳数，累计成交量、成交额、
+// 持仓量与时间（TradingTimeKey，毫秒）都按时间差分，再按小块位宽打包。
+// 日志中未登记或最小变动价位为0的合约被跳过。
+class TickArchiveWriter {
+public:
+  explicit TickArchiveWriter(const TickNormalizer &normalizer,
+                             const TickArchiveOptions &options = {});
+
+  bool Write(const TickJournalReader &journal, const std::string &strPath);
+
+  // 最近一次Write()写入和跳过的行情数
+  std::uint64_t GetTickCount() const { return m_nTicks; }
+  std::uint64_t GetSkippedCount() const { return m_nSkipped; }
+
+  // <strDirectory>/ticks_<TradingDay>.arc
+  static std::string MakePath(const std::string &strDirectory,
+                              const char *pszTradingDay);
+
+private:
+  bool writeBlock(int fd, const TickJournalReader &journal,
+                  const std::uint64_t *pRecords, std::uint32_t nCount,
+                  std::uint32_t nInstrument, std::uint64_t &nOffset);
+
+  const TickNormalizer &m_normalizer;
+  TickArchiveOptions m_options;
+  std::vector<TickArchiveBlock> m_blocks;
+  // 编码缓冲区，在块之间复用
+  std::vector<CompactTick> m_ticks;
+  std::vector<std::uint64_t> m_words;
+  std::uint64_t m_nTicks;
+  std::uint64_t m_nSkipped;
+};
+
+// 只读访问列式归档
+// 文件整体映射，只解码查询的列，未读取的列不会被换入内存。
+// 解码时不加锁，可以被多个线程并发调用。
+class TickArchiveReader {
+public:
+  TickArchiveReader();
+  ~TickArchiveReader();
+
+  TickArchiveReader(const TickArchiveReader &) = delete;
+  TickArchiveReader &operator=(const TickArchiveReader &) = delete;
+
+  bool Open(const std::string &strPath);
+  void Close();
+  bool IsOpen() const { return m_pBase != nullptr; }
+
+  const char *GetTradingDay() const {
+    return m_pBase ? header().szTradingDay : "";
+  }
+  std::uint64_t GetTickCount() const {
+    return m_pBase ? header().nTicks : 0;
+  }
+  std::size_t GetInstrumentCount() const {
+    return m_pBase ? header().nInstruments : 0;
+  }
+  const TickArchiveInstrument &GetInstrument(std::uint32_t nInstrument) const {
+    return m_pInstruments[nInstrument];
+  }
+  // 未找到时返回kInvalidInstrument
+  std::uint32_t Find(const char *pszInstrumentID) const;
+
+  // 解码一列，pOut至少容纳GetInstrument(nInstrument).nTicks个值
+  // 价格列为跳数，成交额列以0.01为单位。
+  bool ReadColumn(std::uint32_t nInstrument, std::uint32_t nColumn,
+                  std::int64_t *pOut) const;
+  // 解码nColumnMask中的列到CompactTick，其余字段保持不变
+  // nInstrument字段为归档内的合约编号。
+  bool ReadTicks(std::uint32_t nInstrument, std::uint32_t nColumnMask,
+                 CompactTick *pOut) const;
+
+private:
+  const TickArchiveHeader &header() const {
+    return *reinterpret_cast<const TickArchiveHeader *>(m_pBase);
+  }
+  void decodeColumn(const TickArchiveBlock &block, std::uint32_t nColumn,
+                    std::int64_t *pOut) const;
+  // 块内各列的位宽与长度是否自洽，解码不会越过块的边界
+  bool validBlock(const TickArchiveBlock &block) const;
+
+  const char *m_pBase;
+  std::size_t m_nMappedSize;
+  const TickArchiveInstrument *m_pInstruments;
+  const TickArchiveBlock *m_pBlocks;
+};
+
+} // namespace ctp
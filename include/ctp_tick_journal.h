@@ -0,0 +1,175 @@
+#pragma once
+
+#include "ThostFtdcUserApiStruct.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ctp {
+
+constexpr std::uint64_t kTickJournalMagic = 0x314C4E524A505443ull; // "CTPJRNL1"
+constexpr std::uint32_t kTickJournalVersion = 1;
+
+// 日志文件头，占用文件的第一页
+struct TickJournalHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nHeaderSize;
+  std::uint32_t nRecordSize;      // sizeof(TickJournalRecord)，用于识别CTP版本差异
+  std::uint32_t nRecordsPerBlock; // 稀疏时间索引的间隔
+  std::uint32_t nBlockSize;
+  std::uint32_t nReserved;
+  TThostFtdcDateType szTradingDay;
+  char szPadding[7];
+  std::atomic<std::uint64_t> nRecordCount; // 已提交的记录数
+};
+
+// 每个块的块头即稀疏时间索引的一项
+struct TickJournalBlockHeader {
+  std::uint64_t nFirstRecord;
+  std::uint32_t nCount;
+  // 本块记录中最大的交易日时间（TradingTimeKey），只由本块决定，
+  // 个别时间异常的记录不会影响其它块的索引
+  std::int32_t nMaxTime;
+  std::int32_t nFirstTime;
+  char szPadding[44];
+};
+
+static_assert(sizeof(TickJournalBlockHeader) == 64,
+              "TickJournalBlockHeader must be one cache line");
+
+// 定长记录
+struct TickJournalRecord {
+  std::int64_t nRecvTime; // 本地接收时间，自1970年以来的纳秒数
+  std::int32_t nTime;     // TradingTimeKey(UpdateTime, UpdateMillisec)
+  std::int32_t nReserved;
+  CThostFtdcDepthMarketDataField tick;
+};
+
+struct TickJournalOptions {
+  // 每隔多少条记录建立一个时间索引项
+  std::uint32_t nRecordsPerBlock = 1024;
+  // 创建文件时预分配的记录数
+  std::uint64_t nInitialRecords = 1u << 20;
+  // 空间不足时每次扩展的记录数，扩展在剩余空间低于一半扩展量时提前进行
+  std::uint64_t nGrowRecords = 1u << 20;
+  // 打开时一次性保留的地址空间（记录数），文件只在其中扩展，不再重新映射。
+  // 默认约29GB虚拟地址，不占用内存和磁盘
+  std::uint64_t nMaxRecords = 1u << 26;
+  // 每写入多少条记录发起一次异步msync
+  std::uint32_t nSyncInterval = 8192;
+};
+
+// 按交易日追加写入的内存映射行情日志
+// 文件按块组织：文件头 | 块头 + nRecordsPerBlock条记录 | 块头 + ... 。
+// Append()只做一次内存拷贝；扩容（ftruncate+fallocate+预先缺页）由后台线程
+// 在写入位置之前按大块进行，Append()不做任何扩容的系统调用。msync按批次发起。
+// 应在行情消费线程（例如MdDispatcher的回调）中调用，不要在CTP的网络线程上调用。
+class TickJournalWriter {
+public:
+  TickJournalWriter();
+  ~TickJournalWriter();
+
+  TickJournalWriter(const TickJournalWriter &) = delete;
+  TickJournalWriter &operator=(const TickJournalWriter &) = delete;
+
+  // 打开或创建日志文件，已存在的同交易日文件会在末尾继续追加
+  bool Open(const std::string &strPath, const char *pszTradingDay,
+            const TickJournalOptions &options = {});
+  void Close();
+  bool IsOpen() const { return m_pBase != nullptr; }
+
+  // 追加一条行情，nRecvTime为0时取当前时间。扩容失败或后台扩容
+  // 跟不上写入时返回false；扩容失败后不再重试，需要Close()后重新Open()
+  bool Append(const CThostFtdcDepthMarketDataField &tick,
+              std::int64_t nRecvTime = 0);
+
+  // 同步写出所有已追加的记录
+  void Flush();
+
+  std::uint64_t GetRecordCount() const { return m_nRecordCount; }
+
+  // <strDirectory>/ticks_<TradingDay>.jnl
+  static std::string MakePath(const std::string &strDirectory,
+                              const char *pszTradingDay);
+
+private:
+  bool mapFile(std::size_t nFileSize);
+  void requestGrow();
+  // 后台扩容线程
+  void run();
+  bool grow();
+  void populate(std::size_t nFrom, std::size_t nTo);
+  void syncRange(std::uint64_t nFromRecord, std::uint64_t nToRecord,
+                 bool bWait);
+  std::size_t offsetOfRecord(std::uint64_t nRecord) const;
+  std::size_t fileSizeForRecords(std::uint64_t nRecords) const;
+
+  TickJournalOptions m_options;
+  int m_fd;
+  char *m_pBase;
+  std::size_t m_nMappedSize; // 保留的地址空间，不小于文件长度
+  std::size_t m_nBlockSize;
+  std::uint64_t m_nRecordCount;
+  std::uint64_t m_nSyncedRecord;
+
+  // 文件长度只由扩容线程修改，容量在扩容完成后发布给写入方
+  std::size_t m_nFileSize;
+  std::atomic<std::uint64_t> m_nRecordCapacity;
+  // 已请求扩容且尚未完成；扩容失败后保持为true，不再重试
+  std::atomic<bool> m_bGrowRequested;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_bStop;
+  std::thread m_grower;
+};
+
+// 只读访问行情日志
+class TickJournalReader {
+public:
+  TickJournalReader();
+  ~TickJournalReader();
+
+  TickJournalReader(const TickJournalReader &) = delete;
+  TickJournalReader &operator=(const TickJournalReader &) = delete;
+
+  bool Open(const std::string &strPath);
+  void Close();
+  bool IsOpen() const { return m_pBase != nullptr; }
+
+  std::uint64_t GetRecordCount() const { return m_nRecordCount; }
+  const char *GetTradingDay() const;
+
+  const TickJournalRecord &GetRecord(std::uint64_t nRecord) const {
+    std::uint64_t nBlock = nRecord / m_nRecordsPerBlock;
+    std::uint64_t nSlot = nRecord % m_nRecordsPerBlock;
+    return *reinterpret_cast<const TickJournalRecord *>(
+        m_pBase + m_nHeaderSize + nBlock * m_nBlockSize +
+        sizeof(TickJournalBlockHeader) + nSlot * sizeof(TickJournalRecord));
+  }
+
+  // 返回第一条交易日时间不早于nTime的记录序号，不存在时返回GetRecordCount()
+  // 先按块头二分，再在块内顺序扫描，只触及O(log n)个索引页和一个数据块。
+  std::uint64_t Seek(std::int32_t nTime) const;
+  std::uint64_t Seek(const char *pszUpdateTime, int nUpdateMillisec) const;
+
+private:
+  const TickJournalBlockHeader &blockHeader(std::uint64_t nBlock) const {
+    return *reinterpret_cast<const TickJournalBlockHeader *>(
+        m_pBase + m_nHeaderSize + nBlock * m_nBlockSize);
+  }
+
+  const char *m_pBase;
+  std::size_t m_nMappedSize;
+  std::uint64_t m_nRecordCount;
+  std::uint64_t m_nRecordsPerBlock;
+  std::size_t m_nHeaderSize;
+  std::size_t m_nBlockSize;
+};
+
+} // namespace ctp
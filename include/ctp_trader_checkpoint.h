@@ -0,0 +1,213 @@
+#pragma once
+
+#include "ThostFtdcTraderApi.h"
+#include "ctp_instrument_table.h"
+#include "ctp_order_state.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ctp {
+
+// "CTPCKPT1"
+constexpr std::uint64_t kTraderCheckpointMagic = 0x3154504B43505443ull;
+// "CTPPLOG1"
+constexpr std::uint64_t kPrivateLogMagic = 0x31474F4C50505443ull;
+constexpr std::uint32_t kTraderCheckpointVersion = 1;
+
+// 检查点文件头，其后依次为：
+// 合约代码[nInstruments] | PositionState[nInstruments] | OrderState[nOrders]
+// | TradeKey[nTrades]
+struct TraderCheckpointHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nHeaderSize;
+  std::uint32_t nOrderSize;
+  std::uint32_t nPositionSize;
+  std::uint32_t nTradeSize;
+  TThostFtdcDateType szTradingDay;
+  char szPadding[3];
+  std::uint64_t nInstruments;
+  std::uint64_t nOrders;
+  std::uint64_t nTrades;
+  // 序列点：已折算进本检查点的私有流日志记录数
+  std::uint64_t nLogRecords;
+  std::int64_t nCreateTime; // 自1970年以来的纳秒数
+};
+
+// 私有流日志文件头，占用文件的第一页
+struct PrivateLogHeader {
+  std::uint64_t nMagic;
+  std::uint32_t nVersion;
+  std::uint32_t nRecordSize;
+  TThostFtdcDateType szTradingDay;
+  char szPadding[7];
+  std::uint64_t nRecordCount;
+};
+
+// 私有流日志的定长记录
+struct PrivateLogRecord {
+  enum Type : std::uint32_t { Order = 1, Trade = 2 };
+  std::uint32_t nType;
+  std::uint32_t nReserved;
+  union {
+    CThostFtdcOrderField order;
+    CThostFtdcTradeField trade;
+  };
+};
+
+struct TraderCheckpointOptions {
+  // 每处理多少条私有流回报写一次检查点，0表示只在Checkpoint()/Close()时写
+  std::uint32_t nCheckpointInterval = 4096;
+  // 日志文件的初始记录数和每次扩展的记录数，扩展由写线程完成
+  std::uint64_t nLogGrowRecords = 1u << 16;
+  // 日志一次性保留的地址空间（记录数），写满后append()失败
+  std::uint64_t nLogMaxRecords = 1u << 22;
+};
+
+// 私有流检查点
+// 以SubscribePrivateTopic(THOST_TERT_QUICK)启动会丢失当日的报单与成交，
+// 以RESTART启动则要从头重放当日的整条私有流。检查点让重启只处理增量：
+// - 每条OnRtnOrder/OnRtnTrade先追加到内存映射的私有流日志（进程崩溃后仍在
+//   页缓存中），再送入OrderStateEngine。剩余空间不足半个扩展量时由写线程
+//   扩展并预分配日志文件，回调线程不做系统调用；
+// - 每nCheckpointInterval条回报把引擎的报单、成交去重表与持仓写成一个紧凑的
+//   检查点文件，并记下已折算的日志记录数。回调线程只复制持仓数组和上次以来
+//   变化的报单、新增的成交，由后台线程合并到副本后写临时文件、fsync、rename
+//   并fsync目录；
+// - 重启时Open()加载最新的检查点，只重放其后的日志记录；检查点与当前交易日
+//   相同时建议以RESUME订阅私有流，前置只补发API流文件记录之后的回报。重复
+//   推送的成交由引擎去重。
+// RESUME仍有一个窗口：API先推进自己的流文件再回调OnRtnOrder/OnRtnTrade，
+// 进程在此之后、append()写入日志之前崩溃时，这条回报不会再次推送。需要
+// 完全不丢时以RESTART订阅，由引擎对重放的回报去重。
+// 文件位于传给CreateFtdcTraderApi的流文件目录：
+//   <dir>/checkpoint_<TradingDay>.bin、<dir>/private_<TradingDay>.log
+// 与OrderStateEngine一样非线程安全，应在交易回调线程上调用。仅支持Linux/Unix。
+class TraderCheckpoint {
+public:
+  TraderCheckpoint(OrderStateEngine &engine, InstrumentTable &table,
+                   const TraderCheckpointOptions &options = {});
+  ~TraderCheckpoint();
+
+  TraderCheckpoint(const TraderCheckpoint &) = delete;
+  TraderCheckpoint &operator=(const TraderCheckpoint &) = delete;
+
+  // Init()之前调用：加载目录中最近一个交易日的检查点并重放其后的日志
+  // pszTradingDay为本次登录预期的交易日（例如来自交易日历）。返回应传给
+  // SubscribePrivateTopic的模式：找到了该交易日的状态时为RESUME，否则为
+  // RESTART（从当日私有流开头重建）；交易日未知或不符时同样返回RESTART，
+  // 之前交易日的持仓仍会载入，由OnLogin()换日。
+  THOST_TE_RESUME_TYPE Open(const std::string &strDirectory,
+                            const char *pszTradingDay);
+  // 登录成功后调用；交易日与已加载的不同时引擎换日（Reset）并开始新的日志
+  bool OnLogin(const char *pszTradingDay);
+  // 写检查点并关闭日志
+  void Close();
+
+  // 代替直接调用OrderStateEngine的对应方法
+  const OrderState *OnRtnOrder(const CThostFtdcOrderField &order);
+  bool OnRtnTrade(const CThostFtdcTradeField &trade);
+
+  // 立即写检查点，等待写完后返回
+  bool Checkpoint();
+
+  const char *GetTradingDay() const { return m_szTradingDay; }
+  // Open()时从检查点载入的报单数和重放的日志记录数
+  std::size_t GetLoadedOrderCount() const { return m_nLoadedOrders; }
+  std::uint64_t GetReplayedCount() const { return m_nReplayed; }
+  std::uint64_t GetLogRecordCount() const { return m_nLogRecords; }
+
+  static std::string MakeCheckpointPath(const std::string &strDirectory,
+                                        const char *pszTradingDay);
+  static std::string MakeLogPath(const std::string &strDirectory,
+                                 const char *pszTradingDay);
+
+private:
+  // 交给写线程的增量：新登记的合约代码、全部持仓、变化的报单和新增的成交
+  struct Snapshot {
+    bool bReady;
+    bool bFull; // 副本从头重建
+    std::string strPath;
+    TThostFtdcDateType szTradingDay;
+    std::uint64_t nLogRecords;
+    std::uint64_t nOrders;
+    std::uint64_t nInstrumentFrom;
+    std::uint64_t nTradeFrom;
+    std::vector<char> vecInstrumentIDs;
+    std::vector<PositionState> vecPositions;
+    std::vector<std::pair<std::uint32_t, OrderState>> vecOrders;
+    std::vector<TradeKey> vecTrades;
+  };
+
+  bool loadCheckpoint(const std::string &strPath, std::uint64_t &nLogRecords);
+  std::uint64_t replayLog(const std::string &strPath, std::uint64_t nFrom);
+  bool openLog(const char *pszTradingDay);
+  bool mapLog(std::size_t nFileSize);
+  void closeLog();
+  void requestGrow();
+  bool waitForGrow();
+  bool growLog();
+  bool append(PrivateLogRecord::Type eType, const void *pField,
+              std::size_t nSize);
+  void afterUpdate();
+  void markOrder(const OrderState *pState);
+  // 把增量交给写线程，返回其序号
+  std::uint64_t stage();
+  void run();
+  bool write(const Snapshot &snapshot);
+
+  OrderStateEngine &m_engine;
+  InstrumentTable &m_table;
+  TraderCheckpointOptions m_options;
+  std::string m_strDirectory;
+  TThostFtdcDateType m_szTradingDay;
+
+  int m_fd;
+  char *m_pLog;
+  std::size_t m_nLogMappedSize; // 保留的地址空间
+  std::size_t m_nLogFileSize;
+  // 文件中可写的记录数，由写线程扩展后发布
+  std::atomic<std::uint64_t> m_nLogCapacity;
+  std::uint64_t m_nLogRecords;
+  std::uint64_t m_nCheckpointRecords; // 最近一个检查点的序列点
+  std::uint32_t m_nSinceCheckpoint;
+
+  std::size_t m_nLoadedOrders;
+  std::uint64_t m_nReplayed;
+
+  // 以下只在回调线程上访问：上次交给写线程之后变化的报单
+  std::vector<std::uint8_t> m_vecDirty;
+  std::vector<std::uint32_t> m_vecDirtyOrders;
+  bool m_bFullSnapshot;
+  std::uint64_t m_nStagedInstruments;
+  std::uint64_t m_nStagedTrades;
+
+  // 以下只在写线程上访问：检查点内容的副本
+  Snapshot m_writing;
+  std::vector<char> m_mirrorIDs;
+  std::vector<OrderState> m_mirrorOrders;
+  std::vector<TradeKey> m_mirrorTrades;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  Snapshot m_pending;
+  std::uint64_t m_nStagedSeq;
+  std::uint64_t m_nWrittenSeq;
+  bool m_bWriteOk;
+  // 日志扩容请求：回调线程置位，写线程扩容成功后清除
+  std::atomic<bool> m_bGrowRequested;
+  bool m_bGrowing;
+  bool m_bGrowFailed;
+  bool m_bStop;
+  std::thread m_writer;
+};
+
+} // namespace ctp
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Generate include/ctp_reflect_fields.h from ThostFtdcUserApiStruct.h.
+
+Usage:
+    python3 scripts/gen_ctp_reflect.py <api_dir>/ThostFtdcUserApiStruct.h \
+        > include/ctp_reflect_fields.h
+
+Only the structs listed in STRUCTS (or given with --struct) are emitted.
+Deprecated reserveN placeholder fields are skipped. Re-run this script after
+upgrading the CTP API so the descriptors match the new header.
+"""
+
+import argparse
+import re
+import sys
+
+# Structs that the library and examples log, record or export. Request
+# structs carrying passwords (ReqUserLogin, ReqAuthenticate) are left out on
+# purpose so they cannot end up in a log by accident.
+STRUCTS = [
+    "CThostFtdcRspInfoField",
+    "CThostFtdcRspUserLoginField",
+    "CThostFtdcSpecificInstrumentField",
+    "CThostFtdcDepthMarketDataField",
+    "CThostFtdcForQuoteRspField",
+    "CThostFtdcInputOrderField",
+    "CThostFtdcOrderField",
+    "CThostFtdcTradeField",
+    "CThostFtdcInputOrderActionField",
+    "CThostFtdcOrderActionField",
+    "CThostFtdcTradingAccountField",
+    "CThostFtdcInvestorPositionField",
+    "CThostFtdcInstrumentField",
+    "CThostFtdcInstrumentCommissionRateField",
+    "CThostFtdcInstrumentMarginRateField",
+]
+
+STRUCT_RE = re.compile(r"struct\s+(CThostFtdc\w+)\s*\{(.*?)\}\s*;", re.S)
+FIELD_RE = re.compile(r"\b(TThostFtdc\w+)\s+(\w+)\s*;")
+RESERVE_RE = re.compile(r"^reserve\d+$")
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def parse_structs(text):
+    structs = {}
+    for match in STRUCT_RE.finditer(strip_comments(text)):
+        fields = [name for _, name in FIELD_RE.findall(match.group(2))
+                  if not RESERVE_RE.match(name)]
+        structs[match.group(1)] = fields
+    return structs
+
+
+def emit(structs, names, source):
+    out = []
+    out.append("// 由scripts/gen_ctp_reflect.py根据%s生成，请勿手工修改" % source)
+    out.append("// 升级CTP API后重新生成：")
+    out.append("//   python3 scripts/gen_ctp_reflect.py "
+               "<api目录>/ThostFtdcUserApiStruct.h")
+    out.append("//       > include/ctp_reflect_fields.h")
+    out.append("#pragma once")
+    out.append("")
+    out.append('#include "ThostFtdcUserApiStruct.h"')
+    out.append("")
+    out.append("#include <cstddef>")
+    out.append("")
+    out.append("namespace ctp {")
+    out.append("")
+    out.append("// 结构体的字段描述，以(字段名, 成员指针)依次调用visitor")
+    out.append("template <typename T> struct Reflect;")
+    for name in names:
+        fields = structs[name]
+        out.append("")
+        out.append("template <> struct Reflect<%s> {" % name)
+        out.append("  using Type = %s;" % name)
+        line = '  static constexpr const char *kName = "%s";' % name
+        if len(line) > 80:
+            line = ('  static constexpr const char *kName =\n      "%s";'
+                    % name)
+        out.append(line)
+        out.append("  static constexpr std::size_t kFieldCount = %d;"
+                   % len(fields))
+        out.append("")
+        out.append("  template <typename Visitor>")
+        out.append("  static constexpr void ForEachField(Visitor &&visitor) {")
+        for field in fields:
+            out.append('    visitor("%s", &Type::%s);' % (field, field))
+        out.append("  }")
+        out.append("};")
+    out.append("")
+    out.append("} // namespace ctp")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("header", help="path to ThostFtdcUserApiStruct.h")
+    parser.add_argument("--struct", action="append", dest="structs",
+                        help="struct to emit (repeatable), defaults to the "
+                             "built-in list")
+    args = parser.parse_args()
+
+    with open(args.header, encoding="gb18030", errors="replace") as f:
+        structs = parse_structs(f.read())
+
+    names = args.structs or STRUCTS
+    missing = [name for name in names if name not in structs]
+    if missing:
+        sys.exit("struct not found in %s: %s"
+                 % (args.header, ", ".join(missing)))
+    sys.stdout.write(emit(structs, names, "ThostFtdcUserApiStruct.h"))
+
+
+if __name__ == "__main__":
+    main()
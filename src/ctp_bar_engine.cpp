@@ -0,0 +1,227 @@
+#include "ctp_bar_engine.h"
+
+#include <climits>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::int32_t kNoBar = INT32_MIN;
+
+// 行情时间回退超过该值视为进入新交易日
+constexpr std::int32_t kRolloverGapMs = 3600 * 1000;
+
+// 向负无穷取整，夜盘时间为负值
+inline std::int32_t alignDown(std::int32_t nTime, std::int32_t nIntervalMs) {
+  std::int32_t nRem = nTime % nIntervalMs;
+  if (nRem < 0)
+    nRem += nIntervalMs;
+  return nTime - nRem;
+}
+
+} // namespace
+
+BarEngine::BarEngine(BarEngineSpi *pSpi, const InstrumentTable &table,
+                     const BarEngineOptions &options)
+    : m_pSpi(pSpi), m_table(table), m_options(options), m_nLatestTime(kNoBar) {
+  const std::size_t nMax = m_table.Capacity();
+  m_series.resize(m_options.vecIntervalsMs.size());
+  for (std::size_t k = 0; k < m_series.size(); ++k) {
+    Series &series = m_series[k];
+    series.nIntervalMs = m_options.vecIntervalsMs[k];
+    series.nStart.assign(nMax, kNoBar);
+    series.nOpen.assign(nMax, 0);
+    series.nHigh.assign(nMax, 0);
+    series.nLow.assign(nMax, 0);
+    series.nClose.assign(nMax, 0);
+    series.nTickCount.assign(nMax, 0);
+    series.nVolume.assign(nMax, 0);
+    series.dTurnover.assign(nMax, 0.0);
+    series.nOpenInterest.assign(nMax, 0);
+    series.nClosedUntil.assign(nMax, kNoBar);
+    series.bExpired.assign(nMax, 0);
+    series.pending.reserve(nMax);
+  }
+  m_lastVolume.assign(nMax, -1);
+  m_lastTurnover.assign(nMax, 0.0);
+  m_lastTime.assign(nMax, kNoBar);
+}
+
+void BarEngine::OnTick(const CompactTick &tick) {
+  const std::uint32_t i = tick.nInstrument;
+
+  std::int64_t nVolume = 0;
+  double dTurnover = 0.0;
+  if (m_lastVolume[i] >= 0) {
+    // 换日只按本合约自己的累计成交量和时间判断，某个合约的陈旧快照不会
+    // 收掉其它合约的K线。时间大幅回退而累计成交量不变（且非零）的是本合约
+    // 的陈旧快照，直接忽略
+    const bool bTimeBack = m_lastTime[i] != kNoBar &&
+                           tick.nTime < m_lastTime[i] - kRolloverGapMs;
+    if (bTimeBack && tick.nVolume == m_lastVolume[i] && tick.nVolume > 0)
+      return;
+    if (tick.nVolume < m_lastVolume[i] || bTimeBack) {
+      // 收掉该合约上一交易日的K线，累计量从零重新开始
+      closeInstrument(i);
+      m_lastVolume[i] = 0;
+      m_lastTurnover[i] = 0.0;
+      m_lastTime[i] = kNoBar;
+      // 第一个换日的合约把行情时钟带入新交易日
+      if (tick.nTime < m_nLatestTime - kRolloverGapMs)
+        m_nLatestTime = kNoBar;
+    }
+    nVolume = tick.nVolume - m_lastVolume[i];
+    dTurnover = tick.dTurnover - m_lastTurnover[i];
+  }
+  if (m_nLatestTime == kNoBar || tick.nTime > m_nLatestTime)
+    m_nLatestTime = tick.nTime;
+  m_lastVolume[i] = tick.nVolume;
+  m_lastTurnover[i] = tick.dTurnover;
+
+  // 乱序行情不回到更早的K线
+  std::int32_t nTime = tick.nTime;
+  if (m_lastTime[i] != kNoBar && nTime < m_lastTime[i])
+    nTime = m_lastTime[i];
+  m_lastTime[i] = nTime;
+  if (!mapToSession(nTime))
+    return;
+
+  const std::int32_t nPrice = tick.nLastPrice;
+  for (Series &series : m_series) {
+    std::int32_t nStart = alignDown(nTime, series.nIntervalMs);
+    if (nStart < series.nClosedUntil[i])
+      nStart = series.nClosedUntil[i];
+    if (series.nStart[i] != kNoBar && series.nStart[i] != nStart)
+      close(series, i);
+
+    if (series.nStart[i] == kNoBar) {
+      if (nPrice == kInvalidTicks)
+        continue;
+      series.nStart[i] = nStart;
+      series.nOpen[i] = nPrice;
+      series.nHigh[i] = nPrice;
+      series.nLow[i] = nPrice;
+      series.nClose[i] = nPrice;
+      series.nTickCount[i] = 1;
+      series.nVolume[i] = nVolume;
+      series.dTurnover[i] = dTurnover;
+      series.nOpenInterest[i] = tick.nOpenInterest;
+      continue;
+    }
+
+    if (nPrice != kInvalidTicks) {
+      if (nPrice > series.nHigh[i])
+        series.nHigh[i] = nPrice;
+      if (nPrice < series.nLow[i])
+        series.nLow[i] = nPrice;
+      series.nClose[i] = nPrice;
+    }
+    ++series.nTickCount[i];
+    series.nVolume[i] += nVolume;
+    series.dTurnover[i] += dTurnover;
+    series.nOpenInterest[i] = tick.nOpenInterest;
+  }
+}
+
+void BarEngine::Advance(std::int32_t nNow) {
+  if (nNow != kNoBar) {
+    const std::size_t nCount = m_table.Size();
+    for (Series &series : m_series) {
+      // 先对整列做无分支的比较，再只处理到期的合约
+      const std::int32_t nLatestStart =
+          nNow - series.nIntervalMs - m_options.nCloseDelayMs;
+      const std::int32_t *pStart = series.nStart.data();
+      std::uint8_t *pExpired = series.bExpired.data();
+      std::size_t nExpired = 0;
+      for (std::size_t i = 0; i < nCount; ++i) {
+        pExpired[i] = static_cast<std::uint8_t>((pStart[i] != kNoBar) &
+                                                (pStart[i] <= nLatestStart));
+        nExpired += pExpired[i];
+      }
+      for (std::size_t i = 0; nExpired && i < nCount; ++i) {
+        if (pExpired[i]) {
+          close(series, static_cast<std::uint32_t>(i));
+          --nExpired;
+        }
+      }
+    }
+  }
+  deliver();
+}
+
+void BarEngine::Flush() {
+  for (Series &series : m_series)
+    for (std::uint32_t i = 0; i < m_table.Size(); ++i)
+      close(series, i);
+  deliver();
+}
+
+bool BarEngine::GetCurrentBar(std::size_t nInterval, std::uint32_t nInstrument,
+                              Bar &bar) const {
+  const Series &series = m_series[nInterval];
+  const std::uint32_t i = nInstrument;
+  if (series.nStart[i] == kNoBar)
+    return false;
+  bar.nInstrument = i;
+  bar.nStartTime = series.nStart[i];
+  bar.nEndTime = series.nStart[i] + series.nIntervalMs;
+  bar.nOpen = series.nOpen[i];
+  bar.nHigh = series.nHigh[i];
+  bar.nLow = series.nLow[i];
+  bar.nClose = series.nClose[i];
+  bar.nTickCount = series.nTickCount[i];
+  bar.nVolume = series.nVolume[i];
+  bar.dTurnover = series.dTurnover[i];
+  bar.nOpenInterest = series.nOpenInterest[i];
+  return true;
+}
+
+bool BarEngine::mapToSession(std::int32_t &nTime) const {
+  if (m_options.vecSessions.empty())
+    return true;
+  const std::int32_t nGrace = m_options.nSessionGraceMs;
+  for (const BarSession &session : m_options.vecSessions) {
+    if (nTime >= session.nStart && nTime < session.nEnd)
+      return true;
+    if (nTime < session.nStart && nTime >= session.nStart - nGrace) {
+      nTime = session.nStart;
+      return true;
+    }
+    if (nTime >= session.nEnd && nTime < session.nEnd + nGrace) {
+      nTime = session.nEnd - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void BarEngine::close(Series &series, std::uint32_t nInstrument) {
+  const std::uint32_t i = nInstrument;
+  if (series.nStart[i] == kNoBar)
+    return;
+  Bar bar;
+  GetCurrentBar(static_cast<std::size_t>(&series - m_series.data()), i, bar);
+  series.pending.push_back(bar);
+  series.nClosedUntil[i] = bar.nEndTime;
+  series.nStart[i] = kNoBar;
+}
+
+void BarEngine::closeInstrument(std::uint32_t nInstrument) {
+  for (Series &series : m_series) {
+    close(series, nInstrument);
+    series.nClosedUntil[nInstrument] = kNoBar;
+  }
+}
+
+void BarEngine::deliver() {
+  for (Series &series : m_series) {
+    if (series.pending.empty())
+      continue;
+    if (m_pSpi)
+      m_pSpi->OnBarsClosed(series.nIntervalMs, series.pending.data(),
+                           series.pending.size());
+    series.pending.clear();
+  }
+}
+
+} // namespace ctp
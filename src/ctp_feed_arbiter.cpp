@@ -0,0 +1,375 @@
+#include "ctp_feed_arbiter.h"
+#include "ctp_latency.h"
+#include "ctp_log.h"
+#include "ctp_tick.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace ctp {
+
+namespace {
+
+// TradingTimeKey的取值范围为[-6小时, 24小时)，加上偏移后放入高32位
+constexpr std::int64_t kTimeKeyOffset = 1ll << 30;
+
+// 单写者计数器，避免原子读-改-写
+inline void bump(std::atomic<std::uint64_t> &nCounter) {
+  nCounter.store(nCounter.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+}
+
+// YYYYMMDD解析为整数，格式不对时返回0
+inline std::uint32_t parseDay(const char *pszDay) {
+  std::uint32_t nDay = 0;
+  for (int i = 0; i < 8; ++i) {
+    if (pszDay[i] < '0' || pszDay[i] > '9')
+      return 0;
+    nDay = nDay * 10 + static_cast<std::uint32_t>(pszDay[i] - '0');
+  }
+  return pszDay[8] == '\0' ? nDay : 0;
+}
+
+} // namespace
+
+// 单个前置的SPI，处理会话回调并把行情交给仲裁器
+class FeedArbiter::FrontSpi : public CThostFtdcMdSpi {
+public:
+  FrontSpi(FeedArbiter &arbiter, std::size_t nFront)
+      : m_arbiter(arbiter), m_nFront(nFront) {}
+
+  void OnFrontConnected() override {
+    Front &front = *m_arbiter.m_fronts[m_nFront];
+    front.bConnected.store(true, std::memory_order_relaxed);
+    CTP_LOG_INFO("[Arbiter] %s connected", front.strName.c_str());
+    m_arbiter.login(front);
+  }
+
+  void OnFrontDisconnected(int nReason) override {
+    Front &front = *m_arbiter.m_fronts[m_nFront];
+    front.bConnected.store(false, std::memory_order_relaxed);
+    front.bLoggedIn.store(false, std::memory_order_relaxed);
+    bump(front.nDisconnects);
+    CTP_LOG_WARN("[Arbiter] %s disconnected, reason: 0x%x",
+                 front.strName.c_str(), nReason);
+  }
+
+  void OnHeartBeatWarning(int nTimeLapse) override {
+    CTP_LOG_WARN("[Arbiter] %s heartbeat warning, %d seconds since last "
+                 "message",
+                 m_arbiter.m_fronts[m_nFront]->strName.c_str(), nTimeLapse);
+  }
+
+  void OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                      CThostFtdcRspInfoField *pRspInfo, int /*nRequestID*/,
+                      bool /*bIsLast*/) override {
+    Front &front = *m_arbiter.m_fronts[m_nFront];
+    if (pRspInfo && pRspInfo->ErrorID != 0) {
+      CTP_LOG_ERROR("[Arbiter] %s login failed, ErrorID: %d, ErrorMsg: %s",
+                    front.strName.c_str(), pRspInfo->ErrorID,
+                    pRspInfo->ErrorMsg);
+      return;
+    }
+    front.bLoggedIn.store(true, std::memory_order_relaxed);
+    CTP_LOG_INFO("[Arbiter] %s logged in, trading day: %s",
+                 front.strName.c_str(),
+                 pRspUserLogin ? pRspUserLogin->TradingDay : "");
+    m_arbiter.subscribe(front);
+  }
+
+  void
+  OnRspSubMarketData(CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+                     CThostFtdcRspInfoField *pRspInfo, int /*nRequestID*/,
+                     bool /*bIsLast*/) override {
+    if (pRspInfo && pRspInfo->ErrorID != 0)
+      CTP_LOG_ERROR("[Arbiter] %s subscribe %s failed, ErrorID: %d, "
+                    "ErrorMsg: %s",
+                    m_arbiter.m_fronts[m_nFront]->strName.c_str(),
+                    pSpecificInstrument ? pSpecificInstrument->InstrumentID
+                                        : "",
+                    pRspInfo->ErrorID, pRspInfo->ErrorMsg);
+  }
+
+  void OnRspError(CThostFtdcRspInfoField *pRspInfo, int /*nRequestID*/,
+                  bool /*bIsLast*/) override {
+    CTP_LOG_ERROR("[Arbiter] %s error, ErrorID: %d, ErrorMsg: %s",
+                  m_arbiter.m_fronts[m_nFront]->strName.c_str(),
+                  pRspInfo ? pRspInfo->ErrorID : -1,
+                  pRspInfo ? pRspInfo->ErrorMsg : "Unknown");
+  }
+
+  void OnRtnDepthMarketData(
+      CThostFtdcDepthMarketDataField *pDepthMarketData) override {
+    if (pDepthMarketData)
+      m_arbiter.OnFrontTick(m_nFront, pDepthMarketData);
+  }
+
+private:
+  FeedArbiter &m_arbiter;
+  std::size_t m_nFront;
+};
+
+FeedArbiter::FeedArbiter(CThostFtdcMdSpi *pHandler,
+                         const InstrumentTable &table,
+                         const FeedArbiterOptions &options)
+    : m_pHandler(pHandler), m_table(table), m_options(options),
+      m_nSlots(table.Capacity()), m_pSlots(nullptr), m_nFronts(0),
+      m_bQueueLock(false), m_nDropped(0), m_ring(options.nRingCapacity),
+      m_bRunning(false), m_bSleeping(false), m_nForwarded(0) {
+  std::size_t nBytes = sizeof(Slot) * m_nSlots;
+  m_pSlots = static_cast<Slot *>(
+      ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+  // 预先触页，高水位0表示尚未收到任何行情
+  std::memset(static_cast<void *>(m_pSlots), 0, nBytes);
+  if (m_options.bRecordLatency)
+    TscClock::Instance();
+}
+
+FeedArbiter::~FeedArbiter() {
+  Stop();
+  ::operator delete(m_pSlots, std::align_val_t(kCacheLineSize));
+}
+
+void FeedArbiter::Start() {
+  if (m_bRunning.exchange(true))
+    return;
+  m_thread = std::thread(&FeedArbiter::run, this);
+}
+
+void FeedArbiter::Stop() {
+  if (!m_bRunning.exchange(false))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cond.notify_one();
+  }
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+int FeedArbiter::AddFront(CThostFtdcMdApi *pApi, const char *pszName) {
+  std::size_t nFront = m_nFronts.load(std::memory_order_relaxed);
+  if (!pApi || nFront >= kMaxFeedFronts)
+    return -1;
+
+  // 值初始化，计数器均为0
+  std::unique_ptr<Front> pFront(new Front());
+  pFront->strName = pszName ? pszName : "front" + std::to_string(nFront);
+  pFront->pApi = pApi;
+  pFront->pSpi.reset(new FrontSpi(*this, nFront));
+  pFront->nLagMetric = kInvalidLatencyMetric;
+  if (m_options.bRecordLatency)
+    pFront->nLagMetric = LatencyRecorder::Instance().Register(
+        ("md.arbiter.lag." + pFront->strName).c_str());
+  pFront->nRequestID = 0;
+
+  pApi->RegisterSpi(pFront->pSpi.get());
+  m_fronts[nFront] = std::move(pFront);
+  m_nFronts.store(nFront + 1, std::memory_order_release);
+  return static_cast<int>(nFront);
+}
+
+std::uint64_t
+FeedArbiter::makeKey(const CThostFtdcDepthMarketDataField &tick) {
+  if (tick.UpdateTime[2] != ':' || tick.UpdateTime[5] != ':')
+    return 0;
+  std::int64_t nTime =
+      TradingTimeKey(tick.UpdateTime, tick.UpdateMillisec) + kTimeKeyOffset;
+  return (static_cast<std::uint64_t>(nTime) << 32) |
+         static_cast<std::uint32_t>(tick.Volume);
+}
+
+bool FeedArbiter::OnFrontTick(
+    std::size_t nFront, CThostFtdcDepthMarketDataField *pDepthMarketData) {
+  Front &front = *m_fronts[nFront];
+  bump(front.nReceived);
+
+  std::uint32_t nInstrument = m_table.Find(pDepthMarketData->InstrumentID);
+  std::uint64_t nKey = makeKey(*pDepthMarketData);
+  if (nInstrument == kInvalidInstrument || nInstrument >= m_nSlots ||
+      nKey == 0) {
+    bump(front.nUnknown);
+    return false;
+  }
+  // TradingDay缺失时退回ActionDay，两者都没有则只比较高水位
+  std::uint32_t nDay = parseDay(pDepthMarketData->TradingDay);
+  if (nDay == 0)
+    nDay = parseDay(pDepthMarketData->ActionDay);
+
+  Slot &slot = m_pSlots[nInstrument];
+  const std::uint64_t nNow = m_options.bRecordLatency ? ReadTsc() : 0;
+  // 比较、更新高水位和入队都在合约锁内，同一合约的行情按高水位顺序入队；
+  // 输掉仲裁的前置只在锁上等待赢家的一次拷贝
+  while (slot.bLock.exchange(true, std::memory_order_acquire))
+    CpuRelax();
+  bool bNewer;
+  if (nDay != 0 && nDay != slot.nTradingDay)
+    bNewer = nDay > slot.nTradingDay;
+  else
+    bNewer = nKey > slot.nHighWater;
+  if (!bNewer) {
+    if (nKey == slot.nHighWater && (nDay == 0 || nDay == slot.nTradingDay)) {
+      bump(front.nDuplicates);
+      if (m_options.bRecordLatency)
+        recordLag(front, slot, nNow);
+    } else {
+      bump(front.nStale);
+    }
+    slot.bLock.store(false, std::memory_order_release);
+    return false;
+  }
+
+  if (nDay != 0)
+    slot.nTradingDay = nDay;
+  slot.nHighWater = nKey;
+  slot.nWinTsc = nNow;
+  bump(front.nWins);
+  bool bQueued = enqueue(*pDepthMarketData);
+  slot.bLock.store(false, std::memory_order_release);
+
+  if (bQueued && m_options.eWaitMode == MdWaitMode::Blocking) {
+    // 与转发线程的m_bSleeping写入配对，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_bSleeping.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cond.notify_one();
+    }
+  }
+  return bQueued;
+}
+
+void FeedArbiter::recordLag(Front &front, const Slot &slot,
+                            std::uint64_t nNow) {
+  std::int64_t nLagNs = TscClock::Instance().ElapsedNs(slot.nWinTsc, nNow);
+  // 后到前置可能在赢家写入时间戳之前读取了TSC
+  if (nLagNs < 0)
+    nLagNs = 0;
+  bump(front.nLagSamples);
+  front.nLagSumNs.store(front.nLagSumNs.load(std::memory_order_relaxed) +
+                            nLagNs,
+                        std::memory_order_relaxed);
+  if (nLagNs > front.nLagMaxNs.load(std::memory_order_relaxed))
+    front.nLagMaxNs.store(nLagNs, std::memory_order_relaxed);
+  LatencyRecorder::Instance().Record(front.nLagMetric, nLagNs);
+}
+
+bool FeedArbiter::enqueue(const CThostFtdcDepthMarketDataField &tick) {
+  // 多个前置线程共用一个生产端，锁内只有一次拷贝
+  while (m_bQueueLock.exchange(true, std::memory_order_acquire))
+    CpuRelax();
+  bool bQueued = m_ring.TryPush(tick);
+  if (!bQueued)
+    bump(m_nDropped);
+  m_bQueueLock.store(false, std::memory_order_release);
+  return bQueued;
+}
+
+void FeedArbiter::run() {
+  while (m_bRunning.load(std::memory_order_acquire)) {
+    if (drain())
+      continue;
+    if (m_options.eWaitMode == MdWaitMode::Blocking)
+      waitForData();
+  }
+  // 退出前处理完剩余行情
+  drain();
+}
+
+bool FeedArbiter::drain() {
+  bool bAny = false;
+  while (const CThostFtdcDepthMarketDataField *pTick = m_ring.Front()) {
+    // CTP的SPI接口使用非const指针，处理期间槽位归转发线程独占
+    m_pHandler->OnRtnDepthMarketData(
+        const_cast<CThostFtdcDepthMarketDataField *>(pTick));
+    m_ring.Pop();
+    bump(m_nForwarded);
+    bAny = true;
+  }
+  return bAny;
+}
+
+void FeedArbiter::waitForData() {
+  for (int i = 0; i < m_options.nSpinCount; ++i) {
+    if (!m_ring.Empty())
+      return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_bSleeping.store(true, std::memory_order_seq_cst);
+  if (m_ring.Empty() && m_bRunning.load(std::memory_order_acquire)) {
+    // 超时仅作兜底，正常情况下由前置线程唤醒
+    m_cond.wait_for(lock, std::chrono::milliseconds(10));
+  }
+  m_bSleeping.store(false, std::memory_order_relaxed);
+}
+
+void FeedArbiter::Reset() {
+  for (std::size_t i = 0; i < m_nSlots; ++i) {
+    Slot &slot = m_pSlots[i];
+    while (slot.bLock.exchange(true, std::memory_order_acquire))
+      CpuRelax();
+    slot.nTradingDay = 0;
+    slot.nHighWater = 0;
+    slot.bLock.store(false, std::memory_order_release);
+  }
+}
+
+FeedFrontStats FeedArbiter::GetFrontStats(std::size_t nFront) const {
+  FeedFrontStats stats{};
+  if (nFront >= GetFrontCount())
+    return stats;
+  const Front &front = *m_fronts[nFront];
+  stats.strName = front.strName;
+  stats.bConnected = front.bConnected.load(std::memory_order_relaxed);
+  stats.bLoggedIn = front.bLoggedIn.load(std::memory_order_relaxed);
+  stats.nReceived = front.nReceived.load(std::memory_order_relaxed);
+  stats.nWins = front.nWins.load(std::memory_order_relaxed);
+  stats.nDuplicates = front.nDuplicates.load(std::memory_order_relaxed);
+  stats.nStale = front.nStale.load(std::memory_order_relaxed);
+  stats.nUnknown = front.nUnknown.load(std::memory_order_relaxed);
+  stats.nDisconnects = front.nDisconnects.load(std::memory_order_relaxed);
+
+  std::uint64_t nArbitrated = stats.nWins + stats.nDuplicates + stats.nStale;
+  stats.dWinRate =
+      nArbitrated ? static_cast<double>(stats.nWins) / nArbitrated : 0.0;
+  stats.nLagSamples = front.nLagSamples.load(std::memory_order_relaxed);
+  stats.dMeanLagNs =
+      stats.nLagSamples
+          ? static_cast<double>(
+                front.nLagSumNs.load(std::memory_order_relaxed)) /
+                stats.nLagSamples
+          : 0.0;
+  stats.nMaxLagNs = front.nLagMaxNs.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void FeedArbiter::login(Front &front) {
+  CThostFtdcReqUserLoginField req;
+  std::memset(&req, 0, sizeof(req));
+  std::strncpy(req.BrokerID, m_options.strBrokerID.c_str(),
+               sizeof(req.BrokerID) - 1);
+  std::strncpy(req.UserID, m_options.strUserID.c_str(),
+               sizeof(req.UserID) - 1);
+  std::strncpy(req.Password, m_options.strPassword.c_str(),
+               sizeof(req.Password) - 1);
+  int nRet = front.pApi->ReqUserLogin(&req, ++front.nRequestID);
+  if (nRet != 0)
+    CTP_LOG_ERROR("[Arbiter] %s login request failed: %d",
+                  front.strName.c_str(), nRet);
+}
+
+void FeedArbiter::subscribe(Front &front) {
+  if (m_options.vecInstruments.empty())
+    return;
+  std::vector<char *> instrumentIDs;
+  for (const auto &strInstrument : m_options.vecInstruments)
+    instrumentIDs.push_back(const_cast<char *>(strInstrument.c_str()));
+  int nRet = front.pApi->SubscribeMarketData(
+      instrumentIDs.data(), static_cast<int>(instrumentIDs.size()));
+  if (nRet != 0)
+    CTP_LOG_ERROR("[Arbiter] %s subscribe request failed: %d",
+                  front.strName.c_str(), nRet);
+}
+
+} // namespace ctp
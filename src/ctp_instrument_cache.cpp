@@ -0,0 +1,581 @@
+#include "ctp_instrument_cache.h"
+#include "ctp_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::size_t kCacheHeaderSize = 4096;
+
+std::size_t pageSize() {
+  static const std::size_t nPageSize =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return nPageSize;
+}
+
+std::size_t roundToPage(std::size_t nSize) {
+  return (nSize + pageSize() - 1) / pageSize() * pageSize();
+}
+
+std::uint32_t bucketCount(std::uint32_t nCapacity) {
+  // 装载率不超过1/2，nCapacity不超过kMaxInstrumentCacheCapacity
+  std::uint32_t nBuckets = 16;
+  while (nBuckets < nCapacity * 2u)
+    nBuckets <<= 1;
+  return nBuckets;
+}
+
+std::size_t bucketsSize(std::uint32_t nBuckets) {
+  return roundToPage(nBuckets * sizeof(std::uint64_t));
+}
+
+} // namespace
+
+InstrumentCache::InstrumentCache()
+    : m_pBase(nullptr), m_nMappedSize(0), m_pBuckets(nullptr),
+      m_pSlots(nullptr), m_nBucketMask(0), m_nCapacity(0),
+      m_nPendingRefresh(0) {}
+
+InstrumentCache::~InstrumentCache() { Close(); }
+
+std::string InstrumentCache::MakePath(const std::string &strDirectory,
+                                      const char *pszTradingDay) {
+  std::string strPath = strDirectory;
+  if (!strPath.empty() && strPath.back() != '/')
+    strPath += '/';
+  return strPath + "instruments_" + pszTradingDay + ".cache";
+}
+
+std::uint32_t InstrumentCache::hash(const char *pszInstrumentID) {
+  std::uint32_t nHash = 2166136261u;
+  for (std::size_t i = 0;
+       i < sizeof(TThostFtdcInstrumentIDType) && pszInstrumentID[i]; ++i) {
+    nHash ^= static_cast<unsigned char>(pszInstrumentID[i]);
+    nHash *= 16777619u;
+  }
+  return nHash;
+}
+
+bool InstrumentCache::Open(const std::string &strDirectory,
+                           const char *pszTradingDay,
+                           const InstrumentCacheOptions &options) {
+  Close();
+  if (!pszTradingDay || !pszTradingDay[0])
+    return false;
+
+  std::string strPath = MakePath(strDirectory, pszTradingDay);
+  if (openExisting(strPath, pszTradingDay)) {
+    CTP_LOG_INFO("[InstrumentCache] mapped %s, %zu instruments",
+                 strPath.c_str(), GetCount());
+    return true;
+  }
+  if (!create(strPath, pszTradingDay, options.nCapacity)) {
+    CTP_LOG_ERROR("[InstrumentCache] failed to create %s", strPath.c_str());
+    return false;
+  }
+  if (options.bSeedFromPrevious)
+    seed(strDirectory, pszTradingDay);
+  return true;
+}
+
+bool InstrumentCache::openExisting(const std::string &strPath,
+                                   const char *pszTradingDay) {
+  int fd = ::open(strPath.c_str(), O_RDWR);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  InstrumentCacheHeader header;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(kCacheHeaderSize) ||
+      ::pread(fd, &header, sizeof(header), 0) !=
+          static_cast<ssize_t>(sizeof(header))) {
+    ::close(fd);
+    return false;
+  }
+
+  // 版本、CTP结构体大小或交易日不符的文件视为无效，由调用方重建。
+  // 容量须先于bucketCount()检查，损坏的容量会使其溢出
+  bool bValid =
+      header.nMagic == kInstrumentCacheMagic &&
+      header.nVersion == kInstrumentCacheVersion &&
+      header.nHeaderSize == kCacheHeaderSize &&
+      header.nEntrySize == sizeof(InstrumentCacheEntry) &&
+      header.nSlotSize == sizeof(Slot) && header.nCapacity != 0 &&
+      header.nCapacity <= kMaxInstrumentCacheCapacity &&
+      header.nCount.load(std::memory_order_relaxed) <= header.nCapacity &&
+      header.nBuckets == bucketCount(header.nCapacity) &&
+      std::strncmp(header.szTradingDay, pszTradingDay,
+                   sizeof(header.szTradingDay)) == 0;
+  std::size_t nExpectedSize =
+      bValid ? kCacheHeaderSize + bucketsSize(header.nBuckets) +
+                   static_cast<std::size_t>(header.nCapacity) * sizeof(Slot)
+             : 0;
+  if (!bValid || static_cast<std::size_t>(st.st_size) < nExpectedSize) {
+    CTP_LOG_WARN("[InstrumentCache] %s is not a valid cache file for %s",
+                 strPath.c_str(), pszTradingDay);
+    ::close(fd);
+    return false;
+  }
+
+  bool bOk = map(fd, nExpectedSize);
+  ::close(fd);
+  if (bOk)
+    repair(strPath);
+  return bOk;
+}
+
+void InstrumentCache::repair(const std::string &strPath) {
+  // 写入槽位时进程退出会留下奇数的nSeq，读方将一直等待。
+  // 这类槽位的内容不完整，清空后把nSeq补为偶数，并把合约列表标记为未刷新，
+  // 由下一次Refresh()重新查询
+  InstrumentCacheHeader *pHeader = header();
+  std::size_t nRepaired = 0;
+  for (std::uint32_t i = 0; i < pHeader->nCount.load(); ++i) {
+    Slot &slot = m_pSlots[i];
+    std::uint64_t nSeq = slot.nSeq.load(std::memory_order_relaxed);
+    if (!(nSeq & 1))
+      continue;
+    for (std::size_t j = 0; j < kWords; ++j)
+      slot.nWords[j].store(0, std::memory_order_relaxed);
+    slot.nSeq.store(nSeq + 1, std::memory_order_release);
+    ++nRepaired;
+  }
+  if (nRepaired) {
+    pHeader->bInstrumentsComplete.store(0, std::memory_order_release);
+    CTP_LOG_WARN("[InstrumentCache] %s: cleared %zu partially written slots",
+                 strPath.c_str(), nRepaired);
+  }
+}
+
+bool InstrumentCache::create(const std::string &strPath,
+                             const char *pszTradingDay,
+                             std::uint32_t nCapacity) {
+  if (nCapacity == 0)
+    nCapacity = 1;
+  nCapacity = std::min(nCapacity, kMaxInstrumentCacheCapacity);
+  const std::uint32_t nBuckets = bucketCount(nCapacity);
+  const std::size_t nSize = kCacheHeaderSize + bucketsSize(nBuckets) +
+                            static_cast<std::size_t>(nCapacity) * sizeof(Slot);
+
+  InstrumentCacheHeader header;
+  std::memset(static_cast<void *>(&header), 0, sizeof(header));
+  header.nMagic = kInstrumentCacheMagic;
+  header.nVersion = kInstrumentCacheVersion;
+  header.nHeaderSize = static_cast<std::uint32_t>(kCacheHeaderSize);
+  header.nEntrySize = sizeof(InstrumentCacheEntry);
+  header.nSlotSize = sizeof(Slot);
+  header.nCapacity = nCapacity;
+  header.nBuckets = nBuckets;
+  std::strncpy(header.szTradingDay, pszTradingDay,
+               sizeof(header.szTradingDay) - 1);
+
+  int fd = ::open(strPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  // 文件保持稀疏，只有写入过的页才占用磁盘
+  bool bOk = ::ftruncate(fd, static_cast<off_t>(nSize)) == 0 &&
+             ::pwrite(fd, &header, sizeof(header), 0) ==
+                 static_cast<ssize_t>(sizeof(header)) &&
+             map(fd, nSize);
+  ::close(fd);
+  return bOk;
+}
+
+bool InstrumentCache::map(int fd, std::size_t nSize) {
+  void *pMapped =
+      ::mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  m_pBase = static_cast<char *>(pMapped);
+  m_nMappedSize = nSize;
+  const InstrumentCacheHeader *pHeader = header();
+  m_nCapacity = pHeader->nCapacity;
+  m_nBucketMask = pHeader->nBuckets - 1;
+  m_pBuckets = reinterpret_cast<Bucket *>(m_pBase + kCacheHeaderSize);
+  m_pSlots = reinterpret_cast<Slot *>(m_pBase + kCacheHeaderSize +
+                                      bucketsSize(pHeader->nBuckets));
+  // 提前读入已使用的部分，第一次查询时不再缺页
+  std::size_t nUsed =
+      reinterpret_cast<char *>(m_pSlots + pHeader->nCount.load()) - m_pBase;
+  ::madvise(m_pBase, std::min(roundToPage(nUsed), m_nMappedSize),
+            MADV_WILLNEED);
+  return true;
+}
+
+void InstrumentCache::Close() {
+  if (m_pBase) {
+    Flush(true);
+    ::munmap(m_pBase, m_nMappedSize);
+    m_pBase = nullptr;
+  }
+  m_nMappedSize = 0;
+  m_pBuckets = nullptr;
+  m_pSlots = nullptr;
+  m_nBucketMask = 0;
+  m_nCapacity = 0;
+}
+
+void InstrumentCache::Flush(bool bWait) {
+  if (m_pBase)
+    ::msync(m_pBase, m_nMappedSize, bWait ? MS_SYNC : MS_ASYNC);
+}
+
+const char *InstrumentCache::GetTradingDay() const {
+  return m_pBase ? header()->szTradingDay : "";
+}
+
+std::size_t InstrumentCache::GetCount() const {
+  return m_pBase ? header()->nCount.load(std::memory_order_acquire) : 0;
+}
+
+bool InstrumentCache::IsInstrumentListFresh() const {
+  return m_pBase &&
+         header()->bInstrumentsComplete.load(std::memory_order_acquire) != 0;
+}
+
+std::int64_t InstrumentCache::findSlot(const char *pszInstrumentID) const {
+  const std::uint32_t nHash = hash(pszInstrumentID);
+  for (std::uint32_t i = nHash & m_nBucketMask;; i = (i + 1) & m_nBucketMask) {
+    const Bucket &bucket = m_pBuckets[i];
+    std::uint32_t nSlot = bucket.nSlot.load(std::memory_order_acquire);
+    if (nSlot == 0)
+      return -1;
+    if (bucket.nHash == nHash &&
+        std::strncmp(m_pSlots[nSlot - 1].szInstrumentID, pszInstrumentID,
+                     sizeof(TThostFtdcInstrumentIDType)) == 0)
+      return nSlot - 1;
+  }
+}
+
+std::int64_t InstrumentCache::insertSlot(const char *pszInstrumentID) {
+  std::int64_t nFound = findSlot(pszInstrumentID);
+  if (nFound >= 0)
+    return nFound;
+
+  InstrumentCacheHeader *pHeader = header();
+  const std::uint32_t nCount = pHeader->nCount.load(std::memory_order_relaxed);
+  if (nCount >= m_nCapacity)
+    return -1;
+
+  // 先写好槽位和桶的哈希值，再以release发布下标
+  Slot &slot = m_pSlots[nCount];
+  std::strncpy(slot.szInstrumentID, pszInstrumentID,
+               sizeof(slot.szInstrumentID) - 1);
+  const std::uint32_t nHash = hash(pszInstrumentID);
+  std::uint32_t i = nHash & m_nBucketMask;
+  while (m_pBuckets[i].nSlot.load(std::memory_order_relaxed) != 0)
+    i = (i + 1) & m_nBucketMask;
+  m_pBuckets[i].nHash = nHash;
+  m_pBuckets[i].nSlot.store(nCount + 1, std::memory_order_release);
+  pHeader->nCount.store(nCount + 1, std::memory_order_release);
+  return nCount;
+}
+
+void InstrumentCache::readSlot(const Slot &slot,
+                               InstrumentCacheEntry &entry) const {
+  std::uint64_t nWords[kWords];
+  for (;;) {
+    std::uint64_t nBegin = slot.nSeq.load(std::memory_order_acquire);
+    if (nBegin & 1) {
+      CpuRelax();
+      continue;
+    }
+    for (std::size_t i = 0; i < kWords; ++i)
+      nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.nSeq.load(std::memory_order_relaxed) == nBegin)
+      break;
+  }
+  std::memcpy(static_cast<void *>(&entry), nWords, sizeof(entry));
+}
+
+void InstrumentCache::writeSlot(Slot &slot, const InstrumentCacheEntry &entry) {
+  const std::uint64_t nSeq = slot.nSeq.load(std::memory_order_relaxed);
+  slot.nSeq.store(nSeq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::uint64_t nWords[kWords] = {};
+  std::memcpy(nWords, &entry, sizeof(entry));
+  for (std::size_t i = 0; i < kWords; ++i)
+    slot.nWords[i].store(nWords[i], std::memory_order_relaxed);
+
+  slot.nSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+bool InstrumentCache::Find(const char *pszInstrumentID,
+                           InstrumentCacheEntry &entry) const {
+  if (!m_pBase || !pszInstrumentID)
+    return false;
+  std::int64_t nSlot = findSlot(pszInstrumentID);
+  if (nSlot < 0)
+    return false;
+  readSlot(m_pSlots[nSlot], entry);
+  return entry.nFlags != 0;
+}
+
+bool InstrumentCache::GetEntry(std::size_t nIndex,
+                               InstrumentCacheEntry &entry) const {
+  if (nIndex >= GetCount())
+    return false;
+  readSlot(m_pSlots[nIndex], entry);
+  return entry.nFlags != 0;
+}
+
+bool InstrumentCache::UpdateInstrument(
+    const CThostFtdcInstrumentField &instrument) {
+  std::lock_guard<std::mutex> lock(m_writeMutex);
+  return update(instrument.InstrumentID, kCacheHasInstrument, &instrument);
+}
+
+bool InstrumentCache::UpdateCommissionRate(
+    const char *pszInstrumentID,
+    const CThostFtdcInstrumentCommissionRateField &rate) {
+  std::lock_guard<std::mutex> lock(m_writeMutex);
+  return update(pszInstrumentID, kCacheHasCommissionRate, &rate);
+}
+
+bool InstrumentCache::UpdateMarginRate(
+    const char *pszInstrumentID,
+    const CThostFtdcInstrumentMarginRateField &rate) {
+  std::lock_guard<std::mutex> lock(m_writeMutex);
+  return update(pszInstrumentID, kCacheHasMarginRate, &rate);
+}
+
+bool InstrumentCache::update(const char *pszInstrumentID, std::uint32_t nFlag,
+                             const void *pField) {
+  if (!m_pBase || !pszInstrumentID || !pszInstrumentID[0])
+    return false;
+  std::int64_t nSlot = insertSlot(pszInstrumentID);
+  if (nSlot < 0) {
+    CTP_LOG_WARN("[InstrumentCache] cache full, %s not stored",
+                 pszInstrumentID);
+    return false;
+  }
+
+  // 只有一个写入方，可直接读取当前内容再整体覆盖
+  Slot &slot = m_pSlots[nSlot];
+  InstrumentCacheEntry entry;
+  readSlot(slot, entry);
+  // pField为空表示前置没有返回该字段，只标记为已刷新，避免反复查询
+  if (pField) {
+    switch (nFlag) {
+    case kCacheHasInstrument:
+      std::memcpy(&entry.instrument, pField, sizeof(entry.instrument));
+      break;
+    case kCacheHasCommissionRate:
+      std::memcpy(&entry.commissionRate, pField,
+                  sizeof(entry.commissionRate));
+      break;
+    case kCacheHasMarginRate:
+      std::memcpy(&entry.marginRate, pField, sizeof(entry.marginRate));
+      break;
+    default:
+      return false;
+    }
+    entry.nFlags |= nFlag;
+  }
+  entry.nFreshFlags |= nFlag;
+  writeSlot(slot, entry);
+  return true;
+}
+
+void InstrumentCache::seed(const std::string &strDirectory,
+                           const char *pszTradingDay) {
+  // 找到目录中早于当前交易日的最近一个缓存文件
+  DIR *pDir = ::opendir(strDirectory.empty() ? "." : strDirectory.c_str());
+  if (!pDir)
+    return;
+  std::string strPrevious;
+  const std::size_t nPrefix = std::strlen("instruments_");
+  while (struct dirent *pEntry = ::readdir(pDir)) {
+    const char *pszName = pEntry->d_name;
+    if (std::strlen(pszName) != nPrefix + 8 + std::strlen(".cache") ||
+        std::strncmp(pszName, "instruments_", nPrefix) != 0 ||
+        std::strcmp(pszName + nPrefix + 8, ".cache") != 0)
+      continue;
+    std::string strDay(pszName + nPrefix, 8);
+    if (strDay < pszTradingDay && strDay > strPrevious)
+      strPrevious = strDay;
+  }
+  ::closedir(pDir);
+  if (strPrevious.empty())
+    return;
+
+  InstrumentCache previous;
+  if (!previous.openExisting(MakePath(strDirectory, strPrevious.c_str()),
+                             strPrevious.c_str()))
+    return;
+
+  std::lock_guard<std::mutex> lock(m_writeMutex);
+  std::size_t nSeeded = 0, nExpired = 0;
+  InstrumentCacheEntry entry;
+  for (std::size_t i = 0; i < previous.GetCount(); ++i) {
+    if (!previous.GetEntry(i, entry))
+      continue;
+    // 已到期的合约不再带入新交易日
+    if ((entry.nFlags & kCacheHasInstrument) &&
+        entry.instrument.ExpireDate[0] &&
+        std::strncmp(entry.instrument.ExpireDate, pszTradingDay,
+                     sizeof(entry.instrument.ExpireDate)) < 0) {
+      ++nExpired;
+      continue;
+    }
+    std::int64_t nSlot = insertSlot(previous.m_pSlots[i].szInstrumentID);
+    if (nSlot < 0)
+      break;
+    entry.nFreshFlags = 0;
+    writeSlot(m_pSlots[nSlot], entry);
+    ++nSeeded;
+  }
+  CTP_LOG_INFO("[InstrumentCache] seeded %zu instruments from %s "
+               "(%zu expired)",
+               nSeeded, strPrevious.c_str(), nExpired);
+}
+
+void InstrumentCache::Refresh(QueryScheduler &scheduler,
+                              const InstrumentCacheRefreshOptions &options) {
+  if (!m_pBase)
+    return;
+  if (IsInstrumentListFresh()) {
+    if (options.bQueryRates)
+      refreshRates(scheduler, options);
+    return;
+  }
+
+  // 先刷新合约列表，新出现的合约随后一并查询费率
+  m_nPendingRefresh.fetch_add(1, std::memory_order_acq_rel);
+  CThostFtdcQryInstrumentField req;
+  std::memset(&req, 0, sizeof(req));
+  scheduler.Submit(
+      req, options.ePriority,
+      [this, &scheduler,
+       options](const std::vector<CThostFtdcInstrumentField> &results,
+                const CThostFtdcRspInfoField &rspInfo) {
+        if (rspInfo.ErrorID == 0) {
+          {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            for (const auto &instrument : results)
+              update(instrument.InstrumentID, kCacheHasInstrument,
+                     &instrument);
+            if (m_pBase)
+              header()->bInstrumentsComplete.store(1,
+                                                   std::memory_order_release);
+          }
+          CTP_LOG_INFO("[InstrumentCache] refreshed %zu instruments",
+                       results.size());
+        } else {
+          CTP_LOG_ERROR("[InstrumentCache] ReqQryInstrument failed, "
+                        "ErrorID: %d, ErrorMsg: %s",
+                        rspInfo.ErrorID, rspInfo.ErrorMsg);
+        }
+        if (options.bQueryRates)
+          refreshRates(scheduler, options);
+        finishRefresh();
+      });
+}
+
+void InstrumentCache::refreshRates(
+    QueryScheduler &scheduler, const InstrumentCacheRefreshOptions &options) {
+  std::vector<std::string> vecCommission, vecMargin;
+  InstrumentCacheEntry entry;
+  auto collect = [&](const char *pszInstrumentID, std::int64_t nSlot) {
+    if (nSlot >= 0)
+      readSlot(m_pSlots[nSlot], entry);
+    else
+      std::memset(static_cast<void *>(&entry), 0, sizeof(entry));
+    if (!(entry.nFreshFlags & kCacheHasCommissionRate))
+      vecCommission.emplace_back(pszInstrumentID);
+    if (!(entry.nFreshFlags & kCacheHasMarginRate))
+      vecMargin.emplace_back(pszInstrumentID);
+  };
+  if (options.vecRateInstruments.empty()) {
+    for (std::size_t i = 0; i < GetCount(); ++i)
+      collect(m_pSlots[i].szInstrumentID, static_cast<std::int64_t>(i));
+  } else {
+    for (const auto &strInstrumentID : options.vecRateInstruments)
+      collect(strInstrumentID.c_str(), findSlot(strInstrumentID.c_str()));
+  }
+  if (vecCommission.empty() && vecMargin.empty())
+    return;
+  CTP_LOG_INFO("[InstrumentCache] querying %zu commission and %zu margin "
+               "rates",
+               vecCommission.size(), vecMargin.size());
+
+  m_nPendingRefresh.fetch_add(vecCommission.size() + vecMargin.size(),
+                              std::memory_order_acq_rel);
+  for (const auto &strInstrumentID : vecCommission) {
+    CThostFtdcQryInstrumentCommissionRateField req;
+    std::memset(&req, 0, sizeof(req));
+    std::strncpy(req.BrokerID, options.strBrokerID.c_str(),
+                 sizeof(req.BrokerID) - 1);
+    std::strncpy(req.InvestorID, options.strInvestorID.c_str(),
+                 sizeof(req.InvestorID) - 1);
+    std::strncpy(req.InstrumentID, strInstrumentID.c_str(),
+                 sizeof(req.InstrumentID) - 1);
+    scheduler.Submit(
+        req, options.ePriority,
+        [this, strInstrumentID](
+            const std::vector<CThostFtdcInstrumentCommissionRateField> &results,
+            const CThostFtdcRspInfoField &rspInfo) {
+          if (rspInfo.ErrorID == 0) {
+            // 前置可能按品种返回（InstrumentID为品种代码），优先取完全匹配的
+            const CThostFtdcInstrumentCommissionRateField *pRate = nullptr;
+            for (const auto &rate : results) {
+              if (!pRate || strInstrumentID == rate.InstrumentID)
+                pRate = &rate;
+            }
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            update(strInstrumentID.c_str(), kCacheHasCommissionRate, pRate);
+          }
+          finishRefresh();
+        });
+  }
+  for (const auto &strInstrumentID : vecMargin) {
+    CThostFtdcQryInstrumentMarginRateField req;
+    std::memset(&req, 0, sizeof(req));
+    std::strncpy(req.BrokerID, options.strBrokerID.c_str(),
+                 sizeof(req.BrokerID) - 1);
+    std::strncpy(req.InvestorID, options.strInvestorID.c_str(),
+                 sizeof(req.InvestorID) - 1);
+    std::strncpy(req.InstrumentID, strInstrumentID.c_str(),
+                 sizeof(req.InstrumentID) - 1);
+    req.HedgeFlag = options.chHedgeFlag;
+    scheduler.Submit(
+        req, options.ePriority,
+        [this, strInstrumentID](
+            const std::vector<CThostFtdcInstrumentMarginRateField> &results,
+            const CThostFtdcRspInfoField &rspInfo) {
+          if (rspInfo.ErrorID == 0) {
+            const CThostFtdcInstrumentMarginRateField *pRate = nullptr;
+            for (const auto &rate : results) {
+              if (!pRate || strInstrumentID == rate.InstrumentID)
+                pRate = &rate;
+            }
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            update(strInstrumentID.c_str(), kCacheHasMarginRate, pRate);
+          }
+          finishRefresh();
+        });
+  }
+}
+
+void InstrumentCache::finishRefresh() {
+  if (m_nPendingRefresh.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    Flush(false);
+    CTP_LOG_INFO("[InstrumentCache] refresh complete, %zu instruments",
+                 GetCount());
+  }
+}
+
+} // namespace ctp
@@ -0,0 +1,54 @@
+#include "ctp_instrument_table.h"
+
+namespace ctp {
+
+InstrumentTable::InstrumentTable(std::size_t nMaxInstruments)
+    : m_nMaxInstruments(nMaxInstruments), m_nBucketMask(0) {
+  // 装载因子不超过0.5，保证线性探测的平均探测长度接近1
+  std::size_t nBuckets = 16;
+  while (nBuckets < nMaxInstruments * 2)
+    nBuckets <<= 1;
+  m_nBucketMask = nBuckets - 1;
+  m_buckets.assign(nBuckets, Bucket{0, kInvalidInstrument});
+  m_instruments.reserve(nMaxInstruments);
+}
+
+std::uint32_t InstrumentTable::Add(const char *pszInstrumentID,
+                                   double dPriceTick) {
+  std::uint32_t nHash = hash(pszInstrumentID);
+  std::size_t i = nHash & m_nBucketMask;
+  for (;; i = (i + 1) & m_nBucketMask) {
+    const Bucket &bucket = m_buckets[i];
+    if (bucket.nIndex == kInvalidInstrument)
+      break;
+    if (bucket.nHash == nHash &&
+        std::strncmp(m_instruments[bucket.nIndex].szInstrumentID,
+                     pszInstrumentID, sizeof(TThostFtdcInstrumentIDType)) == 0) {
+      if (dPriceTick > 0)
+        SetPriceTick(bucket.nIndex, dPriceTick);
+      return bucket.nIndex;
+    }
+  }
+
+  if (m_instruments.size() >= m_nMaxInstruments)
+    return kInvalidInstrument;
+
+  Instrument instrument = {};
+  std::strncpy(instrument.szInstrumentID, pszInstrumentID,
+               sizeof(instrument.szInstrumentID) - 1);
+  std::uint32_t nIndex = static_cast<std::uint32_t>(m_instruments.size());
+  m_instruments.push_back(instrument);
+  SetPriceTick(nIndex, dPriceTick);
+
+  m_buckets[i].nHash = nHash;
+  m_buckets[i].nIndex = nIndex;
+  return nIndex;
+}
+
+void InstrumentTable::SetPriceTick(std::uint32_t nIndex, double dPriceTick) {
+  Instrument &instrument = m_instruments[nIndex];
+  instrument.dPriceTick = dPriceTick;
+  instrument.dInvPriceTick = dPriceTick > 0 ? 1.0 / dPriceTick : 0.0;
+}
+
+} // namespace ctp
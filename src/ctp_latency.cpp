@@ -0,0 +1,423 @@
+#include "ctp_latency.h"
+#include "ThostFtdcUserApiDataType.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <new>
+
+namespace ctp {
+
+namespace {
+
+std::int64_t wallNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::int64_t steadyNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void localTime(std::time_t nSeconds, std::tm &tmLocal) {
+#if defined(_WIN32)
+  localtime_s(&tmLocal, &nSeconds);
+#else
+  localtime_r(&nSeconds, &tmLocal);
+#endif
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TscClock
+
+TscClock &TscClock::Instance() {
+  static TscClock clock;
+  return clock;
+}
+
+TscClock::TscClock() : m_dNsPerTick(1.0), m_nAnchorTsc(0), m_nAnchorWallNs(0) {
+  std::int64_t nSteadyBegin = steadyNs();
+  std::uint64_t nTscBegin = ReadTsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  std::int64_t nSteadyEnd = steadyNs();
+  std::uint64_t nTscEnd = ReadTsc();
+  if (nTscEnd > nTscBegin && nSteadyEnd > nSteadyBegin)
+    m_dNsPerTick = static_cast<double>(nSteadyEnd - nSteadyBegin) /
+                   static_cast<double>(nTscEnd - nTscBegin);
+
+  m_nAnchorWallNs = wallNs();
+  m_nAnchorTsc = ReadTsc();
+}
+
+// ---------------------------------------------------------------------------
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts(kBucketCount, 0), m_nCount(0), m_nSum(0),
+      m_nMin(~std::uint64_t(0)), m_nMax(0) {}
+
+void LatencyHistogram::Record(std::uint64_t nValue, std::uint64_t nCount) {
+  if (nCount == 0)
+    return;
+  m_counts[BucketOf(nValue)] += nCount;
+  m_nCount += nCount;
+  m_nSum += nValue * nCount;
+  if (nValue < m_nMin)
+    m_nMin = nValue;
+  if (nValue > m_nMax)
+    m_nMax = nValue;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (std::size_t i = 0; i < kBucketCount; ++i)
+    m_counts[i] += other.m_counts[i];
+  m_nCount += other.m_nCount;
+  m_nSum += other.m_nSum;
+  if (other.m_nCount && other.m_nMin < m_nMin)
+    m_nMin = other.m_nMin;
+  if (other.m_nMax > m_nMax)
+    m_nMax = other.m_nMax;
+}
+
+void LatencyHistogram::Subtract(const LatencyHistogram &other) {
+  m_nCount = 0;
+  m_nMin = ~std::uint64_t(0);
+  m_nMax = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    m_counts[i] =
+        m_counts[i] > other.m_counts[i] ? m_counts[i] - other.m_counts[i] : 0;
+    if (m_counts[i] == 0)
+      continue;
+    // 区间内的极值只能精确到桶
+    std::uint64_t nUpper = BucketUpperBound(i);
+    std::uint64_t nLower = i == 0 ? 0 : BucketUpperBound(i - 1) + 1;
+    if (m_nCount == 0)
+      m_nMin = nLower;
+    m_nMax = nUpper;
+    m_nCount += m_counts[i];
+  }
+  m_nSum = m_nSum > other.m_nSum ? m_nSum - other.m_nSum : 0;
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(m_counts.begin(), m_counts.end(), 0);
+  m_nCount = 0;
+  m_nSum = 0;
+  m_nMin = ~std::uint64_t(0);
+  m_nMax = 0;
+}
+
+std::uint64_t LatencyHistogram::GetPercentile(double dPercentile) const {
+  if (m_nCount == 0)
+    return 0;
+  std::uint64_t nRank =
+      static_cast<std::uint64_t>(dPercentile / 100.0 * m_nCount + 0.5);
+  if (nRank < 1)
+    nRank = 1;
+  std::uint64_t nSeen = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    nSeen += m_counts[i];
+    if (nSeen >= nRank) {
+      std::uint64_t nUpper = BucketUpperBound(i);
+      return nUpper < m_nMax ? nUpper : m_nMax;
+    }
+  }
+  return m_nMax;
+}
+
+std::uint64_t LatencyHistogram::BucketUpperBound(std::size_t nBucket) {
+  if (nBucket < (2u << kSubBucketBits))
+    return nBucket;
+  int nShift = static_cast<int>(nBucket >> kSubBucketBits) - 1;
+  std::uint64_t nMantissa = nBucket - (static_cast<std::size_t>(nShift)
+                                       << kSubBucketBits);
+  return ((nMantissa + 1) << nShift) - 1;
+}
+
+// ---------------------------------------------------------------------------
+// LatencyRecorder
+
+thread_local LatencyRecorder::Shard *LatencyRecorder::t_pShard = nullptr;
+
+LatencyRecorder::Shard::Shard() {
+  for (auto &pHistogram : histograms)
+    pHistogram.store(nullptr, std::memory_order_relaxed);
+}
+
+LatencyRecorder::Shard::~Shard() {
+  for (auto &pHistogram : histograms) {
+    Histogram *p = pHistogram.load(std::memory_order_relaxed);
+    if (p) {
+      p->~Histogram();
+      ::operator delete(p, std::align_val_t(kCacheLineSize));
+    }
+  }
+}
+
+LatencyRecorder::Histogram *LatencyRecorder::Shard::allocate(int nMetric) {
+  void *p = ::operator new(sizeof(Histogram),
+                           std::align_val_t(kCacheLineSize));
+  // 预先触页
+  std::memset(p, 0, sizeof(Histogram));
+  Histogram *pHistogram = new (p) Histogram;
+  for (auto &nCount : pHistogram->nCounts)
+    nCount.store(0, std::memory_order_relaxed);
+  pHistogram->nSum.store(0, std::memory_order_relaxed);
+  pHistogram->nMin.store(~std::uint64_t(0), std::memory_order_relaxed);
+  pHistogram->nMax.store(0, std::memory_order_relaxed);
+  histograms[nMetric].store(pHistogram, std::memory_order_release);
+  return pHistogram;
+}
+
+LatencyRecorder &LatencyRecorder::Instance() {
+  static LatencyRecorder recorder;
+  return recorder;
+}
+
+LatencyRecorder::LatencyRecorder() : m_nMetrics(0), m_bRunning(false) {
+  std::memset(m_szNames, 0, sizeof(m_szNames));
+}
+
+LatencyRecorder::~LatencyRecorder() { Stop(); }
+
+int LatencyRecorder::Register(const char *pszName) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int nMetrics = m_nMetrics.load(std::memory_order_relaxed);
+  for (int i = 0; i < nMetrics; ++i)
+    if (std::strncmp(m_szNames[i], pszName, sizeof(m_szNames[i]) - 1) == 0)
+      return i;
+  if (nMetrics == kMaxLatencyMetrics)
+    return kInvalidLatencyMetric;
+  std::strncpy(m_szNames[nMetrics], pszName, sizeof(m_szNames[nMetrics]) - 1);
+  m_nMetrics.store(nMetrics + 1, std::memory_order_release);
+  return nMetrics;
+}
+
+const char *LatencyRecorder::GetMetricName(int nMetric) const {
+  if (nMetric < 0 || nMetric >= GetMetricCount())
+    return "";
+  return m_szNames[nMetric];
+}
+
+LatencyRecorder::Shard *LatencyRecorder::registerThread() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shards.emplace_back(new Shard);
+  t_pShard = m_shards.back().get();
+  return t_pShard;
+}
+
+void LatencyRecorder::Snapshot(int nMetric,
+                               LatencyHistogram &histogram) const {
+  histogram.Reset();
+  if (nMetric < 0 || nMetric >= kMaxLatencyMetrics)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto &pShard : m_shards) {
+    const Histogram *p =
+        pShard->histograms[nMetric].load(std::memory_order_acquire);
+    if (!p)
+      continue;
+    for (std::size_t i = 0; i < LatencyHistogram::kBucketCount; ++i)
+      histogram.m_counts[i] += p->nCounts[i].load(std::memory_order_relaxed);
+    histogram.m_nSum += p->nSum.load(std::memory_order_relaxed);
+    std::uint64_t nMin = p->nMin.load(std::memory_order_relaxed);
+    std::uint64_t nMax = p->nMax.load(std::memory_order_relaxed);
+    if (nMin < histogram.m_nMin)
+      histogram.m_nMin = nMin;
+    if (nMax > histogram.m_nMax)
+      histogram.m_nMax = nMax;
+  }
+  // 以桶计数之和为准，避免与并发更新的nCount不一致
+  for (std::size_t i = 0; i < LatencyHistogram::kBucketCount; ++i)
+    histogram.m_nCount += histogram.m_counts[i];
+}
+
+void LatencyRecorder::Dump(std::FILE *pFile) const {
+  std::vector<LatencyHistogram> histograms(GetMetricCount());
+  for (std::size_t i = 0; i < histograms.size(); ++i)
+    Snapshot(static_cast<int>(i), histograms[i]);
+  write(pFile, "total", histograms);
+}
+
+bool LatencyRecorder::Start(const LatencyRecorderOptions &options) {
+  std::lock_guard<std::mutex> lock(m_stopMutex);
+  if (m_bRunning)
+    return true;
+  if (options.strFile.empty())
+    return false;
+
+  std::error_code ec;
+  std::filesystem::path path(options.strFile);
+  if (path.has_parent_path())
+    std::filesystem::create_directories(path.parent_path(), ec);
+  if (ec)
+    return false;
+
+  // 提前完成校准，避免在记录线程上等待
+  TscClock::Instance();
+  m_options = options;
+  m_bRunning = true;
+  m_thread = std::thread(&LatencyRecorder::run, this);
+  return true;
+}
+
+void LatencyRecorder::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_stopMutex);
+    if (!m_bRunning)
+      return;
+    m_bRunning = false;
+  }
+  m_stopCond.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void LatencyRecorder::run() {
+  std::vector<LatencyHistogram> previous;
+  std::vector<LatencyHistogram> current;
+  bool bRunning = true;
+  while (bRunning) {
+    {
+      std::unique_lock<std::mutex> lock(m_stopMutex);
+      m_stopCond.wait_for(lock,
+                          std::chrono::milliseconds(m_options.nIntervalMs),
+                          [this]() { return !m_bRunning; });
+      bRunning = m_bRunning;
+    }
+
+    current.resize(GetMetricCount());
+    previous.resize(current.size());
+    for (std::size_t i = 0; i < current.size(); ++i)
+      Snapshot(static_cast<int>(i), current[i]);
+
+    std::FILE *pFile = std::fopen(m_options.strFile.c_str(), "a");
+    if (!pFile)
+      continue;
+    // 本周期 = 当前快照 - 上一周期的快照
+    std::vector<LatencyHistogram> interval(current);
+    for (std::size_t i = 0; i < interval.size(); ++i)
+      interval[i].Subtract(previous[i]);
+    write(pFile, "interval", interval);
+    if (!bRunning)
+      write(pFile, "total", current);
+    std::fclose(pFile);
+    previous.swap(current);
+  }
+}
+
+void LatencyRecorder::write(
+    std::FILE *pFile, const char *pszTitle,
+    const std::vector<LatencyHistogram> &histograms) const {
+  std::int64_t nNow = wallNs();
+  std::tm tmLocal;
+  localTime(static_cast<std::time_t>(nNow / 1000000000), tmLocal);
+  std::fprintf(pFile,
+               "# %04d-%02d-%02d %02d:%02d:%02d.%03d %s (us)\n"
+               "%-32s %12s %10s %10s %10s %10s %10s %10s %10s\n",
+               tmLocal.tm_year + 1900, tmLocal.tm_mon + 1, tmLocal.tm_mday,
+               tmLocal.tm_hour, tmLocal.tm_min, tmLocal.tm_sec,
+               static_cast<int>(nNow / 1000000 % 1000), pszTitle, "metric",
+               "count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+  for (std::size_t i = 0; i < histograms.size(); ++i) {
+    const LatencyHistogram &h = histograms[i];
+    std::fprintf(pFile,
+                 "%-32s %12llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f "
+                 "%10.1f\n",
+                 GetMetricName(static_cast<int>(i)),
+                 static_cast<unsigned long long>(h.GetCount()),
+                 h.GetMin() / 1000.0, h.GetPercentile(50) / 1000.0,
+                 h.GetPercentile(90) / 1000.0, h.GetPercentile(99) / 1000.0,
+                 h.GetPercentile(99.9) / 1000.0, h.GetMax() / 1000.0,
+                 h.GetMean() / 1000.0);
+  }
+  std::fflush(pFile);
+}
+
+// ---------------------------------------------------------------------------
+// OrderLatencyTracker
+
+OrderLatencyTracker::OrderLatencyTracker(std::size_t nCapacity)
+    : m_nMask(0), m_pSlots(nullptr), m_nFrontID(0), m_nSessionID(0) {
+  std::size_t nSlots = 16;
+  while (nSlots < nCapacity)
+    nSlots <<= 1;
+  m_nMask = nSlots - 1;
+
+  std::size_t nBytes = sizeof(Slot) * nSlots;
+  m_pSlots = static_cast<Slot *>(
+      ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+  std::memset(static_cast<void *>(m_pSlots), 0, nBytes);
+
+  LatencyRecorder &recorder = LatencyRecorder::Instance();
+  m_nInsertToOrder = recorder.Register("order.insert_to_rtn_order");
+  m_nInsertToTrade = recorder.Register("order.insert_to_rtn_trade");
+}
+
+OrderLatencyTracker::~OrderLatencyTracker() {
+  ::operator delete(m_pSlots, std::align_val_t(kCacheLineSize));
+}
+
+void OrderLatencyTracker::OnInsert(const char *pszOrderRef) {
+  std::uint64_t nOrderRef = parseOrderRef(pszOrderRef);
+  if (nOrderRef == 0)
+    return;
+  Slot &slot = m_pSlots[nOrderRef & m_nMask];
+  slot.nOrderRef.store(0, std::memory_order_relaxed);
+  slot.bOrderSeen.store(false, std::memory_order_relaxed);
+  slot.bTradeSeen.store(false, std::memory_order_relaxed);
+  slot.nInsertTsc.store(ReadTsc(), std::memory_order_relaxed);
+  slot.nOrderRef.store(nOrderRef, std::memory_order_release);
+}
+
+void OrderLatencyTracker::OnRtnOrder(int nFrontID, int nSessionID,
+                                     const char *pszOrderRef) {
+  std::uint64_t nNow = ReadTsc();
+  if (nFrontID != m_nFrontID.load(std::memory_order_relaxed) ||
+      nSessionID != m_nSessionID.load(std::memory_order_relaxed))
+    return;
+  Slot *pSlot = find(parseOrderRef(pszOrderRef));
+  if (pSlot && !pSlot->bOrderSeen.exchange(true, std::memory_order_relaxed))
+    LatencyRecorder::Instance().RecordTsc(
+        m_nInsertToOrder,
+        pSlot->nInsertTsc.load(std::memory_order_relaxed), nNow);
+}
+
+void OrderLatencyTracker::OnRtnTrade(const char *pszOrderRef) {
+  std::uint64_t nNow = ReadTsc();
+  Slot *pSlot = find(parseOrderRef(pszOrderRef));
+  if (pSlot && !pSlot->bTradeSeen.exchange(true, std::memory_order_relaxed))
+    LatencyRecorder::Instance().RecordTsc(
+        m_nInsertToTrade,
+        pSlot->nInsertTsc.load(std::memory_order_relaxed), nNow);
+}
+
+OrderLatencyTracker::Slot *
+OrderLatencyTracker::find(std::uint64_t nOrderRef) const {
+  if (nOrderRef == 0)
+    return nullptr;
+  Slot &slot = m_pSlots[nOrderRef & m_nMask];
+  return slot.nOrderRef.load(std::memory_order_acquire) == nOrderRef ? &slot
+                                                                     : nullptr;
+}
+
+std::uint64_t OrderLatencyTracker::parseOrderRef(const char *pszOrderRef) {
+  std::uint64_t nOrderRef = 0;
+  for (std::size_t i = 0;
+       i < sizeof(TThostFtdcOrderRefType) && pszOrderRef[i]; ++i) {
+    char c = pszOrderRef[i];
+    if (c >= '0' && c <= '9')
+      nOrderRef = nOrderRef * 10 + static_cast<std::uint64_t>(c - '0');
+  }
+  return nOrderRef;
+}
+
+} // namespace ctp
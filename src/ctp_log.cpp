@@ -0,0 +1,292 @@
+#include "ctp_log.h"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ctp {
+
+namespace detail {
+
+LogBuffer::LogBuffer(std::size_t nSize, std::uint32_t nThreadID)
+    : bRetired(false), m_nWritePos(0), m_nCachedReadPos(0), m_nPendingPos(0),
+      m_bWriting(false), m_nReadPos(0), m_pData(nullptr), m_nSize(1024),
+      m_nMask(0), m_nThreadID(nThreadID) {
+  while (m_nSize < nSize)
+    m_nSize <<= 1;
+  m_nMask = m_nSize - 1;
+  m_pData = static_cast<char *>(::operator new(m_nSize, std::align_val_t(64)));
+  std::memset(m_pData, 0, m_nSize);
+}
+
+LogBuffer::~LogBuffer() { ::operator delete(m_pData, std::align_val_t(64)); }
+
+} // namespace detail
+
+namespace {
+
+const char *levelName(LogLevel eLevel) {
+  switch (eLevel) {
+  case LogLevel::Debug:
+    return "DEBUG";
+  case LogLevel::Info:
+    return "INFO ";
+  case LogLevel::Warn:
+    return "WARN ";
+  case LogLevel::Error:
+    return "ERROR";
+  }
+  return "?????";
+}
+
+const char *baseName(const char *pszPath) {
+  const char *pszBase = pszPath;
+  for (const char *p = pszPath; *p; ++p) {
+    if (*p == '/' || *p == '\\')
+      pszBase = p + 1;
+  }
+  return pszBase;
+}
+
+std::uint32_t currentThreadID() {
+#if defined(_WIN32)
+  return static_cast<std::uint32_t>(::GetCurrentThreadId());
+#else
+  return static_cast<std::uint32_t>(::syscall(SYS_gettid));
+#endif
+}
+
+void localTime(std::time_t nSeconds, std::tm &tmLocal) {
+#if defined(_WIN32)
+  localtime_s(&tmLocal, &nSeconds);
+#else
+  localtime_r(&nSeconds, &tmLocal);
+#endif
+}
+
+// 线程退出时把缓冲区交给后台线程回收
+struct LogBufferRetirer {
+  detail::LogBuffer *pBuffer = nullptr;
+  ~LogBufferRetirer() {
+    if (pBuffer)
+      pBuffer->bRetired.store(true, std::memory_order_release);
+  }
+};
+
+thread_local LogBufferRetirer t_retirer;
+
+} // namespace
+
+thread_local detail::LogBuffer *Logger::t_pBuffer = nullptr;
+
+Logger &Logger::Instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger()
+    : m_eMinLevel(LogLevel::Info), m_bRunning(false), m_nDropped(0),
+      m_pFile(nullptr), m_nFileDate(0), m_nFileIndex(0), m_nFileSize(0) {}
+
+Logger::~Logger() { Stop(); }
+
+bool Logger::Start(const LoggerOptions &options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_bRunning.load())
+    return true;
+
+  std::error_code ec;
+  std::filesystem::create_directories(options.strDirectory, ec);
+  if (ec)
+    return false;
+
+  m_options = options;
+  m_eMinLevel = options.eMinLevel;
+  m_nFileDate = 0;
+  m_bRunning.store(true);
+  m_thread = std::thread(&Logger::run, this);
+  return true;
+}
+
+void Logger::Stop() {
+  if (!m_bRunning.exchange(false))
+    return;
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+detail::LogBuffer *Logger::registerThread() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_bRunning.load())
+    return nullptr;
+
+  m_buffers.emplace_back(new detail::LogBuffer(m_options.nThreadBufferSize,
+                                               currentThreadID()));
+  t_pBuffer = m_buffers.back().get();
+  t_retirer.pBuffer = t_pBuffer;
+  return t_pBuffer;
+}
+
+void Logger::run() {
+  if (!m_options.placement.Empty())
+    ApplyThreadPlacement(0, m_options.placement, "logger");
+
+  auto lastFlush = std::chrono::steady_clock::now();
+  while (m_bRunning.load(std::memory_order_acquire)) {
+    bool bAny = drainAll();
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastFlush >=
+        std::chrono::milliseconds(m_options.nFlushIntervalMs)) {
+      if (m_pFile)
+        std::fflush(m_pFile);
+      lastFlush = now;
+    }
+    if (!bAny)
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(m_options.nFlushIntervalMs));
+  }
+
+  // Stop()已置位m_bRunning，之后开始的写入都会放弃；等已开始的写入提交后
+  // 再排空，保证Stop()之前返回的日志都写入文件
+  waitWriters();
+  drainAll();
+  if (m_pFile) {
+    std::fclose(m_pFile);
+    m_pFile = nullptr;
+  }
+}
+
+void Logger::waitWriters() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &pBuffer : m_buffers) {
+    while (pBuffer->IsWriting())
+      std::this_thread::yield();
+  }
+}
+
+bool Logger::drainAll() {
+  std::vector<detail::LogBuffer *> buffers;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffers.reserve(m_buffers.size());
+    for (auto &pBuffer : m_buffers)
+      buffers.push_back(pBuffer.get());
+  }
+
+  bool bAny = false;
+  bool bRetired = false;
+  for (detail::LogBuffer *pBuffer : buffers) {
+    std::uint32_t nThreadID = pBuffer->GetThreadID();
+    std::size_t nCount =
+        pBuffer->Drain([&](const detail::LogRecordHeader &header,
+                           const char *pArgs) {
+          writeRecord(nThreadID, header, pArgs);
+        });
+    bAny = bAny || nCount > 0;
+    bRetired = bRetired || pBuffer->bRetired.load(std::memory_order_acquire);
+  }
+
+  if (bRetired) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_buffers.begin(); it != m_buffers.end();) {
+      if ((*it)->bRetired.load(std::memory_order_acquire) && (*it)->Empty())
+        it = m_buffers.erase(it);
+      else
+        ++it;
+    }
+  }
+  return bAny;
+}
+
+void Logger::writeRecord(std::uint32_t nThreadID,
+                         const detail::LogRecordHeader &header,
+                         const char *pArgs) {
+  const LogSite &site = *header.pSite;
+
+  std::time_t nSeconds =
+      static_cast<std::time_t>(header.nTimestamp / 1000000000);
+  int nMicros = static_cast<int>((header.nTimestamp / 1000) % 1000000);
+  std::tm tmLocal;
+  localTime(nSeconds, tmLocal);
+
+  int nDate = (tmLocal.tm_year + 1900) * 10000 + (tmLocal.tm_mon + 1) * 100 +
+              tmLocal.tm_mday;
+  if ((nDate != m_nFileDate || m_nFileSize >= m_options.nMaxFileSize) &&
+      !openFile(nDate))
+    return;
+  if (!m_pFile)
+    return;
+
+  char szLine[4096];
+  int nPrefix = std::snprintf(
+      szLine, sizeof(szLine),
+      "%04d-%02d-%02d %02d:%02d:%02d.%06d %s [%u] %s:%d ",
+      tmLocal.tm_year + 1900, tmLocal.tm_mon + 1, tmLocal.tm_mday,
+      tmLocal.tm_hour, tmLocal.tm_min, tmLocal.tm_sec, nMicros,
+      levelName(site.eLevel), nThreadID, baseName(site.pszFile), site.nLine);
+  std::size_t nLength = static_cast<std::size_t>(nPrefix);
+
+  int nMessage = header.pfnFormat(site.pszFormat, pArgs, szLine + nLength,
+                                  sizeof(szLine) - nLength - 1);
+  if (nMessage > 0)
+    nLength += std::min(static_cast<std::size_t>(nMessage),
+                        sizeof(szLine) - nLength - 2);
+  szLine[nLength++] = '\n';
+
+  std::fwrite(szLine, 1, nLength, m_pFile);
+  m_nFileSize += nLength;
+  if (m_options.bConsole)
+    std::fwrite(szLine, 1, nLength, stdout);
+}
+
+bool Logger::openFile(int nDate) {
+  if (m_pFile) {
+    std::fclose(m_pFile);
+    m_pFile = nullptr;
+  }
+
+  if (nDate != m_nFileDate) {
+    m_nFileDate = nDate;
+    m_nFileIndex = 0;
+  } else {
+    ++m_nFileIndex;
+  }
+
+  // 跳过当天已写满的文件，例如进程重启后
+  for (;; ++m_nFileIndex) {
+    char szName[64];
+    if (m_nFileIndex == 0)
+      std::snprintf(szName, sizeof(szName), "_%08d.log", nDate);
+    else
+      std::snprintf(szName, sizeof(szName), "_%08d.%d.log", nDate,
+                    m_nFileIndex);
+    std::filesystem::path path =
+        std::filesystem::path(m_options.strDirectory) /
+        (m_options.strPrefix + szName);
+
+    std::error_code ec;
+    std::uintmax_t nExisting = std::filesystem::file_size(path, ec);
+    if (ec)
+      nExisting = 0;
+    if (nExisting >= m_options.nMaxFileSize)
+      continue;
+
+    m_pFile = std::fopen(path.string().c_str(), "ab");
+    if (!m_pFile)
+      return false;
+    std::setvbuf(m_pFile, nullptr, _IOFBF, 1 << 16);
+    m_nFileSize = static_cast<std::size_t>(nExisting);
+    return true;
+  }
+}
+
+} // namespace ctp
@@ -0,0 +1,459 @@
+#include "ctp_matching_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+namespace ctp {
+
+namespace {
+
+// 绝对值超过该值的价格视为无效（CTP以DBL_MAX填充空值）
+constexpr double kMaxValidPrice = 1e12;
+
+constexpr std::uint32_t kInvalidOrder = 0xFFFFFFFF;
+
+// 只排除NaN和DBL_MAX一类的空值，期权组合、价差合约等可以是零或负价格
+inline bool validPrice(double dPrice) {
+  return std::fabs(dPrice) < kMaxValidPrice;
+}
+
+inline bool crosses(bool bBuy, double dPrice, double dLimit) {
+  return bBuy ? dPrice <= dLimit : dPrice >= dLimit;
+}
+
+void setRspInfo(CThostFtdcRspInfoField *pRspInfo, int nErrorID,
+                const char *pszErrorMsg) {
+  if (!pRspInfo)
+    return;
+  pRspInfo->ErrorID = nErrorID;
+  std::snprintf(pRspInfo->ErrorMsg, sizeof(pRspInfo->ErrorMsg), "%s",
+                pszErrorMsg);
+}
+
+void currentTime(TThostFtdcTimeType szTime) {
+  std::time_t nNow = std::time(nullptr);
+  std::tm tmLocal;
+#if defined(_WIN32)
+  localtime_s(&tmLocal, &nNow);
+#else
+  localtime_r(&nNow, &tmLocal);
+#endif
+  std::strftime(szTime, sizeof(TThostFtdcTimeType), "%H:%M:%S", &tmLocal);
+}
+
+// CTP的编号字段按12位右对齐，例如OrderSysID为"      123456"
+template <std::size_t N> void formatID(char (&szID)[N], int nID) {
+  static_assert(N > 12, "ID field too short");
+  std::snprintf(szID, N, "%12d", nID);
+}
+
+} // namespace
+
+MatchingEngine::MatchingEngine(MatchingEngineSpi *pSpi,
+                               const char *pszTradingDay,
+                               std::size_t nMaxInstruments)
+    : m_pSpi(pSpi), m_instruments(nMaxInstruments), m_nSequenceNo(0) {
+  std::memset(m_szTradingDay, 0, sizeof(m_szTradingDay));
+  std::strncpy(m_szTradingDay, pszTradingDay, sizeof(m_szTradingDay) - 1);
+  // 订单簿按合约下标预先分配，撮合过程中不会因扩容移动
+  m_books.resize(m_instruments.Capacity());
+  for (Book &book : m_books) {
+    std::memset(book.bidLevels, 0, sizeof(book.bidLevels));
+    std::memset(book.askLevels, 0, sizeof(book.askLevels));
+    book.dLastPrice = 0.0;
+    book.bHasLastPrice = false;
+    book.bHasTick = false;
+  }
+}
+
+std::string MatchingEngine::orderRefKey(int nFrontID, int nSessionID,
+                                        const char *pszOrderRef) {
+  char szKey[64];
+  std::snprintf(szKey, sizeof(szKey), "%d:%d:%.*s", nFrontID, nSessionID,
+                static_cast<int>(sizeof(TThostFtdcOrderRefType)), pszOrderRef);
+  return szKey;
+}
+
+int MatchingEngine::InsertOrder(const CThostFtdcInputOrderField &inputOrder,
+                                int nFrontID, int nSessionID,
+                                CThostFtdcRspInfoField *pRspInfo) {
+  const bool bMarket = inputOrder.OrderPriceType == THOST_FTDC_OPT_AnyPrice;
+  if (inputOrder.InstrumentID[0] == '\0' ||
+      inputOrder.VolumeTotalOriginal <= 0 ||
+      (inputOrder.Direction != THOST_FTDC_D_Buy &&
+       inputOrder.Direction != THOST_FTDC_D_Sell) ||
+      (!bMarket && !validPrice(inputOrder.LimitPrice))) {
+    setRspInfo(pRspInfo, 16, "CTP:order field error");
+    return 16;
+  }
+
+  std::string strRefKey =
+      orderRefKey(nFrontID, nSessionID, inputOrder.OrderRef);
+  if (m_orderRefIndex.count(strRefKey)) {
+    setRspInfo(pRspInfo, 22, "CTP:duplicate order ref");
+    return 22;
+  }
+
+  std::uint32_t nInstrument = m_instruments.Add(inputOrder.InstrumentID);
+  if (nInstrument == kInvalidInstrument) {
+    setRspInfo(pRspInfo, 16, "CTP:too many instruments");
+    return 16;
+  }
+
+  const std::uint32_t nOrder = static_cast<std::uint32_t>(m_orders.size());
+  m_orders.emplace_back();
+  m_orderBooks.push_back(nInstrument);
+  CThostFtdcOrderField &order = m_orders.back();
+  std::memset(&order, 0, sizeof(order));
+
+  std::memcpy(order.BrokerID, inputOrder.BrokerID, sizeof(order.BrokerID));
+  std::memcpy(order.InvestorID, inputOrder.InvestorID,
+              sizeof(order.InvestorID));
+  std::memcpy(order.InstrumentID, inputOrder.InstrumentID,
+              sizeof(order.InstrumentID));
+  std::memcpy(order.OrderRef, inputOrder.OrderRef, sizeof(order.OrderRef));
+  std::memcpy(order.UserID, inputOrder.UserID, sizeof(order.UserID));
+  std::memcpy(order.ExchangeID, inputOrder.ExchangeID,
+              sizeof(order.ExchangeID));
+  std::memcpy(order.CombOffsetFlag, inputOrder.CombOffsetFlag,
+              sizeof(order.CombOffsetFlag));
+  std::memcpy(order.CombHedgeFlag, inputOrder.CombHedgeFlag,
+              sizeof(order.CombHedgeFlag));
+  std::memcpy(order.InvestUnitID, inputOrder.InvestUnitID,
+              sizeof(order.InvestUnitID));
+  order.OrderPriceType = inputOrder.OrderPriceType;
+  order.Direction = inputOrder.Direction;
+  order.LimitPrice = inputOrder.LimitPrice;
+  order.VolumeTotalOriginal = inputOrder.VolumeTotalOriginal;
+  order.TimeCondition = inputOrder.TimeCondition;
+  order.VolumeCondition = inputOrder.VolumeCondition;
+  order.MinVolume = inputOrder.MinVolume;
+  order.ContingentCondition = inputOrder.ContingentCondition;
+  order.ForceCloseReason = inputOrder.ForceCloseReason;
+  order.RequestID = inputOrder.RequestID;
+  order.FrontID = nFrontID;
+  order.SessionID = nSessionID;
+  std::memcpy(order.TradingDay, m_szTradingDay, sizeof(order.TradingDay));
+  std::memcpy(order.InsertDate, m_szTradingDay, sizeof(order.InsertDate));
+  currentTime(order.InsertTime);
+  order.OrderType = THOST_FTDC_ORDT_Normal;
+  order.VolumeTraded = 0;
+  order.VolumeTotal = inputOrder.VolumeTotalOriginal;
+  m_orderRefIndex.emplace(std::move(strRefKey), nOrder);
+
+  // 柜台受理：尚未有交易所编号
+  order.OrderSubmitStatus = THOST_FTDC_OSS_InsertSubmitted;
+  order.OrderStatus = THOST_FTDC_OST_Unknown;
+  stamp(order);
+  m_pSpi->OnOrder(order);
+
+  // 交易所受理
+  formatID(order.OrderSysID, m_nSequenceNo);
+  formatID(order.OrderLocalID, m_nSequenceNo);
+  m_orderSysIndex.emplace(std::string(order.OrderSysID), nOrder);
+  order.OrderSubmitStatus = THOST_FTDC_OSS_Accepted;
+
+  Book &book = m_books[nInstrument];
+  const bool bBuy = order.Direction == THOST_FTDC_D_Buy;
+  const double dLimit =
+      bMarket ? (bBuy ? std::numeric_limits<double>::max()
+                      : -std::numeric_limits<double>::max())
+              : order.LimitPrice;
+  const bool bImmediate = bMarket || order.TimeCondition == THOST_FTDC_TC_IOC;
+
+  if (!bImmediate) {
+    order.OrderStatus = THOST_FTDC_OST_NoTradeQueueing;
+    stamp(order);
+    m_pSpi->OnOrder(order);
+  }
+
+  if (order.VolumeCondition == THOST_FTDC_VC_CV &&
+      availableVolume(book, order, dLimit) < order.VolumeTotal) {
+    cancel(nOrder, "FOK order canceled");
+    return 0;
+  }
+
+  matchIncoming(book, nOrder, dLimit);
+
+  CThostFtdcOrderField &matched = m_orders[nOrder];
+  if (matched.VolumeTotal > 0) {
+    if (bImmediate)
+      cancel(nOrder, "FAK order canceled");
+    else
+      rest(book, nOrder);
+  }
+  return 0;
+}
+
+std::uint32_t MatchingEngine::findOrder(
+    const CThostFtdcInputOrderActionField &action) const {
+  if (action.OrderSysID[0] != '\0') {
+    auto it = m_orderSysIndex.find(action.OrderSysID);
+    return it == m_orderSysIndex.end() ? kInvalidOrder : it->second;
+  }
+  auto it = m_orderRefIndex.find(
+      orderRefKey(action.FrontID, action.SessionID, action.OrderRef));
+  return it == m_orderRefIndex.end() ? kInvalidOrder : it->second;
+}
+
+int MatchingEngine::CancelOrder(
+    const CThostFtdcInputOrderActionField &inputOrderAction,
+    CThostFtdcRspInfoField *pRspInfo) {
+  if (inputOrderAction.ActionFlag != THOST_FTDC_AF_Delete) {
+    setRspInfo(pRspInfo, 16, "CTP:only delete action is supported");
+    return 16;
+  }
+
+  std::uint32_t nOrder = findOrder(inputOrderAction);
+  if (nOrder == kInvalidOrder) {
+    setRspInfo(pRspInfo, 25, "CTP:order not found");
+    return 25;
+  }
+
+  char cStatus = m_orders[nOrder].OrderStatus;
+  if (cStatus != THOST_FTDC_OST_NoTradeQueueing &&
+      cStatus != THOST_FTDC_OST_PartTradedQueueing) {
+    setRspInfo(pRspInfo, 26, "CTP:order already traded or canceled");
+    return 26;
+  }
+
+  cancel(nOrder, "canceled");
+  return 0;
+}
+
+void MatchingEngine::OnMarketData(const CThostFtdcDepthMarketDataField &tick) {
+  std::uint32_t nInstrument = m_instruments.Add(tick.InstrumentID);
+  if (nInstrument == kInvalidInstrument)
+    return;
+
+  Book &book = m_books[nInstrument];
+  const double dBidPrices[kTickDepth] = {tick.BidPrice1, tick.BidPrice2,
+                                         tick.BidPrice3, tick.BidPrice4,
+                                         tick.BidPrice5};
+  const double dAskPrices[kTickDepth] = {tick.AskPrice1, tick.AskPrice2,
+                                         tick.AskPrice3, tick.AskPrice4,
+                                         tick.AskPrice5};
+  const int nBidVolumes[kTickDepth] = {tick.BidVolume1, tick.BidVolume2,
+                                       tick.BidVolume3, tick.BidVolume4,
+                                       tick.BidVolume5};
+  const int nAskVolumes[kTickDepth] = {tick.AskVolume1, tick.AskVolume2,
+                                       tick.AskVolume3, tick.AskVolume4,
+                                       tick.AskVolume5};
+  for (int i = 0; i < kTickDepth; ++i) {
+    bool bBid = validPrice(dBidPrices[i]) && nBidVolumes[i] > 0;
+    bool bAsk = validPrice(dAskPrices[i]) && nAskVolumes[i] > 0;
+    book.bidLevels[i] = {dBidPrices[i], bBid ? nBidVolumes[i] : 0};
+    book.askLevels[i] = {dAskPrices[i], bAsk ? nAskVolumes[i] : 0};
+  }
+  book.bHasLastPrice = validPrice(tick.LastPrice) && tick.Volume > 0;
+  book.dLastPrice = book.bHasLastPrice ? tick.LastPrice : 0.0;
+  book.bHasTick = true;
+
+  matchResting(book, book.bids, true);
+  matchResting(book, book.asks, false);
+}
+
+int MatchingEngine::availableVolume(const Book &book,
+                                    const CThostFtdcOrderField &order,
+                                    double dLimit) const {
+  const bool bBuy = order.Direction == THOST_FTDC_D_Buy;
+  int nAvailable = 0;
+
+  auto countSide = [&](const auto &side) {
+    for (const auto &level : side) {
+      if (!crosses(bBuy, level.first, dLimit))
+        break;
+      for (std::uint32_t nResting : level.second)
+        nAvailable += m_orders[nResting].VolumeTotal;
+    }
+  };
+  if (bBuy)
+    countSide(book.asks);
+  else
+    countSide(book.bids);
+
+  const Level *pLevels = bBuy ? book.askLevels : book.bidLevels;
+  for (int i = 0; i < kTickDepth && book.bHasTick; ++i) {
+    if (pLevels[i].nVolume <= 0 || !crosses(bBuy, pLevels[i].dPrice, dLimit))
+      break;
+    nAvailable += pLevels[i].nVolume;
+  }
+  return nAvailable;
+}
+
+void MatchingEngine::matchIncoming(Book &book, std::uint32_t nOrder,
+                                   double dLimit) {
+  const bool bBuy = m_orders[nOrder].Direction == THOST_FTDC_D_Buy;
+  Level *pLevels = bBuy ? book.askLevels : book.bidLevels;
+  int nLevel = 0;
+
+  // 对手方的模拟挂单与盘口按价格优先合并撮合，同价时盘口在前
+  auto matchSide = [&](auto &side) {
+    while (m_orders[nOrder].VolumeTotal > 0) {
+      while (book.bHasTick && nLevel < kTickDepth &&
+             pLevels[nLevel].nVolume <= 0)
+        ++nLevel;
+      const bool bLevel = book.bHasTick && nLevel < kTickDepth &&
+                          crosses(bBuy, pLevels[nLevel].dPrice, dLimit);
+      const bool bResting =
+          !side.empty() && crosses(bBuy, side.begin()->first, dLimit);
+      if (!bLevel && !bResting)
+        break;
+
+      if (bLevel &&
+          (!bResting || crosses(bBuy, pLevels[nLevel].dPrice,
+                                side.begin()->first))) {
+        // 与盘口成交，成交价为盘口价
+        Level &level = pLevels[nLevel];
+        int nVolume = std::min(m_orders[nOrder].VolumeTotal, level.nVolume);
+        level.nVolume -= nVolume;
+        fill(nOrder, nVolume, level.dPrice);
+        continue;
+      }
+
+      // 与模拟挂单成交，成交价为挂单价
+      auto itLevel = side.begin();
+      std::deque<std::uint32_t> &queue = itLevel->second;
+      std::uint32_t nResting = queue.front();
+      int nVolume = std::min(m_orders[nOrder].VolumeTotal,
+                             m_orders[nResting].VolumeTotal);
+      fill(nResting, nVolume, itLevel->first);
+      fill(nOrder, nVolume, itLevel->first);
+      if (m_orders[nResting].VolumeTotal == 0)
+        queue.pop_front();
+      if (queue.empty())
+        side.erase(itLevel);
+    }
+  };
+  if (bBuy)
+    matchSide(book.asks);
+  else
+    matchSide(book.bids);
+}
+
+template <typename Side>
+void MatchingEngine::matchResting(Book &book, Side &side, bool bBuy) {
+  Level *pLevels = bBuy ? book.askLevels : book.bidLevels;
+  while (!side.empty()) {
+    auto itLevel = side.begin();
+    const double dPrice = itLevel->first;
+    // 最新价穿过挂单价，说明该价位的对手已被全部吃掉
+    const bool bTradeThrough =
+        book.bHasLastPrice &&
+        (bBuy ? book.dLastPrice < dPrice : book.dLastPrice > dPrice);
+
+    std::deque<std::uint32_t> &queue = itLevel->second;
+    while (!queue.empty()) {
+      std::uint32_t nResting = queue.front();
+      for (int i = 0; i < kTickDepth; ++i) {
+        if (m_orders[nResting].VolumeTotal == 0)
+          break;
+        Level &level = pLevels[i];
+        if (level.nVolume <= 0 || !crosses(bBuy, level.dPrice, dPrice))
+          break;
+        int nVolume = std::min(m_orders[nResting].VolumeTotal, level.nVolume);
+        level.nVolume -= nVolume;
+        fill(nResting, nVolume, dPrice);
+      }
+      if (bTradeThrough && m_orders[nResting].VolumeTotal > 0)
+        fill(nResting, m_orders[nResting].VolumeTotal, dPrice);
+      if (m_orders[nResting].VolumeTotal > 0)
+        return; // 本价位剩余挂单无法成交，更差的价位更不可能成交
+      queue.pop_front();
+    }
+    side.erase(itLevel);
+  }
+}
+
+void MatchingEngine::fill(std::uint32_t nOrder, int nVolume, double dPrice) {
+  CThostFtdcOrderField &order = m_orders[nOrder];
+  order.VolumeTraded += nVolume;
+  order.VolumeTotal -= nVolume;
+  if (order.VolumeTotal == 0)
+    order.OrderStatus = THOST_FTDC_OST_AllTraded;
+  else if (order.OrderPriceType == THOST_FTDC_OPT_AnyPrice ||
+           order.TimeCondition == THOST_FTDC_TC_IOC)
+    order.OrderStatus = THOST_FTDC_OST_PartTradedNotQueueing;
+  else
+    order.OrderStatus = THOST_FTDC_OST_PartTradedQueueing;
+  stamp(order);
+  m_pSpi->OnOrder(order);
+
+  m_trades.emplace_back();
+  CThostFtdcTradeField &trade = m_trades.back();
+  std::memset(&trade, 0, sizeof(trade));
+  std::memcpy(trade.BrokerID, order.BrokerID, sizeof(trade.BrokerID));
+  std::memcpy(trade.InvestorID, order.InvestorID, sizeof(trade.InvestorID));
+  std::memcpy(trade.InstrumentID, order.InstrumentID,
+              sizeof(trade.InstrumentID));
+  std::memcpy(trade.OrderRef, order.OrderRef, sizeof(trade.OrderRef));
+  std::memcpy(trade.UserID, order.UserID, sizeof(trade.UserID));
+  std::memcpy(trade.ExchangeID, order.ExchangeID, sizeof(trade.ExchangeID));
+  std::memcpy(trade.OrderSysID, order.OrderSysID, sizeof(trade.OrderSysID));
+  std::memcpy(trade.OrderLocalID, order.OrderLocalID,
+              sizeof(trade.OrderLocalID));
+  std::memcpy(trade.InvestUnitID, order.InvestUnitID,
+              sizeof(trade.InvestUnitID));
+  std::memcpy(trade.TradingDay, m_szTradingDay, sizeof(trade.TradingDay));
+  std::memcpy(trade.TradeDate, m_szTradingDay, sizeof(trade.TradeDate));
+  formatID(trade.TradeID, static_cast<int>(m_trades.size()));
+  trade.Direction = order.Direction;
+  trade.OffsetFlag = order.CombOffsetFlag[0];
+  trade.HedgeFlag = order.CombHedgeFlag[0];
+  trade.Price = dPrice;
+  trade.Volume = nVolume;
+  trade.TradeType = THOST_FTDC_TRDT_Common;
+  trade.SequenceNo = order.SequenceNo;
+  trade.BrokerOrderSeq = order.BrokerOrderSeq;
+  currentTime(trade.TradeTime);
+  m_pSpi->OnTrade(trade);
+}
+
+void MatchingEngine::rest(Book &book, std::uint32_t nOrder) {
+  const CThostFtdcOrderField &order = m_orders[nOrder];
+  if (order.Direction == THOST_FTDC_D_Buy)
+    book.bids[order.LimitPrice].push_back(nOrder);
+  else
+    book.asks[order.LimitPrice].push_back(nOrder);
+}
+
+void MatchingEngine::cancel(std::uint32_t nOrder, const char *pszStatusMsg) {
+  CThostFtdcOrderField &order = m_orders[nOrder];
+  if (order.OrderStatus == THOST_FTDC_OST_NoTradeQueueing ||
+      order.OrderStatus == THOST_FTDC_OST_PartTradedQueueing) {
+    Book &book = m_books[m_orderBooks[nOrder]];
+    auto removeFrom = [&](auto &side) {
+      auto itLevel = side.find(order.LimitPrice);
+      if (itLevel == side.end())
+        return;
+      std::deque<std::uint32_t> &queue = itLevel->second;
+      queue.erase(std::remove(queue.begin(), queue.end(), nOrder),
+                  queue.end());
+      if (queue.empty())
+        side.erase(itLevel);
+    };
+    if (order.Direction == THOST_FTDC_D_Buy)
+      removeFrom(book.bids);
+    else
+      removeFrom(book.asks);
+  }
+
+  order.OrderStatus = THOST_FTDC_OST_Canceled;
+  currentTime(order.CancelTime);
+  std::snprintf(order.StatusMsg, sizeof(order.StatusMsg), "%s", pszStatusMsg);
+  stamp(order);
+  m_pSpi->OnOrder(order);
+}
+
+void MatchingEngine::stamp(CThostFtdcOrderField &order) {
+  ++m_nSequenceNo;
+  order.SequenceNo = m_nSequenceNo;
+  order.BrokerOrderSeq = m_nSequenceNo;
+  currentTime(order.UpdateTime);
+}
+
+} // namespace ctp
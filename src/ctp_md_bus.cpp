@@ -0,0 +1,209 @@
+#include "ctp_md_bus.h"
+
+#include <thread>
+
+namespace ctp {
+
+MdSubscriber::MdSubscriber(std::size_t nID, const MdSubscriberOptions &options,
+                           std::size_t nMaxInstruments)
+    : m_nID(nID), m_options(options), m_nPublished(0), m_nConflated(0),
+      m_nBlocked(0), m_nConsumed(0), m_nDropped(0), m_nMaxLag(0),
+      m_nReadSeq(0) {
+  switch (m_options.ePolicy) {
+  case MdSlowConsumerPolicy::Block:
+    m_pQueue.reset(new SpscRing<CompactTick>(m_options.nQueueCapacity));
+    break;
+  case MdSlowConsumerPolicy::DropOldest:
+    m_pRing.reset(new BroadcastRing<CompactTick>(m_options.nQueueCapacity));
+    break;
+  case MdSlowConsumerPolicy::Conflate:
+    // 每个合约同时最多在脏队列中出现一次，队列按合约数分配即不会满
+    m_pLatest.reset(new SnapshotTable(nMaxInstruments));
+    m_pDirtyQueue.reset(new SpscRing<std::uint32_t>(nMaxInstruments));
+    m_pDirty.reset(new std::atomic<bool>[nMaxInstruments]);
+    for (std::size_t i = 0; i < nMaxInstruments; ++i)
+      m_pDirty[i].store(false, std::memory_order_relaxed);
+    m_lastVersions.assign(nMaxInstruments, 0);
+    break;
+  }
+}
+
+void MdSubscriber::push(const CompactTick &tick) {
+  m_nPublished.store(m_nPublished.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  switch (m_options.ePolicy) {
+  case MdSlowConsumerPolicy::Block:
+    if (!m_pQueue->TryPush(tick)) {
+      m_nBlocked.store(m_nBlocked.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+      while (!m_pQueue->TryPush(tick))
+        std::this_thread::yield();
+    }
+    break;
+  case MdSlowConsumerPolicy::DropOldest:
+    m_pRing->Publish(tick);
+    break;
+  case MdSlowConsumerPolicy::Conflate:
+    m_pLatest->Update(tick);
+    // 与消费方清除标志的exchange配对，保证消费方看到刚写入的快照
+    if (m_pDirty[tick.nInstrument].exchange(true, std::memory_order_acq_rel))
+      m_nConflated.store(m_nConflated.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    else
+      m_pDirtyQueue->TryPush(tick.nInstrument);
+    break;
+  }
+}
+
+bool MdSubscriber::Poll(CompactTick &tick) {
+  std::size_t nLag = 0;
+  switch (m_options.ePolicy) {
+  case MdSlowConsumerPolicy::Block:
+    if (!m_pQueue->TryPop(tick))
+      return false;
+    nLag = m_pQueue->Size();
+    break;
+  case MdSlowConsumerPolicy::DropOldest:
+    for (;;) {
+      auto eResult = m_pRing->Read(m_nReadSeq, tick);
+      if (eResult == BroadcastRing<CompactTick>::ReadResult::Ok)
+        break;
+      if (eResult == BroadcastRing<CompactTick>::ReadResult::Empty)
+        return false;
+      // 被覆盖：跳到仍可读取的最旧序号，中间的行情记为丢弃
+      std::uint64_t nOldest = m_pRing->GetOldestSeq();
+      if (nOldest > m_nReadSeq) {
+        m_nDropped.store(m_nDropped.load(std::memory_order_relaxed) +
+                             (nOldest - m_nReadSeq),
+                         std::memory_order_relaxed);
+        m_nReadSeq = nOldest;
+      } else {
+        CpuRelax();
+      }
+    }
+    ++m_nReadSeq;
+    nLag = static_cast<std::size_t>(m_pRing->GetWriteSeq() - m_nReadSeq);
+    break;
+  case MdSlowConsumerPolicy::Conflate:
+    for (;;) {
+      std::uint32_t nInstrument;
+      if (!m_pDirtyQueue->TryPop(nInstrument))
+        return false;
+      m_pDirty[nInstrument].exchange(false, std::memory_order_acq_rel);
+      // 清除标志后到读取前又有更新时，该合约会再次入队，跳过重复的快照
+      std::uint64_t nVersion;
+      if (!m_pLatest->Read(nInstrument, tick, &nVersion) ||
+          nVersion == m_lastVersions[nInstrument])
+        continue;
+      m_lastVersions[nInstrument] = nVersion;
+      break;
+    }
+    nLag = m_pDirtyQueue->Size();
+    break;
+  }
+
+  m_nConsumed.store(m_nConsumed.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  if (nLag > m_nMaxLag.load(std::memory_order_relaxed))
+    m_nMaxLag.store(nLag, std::memory_order_relaxed);
+  return true;
+}
+
+std::size_t MdSubscriber::GetLag() const {
+  switch (m_options.ePolicy) {
+  case MdSlowConsumerPolicy::Block:
+    return m_pQueue->Size();
+  case MdSlowConsumerPolicy::DropOldest: {
+    // 每个序号要么被取走要么被丢弃
+    std::uint64_t nRead = m_nConsumed.load(std::memory_order_relaxed) +
+                          m_nDropped.load(std::memory_order_relaxed);
+    std::uint64_t nWrite = m_pRing->GetWriteSeq();
+    std::uint64_t nLag = nWrite > nRead ? nWrite - nRead : 0;
+    return static_cast<std::size_t>(
+        nLag < m_pRing->Capacity() ? nLag : m_pRing->Capacity());
+  }
+  case MdSlowConsumerPolicy::Conflate:
+    return m_pDirtyQueue->Size();
+  }
+  return 0;
+}
+
+MdSubscriberStats MdSubscriber::GetStats() const {
+  MdSubscriberStats stats;
+  stats.nPublished = m_nPublished.load(std::memory_order_relaxed);
+  stats.nConsumed = m_nConsumed.load(std::memory_order_relaxed);
+  stats.nDropped = m_nDropped.load(std::memory_order_relaxed);
+  stats.nConflated = m_nConflated.load(std::memory_order_relaxed);
+  stats.nBlocked = m_nBlocked.load(std::memory_order_relaxed);
+  stats.nLag = GetLag();
+  stats.nMaxLag = m_nMaxLag.load(std::memory_order_relaxed);
+  return stats;
+}
+
+MdBus::MdBus(const InstrumentTable &table)
+    : m_table(table), m_normalizer(table),
+      m_nMaxInstruments(table.Capacity()), m_pSubscribers(),
+      m_nSubscribers(0), m_nInvalid(0) {
+  m_pRoutes.reset(new std::atomic<std::uint64_t>[m_nMaxInstruments]);
+  for (std::size_t i = 0; i < m_nMaxInstruments; ++i)
+    m_pRoutes[i].store(0, std::memory_order_relaxed);
+}
+
+MdBus::~MdBus() {
+  for (std::size_t i = 0; i < kMaxMdSubscribers; ++i)
+    delete m_pSubscribers[i];
+}
+
+MdSubscriber *MdBus::AddSubscriber(const MdSubscriberOptions &options) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::size_t nID = m_nSubscribers.load(std::memory_order_relaxed);
+  if (nID >= kMaxMdSubscribers)
+    return nullptr;
+  MdSubscriber *pSubscriber =
+      new MdSubscriber(nID, options, m_nMaxInstruments);
+  m_pSubscribers[nID] = pSubscriber;
+  m_nSubscribers.store(nID + 1, std::memory_order_release);
+  return pSubscriber;
+}
+
+bool MdBus::Subscribe(MdSubscriber *pSubscriber, std::uint32_t nInstrument) {
+  if (!pSubscriber || GetSubscriber(pSubscriber->m_nID) != pSubscriber ||
+      nInstrument >= m_nMaxInstruments)
+    return false;
+  // release与Publish()中的acquire配对，发布方看到位图时订阅者已构造完毕
+  m_pRoutes[nInstrument].fetch_or(1ull << pSubscriber->m_nID,
+                                  std::memory_order_release);
+  return true;
+}
+
+bool MdBus::Unsubscribe(MdSubscriber *pSubscriber, std::uint32_t nInstrument) {
+  if (!pSubscriber || GetSubscriber(pSubscriber->m_nID) != pSubscriber ||
+      nInstrument >= m_nMaxInstruments)
+    return false;
+  m_pRoutes[nInstrument].fetch_and(~(1ull << pSubscriber->m_nID),
+                                   std::memory_order_release);
+  return true;
+}
+
+bool MdBus::Subscribe(MdSubscriber *pSubscriber,
+                      const char *pszInstrumentID) {
+  return Subscribe(pSubscriber, m_table.Find(pszInstrumentID));
+}
+
+bool MdBus::Unsubscribe(MdSubscriber *pSubscriber,
+                        const char *pszInstrumentID) {
+  return Unsubscribe(pSubscriber, m_table.Find(pszInstrumentID));
+}
+
+bool MdBus::Publish(const CThostFtdcDepthMarketDataField &tick) {
+  std::uint32_t nInstrument = m_table.Find(tick.InstrumentID);
+  if (nInstrument == kInvalidInstrument)
+    return false;
+  if (m_pRoutes[nInstrument].load(std::memory_order_relaxed) == 0)
+    return true;
+  CompactTick compact;
+  m_normalizer.Normalize(nInstrument, tick, compact);
+  return Publish(compact);
+}
+
+} // namespace ctp
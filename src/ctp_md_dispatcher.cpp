@@ -0,0 +1,213 @@
+#include "ctp_md_dispatcher.h"
+#include "ctp_latency.h"
+#include "ctp_tick.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace ctp {
+
+MdDispatcher::MdDispatcher(CThostFtdcMdSpi *pHandler,
+                           const MdDispatcherOptions &options)
+    : m_pHandler(pHandler), m_options(options), m_ring(options.nRingCapacity),
+      m_nExchangeLatency(kInvalidLatencyMetric),
+      m_nQueueLatency(kInvalidLatencyMetric),
+      m_nHandlerLatency(kInvalidLatencyMetric), m_bRunning(false),
+      m_bSleeping(false), m_nHighWater(0), m_nDropped(0), m_nDispatched(0) {
+  if (m_options.bRecordLatency) {
+    LatencyRecorder &recorder = LatencyRecorder::Instance();
+    m_nExchangeLatency = recorder.Register("md.exchange_to_callback");
+    m_nQueueLatency = recorder.Register("md.callback_to_dispatch");
+    m_nHandlerLatency = recorder.Register("md.handler");
+    // 在构造时完成校准，不占用行情线程
+    TscClock::Instance();
+  }
+}
+
+MdDispatcher::~MdDispatcher() { Stop(); }
+
+void MdDispatcher::Start() {
+  if (m_bRunning.exchange(true))
+    return;
+  m_thread = std::thread(&MdDispatcher::run, this);
+}
+
+void MdDispatcher::Stop() {
+  if (!m_bRunning.exchange(false))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cond.notify_one();
+  }
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void MdDispatcher::OnRtnDepthMarketData(
+    CThostFtdcDepthMarketDataField *pDepthMarketData) {
+  if (!pDepthMarketData)
+    return;
+
+  // 只在CTP线程上打时间戳，换算与记录都在消费线程上完成
+  Entry *pEntry = m_ring.Reserve();
+  if (!pEntry) {
+    m_nDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  pEntry->nRecvTsc = m_options.bRecordLatency ? ReadTsc() : 0;
+  std::memcpy(static_cast<void *>(&pEntry->tick), pDepthMarketData,
+              sizeof(CThostFtdcDepthMarketDataField));
+  m_ring.Commit();
+
+  std::size_t nSize = m_ring.Size();
+  if (nSize > m_nHighWater.load(std::memory_order_relaxed))
+    m_nHighWater.store(nSize, std::memory_order_relaxed);
+
+  if (m_options.eWaitMode == MdWaitMode::Blocking) {
+    // 与消费线程的m_bSleeping写入配对，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_bSleeping.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cond.notify_one();
+    }
+  }
+}
+
+void MdDispatcher::run() {
+  const ThreadPlacement &placement = m_options.consumerPlacement;
+  if (!placement.Empty()) {
+    ApplyThreadPlacement(0, placement, "md.dispatcher");
+    int nNode = GetNumaNodeOfPlacement(placement);
+    if (nNode >= 0 && GetNumaNodeCount() > 1)
+      BindMemoryToNumaNode(m_ring.GetStorage(), m_ring.GetStorageSize(),
+                           nNode);
+  }
+
+  while (m_bRunning.load(std::memory_order_acquire)) {
+    if (drain())
+      continue;
+    if (m_options.eWaitMode == MdWaitMode::Blocking)
+      waitForData();
+  }
+  // 退出前处理完剩余行情
+  drain();
+}
+
+bool MdDispatcher::drain() {
+  bool bAny = false;
+  while (const Entry *pEntry = m_ring.Front()) {
+    std::uint64_t nBegin = m_options.bRecordLatency ? ReadTsc() : 0;
+    // CTP的SPI接口使用非const指针，处理期间槽位归消费线程独占
+    m_pHandler->OnRtnDepthMarketData(
+        const_cast<CThostFtdcDepthMarketDataField *>(&pEntry->tick));
+    if (m_options.bRecordLatency)
+      recordLatency(*pEntry, nBegin, ReadTsc());
+    m_ring.Pop();
+    m_nDispatched.fetch_add(1, std::memory_order_relaxed);
+    bAny = true;
+  }
+  return bAny;
+}
+
+void MdDispatcher::recordLatency(const Entry &entry, std::uint64_t nBegin,
+                                 std::uint64_t nEnd) {
+  LatencyRecorder &recorder = LatencyRecorder::Instance();
+  const TscClock &clock = TscClock::Instance();
+  recorder.Record(m_nQueueLatency, clock.ElapsedNs(entry.nRecvTsc, nBegin));
+  recorder.Record(m_nHandlerLatency, clock.ElapsedNs(nBegin, nEnd));
+
+  // 交易所时间只精确到毫秒，且包含两端的时钟偏差；本地时钟偏慢时记为0
+  const CThostFtdcDepthMarketDataField &tick = entry.tick;
+  if (tick.UpdateTime[2] != ':' || tick.UpdateTime[5] != ':')
+    return;
+  std::int32_t nLocal = LocalTradingTimeKey(clock.ToWallNs(entry.nRecvTsc));
+  std::int32_t nExchange =
+      TradingTimeKey(tick.UpdateTime, tick.UpdateMillisec);
+  recorder.Record(m_nExchangeLatency,
+                  static_cast<std::int64_t>(
+                      TradingTimeDiffMs(nLocal, nExchange)) *
+                      1000000);
+}
+
+void MdDispatcher::waitForData() {
+  for (int i = 0; i < m_options.nSpinCount; ++i) {
+    if (!m_ring.Empty())
+      return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_bSleeping.store(true, std::memory_order_seq_cst);
+  if (m_ring.Empty() && m_bRunning.load(std::memory_order_acquire)) {
+    // 超时仅作兜底，正常情况下由生产者唤醒
+    m_cond.wait_for(lock, std::chrono::milliseconds(10));
+  }
+  m_bSleeping.store(false, std::memory_order_relaxed);
+}
+
+void MdDispatcher::OnFrontConnected() { m_pHandler->OnFrontConnected(); }
+
+void MdDispatcher::OnFrontDisconnected(int nReason) {
+  m_pHandler->OnFrontDisconnected(nReason);
+}
+
+void MdDispatcher::OnHeartBeatWarning(int nTimeLapse) {
+  m_pHandler->OnHeartBeatWarning(nTimeLapse);
+}
+
+void MdDispatcher::OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                                  CThostFtdcRspInfoField *pRspInfo,
+                                  int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspUserLogin(pRspUserLogin, pRspInfo, nRequestID, bIsLast);
+}
+
+void MdDispatcher::OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                                   CThostFtdcRspInfoField *pRspInfo,
+                                   int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspUserLogout(pUserLogout, pRspInfo, nRequestID, bIsLast);
+}
+
+void MdDispatcher::OnRspQryMulticastInstrument(
+    CThostFtdcMulticastInstrumentField *pMulticastInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspQryMulticastInstrument(pMulticastInstrument, pRspInfo,
+                                          nRequestID, bIsLast);
+}
+
+void MdDispatcher::OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                              bool bIsLast) {
+  m_pHandler->OnRspError(pRspInfo, nRequestID, bIsLast);
+}
+
+void MdDispatcher::OnRspSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspSubMarketData(pSpecificInstrument, pRspInfo, nRequestID,
+                                 bIsLast);
+}
+
+void MdDispatcher::OnRspUnSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspUnSubMarketData(pSpecificInstrument, pRspInfo, nRequestID,
+                                   bIsLast);
+}
+
+void MdDispatcher::OnRspSubForQuoteRsp(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspSubForQuoteRsp(pSpecificInstrument, pRspInfo, nRequestID,
+                                  bIsLast);
+}
+
+void MdDispatcher::OnRspUnSubForQuoteRsp(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  m_pHandler->OnRspUnSubForQuoteRsp(pSpecificInstrument, pRspInfo, nRequestID,
+                                    bIsLast);
+}
+
+void MdDispatcher::OnRtnForQuoteRsp(CThostFtdcForQuoteRspField *pForQuoteRsp) {
+  m_pHandler->OnRtnForQuoteRsp(pForQuoteRsp);
+}
+
+} // namespace ctp
@@ -0,0 +1,419 @@
+#include "ctp_md_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_set>
+
+namespace ctp {
+
+namespace {
+
+std::int64_t steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 录制时间：优先使用本地接收时间，缺失时退回交易所时间
+std::int64_t recordNanos(const TickJournalRecord &record) {
+  return record.nRecvTime ? record.nRecvTime
+                          : static_cast<std::int64_t>(record.nTime) * 1000000;
+}
+
+} // namespace
+
+ReplayMdApi *ReplayMdApi::CreateReplayMdApi(const ReplayMdApiOptions &options) {
+  ReplayMdApi *pApi = new ReplayMdApi(options);
+  if (!pApi->open()) {
+    delete pApi;
+    return nullptr;
+  }
+  return pApi;
+}
+
+ReplayMdApi::ReplayMdApi(const ReplayMdApiOptions &options)
+    : m_options(options), m_pSpi(nullptr), m_nRecordCount(0),
+      m_bRunning(false), m_bReleaseOnExit(false), m_bFinished(false),
+      m_bLoggedIn(false),
+      m_bSubscribed(false), m_bHasEvents(false), m_nDelivered(0),
+      m_nStartNanos(0), m_nEndNanos(0), m_nJournal(0) {
+  if (m_options.dSpeedMultiple <= 0.0)
+    m_options.dSpeedMultiple = 1.0;
+}
+
+ReplayMdApi::~ReplayMdApi() {
+  if (m_bRunning.exchange(false)) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cond.notify_all();
+    }
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+}
+
+bool ReplayMdApi::open() {
+  std::unordered_set<std::string> setInstruments;
+  for (const std::string &strFile : m_options.vecJournalFiles) {
+    std::unique_ptr<TickJournalReader> pReader(new TickJournalReader());
+    if (!pReader->Open(strFile))
+      return false;
+    for (std::uint64_t i = 0; i < pReader->GetRecordCount(); ++i) {
+      const char *pszInstrumentID = pReader->GetRecord(i).tick.InstrumentID;
+      setInstruments.emplace(
+          pszInstrumentID,
+          strnlen(pszInstrumentID, sizeof(TThostFtdcInstrumentIDType)));
+    }
+    m_nRecordCount += pReader->GetRecordCount();
+    m_readers.push_back(std::move(pReader));
+  }
+
+  // 合约表按日志中实际出现的合约数创建，不会有合约因表满被丢弃
+  m_pInstruments.reset(
+      new InstrumentTable(std::max<std::size_t>(setInstruments.size(), 1)));
+  for (const std::unique_ptr<TickJournalReader> &pReader : m_readers) {
+    // 预先为每条记录计算合约编号，回放时不再做字符串查找
+    std::vector<std::uint32_t> vecIndices(pReader->GetRecordCount());
+    for (std::uint64_t i = 0; i < vecIndices.size(); ++i)
+      vecIndices[i] =
+          m_pInstruments->Add(pReader->GetRecord(i).tick.InstrumentID);
+    m_indices.push_back(std::move(vecIndices));
+  }
+
+  m_pSubscribed.reset(new std::atomic<bool>[m_pInstruments->Capacity()]);
+  for (std::size_t i = 0; i < m_pInstruments->Capacity(); ++i)
+    m_pSubscribed[i].store(false, std::memory_order_relaxed);
+  return true;
+}
+
+void ReplayMdApi::Release() {
+  // 在回放线程的回调中不能join自己，停止回放并交给回放线程在退出前释放
+  if (m_thread.joinable() &&
+      m_thread.get_id() == std::this_thread::get_id()) {
+    m_bReleaseOnExit = true;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bRunning.store(false, std::memory_order_release);
+      m_cond.notify_all();
+    }
+    m_thread.detach();
+    return;
+  }
+  delete this;
+}
+
+void ReplayMdApi::Init() {
+  if (m_bRunning.exchange(true))
+    return;
+  m_thread = std::thread(&ReplayMdApi::run, this);
+}
+
+int ReplayMdApi::Join() {
+  // 阻塞到所有日志回放完毕
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this] {
+    return m_bFinished.load(std::memory_order_acquire) ||
+           !m_bRunning.load(std::memory_order_acquire);
+  });
+  return 0;
+}
+
+const char *ReplayMdApi::GetTradingDay() {
+  // 日志在创建后只读，交易日取自当前回放日志的文件头
+  if (m_readers.empty())
+    return "";
+  return m_readers[m_nJournal.load(std::memory_order_acquire)]
+      ->GetTradingDay();
+}
+
+void ReplayMdApi::GetFrontInfo(CThostFtdcFrontInfoField *pFrontInfo) {
+  if (pFrontInfo)
+    std::memset(pFrontInfo, 0, sizeof(*pFrontInfo));
+}
+
+void ReplayMdApi::RegisterFront(char *) {}
+
+void ReplayMdApi::RegisterNameServer(char *) {}
+
+void ReplayMdApi::RegisterFensUserInfo(CThostFtdcFensUserInfoField *) {}
+
+void ReplayMdApi::RegisterSpi(CThostFtdcMdSpi *pSpi) { m_pSpi = pSpi; }
+
+int ReplayMdApi::SubscribeMarketData(char *ppInstrumentID[], int nCount) {
+  return pushInstruments(Event::SubMarketData, ppInstrumentID, nCount, 0);
+}
+
+int ReplayMdApi::UnSubscribeMarketData(char *ppInstrumentID[], int nCount) {
+  return pushInstruments(Event::UnSubMarketData, ppInstrumentID, nCount, 0);
+}
+
+int ReplayMdApi::SubscribeForQuoteRsp(char *ppInstrumentID[], int nCount) {
+  return pushInstruments(Event::SubForQuoteRsp, ppInstrumentID, nCount, 0);
+}
+
+int ReplayMdApi::UnSubscribeForQuoteRsp(char *ppInstrumentID[], int nCount) {
+  return pushInstruments(Event::UnSubForQuoteRsp, ppInstrumentID, nCount, 0);
+}
+
+int ReplayMdApi::ReqUserLogin(CThostFtdcReqUserLoginField *pReqUserLoginField,
+                              int nRequestID) {
+  if (!pReqUserLoginField)
+    return -1;
+  Event event{};
+  event.eType = Event::UserLogin;
+  event.nRequestID = nRequestID;
+  event.bIsLast = true;
+  std::memcpy(event.user.BrokerID, pReqUserLoginField->BrokerID,
+              sizeof(event.user.BrokerID));
+  std::memcpy(event.user.UserID, pReqUserLoginField->UserID,
+              sizeof(event.user.UserID));
+  pushEvent(event);
+  return 0;
+}
+
+int ReplayMdApi::ReqUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                               int nRequestID) {
+  if (!pUserLogout)
+    return -1;
+  Event event{};
+  event.eType = Event::UserLogout;
+  event.nRequestID = nRequestID;
+  event.bIsLast = true;
+  event.user = *pUserLogout;
+  pushEvent(event);
+  return 0;
+}
+
+int ReplayMdApi::ReqQryMulticastInstrument(
+    CThostFtdcQryMulticastInstrumentField *, int) {
+  // 回放不提供组播合约信息
+  return -1;
+}
+
+int ReplayMdApi::pushInstruments(Event::Type eType, char *ppInstrumentID[],
+                                 int nCount, int nRequestID) {
+  if (!ppInstrumentID || nCount <= 0)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (int i = 0; i < nCount; ++i) {
+    Event event{};
+    event.eType = eType;
+    event.nRequestID = nRequestID;
+    event.bIsLast = i == nCount - 1;
+    std::strncpy(event.instrument.InstrumentID, ppInstrumentID[i],
+                 sizeof(event.instrument.InstrumentID) - 1);
+    m_events.push_back(event);
+  }
+  m_bHasEvents.store(true, std::memory_order_release);
+  m_cond.notify_all();
+  return 0;
+}
+
+void ReplayMdApi::pushEvent(const Event &event) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_events.push_back(event);
+  m_bHasEvents.store(true, std::memory_order_release);
+  m_cond.notify_all();
+}
+
+bool ReplayMdApi::processEvents() {
+  if (!m_bHasEvents.load(std::memory_order_acquire))
+    return false;
+
+  std::deque<Event> events;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    events.swap(m_events);
+    m_bHasEvents.store(false, std::memory_order_relaxed);
+  }
+  // 应答在锁外回调，SPI可以在回调中继续发起请求；
+  // 回调中Release()之后不再应答剩余的请求
+  for (const Event &event : events) {
+    if (!m_bRunning.load(std::memory_order_relaxed))
+      break;
+    handleEvent(event);
+  }
+  return !events.empty();
+}
+
+void ReplayMdApi::handleEvent(const Event &event) {
+  CThostFtdcRspInfoField rspInfo{};
+  CThostFtdcSpecificInstrumentField instrument = event.instrument;
+  CThostFtdcUserLogoutField user = event.user;
+
+  switch (event.eType) {
+  case Event::UserLogin: {
+    CThostFtdcRspUserLoginField login{};
+    std::strncpy(login.TradingDay, GetTradingDay(),
+                 sizeof(login.TradingDay) - 1);
+    std::time_t nNow = std::time(nullptr);
+    std::tm tmLocal;
+    localtime_r(&nNow, &tmLocal);
+    std::strftime(login.LoginTime, sizeof(login.LoginTime), "%H:%M:%S",
+                  &tmLocal);
+    std::memcpy(login.BrokerID, user.BrokerID, sizeof(login.BrokerID));
+    std::memcpy(login.UserID, user.UserID, sizeof(login.UserID));
+    std::strncpy(login.SystemName, "Replay", sizeof(login.SystemName) - 1);
+    login.FrontID = 1;
+    login.SessionID = 1;
+    std::strncpy(login.MaxOrderRef, "1", sizeof(login.MaxOrderRef) - 1);
+    m_bLoggedIn = true;
+    if (m_pSpi)
+      m_pSpi->OnRspUserLogin(&login, &rspInfo, event.nRequestID,
+                             event.bIsLast);
+    break;
+  }
+  case Event::UserLogout: {
+    m_bLoggedIn = false;
+    if (m_pSpi)
+      m_pSpi->OnRspUserLogout(&user, &rspInfo, event.nRequestID,
+                              event.bIsLast);
+    break;
+  }
+  case Event::SubMarketData:
+  case Event::UnSubMarketData: {
+    bool bSubscribe = event.eType == Event::SubMarketData;
+    // 日志中没有的合约同样应答成功，只是不会有行情
+    std::uint32_t nIndex = m_pInstruments->Find(instrument.InstrumentID);
+    if (nIndex != kInvalidInstrument)
+      m_pSubscribed[nIndex].store(bSubscribe, std::memory_order_relaxed);
+    if (bSubscribe)
+      m_bSubscribed = true;
+    if (m_pSpi) {
+      if (bSubscribe)
+        m_pSpi->OnRspSubMarketData(&instrument, &rspInfo, event.nRequestID,
+                                   event.bIsLast);
+      else
+        m_pSpi->OnRspUnSubMarketData(&instrument, &rspInfo, event.nRequestID,
+                                     event.bIsLast);
+    }
+    break;
+  }
+  case Event::SubForQuoteRsp:
+    if (m_pSpi)
+      m_pSpi->OnRspSubForQuoteRsp(&instrument, &rspInfo, event.nRequestID,
+                                  event.bIsLast);
+    break;
+  case Event::UnSubForQuoteRsp:
+    if (m_pSpi)
+      m_pSpi->OnRspUnSubForQuoteRsp(&instrument, &rspInfo, event.nRequestID,
+                                    event.bIsLast);
+    break;
+  }
+}
+
+void ReplayMdApi::waitForStart() {
+  while (m_bRunning.load(std::memory_order_acquire)) {
+    processEvents();
+    if (m_bLoggedIn && (m_bSubscribed || !m_options.bWaitForSubscribe))
+      return;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this] {
+      return m_bHasEvents.load(std::memory_order_relaxed) ||
+             !m_bRunning.load(std::memory_order_relaxed);
+    });
+  }
+}
+
+void ReplayMdApi::run() {
+  if (m_pSpi)
+    m_pSpi->OnFrontConnected();
+
+  waitForStart();
+
+  m_nStartNanos.store(steadyNanos(), std::memory_order_relaxed);
+  bool bRunning = m_bRunning.load(std::memory_order_acquire);
+  for (int nPass = 0; bRunning && nPass < m_options.nRepeat; ++nPass) {
+    for (std::size_t i = 0; bRunning && i < m_readers.size(); ++i) {
+      m_nJournal.store(i, std::memory_order_release);
+      bRunning = replayJournal(*m_readers[i], m_indices[i]);
+    }
+  }
+  m_nEndNanos.store(steadyNanos(), std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bFinished.store(true, std::memory_order_release);
+    m_cond.notify_all();
+  }
+
+  // 回放结束后继续应答请求，直到Release
+  while (m_bRunning.load(std::memory_order_acquire)) {
+    processEvents();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this] {
+      return m_bHasEvents.load(std::memory_order_relaxed) ||
+             !m_bRunning.load(std::memory_order_relaxed);
+    });
+  }
+
+  if (m_bReleaseOnExit)
+    delete this;
+}
+
+bool ReplayMdApi::replayJournal(const TickJournalReader &reader,
+                                const std::vector<std::uint32_t> &vecIndices) {
+  const std::uint64_t nCount = reader.GetRecordCount();
+  if (nCount == 0)
+    return true;
+
+  const bool bPaced = m_options.eSpeed != ReplaySpeed::AsFastAsPossible;
+  const double dScale = m_options.eSpeed == ReplaySpeed::Multiple
+                            ? 1.0 / m_options.dSpeedMultiple
+                            : 1.0;
+  const std::int64_t nFirstRecorded = recordNanos(reader.GetRecord(0));
+  const std::int64_t nReplayStart = steadyNanos();
+
+  CThostFtdcDepthMarketDataField tick;
+  for (std::uint64_t i = 0; i < nCount; ++i) {
+    processEvents();
+    if (!m_bRunning.load(std::memory_order_relaxed))
+      return false;
+
+    std::uint32_t nIndex = vecIndices[i];
+    if (nIndex == kInvalidInstrument ||
+        !m_pSubscribed[nIndex].load(std::memory_order_relaxed))
+      continue;
+
+    const TickJournalRecord &record = reader.GetRecord(i);
+    if (bPaced) {
+      std::int64_t nOffset = static_cast<std::int64_t>(
+          (recordNanos(record) - nFirstRecorded) * dScale);
+      std::int64_t nDue = nReplayStart + nOffset;
+      // 大段空闲（如午休）期间仍然及时应答请求
+      while (steadyNanos() < nDue) {
+        if (processEvents())
+          continue;
+        if (!m_bRunning.load(std::memory_order_relaxed))
+          return false;
+        std::int64_t nWait = nDue - steadyNanos();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait_for(lock, std::chrono::nanoseconds(nWait), [this] {
+          return m_bHasEvents.load(std::memory_order_relaxed) ||
+                 !m_bRunning.load(std::memory_order_relaxed);
+        });
+      }
+    }
+
+    // 日志是只读映射，拷贝一份交给SPI
+    std::memcpy(&tick, &record.tick, sizeof(tick));
+    if (m_pSpi)
+      m_pSpi->OnRtnDepthMarketData(&tick);
+    m_nDelivered.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+std::int64_t ReplayMdApi::GetElapsedNanos() const {
+  std::int64_t nStart = m_nStartNanos.load(std::memory_order_relaxed);
+  if (nStart == 0)
+    return 0;
+  std::int64_t nEnd = m_nEndNanos.load(std::memory_order_relaxed);
+  return (nEnd ? nEnd : steadyNanos()) - nStart;
+}
+
+} // namespace ctp
@@ -0,0 +1,509 @@
+#include "ctp_order_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace ctp {
+
+namespace {
+
+template <typename T> T *allocate(std::size_t nCount, int nFill) {
+  std::size_t nBytes = sizeof(T) * nCount;
+  void *p = ::operator new(nBytes, std::align_val_t(kCacheLineSize));
+  // 预先触页
+  std::memset(p, nFill, nBytes);
+  return static_cast<T *>(p);
+}
+
+template <typename T> void deallocate(T *p) {
+  ::operator delete(p, std::align_val_t(kCacheLineSize));
+}
+
+template <std::size_t N> void copyField(char (&dst)[N], const char *src) {
+  std::size_t nLength = strnlen(src, N - 1);
+  std::memcpy(dst, src, nLength);
+  std::memset(dst + nLength, 0, N - nLength);
+}
+
+} // namespace
+
+OrderStateEngine::OrderStateEngine(const InstrumentTable &table,
+                                   const OrderStateEngineOptions &options)
+    : m_table(table), m_nInstruments(table.Capacity()),
+      m_nMaxOrders(options.nMaxOrders), m_nBucketMask(0), m_pOrders(nullptr),
+      m_nOrders(0), m_pOrderBuckets(nullptr), m_pSysBuckets(nullptr),
+      m_pPositions(nullptr), m_nMaxTrades(options.nMaxTrades),
+      m_nTradeBucketMask(0), m_pTrades(nullptr), m_nTrades(0),
+      m_pTradeBuckets(nullptr),
+      m_nMaxUnmatched(std::max<std::size_t>(options.nMaxUnmatchedTrades, 1)),
+      m_pUnmatched(nullptr), m_nUnmatched(0), m_nDropped(0),
+      m_nUnknownTrades(0), m_nDuplicateTrades(0), m_nUnmatchedDropped(0) {
+  // 负载因子不超过0.5
+  std::size_t nBuckets = 16;
+  while (nBuckets < m_nMaxOrders * 2)
+    nBuckets <<= 1;
+  m_nBucketMask = nBuckets - 1;
+  std::size_t nTradeBuckets = 16;
+  while (nTradeBuckets < m_nMaxTrades * 2)
+    nTradeBuckets <<= 1;
+  m_nTradeBucketMask = nTradeBuckets - 1;
+
+  m_pOrders = allocate<OrderState>(m_nMaxOrders, 0);
+  m_pOrderBuckets = allocate<std::uint32_t>(nBuckets, 0xFF);
+  m_pSysBuckets = allocate<std::uint32_t>(nBuckets, 0xFF);
+  m_pPositions = allocate<PositionState>(m_nInstruments, 0);
+  m_pTrades = allocate<TradeKey>(m_nMaxTrades, 0);
+  m_pTradeBuckets = allocate<std::uint32_t>(nTradeBuckets, 0xFF);
+  m_pUnmatched = allocate<UnmatchedTrade>(m_nMaxUnmatched, 0);
+  for (std::size_t i = 0; i < m_nInstruments; ++i)
+    m_pPositions[i].nVolumeMultiple = 1;
+}
+
+OrderStateEngine::~OrderStateEngine() {
+  deallocate(m_pOrders);
+  deallocate(m_pOrderBuckets);
+  deallocate(m_pSysBuckets);
+  deallocate(m_pPositions);
+  deallocate(m_pTrades);
+  deallocate(m_pTradeBuckets);
+  deallocate(m_pUnmatched);
+}
+
+void OrderStateEngine::SetVolumeMultiple(std::uint32_t nInstrument,
+                                         int nVolumeMultiple) {
+  if (nInstrument >= m_nInstruments || nVolumeMultiple <= 0)
+    return;
+  PositionState &position = m_pPositions[nInstrument];
+  position.nVolumeMultiple = nVolumeMultiple;
+  mark(position, position.dLastPrice);
+}
+
+bool OrderStateEngine::LoadPosition(
+    const CThostFtdcInvestorPositionField &position) {
+  std::uint32_t nInstrument = m_table.Find(position.InstrumentID);
+  if (nInstrument == kInvalidInstrument || nInstrument >= m_nInstruments)
+    return false;
+
+  PositionState &state = m_pPositions[nInstrument];
+  // PositionCost含合约乘数
+  double dCost = position.PositionCost / state.nVolumeMultiple;
+  if (position.PosiDirection == THOST_FTDC_PD_Short) {
+    state.nShortPosition += position.Position;
+    state.nShortToday += position.TodayPosition;
+    state.dShortCost += dCost;
+  } else {
+    state.nLongPosition += position.Position;
+    state.nLongToday += position.TodayPosition;
+    state.dLongCost += dCost;
+  }
+  if (state.dLastPrice != 0.0)
+    mark(state, state.dLastPrice);
+  return true;
+}
+
+const OrderState *
+OrderStateEngine::OnRtnOrder(const CThostFtdcOrderField &order) {
+  std::uint64_t nOrderRef = parseOrderRef(order.OrderRef);
+  std::size_t nBucket;
+  std::uint32_t nOrder = findOrder(order.FrontID, order.SessionID, nOrderRef,
+                                   order.OrderRef, nBucket);
+  if (nOrder == kInvalidOrder) {
+    if (m_nOrders == m_nMaxOrders) {
+      ++m_nDropped;
+      return nullptr;
+    }
+    nOrder = static_cast<std::uint32_t>(m_nOrders++);
+    m_pOrderBuckets[nBucket] = nOrder;
+
+    OrderState &state = m_pOrders[nOrder];
+    std::memset(&state, 0, sizeof(state));
+    state.nFrontID = order.FrontID;
+    state.nSessionID = order.SessionID;
+    state.nOrderRef = nOrderRef;
+    state.nInstrument = m_table.Find(order.InstrumentID);
+    state.cDirection = order.Direction;
+    state.cOffsetFlag = order.CombOffsetFlag[0];
+    state.nVolumeTotalOriginal = order.VolumeTotalOriginal;
+    state.dLimitPrice = order.LimitPrice;
+    copyField(state.szOrderRef, order.OrderRef);
+    copyField(state.szExchangeID, order.ExchangeID);
+  }
+
+  OrderState &state = m_pOrders[nOrder];
+  // 重放或乱序到达的旧回报：已结束的报单不再回到活动状态，成交量不回退
+  if (order.VolumeTraded < state.nVolumeTraded)
+    return &state;
+  if (state.cOrderStatus != '\0' && !state.IsActive()) {
+    OrderState incoming = state;
+    incoming.cOrderStatus = order.OrderStatus;
+    incoming.cSubmitStatus = order.OrderSubmitStatus;
+    if (incoming.IsActive())
+      return &state;
+  }
+  state.cOrderStatus = order.OrderStatus;
+  state.cSubmitStatus = order.OrderSubmitStatus;
+  state.nVolumeTraded = order.VolumeTraded;
+  state.nVolumeTotal = order.VolumeTotal;
+
+  // 交易所确认后才有OrderSysID，首次出现时建立索引
+  if (state.szOrderSysID[0] == '\0' && order.OrderSysID[0] != '\0') {
+    copyField(state.szExchangeID, order.ExchangeID);
+    if (findSysOrder(order.ExchangeID, order.OrderSysID, nBucket) ==
+        kInvalidOrder) {
+      copyField(state.szOrderSysID, order.OrderSysID);
+      m_pSysBuckets[nBucket] = nOrder;
+      creditUnmatched(state);
+    }
+  }
+  return &state;
+}
+
+bool OrderStateEngine::OnRtnTrade(const CThostFtdcTradeField &trade) {
+  TradeKey key;
+  std::memset(&key, 0, sizeof(key));
+  copyField(key.szExchangeID, trade.ExchangeID);
+  copyField(key.szTradeID, trade.TradeID);
+  key.cDirection = trade.Direction;
+  if (!addTrade(key)) {
+    ++m_nDuplicateTrades;
+    return false;
+  }
+
+  std::size_t nBucket;
+  std::uint32_t nOrder =
+      findSysOrder(trade.ExchangeID, trade.OrderSysID, nBucket);
+  if (nOrder != kInvalidOrder) {
+    OrderState &order = m_pOrders[nOrder];
+    order.nTradeVolume += trade.Volume;
+    order.dTradeAmount += trade.Price * trade.Volume;
+  } else if (trade.OrderSysID[0] != '\0') {
+    // 报单的OrderSysID尚未由OnRtnOrder建立索引，先暂存
+    addUnmatched(trade);
+  }
+
+  std::uint32_t nInstrument = m_table.Find(trade.InstrumentID);
+  if (nInstrument == kInvalidInstrument || nInstrument >= m_nInstruments) {
+    ++m_nUnknownTrades;
+    return false;
+  }
+
+  PositionState &position = m_pPositions[nInstrument];
+  bool bBuy = trade.Direction == THOST_FTDC_D_Buy;
+  if (trade.OffsetFlag == THOST_FTDC_OF_Open) {
+    if (bBuy) {
+      position.nLongPosition += trade.Volume;
+      position.nLongToday += trade.Volume;
+      position.dLongCost += trade.Price * trade.Volume;
+    } else {
+      position.nShortPosition += trade.Volume;
+      position.nShortToday += trade.Volume;
+      position.dShortCost += trade.Price * trade.Volume;
+    }
+  } else if (bBuy) {
+    // 买平：平空头
+    close(position.nShortPosition, position.nShortToday, position.dShortCost,
+          trade.OffsetFlag, trade.Volume, trade.Price, false, position);
+  } else {
+    close(position.nLongPosition, position.nLongToday, position.dLongCost,
+          trade.OffsetFlag, trade.Volume, trade.Price, true, position);
+  }
+  mark(position, trade.Price);
+  return true;
+}
+
+void OrderStateEngine::addUnmatched(const CThostFtdcTradeField &trade) {
+  const double dAmount = trade.Price * trade.Volume;
+  for (std::size_t i = 0; i < m_nUnmatched; ++i) {
+    UnmatchedTrade &unmatched = m_pUnmatched[i];
+    if (std::strncmp(unmatched.szOrderSysID, trade.OrderSysID,
+                     sizeof(TThostFtdcOrderSysIDType)) == 0 &&
+        std::strncmp(unmatched.szExchangeID, trade.ExchangeID,
+                     sizeof(TThostFtdcExchangeIDType)) == 0) {
+      unmatched.nVolume += trade.Volume;
+      unmatched.dAmount += dAmount;
+      return;
+    }
+  }
+  if (m_nUnmatched == m_nMaxUnmatched) {
+    // 最早的一笔最可能永远等不到报单回报
+    std::memmove(static_cast<void *>(m_pUnmatched), m_pUnmatched + 1,
+                 sizeof(UnmatchedTrade) * (m_nUnmatched - 1));
+    --m_nUnmatched;
+    ++m_nUnmatchedDropped;
+  }
+  UnmatchedTrade &unmatched = m_pUnmatched[m_nUnmatched++];
+  copyField(unmatched.szExchangeID, trade.ExchangeID);
+  copyField(unmatched.szOrderSysID, trade.OrderSysID);
+  unmatched.nVolume = trade.Volume;
+  unmatched.dAmount = dAmount;
+}
+
+void OrderStateEngine::creditUnmatched(OrderState &order) {
+  for (std::size_t i = 0; i < m_nUnmatched; ++i) {
+    const UnmatchedTrade &unmatched = m_pUnmatched[i];
+    if (std::strncmp(unmatched.szOrderSysID, order.szOrderSysID,
+                     sizeof(TThostFtdcOrderSysIDType)) != 0 ||
+        std::strncmp(unmatched.szExchangeID, order.szExchangeID,
+                     sizeof(TThostFtdcExchangeIDType)) != 0)
+      continue;
+    order.nTradeVolume += unmatched.nVolume;
+    order.dTradeAmount += unmatched.dAmount;
+    // 同一报单只有一条，保持其余条目的先后顺序
+    std::memmove(static_cast<void *>(m_pUnmatched + i), m_pUnmatched + i + 1,
+                 sizeof(UnmatchedTrade) * (m_nUnmatched - i - 1));
+    --m_nUnmatched;
+    return;
+  }
+}
+
+void OrderStateEngine::close(std::int32_t &nPosition, std::int32_t &nToday,
+                             double &dCost, char cOffsetFlag, int nVolume,
+                             double dPrice, bool bLong,
+                             PositionState &position) {
+  // 持仓与回报不同步时只平掉已知的持仓
+  int nClose = std::min(nVolume, nPosition);
+  if (nClose <= 0)
+    return;
+
+  double dAverage = dCost / nPosition;
+  double dPnL = (dPrice - dAverage) * nClose * position.nVolumeMultiple;
+  position.dRealizedPnL += bLong ? dPnL : -dPnL;
+  dCost = nClose == nPosition ? 0.0 : dCost - dAverage * nClose;
+
+  // 平今只减今仓；平仓、强平先平昨仓再平今仓
+  int nYesterday = nPosition - nToday;
+  int nFromToday = 0;
+  if (cOffsetFlag == THOST_FTDC_OF_CloseToday)
+    nFromToday = std::min(nClose, nToday);
+  else if (cOffsetFlag != THOST_FTDC_OF_CloseYesterday)
+    nFromToday = std::max(0, nClose - nYesterday);
+  nToday -= nFromToday;
+  nPosition -= nClose;
+  if (nToday > nPosition)
+    nToday = nPosition;
+}
+
+const OrderState *OrderStateEngine::FindOrder(int nFrontID, int nSessionID,
+                                              const char *pszOrderRef) const {
+  std::size_t nBucket;
+  std::uint32_t nOrder = findOrder(nFrontID, nSessionID,
+                                   parseOrderRef(pszOrderRef), pszOrderRef,
+                                   nBucket);
+  return nOrder == kInvalidOrder ? nullptr : &m_pOrders[nOrder];
+}
+
+const OrderState *
+OrderStateEngine::FindOrder(const char *pszExchangeID,
+                            const char *pszOrderSysID) const {
+  std::size_t nBucket;
+  std::uint32_t nOrder = findSysOrder(pszExchangeID, pszOrderSysID, nBucket);
+  return nOrder == kInvalidOrder ? nullptr : &m_pOrders[nOrder];
+}
+
+double OrderStateEngine::GetTotalRealizedPnL() const {
+  double dTotal = 0.0;
+  for (std::size_t i = 0; i < m_table.Size() && i < m_nInstruments; ++i)
+    dTotal += m_pPositions[i].dRealizedPnL;
+  return dTotal;
+}
+
+double OrderStateEngine::GetTotalUnrealizedPnL() const {
+  double dTotal = 0.0;
+  for (std::size_t i = 0; i < m_table.Size() && i < m_nInstruments; ++i)
+    dTotal += m_pPositions[i].dUnrealizedPnL;
+  return dTotal;
+}
+
+void OrderStateEngine::Reset() {
+  m_nOrders = 0;
+  std::size_t nBytes = sizeof(std::uint32_t) * (m_nBucketMask + 1);
+  std::memset(m_pOrderBuckets, 0xFF, nBytes);
+  std::memset(m_pSysBuckets, 0xFF, nBytes);
+  m_nTrades = 0;
+  std::memset(m_pTradeBuckets, 0xFF,
+              sizeof(std::uint32_t) * (m_nTradeBucketMask + 1));
+  m_nUnmatched = 0;
+  for (std::size_t i = 0; i < m_nInstruments; ++i) {
+    PositionState &position = m_pPositions[i];
+    position.nLongToday = 0;
+    position.nShortToday = 0;
+    position.dRealizedPnL = 0.0;
+  }
+}
+
+std::uint64_t OrderStateEngine::parseOrderRef(const char *pszOrderRef) {
+  // OrderRef通常是右对齐的数字串，跳过空格按十进制解析，12位以内不会溢出，
+  // 数值不同则键不同；含非数字字符时改用去掉空格后字节串的FNV-1a哈希并置
+  // 最高位，这类键可能碰撞，匹配时须再由sameOrderRef()核对原串
+  std::uint64_t nOrderRef = 0;
+  std::uint64_t nHash = 14695981039346656037ull;
+  bool bNumeric = true;
+  for (std::size_t i = 0;
+       i < sizeof(TThostFtdcOrderRefType) && pszOrderRef[i]; ++i) {
+    char c = pszOrderRef[i];
+    if (c == ' ')
+      continue;
+    if (c >= '0' && c <= '9')
+      nOrderRef = nOrderRef * 10 + static_cast<std::uint64_t>(c - '0');
+    else
+      bNumeric = false;
+    nHash ^= static_cast<unsigned char>(c);
+    nHash *= 1099511628211ull;
+  }
+  return bNumeric ? nOrderRef : nHash | kHashedOrderRef;
+}
+
+bool OrderStateEngine::sameOrderRef(std::uint64_t nOrderRef,
+                                    const char *pszLeft,
+                                    const char *pszRight) {
+  if (!(nOrderRef & kHashedOrderRef))
+    return true;
+  // 逐个比较去掉空格后的字符
+  constexpr std::size_t kSize = sizeof(TThostFtdcOrderRefType);
+  std::size_t i = 0, j = 0;
+  for (;;) {
+    while (i < kSize && pszLeft[i] == ' ')
+      ++i;
+    while (j < kSize && pszRight[j] == ' ')
+      ++j;
+    char cLeft = i < kSize ? pszLeft[i] : '\0';
+    char cRight = j < kSize ? pszRight[j] : '\0';
+    if (cLeft != cRight)
+      return false;
+    if (cLeft == '\0')
+      return true;
+    ++i;
+    ++j;
+  }
+}
+
+std::uint32_t OrderStateEngine::hashOrderKey(int nFrontID, int nSessionID,
+                                             std::uint64_t nOrderRef) {
+  // splitmix64的混合函数
+  std::uint64_t x = (static_cast<std::uint64_t>(
+                         static_cast<std::uint32_t>(nFrontID))
+                     << 32) |
+                    static_cast<std::uint32_t>(nSessionID);
+  x ^= nOrderRef * 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return static_cast<std::uint32_t>(x ^ (x >> 31));
+}
+
+std::uint32_t OrderStateEngine::hashSysKey(const char *pszExchangeID,
+                                           const char *pszOrderSysID) {
+  // FNV-1a
+  std::uint32_t nHash = 2166136261u;
+  for (std::size_t i = 0;
+       i < sizeof(TThostFtdcExchangeIDType) && pszExchangeID[i]; ++i) {
+    nHash ^= static_cast<unsigned char>(pszExchangeID[i]);
+    nHash *= 16777619u;
+  }
+  nHash ^= '|';
+  nHash *= 16777619u;
+  for (std::size_t i = 0;
+       i < sizeof(TThostFtdcOrderSysIDType) && pszOrderSysID[i]; ++i) {
+    nHash ^= static_cast<unsigned char>(pszOrderSysID[i]);
+    nHash *= 16777619u;
+  }
+  return nHash;
+}
+
+std::uint32_t OrderStateEngine::hashTradeKey(const TradeKey &key) {
+  // FNV-1a
+  std::uint32_t nHash = 2166136261u;
+  for (std::size_t i = 0; i < sizeof(key.szExchangeID) && key.szExchangeID[i];
+       ++i) {
+    nHash ^= static_cast<unsigned char>(key.szExchangeID[i]);
+    nHash *= 16777619u;
+  }
+  nHash ^= static_cast<unsigned char>(key.cDirection);
+  nHash *= 16777619u;
+  for (std::size_t i = 0; i < sizeof(key.szTradeID) && key.szTradeID[i];
+       ++i) {
+    nHash ^= static_cast<unsigned char>(key.szTradeID[i]);
+    nHash *= 16777619u;
+  }
+  return nHash;
+}
+
+std::uint32_t OrderStateEngine::findOrder(int nFrontID, int nSessionID,
+                                          std::uint64_t nOrderRef,
+                                          const char *pszOrderRef,
+                                          std::size_t &nBucket) const {
+  for (std::size_t i = hashOrderKey(nFrontID, nSessionID, nOrderRef) &
+                       m_nBucketMask;;
+       i = (i + 1) & m_nBucketMask) {
+    std::uint32_t nOrder = m_pOrderBuckets[i];
+    if (nOrder == kInvalidOrder) {
+      nBucket = i;
+      return kInvalidOrder;
+    }
+    const OrderState &order = m_pOrders[nOrder];
+    if (order.nOrderRef == nOrderRef && order.nSessionID == nSessionID &&
+        order.nFrontID == nFrontID &&
+        sameOrderRef(nOrderRef, order.szOrderRef, pszOrderRef)) {
+      nBucket = i;
+      return nOrder;
+    }
+  }
+}
+
+std::uint32_t OrderStateEngine::findSysOrder(const char *pszExchangeID,
+                                             const char *pszOrderSysID,
+                                             std::size_t &nBucket) const {
+  for (std::size_t i = hashSysKey(pszExchangeID, pszOrderSysID) &
+                       m_nBucketMask;;
+       i = (i + 1) & m_nBucketMask) {
+    std::uint32_t nOrder = m_pSysBuckets[i];
+    if (nOrder == kInvalidOrder) {
+      nBucket = i;
+      return kInvalidOrder;
+    }
+    const OrderState &order = m_pOrders[nOrder];
+    if (std::strncmp(order.szOrderSysID, pszOrderSysID,
+                     sizeof(TThostFtdcOrderSysIDType)) == 0 &&
+        std::strncmp(order.szExchangeID, pszExchangeID,
+                     sizeof(TThostFtdcExchangeIDType)) == 0) {
+      nBucket = i;
+      return nOrder;
+    }
+  }
+}
+
+std::uint32_t OrderStateEngine::findTrade(const TradeKey &key,
+                                          std::size_t &nBucket) const {
+  for (std::size_t i = hashTradeKey(key) & m_nTradeBucketMask;;
+       i = (i + 1) & m_nTradeBucketMask) {
+    std::uint32_t nTrade = m_pTradeBuckets[i];
+    if (nTrade == kInvalidOrder) {
+      nBucket = i;
+      return kInvalidOrder;
+    }
+    const TradeKey &trade = m_pTrades[nTrade];
+    if (trade.cDirection == key.cDirection &&
+        std::strncmp(trade.szTradeID, key.szTradeID,
+                     sizeof(TThostFtdcTradeIDType)) == 0 &&
+        std::strncmp(trade.szExchangeID, key.szExchangeID,
+                     sizeof(TThostFtdcExchangeIDType)) == 0) {
+      nBucket = i;
+      return nTrade;
+    }
+  }
+}
+
+bool OrderStateEngine::addTrade(const TradeKey &key) {
+  std::size_t nBucket;
+  if (findTrade(key, nBucket) != kInvalidOrder)
+    return false;
+  // 去重表已满时照常处理成交，只是不再能识别其重复推送
+  if (m_nTrades < m_nMaxTrades) {
+    std::uint32_t nTrade = static_cast<std::uint32_t>(m_nTrades++);
+    m_pTrades[nTrade] = key;
+    m_pTradeBuckets[nBucket] = nTrade;
+  }
+  return true;
+}
+
+} // namespace ctp
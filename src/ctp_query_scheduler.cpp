@@ -0,0 +1,233 @@
+#include "ctp_query_scheduler.h"
+
+#include <cstdio>
+
+namespace ctp {
+
+QueryScheduler::QueryScheduler(CThostFtdcTraderApi *pApi,
+                               const QuerySchedulerOptions &options)
+    : m_pApi(pApi), m_options(options), m_nInFlightRequestID(0),
+      m_inFlightDeadline(), m_inFlightRspInfo(),
+      m_nNextRequestID(options.nFirstRequestID),
+      m_dTokens(options.dBurst), m_lastRefill(Clock::now()),
+      m_notBefore(Clock::time_point::min()), m_bRunning(false),
+      m_bPaused(false), m_nSent(0), m_nCoalesced(0), m_nThrottled(0) {}
+
+QueryScheduler::~QueryScheduler() { Stop(); }
+
+void QueryScheduler::Start() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bPaused = false;
+    if (!m_bRunning) {
+      m_bRunning = true;
+      m_thread = std::thread(&QueryScheduler::run, this);
+      return;
+    }
+  }
+  m_cond.notify_all();
+}
+
+void QueryScheduler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_bRunning)
+      return;
+    m_bRunning = false;
+  }
+  m_cond.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &queue : m_queues)
+    queue.clear();
+  m_pInFlight.reset();
+}
+
+void QueryScheduler::OnFrontDisconnected() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bPaused = true;
+    if (!m_pInFlight)
+      return;
+    m_pInFlight->Reset();
+    auto &queue = m_queues[static_cast<int>(m_pInFlight->ePriority)];
+    queue.push_front(std::move(m_pInFlight));
+  }
+  m_cond.notify_all();
+}
+
+std::size_t QueryScheduler::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::size_t nCount = m_pInFlight ? 1 : 0;
+  for (const auto &queue : m_queues)
+    nCount += queue.size();
+  return nCount;
+}
+
+void QueryScheduler::submit(std::string &&strKey, QueryPriority ePriority,
+                            const std::function<Job *()> &fnCreate,
+                            const std::function<void(Job *)> &fnAddCallback) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &queue : m_queues) {
+      for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if ((*it)->strKey != strKey)
+          continue;
+        fnAddCallback(it->get());
+        m_nCoalesced.fetch_add(1, std::memory_order_relaxed);
+        // 合并后按较高的优先级排队
+        if (ePriority < (*it)->ePriority) {
+          std::unique_ptr<Job> pJob = std::move(*it);
+          queue.erase(it);
+          pJob->ePriority = ePriority;
+          m_queues[static_cast<int>(ePriority)].push_back(std::move(pJob));
+        }
+        return;
+      }
+    }
+
+    std::unique_ptr<Job> pJob(fnCreate());
+    pJob->strKey = std::move(strKey);
+    pJob->ePriority = ePriority;
+    fnAddCallback(pJob.get());
+    m_queues[static_cast<int>(ePriority)].push_back(std::move(pJob));
+  }
+  m_cond.notify_all();
+}
+
+bool QueryScheduler::onRsp(const std::type_info *pType, const void *pRsp,
+                           CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                           bool bIsLast) {
+  std::unique_ptr<Job> pDone;
+  CThostFtdcRspInfoField rspInfo;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pInFlight || nRequestID != m_nInFlightRequestID)
+      return false;
+    if (pRspInfo && pRspInfo->ErrorID != 0)
+      m_inFlightRspInfo = *pRspInfo;
+    if (pRsp && pType && *pType == m_pInFlight->ResponseType())
+      m_pInFlight->Append(pRsp);
+    if (!bIsLast) {
+      // 分段应答仍在到达，时限从这一段重新计算
+      m_inFlightDeadline = Clock::now() + std::chrono::milliseconds(
+                                              m_options.nInFlightTimeoutMs);
+      return true;
+    }
+    pDone = std::move(m_pInFlight);
+    rspInfo = m_inFlightRspInfo;
+  }
+  m_cond.notify_all();
+  pDone->Complete(rspInfo);
+  return true;
+}
+
+void QueryScheduler::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_bRunning) {
+    std::deque<std::unique_ptr<Job>> *pQueue = nullptr;
+    for (auto &queue : m_queues) {
+      if (!queue.empty()) {
+        pQueue = &queue;
+        break;
+      }
+    }
+    if (m_pInFlight) {
+      if (m_options.nInFlightTimeoutMs <= 0) {
+        m_cond.wait(lock);
+      } else if (Clock::now() < m_inFlightDeadline) {
+        m_cond.wait_until(lock, m_inFlightDeadline);
+      } else {
+        // 应答丢失，不再占住唯一的在途名额；迟到的应答因RequestID不符被忽略
+        fail(std::move(m_pInFlight), kQryErrorTimeout, "query timed out",
+             lock);
+      }
+      continue;
+    }
+    if (m_bPaused || !pQueue) {
+      m_cond.wait(lock);
+      continue;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (now < m_notBefore) {
+      m_cond.wait_until(lock, m_notBefore);
+      continue;
+    }
+    refill(now);
+    if (m_dTokens < 1.0) {
+      auto wait = std::chrono::duration<double>((1.0 - m_dTokens) /
+                                                m_options.dQueriesPerSecond);
+      m_cond.wait_until(
+          lock, now + std::chrono::duration_cast<Clock::duration>(wait));
+      continue;
+    }
+    m_dTokens -= 1.0;
+
+    m_pInFlight = std::move(pQueue->front());
+    pQueue->pop_front();
+    m_pInFlight->Reset();
+    std::memset(&m_inFlightRspInfo, 0, sizeof(m_inFlightRspInfo));
+    const int nRequestID = m_nNextRequestID++;
+    m_nInFlightRequestID = nRequestID;
+    m_inFlightDeadline =
+        Clock::now() + std::chrono::milliseconds(m_options.nInFlightTimeoutMs);
+    Job *pJob = m_pInFlight.get();
+
+    // ReqQry*可能阻塞在网络层，不在锁内调用
+    lock.unlock();
+    int nRet = pJob->Send(m_pApi, nRequestID);
+    m_nSent.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+
+    // 发送失败不会有应答；断线时在途查询可能已被重新排队
+    if (nRet == 0 || m_pInFlight.get() != pJob)
+      continue;
+    std::unique_ptr<Job> pFailed = std::move(m_pInFlight);
+    if (nRet == kQryRetNotConnected) {
+      // 连接断开，等重新登录后的Start()再发
+      m_bPaused = true;
+      m_queues[static_cast<int>(pFailed->ePriority)].push_front(
+          std::move(pFailed));
+      continue;
+    }
+    if (nRet == kQryRetTooManyPending || nRet == kQryRetTooFrequent) {
+      m_nThrottled.fetch_add(1, std::memory_order_relaxed);
+      if (nRet == kQryRetTooFrequent)
+        m_dTokens = 0.0;
+      else
+        m_notBefore =
+            Clock::now() + std::chrono::milliseconds(m_options.nRetryDelayMs);
+      m_queues[static_cast<int>(pFailed->ePriority)].push_front(
+          std::move(pFailed));
+      continue;
+    }
+
+    char szMsg[32];
+    std::snprintf(szMsg, sizeof(szMsg), "ReqQry returned %d", nRet);
+    fail(std::move(pFailed), nRet, szMsg, lock);
+  }
+}
+
+void QueryScheduler::fail(std::unique_ptr<Job> pJob, int nErrorID,
+                          const char *pszMsg,
+                          std::unique_lock<std::mutex> &lock) {
+  CThostFtdcRspInfoField rspInfo = {};
+  rspInfo.ErrorID = nErrorID;
+  std::snprintf(rspInfo.ErrorMsg, sizeof(rspInfo.ErrorMsg), "%s", pszMsg);
+  lock.unlock();
+  pJob->Complete(rspInfo);
+  lock.lock();
+}
+
+void QueryScheduler::refill(Clock::time_point now) {
+  double dElapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+  m_lastRefill = now;
+  m_dTokens += dElapsed * m_options.dQueriesPerSecond;
+  if (m_dTokens > m_options.dBurst)
+    m_dTokens = m_options.dBurst;
+}
+
+} // namespace ctp
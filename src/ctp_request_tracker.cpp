@@ -0,0 +1,236 @@
+#include "ctp_request_tracker.h"
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace ctp {
+
+RequestFuture &RequestFuture::operator=(RequestFuture &&other) noexcept {
+  if (this != &other) {
+    Release();
+    m_pTracker = other.m_pTracker;
+    m_nRequestID = other.m_nRequestID;
+    other.m_pTracker = nullptr;
+  }
+  return *this;
+}
+
+bool RequestFuture::Wait(std::chrono::nanoseconds timeout) {
+  if (!m_pTracker)
+    return false;
+  RequestTracker::Slot &slot = m_pTracker->slotOf(m_nRequestID);
+  const std::uint64_t nDone =
+      RequestTracker::makeTag(m_nRequestID, RequestTracker::kDone);
+  std::unique_lock<std::mutex> lock(slot.mutex);
+  return slot.cond.wait_for(lock, timeout, [&slot, nDone]() {
+    return slot.nTag.load(std::memory_order_acquire) == nDone;
+  });
+}
+
+const RequestResult &RequestFuture::Get() const {
+  return m_pTracker->slotOf(m_nRequestID).result;
+}
+
+void RequestFuture::Release() {
+  if (!m_pTracker)
+    return;
+  RequestTracker::Slot &slot = m_pTracker->slotOf(m_nRequestID);
+  {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    std::uint64_t nTag =
+        RequestTracker::makeTag(m_nRequestID, RequestTracker::kPending);
+    // 应答未到时交给回调线程在应答到达后释放；已完成（含Cancel）时在此释放
+    if (!slot.nTag.compare_exchange_strong(
+            nTag,
+            RequestTracker::makeTag(m_nRequestID, RequestTracker::kAbandoned),
+            std::memory_order_acq_rel) &&
+        nTag == RequestTracker::makeTag(m_nRequestID, RequestTracker::kDone))
+      m_pTracker->free(slot);
+  }
+  m_pTracker = nullptr;
+}
+
+RequestTracker::RequestTracker(const RequestTrackerOptions &options)
+    : m_nMask(0), m_nRowBufferBytes(options.nRowBufferBytes),
+      m_pSlots(nullptr), m_pBuffers(nullptr), m_nNextRequestID(1),
+      m_nPending(0), m_nRejected(0) {
+  std::size_t nCapacity = 2;
+  while (nCapacity < options.nCapacity)
+    nCapacity <<= 1;
+  m_nMask = nCapacity - 1;
+
+  m_pSlots = new Slot[nCapacity];
+  std::size_t nBytes = nCapacity * m_nRowBufferBytes;
+  m_pBuffers = static_cast<char *>(
+      ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+  // 预先触页，避免首次应答时在回调线程上产生缺页中断
+  std::memset(m_pBuffers, 0, nBytes);
+  for (std::size_t i = 0; i < nCapacity; ++i) {
+    m_pSlots[i].nTag.store(makeTag(0, kFree), std::memory_order_relaxed);
+    m_pSlots[i].bFuture.store(false, std::memory_order_relaxed);
+    m_pSlots[i].result.pRows = m_pBuffers + i * m_nRowBufferBytes;
+  }
+}
+
+RequestTracker::~RequestTracker() {
+  delete[] m_pSlots;
+  ::operator delete(m_pBuffers, std::align_val_t(kCacheLineSize));
+}
+
+int RequestTracker::Begin(RequestCallback fnCallback, void *pContext) {
+  return claim(fnCallback, pContext, false);
+}
+
+RequestFuture RequestTracker::BeginFuture() {
+  int nRequestID = claim(nullptr, nullptr, true);
+  if (nRequestID < 0)
+    return RequestFuture();
+  return RequestFuture(this, nRequestID);
+}
+
+void RequestTracker::Cancel(int nRequestID) {
+  Slot &slot = slotOf(nRequestID);
+  std::uint64_t nTag = slot.nTag.load(std::memory_order_acquire);
+  if (tagRequestID(nTag) != nRequestID)
+    return;
+  if (slot.bFuture.load(std::memory_order_relaxed)) {
+    // RequestFuture仍持有槽位，以错误完成，由它释放
+    CThostFtdcRspInfoField rspInfo = {};
+    rspInfo.ErrorID = -1;
+    std::snprintf(rspInfo.ErrorMsg, sizeof(rspInfo.ErrorMsg),
+                  "request canceled");
+    complete(slot, nRequestID, &rspInfo);
+    return;
+  }
+  std::uint64_t nExpected = makeTag(nRequestID, kPending);
+  if (slot.nTag.compare_exchange_strong(nExpected, makeTag(0, kFree),
+                                        std::memory_order_acq_rel))
+    m_nPending.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void RequestTracker::OnFrontDisconnected() {
+  CThostFtdcRspInfoField rspInfo = {};
+  rspInfo.ErrorID = -1;
+  std::snprintf(rspInfo.ErrorMsg, sizeof(rspInfo.ErrorMsg),
+                "front disconnected");
+  for (std::size_t i = 0; i <= m_nMask; ++i) {
+    Slot &slot = m_pSlots[i];
+    std::uint64_t nTag = slot.nTag.load(std::memory_order_acquire);
+    SlotState eState = tagState(nTag);
+    if (eState == kPending || eState == kAbandoned)
+      complete(slot, tagRequestID(nTag), &rspInfo);
+  }
+}
+
+int RequestTracker::claim(RequestCallback fnCallback, void *pContext,
+                          bool bFuture) {
+  // 槽位被仍在途的旧请求占用时换下一个RequestID，最多尝试一圈
+  for (std::size_t i = 0; i <= m_nMask; ++i) {
+    int nRequestID = m_nNextRequestID.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = slotOf(nRequestID);
+    std::uint64_t nTag = slot.nTag.load(std::memory_order_relaxed);
+    if (tagState(nTag) != kFree ||
+        !slot.nTag.compare_exchange_strong(nTag,
+                                           makeTag(nRequestID, kClaiming),
+                                           std::memory_order_acquire))
+      continue;
+
+    slot.bFuture.store(bFuture, std::memory_order_relaxed);
+    slot.fnCallback = fnCallback;
+    slot.pContext = pContext;
+    slot.nBeginNs = nowNs();
+    slot.result.nRequestID = nRequestID;
+    std::memset(&slot.result.rspInfo, 0, sizeof(slot.result.rspInfo));
+    slot.result.nRowSize = 0;
+    slot.result.nRows = 0;
+    slot.result.bTruncated = false;
+    slot.result.nLatencyNs = 0;
+    m_nPending.fetch_add(1, std::memory_order_relaxed);
+    slot.nTag.store(makeTag(nRequestID, kPending), std::memory_order_release);
+    return nRequestID;
+  }
+  m_nRejected.fetch_add(1, std::memory_order_relaxed);
+  return -1;
+}
+
+bool RequestTracker::onRsp(const void *pRow, std::size_t nRowSize,
+                           const CThostFtdcRspInfoField *pRspInfo,
+                           int nRequestID, bool bIsLast) {
+  if (nRequestID <= 0)
+    return false;
+  Slot &slot = slotOf(nRequestID);
+  std::uint64_t nTag = slot.nTag.load(std::memory_order_acquire);
+  if (nTag != makeTag(nRequestID, kPending) &&
+      nTag != makeTag(nRequestID, kAbandoned))
+    return false;
+
+  RequestResult &result = slot.result;
+  if (pRspInfo && pRspInfo->ErrorID != 0 && result.rspInfo.ErrorID == 0)
+    result.rspInfo = *pRspInfo;
+  if (pRow) {
+    if (result.nRows == 0)
+      result.nRowSize = nRowSize;
+    if (nRowSize != result.nRowSize ||
+        (result.nRows + 1) * nRowSize > m_nRowBufferBytes) {
+      result.bTruncated = true;
+    } else {
+      std::memcpy(static_cast<char *>(const_cast<void *>(result.pRows)) +
+                      result.nRows * nRowSize,
+                  pRow, nRowSize);
+      ++result.nRows;
+    }
+  }
+  if (bIsLast)
+    complete(slot, nRequestID, nullptr);
+  return true;
+}
+
+bool RequestTracker::complete(Slot &slot, int nRequestID,
+                              const CThostFtdcRspInfoField *pError) {
+  std::uint64_t nTag = slot.nTag.load(std::memory_order_acquire);
+  if (nTag != makeTag(nRequestID, kPending) &&
+      nTag != makeTag(nRequestID, kAbandoned))
+    return false;
+
+  if (slot.bFuture.load(std::memory_order_relaxed)) {
+    {
+      // 与RequestFuture::Release和Cancel在同一把锁内转换状态
+      std::lock_guard<std::mutex> lock(slot.mutex);
+      nTag = slot.nTag.load(std::memory_order_acquire);
+      if (nTag == makeTag(nRequestID, kAbandoned)) {
+        free(slot);
+        return true;
+      }
+      if (nTag != makeTag(nRequestID, kPending))
+        return false;
+      if (pError && slot.result.rspInfo.ErrorID == 0)
+        slot.result.rspInfo = *pError;
+      slot.result.nLatencyNs = nowNs() - slot.nBeginNs;
+      slot.nTag.store(makeTag(nRequestID, kDone), std::memory_order_release);
+    }
+    slot.cond.notify_all();
+    return true;
+  }
+
+  // 回调方式：CAS成功的一方独占完成，与并发的Cancel互斥
+  std::uint64_t nExpected = makeTag(nRequestID, kPending);
+  if (!slot.nTag.compare_exchange_strong(nExpected,
+                                         makeTag(nRequestID, kCompleting),
+                                         std::memory_order_acq_rel))
+    return false;
+  if (pError && slot.result.rspInfo.ErrorID == 0)
+    slot.result.rspInfo = *pError;
+  slot.result.nLatencyNs = nowNs() - slot.nBeginNs;
+  if (slot.fnCallback)
+    slot.fnCallback(slot.pContext, slot.result);
+  free(slot);
+  return true;
+}
+
+void RequestTracker::free(Slot &slot) {
+  slot.nTag.store(makeTag(0, kFree), std::memory_order_release);
+  m_nPending.fetch_sub(1, std::memory_order_relaxed);
+}
+
+} // namespace ctp
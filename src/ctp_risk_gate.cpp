@@ -0,0 +1,294 @@
+#include "ctp_risk_gate.h"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+namespace ctp {
+
+namespace {
+
+// 超过该值的价格视为无效（CTP以DBL_MAX填充空值）
+constexpr double kMaxValidPrice = 1e12;
+
+inline std::int32_t priceToTicks(double dPrice, double dInvPriceTick) {
+  if (!(dPrice > -kMaxValidPrice && dPrice < kMaxValidPrice) ||
+      dInvPriceTick == 0.0)
+    return kInvalidTicks;
+  return static_cast<std::int32_t>(std::lround(dPrice * dInvPriceTick));
+}
+
+void clearMarket(RiskInstrumentState &state) {
+  state.nUpperLimit = kInvalidTicks;
+  state.nLowerLimit = kInvalidTicks;
+  state.nWorkingVolume[0] = state.nWorkingVolume[1] = 0;
+  state.nWorkingCount[0] = state.nWorkingCount[1] = 0;
+  state.nOwnCount[0] = state.nOwnCount[1] = 0;
+}
+
+} // namespace
+
+const char *GetRiskRejectName(RiskReject eReject) {
+  switch (eReject) {
+  case RiskReject::None:
+    return "None";
+  case RiskReject::UnknownInstrument:
+    return "UnknownInstrument";
+  case RiskReject::OrderVolume:
+    return "OrderVolume";
+  case RiskReject::NetPosition:
+    return "NetPosition";
+  case RiskReject::PriceBand:
+    return "PriceBand";
+  case RiskReject::NoPriceLimits:
+    return "NoPriceLimits";
+  case RiskReject::SelfTrade:
+    return "SelfTrade";
+  case RiskReject::WorkingOrders:
+    return "WorkingOrders";
+  case RiskReject::OrderRate:
+    return "OrderRate";
+  case RiskReject::CancelRate:
+    return "CancelRate";
+  default:
+    return "Unknown";
+  }
+}
+
+RiskGate::RiskGate(const InstrumentTable &table, const OrderStateEngine &engine,
+                   const RiskGateOptions &options)
+    : m_table(table), m_engine(engine), m_nInstruments(table.Capacity()),
+      m_pStates(nullptr), m_bRequirePriceLimits(options.bRequirePriceLimits),
+      m_nFrontID(0), m_nSessionID(0),
+      m_orderLimiter(options.nMaxOrdersPerSecond),
+      m_cancelLimiter(options.nMaxCancelsPerSecond),
+      m_pOrderLimiter(&m_orderLimiter), m_pCancelLimiter(&m_cancelLimiter),
+      m_nRejects(), m_nPassedOrders(0), m_nPassedCancels(0), m_nUntracked(0) {
+  std::size_t nBytes = sizeof(RiskInstrumentState) * m_nInstruments;
+  m_pStates = static_cast<RiskInstrumentState *>(
+      ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+  // 预先触页
+  std::memset(static_cast<void *>(m_pStates), 0, nBytes);
+  for (std::size_t i = 0; i < m_nInstruments; ++i) {
+    RiskInstrumentState &state = m_pStates[i];
+    state.nMaxOrderVolume = options.nMaxOrderVolume;
+    state.nMaxNetPosition = options.nMaxNetPosition;
+    clearMarket(state);
+  }
+}
+
+RiskGate::~RiskGate() {
+  ::operator delete(m_pStates, std::align_val_t(kCacheLineSize));
+}
+
+void RiskGate::SetLimits(std::uint32_t nInstrument,
+                         std::int32_t nMaxOrderVolume,
+                         std::int32_t nMaxNetPosition) {
+  if (nInstrument >= m_nInstruments)
+    return;
+  m_pStates[nInstrument].nMaxOrderVolume = nMaxOrderVolume;
+  m_pStates[nInstrument].nMaxNetPosition = nMaxNetPosition;
+}
+
+void RiskGate::SetRateLimiters(RiskRateLimiter *pOrderLimiter,
+                               RiskRateLimiter *pCancelLimiter) {
+  m_pOrderLimiter = pOrderLimiter ? pOrderLimiter : &m_orderLimiter;
+  m_pCancelLimiter = pCancelLimiter ? pCancelLimiter : &m_cancelLimiter;
+}
+
+void RiskGate::OnTick(std::uint32_t nInstrument, double dUpperLimitPrice,
+                      double dLowerLimitPrice) {
+  if (nInstrument >= m_nInstruments)
+    return;
+  double dInv = m_table.GetInversePriceTick(nInstrument);
+  m_pStates[nInstrument].nUpperLimit = priceToTicks(dUpperLimitPrice, dInv);
+  m_pStates[nInstrument].nLowerLimit = priceToTicks(dLowerLimitPrice, dInv);
+}
+
+std::uint32_t RiskGate::findWorking(const RiskInstrumentState &state,
+                                    int nSide, int nFrontID, int nSessionID,
+                                    std::uint64_t nOrderRef,
+                                    const char *pszOrderRef) {
+  const RiskWorkingOrder *pWorking = state.working[nSide];
+  for (std::uint32_t i = 0; i < state.nWorkingCount[nSide]; ++i) {
+    if (pWorking[i].nOrderRef == nOrderRef &&
+        pWorking[i].nSessionID == nSessionID &&
+        pWorking[i].nFrontID == nFrontID &&
+        OrderStateEngine::sameOrderRef(nOrderRef, pWorking[i].szOrderRef,
+                                       pszOrderRef))
+      return i;
+  }
+  return kRiskMaxWorkingOrders;
+}
+
+void RiskGate::removeWorking(RiskInstrumentState &state, int nSide,
+                             std::uint32_t nSlot) {
+  // 末项补位，保持在途报单紧凑
+  RiskWorkingOrder *pWorking = state.working[nSide];
+  state.nWorkingVolume[nSide] -= pWorking[nSlot].nVolume;
+  if (pWorking[nSlot].bOwn)
+    --state.nOwnCount[nSide];
+  pWorking[nSlot] = pWorking[--state.nWorkingCount[nSide]];
+}
+
+std::uint32_t RiskGate::allocWorking(RiskInstrumentState &state, int nSide) {
+  if (state.nWorkingCount[nSide] < kRiskMaxWorkingOrders)
+    return state.nWorkingCount[nSide]++;
+  for (std::uint32_t i = 0; i < kRiskMaxWorkingOrders; ++i) {
+    if (!state.working[nSide][i].bOwn) {
+      // 挤出的报单不再参与自成交检查与净持仓计算
+      state.nWorkingVolume[nSide] -= state.working[nSide][i].nVolume;
+      ++m_nUntracked;
+      return i;
+    }
+  }
+  return kRiskMaxWorkingOrders;
+}
+
+void RiskGate::OnOrder(const OrderState &order) {
+  if (order.nInstrument >= m_nInstruments)
+    return;
+  RiskInstrumentState &state = m_pStates[order.nInstrument];
+  int nSide = sideOf(order.cDirection);
+  std::uint32_t nSlot = findWorking(state, nSide, order.nFrontID,
+                                    order.nSessionID, order.nOrderRef,
+                                    order.szOrderRef);
+  if (!order.IsActive() || order.nVolumeTotal <= 0) {
+    if (nSlot != kRiskMaxWorkingOrders)
+      removeWorking(state, nSide, nSlot);
+    return;
+  }
+
+  if (nSlot == kRiskMaxWorkingOrders) {
+    // 其他会话的报单，或重启后由私有流重放的本会话报单，不挤出已跟踪的报单。
+    // 市价单的LimitPrice为0，按0跳跟踪会让对手方向的报单都被判为自成交，
+    // 与换算失败的价格一样不跟踪
+    std::int32_t nPrice = priceToTicks(
+        order.dLimitPrice, m_table.GetInversePriceTick(order.nInstrument));
+    if (state.nWorkingCount[nSide] == kRiskMaxWorkingOrders ||
+        nPrice == kInvalidTicks || order.dLimitPrice <= 0.0) {
+      ++m_nUntracked;
+      return;
+    }
+    nSlot = state.nWorkingCount[nSide]++;
+    RiskWorkingOrder &working = state.working[nSide][nSlot];
+    working.nPrice = nPrice;
+    working.nVolume = 0;
+    working.nFrontID = order.nFrontID;
+    working.nSessionID = order.nSessionID;
+    working.nOrderRef = order.nOrderRef;
+    std::memcpy(working.szOrderRef, order.szOrderRef,
+                sizeof(working.szOrderRef));
+    working.bOwn = order.nFrontID == m_nFrontID &&
+                   order.nSessionID == m_nSessionID;
+    state.nOwnCount[nSide] += working.bOwn;
+  }
+  RiskWorkingOrder &working = state.working[nSide][nSlot];
+  state.nWorkingVolume[nSide] += order.nVolumeTotal - working.nVolume;
+  working.nVolume = order.nVolumeTotal;
+}
+
+void RiskGate::OnInsertRejected(const CThostFtdcInputOrderField &order) {
+  std::uint32_t nInstrument = m_table.Find(order.InstrumentID);
+  if (nInstrument >= m_nInstruments)
+    return;
+  RiskInstrumentState &state = m_pStates[nInstrument];
+  int nSide = sideOf(order.Direction);
+  std::uint32_t nSlot =
+      findWorking(state, nSide, m_nFrontID, m_nSessionID,
+                  OrderStateEngine::parseOrderRef(order.OrderRef),
+                  order.OrderRef);
+  if (nSlot != kRiskMaxWorkingOrders)
+    removeWorking(state, nSide, nSlot);
+}
+
+RiskReject RiskGate::CheckOrder(const CThostFtdcInputOrderField &order,
+                                std::int64_t nNowNs) {
+  std::uint32_t nInstrument = m_table.Find(order.InstrumentID);
+  if (nInstrument >= m_nInstruments)
+    return reject(RiskReject::UnknownInstrument);
+  RiskInstrumentState &state = m_pStates[nInstrument];
+
+  std::int32_t nVolume = order.VolumeTotalOriginal;
+  if (nVolume <= 0 ||
+      (state.nMaxOrderVolume > 0 && nVolume > state.nMaxOrderVolume))
+    return reject(RiskReject::OrderVolume);
+
+  // 按同方向在途报单全部成交后的净持仓计算，平仓单同样计入
+  int nSide = sideOf(order.Direction);
+  if (state.nMaxNetPosition > 0) {
+    std::int32_t nNet = m_engine.GetPosition(nInstrument).GetNetPosition();
+    if (nSide == 0 ? nNet + state.nWorkingVolume[0] + nVolume >
+                         state.nMaxNetPosition
+                   : nNet - state.nWorkingVolume[1] - nVolume <
+                         -state.nMaxNetPosition)
+      return reject(RiskReject::NetPosition);
+  }
+
+  bool bHasLimits = state.nUpperLimit != kInvalidTicks &&
+                    state.nLowerLimit != kInvalidTicks;
+  if (!bHasLimits && m_bRequirePriceLimits)
+    return reject(RiskReject::NoPriceLimits);
+  // 市价单不检查涨跌停板，自成交检查时视为与对手方所有报单交叉
+  std::int32_t nPrice = nSide == 0 ? INT32_MAX : INT32_MIN + 1;
+  if (order.OrderPriceType == THOST_FTDC_OPT_LimitPrice) {
+    // 最小变动价位未知时价格无法换算为跳数，同样按超出价格范围拒绝
+    nPrice = priceToTicks(order.LimitPrice,
+                          m_table.GetInversePriceTick(nInstrument));
+    if (nPrice == kInvalidTicks ||
+        (bHasLimits &&
+         (nPrice > state.nUpperLimit || nPrice < state.nLowerLimit)))
+      return reject(RiskReject::PriceBand);
+  }
+
+  const RiskWorkingOrder *pOpposite = state.working[1 - nSide];
+  std::uint32_t nOpposite = state.nWorkingCount[1 - nSide];
+  bool bCross = false;
+  if (nSide == 0) {
+    for (std::uint32_t i = 0; i < nOpposite; ++i)
+      bCross |= pOpposite[i].nPrice <= nPrice;
+  } else {
+    for (std::uint32_t i = 0; i < nOpposite; ++i)
+      bCross |= pOpposite[i].nPrice >= nPrice;
+  }
+  if (bCross)
+    return reject(RiskReject::SelfTrade);
+
+  // 只限制经本风控报出的报单，其他会话的报单不占用名额
+  if (state.nOwnCount[nSide] == kRiskMaxWorkingOrders)
+    return reject(RiskReject::WorkingOrders);
+  // 频率计数放在最后，被其他规则拒绝的报单不占用名额
+  if (!m_pOrderLimiter->TryAcquire(nNowNs))
+    return reject(RiskReject::OrderRate);
+
+  // nOwnCount未满时列表中必有其他会话的报单可以挤出
+  RiskWorkingOrder &working = state.working[nSide][allocWorking(state, nSide)];
+  working.nPrice = nPrice;
+  working.nVolume = nVolume;
+  working.nFrontID = m_nFrontID;
+  working.nSessionID = m_nSessionID;
+  working.nOrderRef = OrderStateEngine::parseOrderRef(order.OrderRef);
+  std::memcpy(working.szOrderRef, order.OrderRef, sizeof(working.szOrderRef));
+  working.bOwn = true;
+  ++state.nOwnCount[nSide];
+  state.nWorkingVolume[nSide] += nVolume;
+  ++m_nPassedOrders;
+  return RiskReject::None;
+}
+
+RiskReject RiskGate::CheckCancel(const CThostFtdcInputOrderActionField &action,
+                                 std::int64_t nNowNs) {
+  (void)action;
+  if (!m_pCancelLimiter->TryAcquire(nNowNs))
+    return reject(RiskReject::CancelRate);
+  ++m_nPassedCancels;
+  return RiskReject::None;
+}
+
+void RiskGate::Reset() {
+  for (std::size_t i = 0; i < m_nInstruments; ++i)
+    clearMarket(m_pStates[i]);
+}
+
+} // namespace ctp
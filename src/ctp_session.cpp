@@ -0,0 +1,526 @@
+#include "ctp_session.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace ctp {
+
+namespace {
+
+// 挂起在固定操作上的键，RequestID从1开始
+constexpr int kKeyConnect = -1;
+
+template <std::size_t N>
+void copyField(char (&dst)[N], const std::string &src) {
+  std::snprintf(dst, N, "%s", src.c_str());
+}
+
+inline int errorOf(const CThostFtdcRspInfoField *pRspInfo) {
+  return pRspInfo ? pRspInfo->ErrorID : 0;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// SessionExecutor
+
+SessionExecutor::SessionExecutor() : m_bStopped(false) {}
+
+SessionExecutor::~SessionExecutor() {}
+
+void SessionExecutor::Post(std::function<void()> fnTask) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(fnTask));
+  }
+  m_cond.notify_one();
+}
+
+void SessionExecutor::Spawn(Task<void> task) {
+  Post(std::coroutine_handle<>(task.Detach()));
+}
+
+void SessionExecutor::Run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_bStopped = false;
+  while (!m_bStopped) {
+    if (!m_tasks.empty()) {
+      std::function<void()> fnTask = std::move(m_tasks.front());
+      m_tasks.pop_front();
+      lock.unlock();
+      fnTask();
+      lock.lock();
+      continue;
+    }
+
+    if (m_timers.empty()) {
+      m_cond.wait(lock);
+      continue;
+    }
+    auto it = m_timers.begin();
+    if (Clock::now() < it->first) {
+      m_cond.wait_until(lock, it->first);
+      continue;
+    }
+    std::function<void()> fnTask = std::move(it->second);
+    m_timers.erase(it);
+    lock.unlock();
+    fnTask();
+    lock.lock();
+  }
+  m_tasks.clear();
+}
+
+void SessionExecutor::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bStopped = true;
+  }
+  m_cond.notify_all();
+}
+
+void SessionExecutor::CallAt(Clock::time_point due,
+                             std::function<void()> fnTask) {
+  // 只在执行线程上调用，Run()在执行任务时不持有锁
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_timers.emplace(due, std::move(fnTask));
+}
+
+// ---------------------------------------------------------------------------
+// SessionCore
+
+SessionCore::Awaiter::~Awaiter() {
+  if (m_pCore && m_nSeq)
+    m_pCore->forget(m_nKey, m_nSeq);
+  if (m_fnCleanup)
+    m_fnCleanup();
+}
+
+bool SessionCore::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+  std::uint64_t nSeq = m_pCore->add(m_nKey, handle, &m_nResult);
+  m_nSeq = nSeq;
+  int nRet = m_fnIssue ? m_fnIssue() : 0;
+  if (nRet != 0) {
+    // 请求未发出；若已被取消则恢复已投递，仍需挂起
+    if (!m_pCore->remove(m_nKey, nSeq))
+      return true;
+    m_nSeq = 0;
+    m_nResult = nRet;
+    return false;
+  }
+  if (m_timeout.count() > 0) {
+    SessionCore *pCore = m_pCore;
+    int nKey = m_nKey;
+    m_pCore->m_executor.CallAt(
+        SessionExecutor::Clock::now() + m_timeout,
+        [pCore, nKey, nSeq]() { pCore->expire(nKey, nSeq); });
+  }
+  return true;
+}
+
+std::uint64_t SessionCore::add(int nKey, std::coroutine_handle<> handle,
+                               int *pResult) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::uint64_t nSeq = ++m_nNextSeq;
+  m_waiters.emplace(nKey, Waiter{nSeq, handle, pResult});
+  return nSeq;
+}
+
+bool SessionCore::remove(int nKey, std::uint64_t nSeq) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto range = m_waiters.equal_range(nKey);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.nSeq == nSeq) {
+      m_waiters.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void SessionCore::expire(int nKey, std::uint64_t nSeq) {
+  std::coroutine_handle<> handle;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto range = m_waiters.equal_range(nKey);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.nSeq == nSeq) {
+        *it->second.pResult = kSessionTimeout;
+        handle = it->second.handle;
+        m_waiters.erase(it);
+        break;
+      }
+    }
+  }
+  // 已在执行线程上，直接恢复
+  if (handle)
+    handle.resume();
+}
+
+void SessionCore::forget(int nKey, std::uint64_t nSeq) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_resuming.erase(nSeq))
+    return;
+  auto range = m_waiters.equal_range(nKey);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.nSeq == nSeq) {
+      m_waiters.erase(it);
+      return;
+    }
+  }
+}
+
+void SessionCore::resume(std::uint64_t nSeq, std::coroutine_handle<> handle) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_resuming.erase(nSeq))
+      return;
+  }
+  handle.resume();
+}
+
+void SessionCore::post(std::vector<Waiter> &&waiters) {
+  for (const Waiter &waiter : waiters) {
+    std::uint64_t nSeq = waiter.nSeq;
+    std::coroutine_handle<> handle = waiter.handle;
+    m_executor.Post([this, nSeq, handle]() { resume(nSeq, handle); });
+  }
+}
+
+void SessionCore::Complete(int nKey, int nResult) {
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto range = m_waiters.equal_range(nKey);
+    for (auto it = range.first; it != range.second; ++it) {
+      *it->second.pResult = nResult;
+      m_resuming.insert(it->second.nSeq);
+      waiters.push_back(it->second);
+    }
+    m_waiters.erase(range.first, range.second);
+  }
+  post(std::move(waiters));
+}
+
+void SessionCore::CompleteAll(int nResult, int nExceptKey) {
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_waiters.begin(); it != m_waiters.end();) {
+      if (it->first == nExceptKey) {
+        ++it;
+        continue;
+      }
+      *it->second.pResult = nResult;
+      m_resuming.insert(it->second.nSeq);
+      waiters.push_back(it->second);
+      it = m_waiters.erase(it);
+    }
+  }
+  post(std::move(waiters));
+}
+
+// ---------------------------------------------------------------------------
+// TraderSession
+
+TraderSession::TraderSession(SessionExecutor &executor,
+                             CThostFtdcTraderApi *pApi,
+                             const TraderSessionOptions &options)
+    : m_pApi(pApi), m_options(options), m_core(executor, options.timeout),
+      m_bInitialized(false), m_bConnected(false), m_loginInfo() {
+  m_pApi->RegisterSpi(this);
+}
+
+SessionCore::Awaiter
+TraderSession::Connect(std::chrono::milliseconds timeout) {
+  if (IsConnected())
+    return SessionCore::Awaiter(0);
+  return SessionCore::Awaiter(
+      m_core, kKeyConnect,
+      [this]() {
+        if (!m_bInitialized.exchange(true)) {
+          if (!m_options.strFrontAddress.empty())
+            m_pApi->RegisterFront(
+                const_cast<char *>(m_options.strFrontAddress.c_str()));
+          m_pApi->SubscribePrivateTopic(THOST_TERT_QUICK);
+          m_pApi->SubscribePublicTopic(THOST_TERT_QUICK);
+          m_pApi->Init();
+        }
+        return 0;
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter
+TraderSession::Authenticate(std::chrono::milliseconds timeout) {
+  int nRequestID = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nRequestID,
+      [this, nRequestID]() {
+        CThostFtdcReqAuthenticateField req = {};
+        copyField(req.BrokerID, m_options.strBrokerID);
+        copyField(req.UserID, m_options.strUserID);
+        copyField(req.UserProductInfo, m_options.strUserProductInfo);
+        copyField(req.AuthCode, m_options.strAuthCode);
+        copyField(req.AppID, m_options.strAppID);
+        return m_pApi->ReqAuthenticate(&req, nRequestID);
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter TraderSession::Login(std::chrono::milliseconds timeout) {
+  int nRequestID = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nRequestID,
+      [this, nRequestID]() {
+        CThostFtdcReqUserLoginField req = {};
+        copyField(req.BrokerID, m_options.strBrokerID);
+        copyField(req.UserID, m_options.strUserID);
+        copyField(req.Password, m_options.strPassword);
+        copyField(req.UserProductInfo, m_options.strUserProductInfo);
+        return m_pApi->ReqUserLogin(&req, nRequestID);
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter
+TraderSession::ConfirmSettlement(std::chrono::milliseconds timeout) {
+  int nRequestID = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nRequestID,
+      [this, nRequestID]() {
+        CThostFtdcSettlementInfoConfirmField req = {};
+        copyField(req.BrokerID, m_options.strBrokerID);
+        copyField(req.InvestorID, m_options.strUserID);
+        return m_pApi->ReqSettlementInfoConfirm(&req, nRequestID);
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter TraderSession::Logout(std::chrono::milliseconds timeout) {
+  int nRequestID = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nRequestID,
+      [this, nRequestID]() {
+        CThostFtdcUserLogoutField req = {};
+        copyField(req.BrokerID, m_options.strBrokerID);
+        copyField(req.UserID, m_options.strUserID);
+        return m_pApi->ReqUserLogout(&req, nRequestID);
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+void TraderSession::OnFrontConnected() {
+  m_bConnected.store(true, std::memory_order_release);
+  m_core.Complete(kKeyConnect, 0);
+}
+
+void TraderSession::OnFrontDisconnected(int nReason) {
+  m_bConnected.store(false, std::memory_order_release);
+  // CTP会自动重连，等待连接的协程继续等待
+  m_core.CompleteAll(kSessionDisconnected, kKeyConnect);
+}
+
+void TraderSession::OnRspAuthenticate(
+    CThostFtdcRspAuthenticateField *pRspAuthenticateField,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+void TraderSession::OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                                   CThostFtdcRspInfoField *pRspInfo,
+                                   int nRequestID, bool bIsLast) {
+  if (pRspUserLogin && errorOf(pRspInfo) == 0)
+    m_loginInfo = *pRspUserLogin;
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+void TraderSession::OnRspUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                                    CThostFtdcRspInfoField *pRspInfo,
+                                    int nRequestID, bool bIsLast) {
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+void TraderSession::OnRspSettlementInfoConfirm(
+    CThostFtdcSettlementInfoConfirmField *pSettlementInfoConfirm,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+void TraderSession::OnRspError(CThostFtdcRspInfoField *pRspInfo,
+                               int nRequestID, bool bIsLast) {
+  // 与其它应答一样只在最后一段完成，之后到达的分段不会落到下一个请求上
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+// ---------------------------------------------------------------------------
+// MdSession
+
+MdSession::MdSession(SessionExecutor &executor, CThostFtdcMdApi *pApi,
+                     const MdSessionOptions &options)
+    : m_pApi(pApi), m_options(options), m_core(executor, options.timeout),
+      m_bInitialized(false), m_bConnected(false), m_loginInfo() {
+  m_pApi->RegisterSpi(this);
+}
+
+SessionCore::Awaiter MdSession::Connect(std::chrono::milliseconds timeout) {
+  if (IsConnected())
+    return SessionCore::Awaiter(0);
+  return SessionCore::Awaiter(
+      m_core, kKeyConnect,
+      [this]() {
+        if (!m_bInitialized.exchange(true)) {
+          if (!m_options.strFrontAddress.empty())
+            m_pApi->RegisterFront(
+                const_cast<char *>(m_options.strFrontAddress.c_str()));
+          m_pApi->Init();
+        }
+        return 0;
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter MdSession::Login(std::chrono::milliseconds timeout) {
+  int nRequestID = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nRequestID,
+      [this, nRequestID]() {
+        CThostFtdcReqUserLoginField req = {};
+        copyField(req.BrokerID, m_options.strBrokerID);
+        copyField(req.UserID, m_options.strUserID);
+        copyField(req.Password, m_options.strPassword);
+        return m_pApi->ReqUserLogin(&req, nRequestID);
+      },
+      m_core.ResolveTimeout(timeout));
+}
+
+SessionCore::Awaiter
+MdSession::Subscribe(const std::vector<std::string> &instruments,
+                     std::chrono::milliseconds timeout) {
+  return subscribe(instruments, true, timeout);
+}
+
+SessionCore::Awaiter
+MdSession::Unsubscribe(const std::vector<std::string> &instruments,
+                       std::chrono::milliseconds timeout) {
+  return subscribe(instruments, false, timeout);
+}
+
+SessionCore::Awaiter
+MdSession::subscribe(const std::vector<std::string> &instruments,
+                     bool bSubscribe, std::chrono::milliseconds timeout) {
+  if (instruments.empty())
+    return SessionCore::Awaiter(0);
+  // 每次调用一个键，与RequestID共用计数器
+  int nKey = m_core.NextRequestID();
+  return SessionCore::Awaiter(
+      m_core, nKey,
+      [this, nKey, instruments, bSubscribe]() {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_pending[nKey] = Pending{bSubscribe, instruments, 0};
+        }
+        std::vector<char *> ids;
+        for (const std::string &instrument : instruments)
+          ids.push_back(const_cast<char *>(instrument.c_str()));
+        int nCount = static_cast<int>(ids.size());
+        return bSubscribe ? m_pApi->SubscribeMarketData(ids.data(), nCount)
+                          : m_pApi->UnSubscribeMarketData(ids.data(), nCount);
+      },
+      m_core.ResolveTimeout(timeout),
+      // 发送失败、超时、取消或协程帧销毁后，丢弃该次调用尚未应答的合约
+      [this, nKey]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.erase(nKey);
+      });
+}
+
+void MdSession::acknowledge(
+    bool bSubscribe, CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo) {
+  int nKey = 0;
+  int nError = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto match = m_pending.end();
+    for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+      if (it->second.bSubscribe != bSubscribe)
+        continue;
+      // 没有合约信息的应答记到最早的调用上，该调用的合约全部按此应答完成
+      if (!pSpecificInstrument) {
+        it->second.instruments.clear();
+        match = it;
+        break;
+      }
+      std::vector<std::string> &pending = it->second.instruments;
+      auto found = pending.begin();
+      while (found != pending.end() &&
+             std::strcmp(found->c_str(), pSpecificInstrument->InstrumentID) !=
+                 0)
+        ++found;
+      if (found != pending.end()) {
+        pending.erase(found);
+        match = it;
+        break;
+      }
+    }
+    if (match == m_pending.end())
+      return;
+    if (errorOf(pRspInfo) != 0 && match->second.nError == 0)
+      match->second.nError = errorOf(pRspInfo);
+    if (!match->second.instruments.empty())
+      return;
+    nKey = match->first;
+    nError = match->second.nError;
+    m_pending.erase(match);
+  }
+  m_core.Complete(nKey, nError);
+}
+
+void MdSession::OnFrontConnected() {
+  m_bConnected.store(true, std::memory_order_release);
+  m_core.Complete(kKeyConnect, 0);
+}
+
+void MdSession::OnFrontDisconnected(int nReason) {
+  m_bConnected.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.clear();
+  }
+  m_core.CompleteAll(kSessionDisconnected, kKeyConnect);
+}
+
+void MdSession::OnRspUserLogin(CThostFtdcRspUserLoginField *pRspUserLogin,
+                               CThostFtdcRspInfoField *pRspInfo,
+                               int nRequestID, bool bIsLast) {
+  if (pRspUserLogin && errorOf(pRspInfo) == 0)
+    m_loginInfo = *pRspUserLogin;
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+void MdSession::OnRspSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  acknowledge(true, pSpecificInstrument, pRspInfo);
+}
+
+void MdSession::OnRspUnSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, int nRequestID, bool bIsLast) {
+  acknowledge(false, pSpecificInstrument, pRspInfo);
+}
+
+void MdSession::OnRspError(CThostFtdcRspInfoField *pRspInfo, int nRequestID,
+                           bool bIsLast) {
+  if (bIsLast)
+    m_core.Complete(nRequestID, errorOf(pRspInfo));
+}
+
+} // namespace ctp
@@ -0,0 +1,437 @@
+#include "ctp_shm_md.h"
+#include "ctp_log.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::size_t kShmMdHeaderSize = 4096;
+constexpr std::size_t kWords = sizeof(CompactTick) / 8;
+// ReadSnapshot()遇到写入中的槽位时，每自旋这么多次检查一次发布方心跳
+constexpr std::uint32_t kSnapshotSpins = 4096;
+
+static_assert(sizeof(ShmMdHeader) <= kShmMdHeaderSize,
+              "ShmMdHeader must fit in the first page");
+
+std::size_t pageSize() {
+  static const std::size_t nPageSize =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return nPageSize;
+}
+
+std::int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::size_t alignUp(std::size_t nSize, std::size_t nAlign) {
+  return (nSize + nAlign - 1) / nAlign * nAlign;
+}
+
+std::size_t roundUpPow2(std::size_t n) {
+  std::size_t nResult = 2;
+  while (nResult < n)
+    nResult <<= 1;
+  return nResult;
+}
+
+// 文件头中的各区域须落在文件之内、互不重叠且按缓存行对齐；
+// 逐项先除后比，避免乘法溢出
+bool validLayout(const ShmMdHeader &header, std::size_t nSize) {
+  const std::uint64_t nFileSize = header.nFileSize;
+  const std::uint64_t nMax = header.nMaxInstruments;
+  const std::uint64_t nRing = header.nRingCapacity;
+  return nFileSize <= nSize && nMax <= UINT32_MAX &&
+         header.nInstrumentOffset >= kShmMdHeaderSize &&
+         header.nInstrumentOffset % alignof(ShmMdInstrument) == 0 &&
+         header.nSnapshotOffset % kCacheLineSize == 0 &&
+         header.nRingOffset % kCacheLineSize == 0 &&
+         header.nInstrumentOffset <= header.nSnapshotOffset &&
+         nMax <= (header.nSnapshotOffset - header.nInstrumentOffset) /
+                     sizeof(ShmMdInstrument) &&
+         header.nSnapshotOffset <= header.nRingOffset &&
+         nMax <= (header.nRingOffset - header.nSnapshotOffset) /
+                     sizeof(ShmMdSlot) &&
+         header.nRingOffset <= nFileSize &&
+         nRing <= (nFileSize - header.nRingOffset) / sizeof(ShmMdSlot);
+}
+
+// 按seqlock协议写入槽位：先置为nBusy（奇数），写完负载后置为nDone
+void writeSlot(ShmMdSlot &slot, std::uint64_t nBusy, std::uint64_t nDone,
+               const CompactTick &tick) {
+  slot.nSeq.store(nBusy, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::uint64_t nWords[kWords];
+  std::memcpy(nWords, &tick, sizeof(tick));
+  for (std::size_t i = 0; i < kWords; ++i)
+    slot.nWords[i].store(nWords[i], std::memory_order_relaxed);
+
+  slot.nSeq.store(nDone, std::memory_order_release);
+}
+
+} // namespace
+
+ShmMdPublisher::ShmMdPublisher(const TickNormalizer &normalizer)
+    : m_normalizer(normalizer), m_pBase(nullptr), m_nMappedSize(0),
+      m_pHeader(nullptr), m_pInstruments(nullptr), m_pSnapshots(nullptr),
+      m_pRing(nullptr), m_nMask(0), m_nWriteSeq(0), m_nInstruments(0),
+      m_nMaxInstruments(0), m_nDropped(0) {}
+
+ShmMdPublisher::~ShmMdPublisher() { Close(); }
+
+bool ShmMdPublisher::Open(const std::string &strPath,
+                          const ShmMdOptions &options) {
+  Close();
+  const InstrumentTable &table = m_normalizer.GetInstrumentTable();
+  std::size_t nRingCapacity = roundUpPow2(options.nRingCapacity);
+  std::size_t nMaxInstruments =
+      options.nMaxInstruments ? options.nMaxInstruments : table.Capacity();
+
+  std::size_t nInstrumentOffset = kShmMdHeaderSize;
+  std::size_t nSnapshotOffset =
+      alignUp(nInstrumentOffset + sizeof(ShmMdInstrument) * nMaxInstruments,
+              pageSize());
+  std::size_t nRingOffset = alignUp(
+      nSnapshotOffset + sizeof(ShmMdSlot) * nMaxInstruments, pageSize());
+  std::size_t nFileSize =
+      alignUp(nRingOffset + sizeof(ShmMdSlot) * nRingCapacity, pageSize());
+
+  // 在临时文件中建好再改名，读者不会看到未初始化的文件头
+  std::string strTempPath = strPath + ".tmp";
+  int fd = ::open(strTempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    CTP_LOG_ERROR("[ShmMd] failed to create %s", strTempPath.c_str());
+    return false;
+  }
+  // 预先分配，避免写入映射区时因/dev/shm空间不足触发SIGBUS
+  if (::ftruncate(fd, static_cast<off_t>(nFileSize)) != 0 ||
+      ::posix_fallocate(fd, 0, static_cast<off_t>(nFileSize)) != 0) {
+    CTP_LOG_ERROR("[ShmMd] failed to allocate %zu bytes for %s", nFileSize,
+                  strTempPath.c_str());
+    ::close(fd);
+    ::unlink(strTempPath.c_str());
+    return false;
+  }
+  int nFlags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+  nFlags |= MAP_POPULATE;
+#endif
+  void *pMapped =
+      ::mmap(nullptr, nFileSize, PROT_READ | PROT_WRITE, nFlags, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED) {
+    CTP_LOG_ERROR("[ShmMd] failed to map %s", strTempPath.c_str());
+    ::unlink(strTempPath.c_str());
+    return false;
+  }
+
+  m_pBase = static_cast<char *>(pMapped);
+  m_nMappedSize = nFileSize;
+  m_pHeader = reinterpret_cast<ShmMdHeader *>(m_pBase);
+  m_pInstruments =
+      reinterpret_cast<ShmMdInstrument *>(m_pBase + nInstrumentOffset);
+  m_pSnapshots = reinterpret_cast<ShmMdSlot *>(m_pBase + nSnapshotOffset);
+  m_pRing = reinterpret_cast<ShmMdSlot *>(m_pBase + nRingOffset);
+  m_nMask = nRingCapacity - 1;
+  m_nWriteSeq = 0;
+  m_nInstruments = 0;
+  m_nMaxInstruments = static_cast<std::uint32_t>(nMaxInstruments);
+  m_nDropped = 0;
+
+  // 新文件内容全为0：槽位序号0表示从未写入
+  m_pHeader->nMagic = kShmMdMagic;
+  m_pHeader->nVersion = kShmMdVersion;
+  m_pHeader->nHeaderSize = static_cast<std::uint32_t>(kShmMdHeaderSize);
+  m_pHeader->nTickSize = sizeof(CompactTick);
+  m_pHeader->nSlotSize = sizeof(ShmMdSlot);
+  m_pHeader->nRingCapacity = nRingCapacity;
+  m_pHeader->nMaxInstruments = nMaxInstruments;
+  m_pHeader->nInstrumentOffset = nInstrumentOffset;
+  m_pHeader->nSnapshotOffset = nSnapshotOffset;
+  m_pHeader->nRingOffset = nRingOffset;
+  m_pHeader->nFileSize = nFileSize;
+  m_pHeader->nEpoch = nowNanos();
+  m_pHeader->nPublisherPid = static_cast<std::int32_t>(::getpid());
+  m_pHeader->nHeartbeatNs.store(m_pHeader->nEpoch, std::memory_order_relaxed);
+  m_pHeader->nWriteSeq.store(0, std::memory_order_relaxed);
+  SyncInstruments();
+
+  if (::rename(strTempPath.c_str(), strPath.c_str()) != 0) {
+    CTP_LOG_ERROR("[ShmMd] failed to rename %s", strTempPath.c_str());
+    ::munmap(m_pBase, m_nMappedSize);
+    ::unlink(strTempPath.c_str());
+    m_pBase = nullptr;
+    m_pHeader = nullptr;
+    return false;
+  }
+  m_strPath = strPath;
+  CTP_LOG_INFO("[ShmMd] publishing to %s: %zu ring slots, %zu instruments, "
+               "%zu bytes",
+               strPath.c_str(), nRingCapacity, nMaxInstruments, nFileSize);
+  return true;
+}
+
+void ShmMdPublisher::Close() {
+  if (!m_pBase)
+    return;
+  m_pHeader->nClosed.store(1, std::memory_order_release);
+  ::munmap(m_pBase, m_nMappedSize);
+  ::unlink(m_strPath.c_str());
+  m_pBase = nullptr;
+  m_nMappedSize = 0;
+  m_pHeader = nullptr;
+  m_nInstruments = 0;
+  m_nMaxInstruments = 0;
+  m_strPath.clear();
+}
+
+std::size_t ShmMdPublisher::SyncInstruments() {
+  const InstrumentTable &table = m_normalizer.GetInstrumentTable();
+  std::size_t nSize = table.Size();
+  if (nSize > m_nMaxInstruments)
+    nSize = m_nMaxInstruments;
+  if (nSize <= m_nInstruments)
+    return m_nInstruments;
+  for (std::uint32_t i = m_nInstruments; i < nSize; ++i) {
+    ShmMdInstrument &instrument = m_pInstruments[i];
+    std::memcpy(instrument.szInstrumentID, table.GetInstrumentID(i),
+                sizeof(instrument.szInstrumentID));
+    instrument.dPriceTick = table.GetPriceTick(i);
+  }
+  m_nInstruments = static_cast<std::uint32_t>(nSize);
+  // 目录项先于引用它的行情可见
+  m_pHeader->nInstruments.store(m_nInstruments, std::memory_order_release);
+  return m_nInstruments;
+}
+
+bool ShmMdPublisher::Publish(const CompactTick &tick) {
+  if (tick.nInstrument >= m_nInstruments) {
+    if (tick.nInstrument >= m_nMaxInstruments ||
+        tick.nInstrument >= SyncInstruments()) {
+      ++m_nDropped;
+      return false;
+    }
+  }
+  ShmMdSlot &snapshot = m_pSnapshots[tick.nInstrument];
+  const std::uint64_t nVersion = snapshot.nSeq.load(std::memory_order_relaxed);
+  writeSlot(snapshot, nVersion + 1, nVersion + 2, tick);
+
+  const std::uint64_t nSeq = m_nWriteSeq++;
+  writeSlot(m_pRing[nSeq & m_nMask], 2 * nSeq + 1, 2 * nSeq + 2, tick);
+  m_pHeader->nWriteSeq.store(nSeq + 1, std::memory_order_release);
+  return true;
+}
+
+bool ShmMdPublisher::Publish(const CThostFtdcDepthMarketDataField &tick) {
+  CompactTick compact;
+  if (!m_normalizer.Normalize(tick, compact)) {
+    ++m_nDropped;
+    return false;
+  }
+  return Publish(compact);
+}
+
+void ShmMdPublisher::Heartbeat() {
+  if (m_pHeader)
+    m_pHeader->nHeartbeatNs.store(nowNanos(), std::memory_order_relaxed);
+}
+
+ShmMdClient::ShmMdClient()
+    : m_nDevice(0), m_nInode(0), m_pBase(nullptr), m_nMappedSize(0),
+      m_pHeader(nullptr), m_pInstruments(nullptr), m_pSnapshots(nullptr),
+      m_pRing(nullptr), m_nMask(0), m_nMaxInstruments(0), m_nReadSeq(0),
+      m_nConsumed(0), m_nGaps(0), m_nLost(0) {}
+
+ShmMdClient::~ShmMdClient() { Close(); }
+
+bool ShmMdClient::Open(const std::string &strPath) {
+  Close();
+  int fd = ::open(strPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(kShmMdHeaderSize)) {
+    ::close(fd);
+    return false;
+  }
+  std::size_t nSize = static_cast<std::size_t>(st.st_size);
+  void *pMapped = ::mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  const ShmMdHeader *pHeader = static_cast<const ShmMdHeader *>(pMapped);
+  if (pHeader->nMagic != kShmMdMagic || pHeader->nVersion != kShmMdVersion ||
+      pHeader->nTickSize != sizeof(CompactTick) ||
+      pHeader->nSlotSize != sizeof(ShmMdSlot) || pHeader->nRingCapacity == 0 ||
+      (pHeader->nRingCapacity & (pHeader->nRingCapacity - 1)) != 0 ||
+      !validLayout(*pHeader, nSize)) {
+    CTP_LOG_WARN("[ShmMd] %s is not a valid market data region",
+                 strPath.c_str());
+    ::munmap(pMapped, nSize);
+    return false;
+  }
+
+  m_strPath = strPath;
+  m_nDevice = static_cast<std::uint64_t>(st.st_dev);
+  m_nInode = static_cast<std::uint64_t>(st.st_ino);
+  m_pBase = static_cast<const char *>(pMapped);
+  m_nMappedSize = nSize;
+  m_pHeader = pHeader;
+  m_pInstruments = reinterpret_cast<const ShmMdInstrument *>(
+      m_pBase + pHeader->nInstrumentOffset);
+  m_pSnapshots =
+      reinterpret_cast<const ShmMdSlot *>(m_pBase + pHeader->nSnapshotOffset);
+  m_pRing =
+      reinterpret_cast<const ShmMdSlot *>(m_pBase + pHeader->nRingOffset);
+  m_nMask = pHeader->nRingCapacity - 1;
+  m_nMaxInstruments = static_cast<std::uint32_t>(pHeader->nMaxInstruments);
+  m_pTable.reset(new InstrumentTable(m_nMaxInstruments));
+  m_nConsumed = m_nGaps = m_nLost = 0;
+  RefreshInstruments();
+  SeekLatest();
+  return true;
+}
+
+void ShmMdClient::Close() {
+  if (!m_pBase)
+    return;
+  ::munmap(const_cast<char *>(m_pBase), m_nMappedSize);
+  m_pBase = nullptr;
+  m_nMappedSize = 0;
+  m_pHeader = nullptr;
+  m_nMaxInstruments = 0;
+}
+
+bool ShmMdClient::Poll(CompactTick &tick) {
+  std::uint64_t nWords[kWords];
+  for (;;) {
+    const ShmMdSlot &slot = m_pRing[m_nReadSeq & m_nMask];
+    const std::uint64_t nExpected = 2 * m_nReadSeq + 2;
+    const std::uint64_t nBegin = slot.nSeq.load(std::memory_order_acquire);
+    if (nBegin < nExpected)
+      return false;
+    if (nBegin == nExpected) {
+      for (std::size_t i = 0; i < kWords; ++i)
+        nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.nSeq.load(std::memory_order_relaxed) == nBegin)
+        break;
+    }
+    // 已被覆盖：跳到最新位置之前半个环处，留出余量，避免紧接着再次被覆盖
+    std::uint64_t nWriteSeq =
+        m_pHeader->nWriteSeq.load(std::memory_order_acquire);
+    std::uint64_t nResume = nWriteSeq - (m_nMask + 1) / 2;
+    if (nResume > m_nReadSeq) {
+      ++m_nGaps;
+      m_nLost += nResume - m_nReadSeq;
+      m_nReadSeq = nResume;
+    }
+  }
+  std::memcpy(static_cast<void *>(&tick), nWords, sizeof(tick));
+  ++m_nReadSeq;
+  ++m_nConsumed;
+  if (tick.nInstrument >= m_pTable->Size())
+    RefreshInstruments();
+  return true;
+}
+
+void ShmMdClient::SeekOldest() {
+  std::uint64_t nWriteSeq =
+      m_pHeader->nWriteSeq.load(std::memory_order_acquire);
+  m_nReadSeq = nWriteSeq > m_nMask + 1 ? nWriteSeq - (m_nMask + 1) : 0;
+}
+
+void ShmMdClient::SeekLatest() {
+  m_nReadSeq = m_pHeader->nWriteSeq.load(std::memory_order_acquire);
+}
+
+bool ShmMdClient::ReadSnapshot(std::uint32_t nInstrument, CompactTick &tick,
+                               std::uint64_t *pVersion) const {
+  if (nInstrument >= m_nMaxInstruments)
+    return false;
+  const ShmMdSlot &slot = m_pSnapshots[nInstrument];
+  std::uint64_t nWords[kWords];
+  std::uint64_t nBegin;
+  std::uint32_t nSpins = 0;
+  for (;;) {
+    nBegin = slot.nSeq.load(std::memory_order_acquire);
+    if (nBegin & 1) {
+      // 写入只需几十纳秒；长时间为奇数说明发布方被抢占或已在写入途中退出
+      if (++nSpins % kSnapshotSpins == 0) {
+        if (IsPublisherStale())
+          return false;
+        std::this_thread::yield();
+      } else {
+        CpuRelax();
+      }
+      continue;
+    }
+    for (std::size_t i = 0; i < kWords; ++i)
+      nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.nSeq.load(std::memory_order_relaxed) == nBegin)
+      break;
+  }
+  if (nBegin == 0)
+    return false;
+  std::memcpy(static_cast<void *>(&tick), nWords, sizeof(tick));
+  if (pVersion)
+    *pVersion = nBegin;
+  return true;
+}
+
+bool ShmMdClient::IsPublisherStale(std::int64_t nTimeoutNs) const {
+  return m_pHeader && nowNanos() - GetHeartbeatNs() > nTimeoutNs;
+}
+
+bool ShmMdClient::IsReplaced() const {
+  if (!m_pHeader)
+    return false;
+  struct stat st;
+  if (::stat(m_strPath.c_str(), &st) != 0)
+    return true;
+  return static_cast<std::uint64_t>(st.st_dev) != m_nDevice ||
+         static_cast<std::uint64_t>(st.st_ino) != m_nInode;
+}
+
+std::size_t ShmMdClient::RefreshInstruments() {
+  std::uint32_t nCount =
+      m_pHeader->nInstruments.load(std::memory_order_acquire);
+  if (nCount > m_nMaxInstruments)
+    nCount = m_nMaxInstruments;
+  for (std::size_t i = m_pTable->Size(); i < nCount; ++i) {
+    const ShmMdInstrument &instrument = m_pInstruments[i];
+    if (m_pTable->Add(instrument.szInstrumentID, instrument.dPriceTick) != i) {
+      // 目录中出现重复合约，说明文件已损坏；保持下标一致，不再继续同步
+      CTP_LOG_WARN("[ShmMd] inconsistent instrument directory at %zu", i);
+      break;
+    }
+  }
+  return m_pTable->Size();
+}
+
+ShmMdClientStats ShmMdClient::GetStats() const {
+  ShmMdClientStats stats;
+  stats.nConsumed = m_nConsumed;
+  stats.nGaps = m_nGaps;
+  stats.nLost = m_nLost;
+  std::uint64_t nWriteSeq =
+      m_pHeader ? m_pHeader->nWriteSeq.load(std::memory_order_acquire) : 0;
+  stats.nLag = nWriteSeq > m_nReadSeq ? nWriteSeq - m_nReadSeq : 0;
+  return stats;
+}
+
+} // namespace ctp
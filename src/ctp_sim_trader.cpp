@@ -0,0 +1,498 @@
+#include "ctp_sim_trader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace ctp {
+
+namespace {
+
+// 距离到期不足该值时改为让出CPU轮询，条件变量的超时精度不够
+constexpr std::int64_t kSpinThresholdNs = 100000;
+
+std::int64_t steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void localDateTime(TThostFtdcDateType szDate, TThostFtdcTimeType szTime) {
+  std::time_t nNow = std::time(nullptr);
+  std::tm tmLocal;
+#if defined(_WIN32)
+  localtime_s(&tmLocal, &nNow);
+#else
+  localtime_r(&nNow, &tmLocal);
+#endif
+  if (szDate)
+    std::strftime(szDate, sizeof(TThostFtdcDateType), "%Y%m%d", &tmLocal);
+  if (szTime)
+    std::strftime(szTime, sizeof(TThostFtdcTimeType), "%H:%M:%S", &tmLocal);
+}
+
+SimTraderOptions resolveOptions(const SimTraderOptions &options) {
+  SimTraderOptions resolved = options;
+  if (resolved.strTradingDay.empty()) {
+    TThostFtdcDateType szDate;
+    localDateTime(szDate, nullptr);
+    resolved.strTradingDay = szDate;
+  }
+  return resolved;
+}
+
+} // namespace
+
+SimTraderApi *
+SimTraderApi::CreateSimTraderApi(const SimTraderOptions &options) {
+  return new SimTraderApi(options);
+}
+
+SimTraderApi::SimTraderApi(const SimTraderOptions &options)
+    : m_options(resolveOptions(options)), m_pSpi(nullptr),
+      m_engine(this, m_options.strTradingDay.c_str()), m_bRunning(false),
+      m_nSeq(0), m_nLastRequestDue(0), m_nLastResponseDue(0) {
+  std::memset(m_szTradingDay, 0, sizeof(m_szTradingDay));
+  std::strncpy(m_szTradingDay, m_options.strTradingDay.c_str(),
+               sizeof(m_szTradingDay) - 1);
+}
+
+SimTraderApi::~SimTraderApi() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bRunning = false;
+    m_cond.notify_all();
+  }
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void SimTraderApi::Release() { delete this; }
+
+void SimTraderApi::Init() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bRunning)
+      return;
+  }
+  // 上一个会话已经登出，先等其模拟线程退出
+  if (m_thread.joinable())
+    m_thread.join();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bRunning = true;
+  }
+  m_thread = std::thread(&SimTraderApi::run, this);
+  scheduleResponse([this] {
+    if (m_pSpi)
+      m_pSpi->OnFrontConnected();
+  });
+}
+
+int SimTraderApi::Join() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this] { return !m_bRunning; });
+  return 0;
+}
+
+const char *SimTraderApi::GetTradingDay() { return m_szTradingDay; }
+
+void SimTraderApi::GetFrontInfo(CThostFtdcFrontInfoField *pFrontInfo) {
+  if (pFrontInfo)
+    std::memset(pFrontInfo, 0, sizeof(*pFrontInfo));
+}
+
+void SimTraderApi::RegisterFront(char *) {}
+
+void SimTraderApi::RegisterNameServer(char *) {}
+
+void SimTraderApi::RegisterFensUserInfo(CThostFtdcFensUserInfoField *) {}
+
+void SimTraderApi::RegisterSpi(CThostFtdcTraderSpi *pSpi) { m_pSpi = pSpi; }
+
+void SimTraderApi::SubscribePrivateTopic(THOST_TE_RESUME_TYPE) {}
+
+void SimTraderApi::SubscribePublicTopic(THOST_TE_RESUME_TYPE) {}
+
+int SimTraderApi::RegisterUserSystemInfo(CThostFtdcUserSystemInfoField *) {
+  return 0;
+}
+
+int SimTraderApi::SubmitUserSystemInfo(CThostFtdcUserSystemInfoField *) {
+  return 0;
+}
+
+int SimTraderApi::RegisterWechatUserSystemInfo(
+    CThostFtdcWechatUserSystemInfoField *) {
+  return 0;
+}
+
+int SimTraderApi::SubmitWechatUserSystemInfo(
+    CThostFtdcWechatUserSystemInfoField *) {
+  return 0;
+}
+
+void SimTraderApi::FeedMarketData(const CThostFtdcDepthMarketDataField &tick) {
+  // 行情直接到达撮合引擎，不计请求延迟
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_jobs.push(Job{steadyNanos(), m_nSeq++,
+                  [this, tick] { m_engine.OnMarketData(tick); }});
+  m_cond.notify_all();
+}
+
+int SimTraderApi::ReqAuthenticate(
+    CThostFtdcReqAuthenticateField *pReqAuthenticate, int nRequestID) {
+  if (!pReqAuthenticate)
+    return -1;
+  CThostFtdcRspAuthenticateField rsp{};
+  std::memcpy(rsp.BrokerID, pReqAuthenticate->BrokerID, sizeof(rsp.BrokerID));
+  std::memcpy(rsp.UserID, pReqAuthenticate->UserID, sizeof(rsp.UserID));
+  std::memcpy(rsp.UserProductInfo, pReqAuthenticate->UserProductInfo,
+              sizeof(rsp.UserProductInfo));
+  std::memcpy(rsp.AppID, pReqAuthenticate->AppID, sizeof(rsp.AppID));
+  scheduleRequest([this, rsp, nRequestID] {
+    scheduleResponse([this, rsp, nRequestID]() mutable {
+      CThostFtdcRspInfoField rspInfo{};
+      if (m_pSpi)
+        m_pSpi->OnRspAuthenticate(&rsp, &rspInfo, nRequestID, true);
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqUserLogin(CThostFtdcReqUserLoginField *pReqUserLogin,
+                               int nRequestID) {
+  if (!pReqUserLogin)
+    return -1;
+  CThostFtdcRspUserLoginField rsp{};
+  std::memcpy(rsp.TradingDay, m_szTradingDay, sizeof(rsp.TradingDay));
+  std::memcpy(rsp.BrokerID, pReqUserLogin->BrokerID, sizeof(rsp.BrokerID));
+  std::memcpy(rsp.UserID, pReqUserLogin->UserID, sizeof(rsp.UserID));
+  std::strncpy(rsp.SystemName, "SimTrader", sizeof(rsp.SystemName) - 1);
+  rsp.FrontID = m_options.nFrontID;
+  rsp.SessionID = m_options.nSessionID;
+  std::strncpy(rsp.MaxOrderRef, "1", sizeof(rsp.MaxOrderRef) - 1);
+  scheduleRequest([this, rsp, nRequestID] {
+    scheduleResponse([this, rsp, nRequestID]() mutable {
+      localDateTime(nullptr, rsp.LoginTime);
+      CThostFtdcRspInfoField rspInfo{};
+      if (m_pSpi)
+        m_pSpi->OnRspUserLogin(&rsp, &rspInfo, nRequestID, true);
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqUserLogout(CThostFtdcUserLogoutField *pUserLogout,
+                                int nRequestID) {
+  if (!pUserLogout)
+    return -1;
+  CThostFtdcUserLogoutField rsp = *pUserLogout;
+  scheduleRequest([this, rsp, nRequestID] {
+    scheduleResponse([this, rsp, nRequestID]() mutable {
+      CThostFtdcRspInfoField rspInfo{};
+      if (m_pSpi)
+        m_pSpi->OnRspUserLogout(&rsp, &rspInfo, nRequestID, true);
+      // 登出即模拟会话结束，模拟线程退出并唤醒Join()
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bRunning = false;
+      m_cond.notify_all();
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqSettlementInfoConfirm(
+    CThostFtdcSettlementInfoConfirmField *pSettlementInfoConfirm,
+    int nRequestID) {
+  if (!pSettlementInfoConfirm)
+    return -1;
+  CThostFtdcSettlementInfoConfirmField rsp = *pSettlementInfoConfirm;
+  scheduleRequest([this, rsp, nRequestID] {
+    scheduleResponse([this, rsp, nRequestID]() mutable {
+      localDateTime(rsp.ConfirmDate, rsp.ConfirmTime);
+      CThostFtdcRspInfoField rspInfo{};
+      if (m_pSpi)
+        m_pSpi->OnRspSettlementInfoConfirm(&rsp, &rspInfo, nRequestID, true);
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqOrderInsert(CThostFtdcInputOrderField *pInputOrder,
+                                 int nRequestID) {
+  if (!pInputOrder)
+    return -1;
+  CThostFtdcInputOrderField inputOrder = *pInputOrder;
+  inputOrder.RequestID = nRequestID;
+  scheduleRequest([this, inputOrder, nRequestID] {
+    CThostFtdcRspInfoField rspInfo{};
+    if (m_engine.InsertOrder(inputOrder, m_options.nFrontID,
+                             m_options.nSessionID, &rspInfo) == 0)
+      return;
+    // 柜台拒单：OnRspOrderInsert与OnErrRtnOrderInsert
+    scheduleResponse([this, inputOrder, rspInfo, nRequestID]() mutable {
+      if (!m_pSpi)
+        return;
+      m_pSpi->OnRspOrderInsert(&inputOrder, &rspInfo, nRequestID, true);
+      m_pSpi->OnErrRtnOrderInsert(&inputOrder, &rspInfo);
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqOrderAction(
+    CThostFtdcInputOrderActionField *pInputOrderAction, int nRequestID) {
+  if (!pInputOrderAction)
+    return -1;
+  CThostFtdcInputOrderActionField inputOrderAction = *pInputOrderAction;
+  inputOrderAction.RequestID = nRequestID;
+  scheduleRequest([this, inputOrderAction, nRequestID] {
+    CThostFtdcRspInfoField rspInfo{};
+    if (m_engine.CancelOrder(inputOrderAction, &rspInfo) == 0)
+      return;
+
+    CThostFtdcOrderActionField orderAction{};
+    std::memcpy(orderAction.BrokerID, inputOrderAction.BrokerID,
+                sizeof(orderAction.BrokerID));
+    std::memcpy(orderAction.InvestorID, inputOrderAction.InvestorID,
+                sizeof(orderAction.InvestorID));
+    std::memcpy(orderAction.OrderRef, inputOrderAction.OrderRef,
+                sizeof(orderAction.OrderRef));
+    std::memcpy(orderAction.ExchangeID, inputOrderAction.ExchangeID,
+                sizeof(orderAction.ExchangeID));
+    std::memcpy(orderAction.OrderSysID, inputOrderAction.OrderSysID,
+                sizeof(orderAction.OrderSysID));
+    std::memcpy(orderAction.UserID, inputOrderAction.UserID,
+                sizeof(orderAction.UserID));
+    std::memcpy(orderAction.InstrumentID, inputOrderAction.InstrumentID,
+                sizeof(orderAction.InstrumentID));
+    std::memcpy(orderAction.StatusMsg, rspInfo.ErrorMsg,
+                sizeof(orderAction.StatusMsg));
+    orderAction.OrderActionRef = inputOrderAction.OrderActionRef;
+    orderAction.RequestID = inputOrderAction.RequestID;
+    orderAction.FrontID = inputOrderAction.FrontID;
+    orderAction.SessionID = inputOrderAction.SessionID;
+    orderAction.ActionFlag = inputOrderAction.ActionFlag;
+    orderAction.LimitPrice = inputOrderAction.LimitPrice;
+    orderAction.VolumeChange = inputOrderAction.VolumeChange;
+    localDateTime(orderAction.ActionDate, orderAction.ActionTime);
+
+    scheduleResponse([this, inputOrderAction, orderAction, rspInfo,
+                      nRequestID]() mutable {
+      if (!m_pSpi)
+        return;
+      m_pSpi->OnRspOrderAction(&inputOrderAction, &rspInfo, nRequestID, true);
+      m_pSpi->OnErrRtnOrderAction(&orderAction, &rspInfo);
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqQryOrder(CThostFtdcQryOrderField *pQryOrder,
+                              int nRequestID) {
+  if (!pQryOrder)
+    return -1;
+  CThostFtdcQryOrderField query = *pQryOrder;
+  scheduleRequest([this, query, nRequestID] {
+    std::vector<CThostFtdcOrderField> orders;
+    for (const CThostFtdcOrderField &order : m_engine.GetOrders()) {
+      if (query.InstrumentID[0] == '\0' ||
+          std::strcmp(query.InstrumentID, order.InstrumentID) == 0)
+        orders.push_back(order);
+    }
+    scheduleResponse([this, orders, nRequestID]() mutable {
+      if (!m_pSpi)
+        return;
+      if (orders.empty())
+        m_pSpi->OnRspQryOrder(nullptr, nullptr, nRequestID, true);
+      for (std::size_t i = 0; i < orders.size(); ++i)
+        m_pSpi->OnRspQryOrder(&orders[i], nullptr, nRequestID,
+                              i + 1 == orders.size());
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqQryTrade(CThostFtdcQryTradeField *pQryTrade,
+                              int nRequestID) {
+  if (!pQryTrade)
+    return -1;
+  CThostFtdcQryTradeField query = *pQryTrade;
+  scheduleRequest([this, query, nRequestID] {
+    std::vector<CThostFtdcTradeField> trades;
+    for (const CThostFtdcTradeField &trade : m_engine.GetTrades()) {
+      if (query.InstrumentID[0] == '\0' ||
+          std::strcmp(query.InstrumentID, trade.InstrumentID) == 0)
+        trades.push_back(trade);
+    }
+    scheduleResponse([this, trades, nRequestID]() mutable {
+      if (!m_pSpi)
+        return;
+      if (trades.empty())
+        m_pSpi->OnRspQryTrade(nullptr, nullptr, nRequestID, true);
+      for (std::size_t i = 0; i < trades.size(); ++i)
+        m_pSpi->OnRspQryTrade(&trades[i], nullptr, nRequestID,
+                              i + 1 == trades.size());
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqQryInvestorPosition(
+    CThostFtdcQryInvestorPositionField *pQryInvestorPosition, int nRequestID) {
+  if (!pQryInvestorPosition)
+    return -1;
+  CThostFtdcQryInvestorPositionField query = *pQryInvestorPosition;
+  scheduleRequest([this, query, nRequestID] {
+    std::vector<CThostFtdcInvestorPositionField> positions;
+    for (const auto &item : m_positions) {
+      if (query.InstrumentID[0] != '\0' && item.first != query.InstrumentID)
+        continue;
+      const Position &position = item.second;
+      for (int nSide = 0; nSide < 2; ++nSide) {
+        int nVolume = nSide == 0 ? position.nLong : position.nShort;
+        if (nVolume == 0)
+          continue;
+        CThostFtdcInvestorPositionField field{};
+        std::memcpy(field.BrokerID, query.BrokerID, sizeof(field.BrokerID));
+        std::memcpy(field.InvestorID, query.InvestorID,
+                    sizeof(field.InvestorID));
+        std::strncpy(field.InstrumentID, item.first.c_str(),
+                     sizeof(field.InstrumentID) - 1);
+        field.PosiDirection = nSide == 0 ? THOST_FTDC_PD_Long
+                                         : THOST_FTDC_PD_Short;
+        field.HedgeFlag = THOST_FTDC_HF_Speculation;
+        field.PositionDate = THOST_FTDC_PSD_Today;
+        field.Position = nVolume;
+        field.TodayPosition = nVolume;
+        field.PositionCost =
+            nSide == 0 ? position.dLongCost : position.dShortCost;
+        field.OpenCost = field.PositionCost;
+        positions.push_back(field);
+      }
+    }
+    scheduleResponse([this, positions, nRequestID]() mutable {
+      if (!m_pSpi)
+        return;
+      if (positions.empty())
+        m_pSpi->OnRspQryInvestorPosition(nullptr, nullptr, nRequestID, true);
+      for (std::size_t i = 0; i < positions.size(); ++i)
+        m_pSpi->OnRspQryInvestorPosition(&positions[i], nullptr, nRequestID,
+                                         i + 1 == positions.size());
+    });
+  });
+  return 0;
+}
+
+int SimTraderApi::ReqQryTradingAccount(
+    CThostFtdcQryTradingAccountField *pQryTradingAccount, int nRequestID) {
+  if (!pQryTradingAccount)
+    return -1;
+  CThostFtdcTradingAccountField account{};
+  std::memcpy(account.BrokerID, pQryTradingAccount->BrokerID,
+              sizeof(account.BrokerID));
+  std::memcpy(account.AccountID, pQryTradingAccount->InvestorID,
+              sizeof(account.AccountID));
+  std::memcpy(account.TradingDay, m_szTradingDay, sizeof(account.TradingDay));
+  account.PreBalance = m_options.dInitialBalance;
+  account.Balance = m_options.dInitialBalance;
+  account.Available = m_options.dInitialBalance;
+  scheduleRequest([this, account, nRequestID] {
+    scheduleResponse([this, account, nRequestID]() mutable {
+      CThostFtdcRspInfoField rspInfo{};
+      if (m_pSpi)
+        m_pSpi->OnRspQryTradingAccount(&account, &rspInfo, nRequestID, true);
+    });
+  });
+  return 0;
+}
+
+void SimTraderApi::OnOrder(const CThostFtdcOrderField &order) {
+  scheduleResponse([this, order = order]() mutable {
+    if (m_pSpi)
+      m_pSpi->OnRtnOrder(&order);
+  });
+}
+
+void SimTraderApi::OnTrade(const CThostFtdcTradeField &trade) {
+  Position &position = m_positions[trade.InstrumentID];
+  const double dAmount = trade.Price * trade.Volume;
+  const bool bBuy = trade.Direction == THOST_FTDC_D_Buy;
+  if (trade.OffsetFlag == THOST_FTDC_OF_Open) {
+    int &nVolume = bBuy ? position.nLong : position.nShort;
+    double &dCost = bBuy ? position.dLongCost : position.dShortCost;
+    nVolume += trade.Volume;
+    dCost += dAmount;
+  } else {
+    // 平仓按持仓均价扣减成本
+    int &nVolume = bBuy ? position.nShort : position.nLong;
+    double &dCost = bBuy ? position.dShortCost : position.dLongCost;
+    int nClosed = std::min(nVolume, trade.Volume);
+    if (nVolume > 0)
+      dCost -= dCost * nClosed / nVolume;
+    nVolume -= nClosed;
+  }
+
+  scheduleResponse([this, trade = trade]() mutable {
+    if (m_pSpi)
+      m_pSpi->OnRtnTrade(&trade);
+  });
+}
+
+void SimTraderApi::scheduleRequest(std::function<void()> fnRun) {
+  schedule(m_options.nRequestLatencyNs, m_nLastRequestDue, std::move(fnRun));
+}
+
+void SimTraderApi::scheduleResponse(std::function<void()> fnRun) {
+  schedule(m_options.nResponseLatencyNs, m_nLastResponseDue, std::move(fnRun));
+}
+
+void SimTraderApi::schedule(std::int64_t nLatency, std::int64_t &nLastDue,
+                            std::function<void()> fnRun) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::int64_t nDue = steadyNanos() + nLatency;
+  if (m_options.nLatencyJitterNs > 0)
+    nDue += static_cast<std::int64_t>(m_random() %
+                                      static_cast<std::uint64_t>(
+                                          m_options.nLatencyJitterNs));
+  // 抖动不能让同类事件乱序
+  if (nDue < nLastDue)
+    nDue = nLastDue;
+  nLastDue = nDue;
+  m_jobs.push(Job{nDue, m_nSeq++, std::move(fnRun)});
+  m_cond.notify_all();
+}
+
+void SimTraderApi::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_bRunning) {
+    if (m_jobs.empty()) {
+      m_cond.wait(lock);
+      continue;
+    }
+
+    std::int64_t nWait = m_jobs.top().nDue - steadyNanos();
+    if (nWait > kSpinThresholdNs) {
+      m_cond.wait_for(lock, std::chrono::nanoseconds(nWait - kSpinThresholdNs));
+      continue;
+    }
+    if (nWait > 0) {
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+      continue;
+    }
+
+    // priority_queue::top()只提供const引用，移出后立即弹出
+    Job job = std::move(const_cast<Job &>(m_jobs.top()));
+    m_jobs.pop();
+    lock.unlock();
+    job.fnRun();
+    lock.lock();
+  }
+  m_cond.notify_all();
+}
+
+} // namespace ctp
@@ -0,0 +1,23 @@
+#include "ctp_snapshot_table.h"
+
+#include <new>
+
+namespace ctp {
+
+static_assert(sizeof(CompactTick) % 8 == 0,
+              "CompactTick must be a whole number of 8-byte words");
+
+SnapshotTable::SnapshotTable(std::size_t nMaxInstruments)
+    : m_nCapacity(nMaxInstruments), m_pSlots(nullptr) {
+  std::size_t nBytes = sizeof(Slot) * m_nCapacity;
+  m_pSlots = static_cast<Slot *>(
+      ::operator new(nBytes, std::align_val_t(kCacheLineSize)));
+  // 预先触页并将序号清零，未写入过的槽位序号为0
+  std::memset(static_cast<void *>(m_pSlots), 0, nBytes);
+}
+
+SnapshotTable::~SnapshotTable() {
+  ::operator delete(m_pSlots, std::align_val_t(kCacheLineSize));
+}
+
+} // namespace ctp
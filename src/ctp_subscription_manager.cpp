@@ -0,0 +1,259 @@
+#include "ctp_subscription_manager.h"
+#include "ctp_log.h"
+
+#include <cstring>
+
+namespace ctp {
+
+SubscriptionManager::SubscriptionManager(
+    const SubscriptionManagerOptions &options)
+    : m_options(options), m_pApi(nullptr), m_bLoggedIn(false),
+      m_pIDs(new TThostFtdcInstrumentIDType[options.nMaxInstruments]()),
+      m_table(options.nMaxInstruments), m_nBatches(0) {
+  if (m_options.nBatchSize == 0)
+    m_options.nBatchSize = 1;
+  m_desired.reserve(m_options.nMaxInstruments);
+  m_states.reserve(m_options.nMaxInstruments);
+  m_batchOf.reserve(m_options.nMaxInstruments);
+  m_batch.reserve(m_options.nBatchSize);
+  m_batchIndices.reserve(m_options.nBatchSize);
+}
+
+void SubscriptionManager::SetMdApi(CThostFtdcMdApi *pApi) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_pApi = pApi;
+}
+
+bool SubscriptionManager::Add(const char *pszInstrumentID) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  bool bOk = add(pszInstrumentID);
+  flush();
+  return bOk;
+}
+
+bool SubscriptionManager::Add(const std::vector<const char *> &instrumentIDs) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  bool bOk = true;
+  for (const char *pszInstrumentID : instrumentIDs)
+    bOk = add(pszInstrumentID) && bOk;
+  flush();
+  return bOk;
+}
+
+bool SubscriptionManager::Remove(const char *pszInstrumentID) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::uint32_t nIndex = m_table.Find(pszInstrumentID);
+  if (nIndex == kInvalidInstrument)
+    return false;
+  m_desired[nIndex] = false;
+  if (m_states[nIndex] == SubscriptionState::Failed)
+    m_states[nIndex] = SubscriptionState::None;
+  // 等待订阅应答的合约在确认后再退订
+  flush();
+  return true;
+}
+
+void SubscriptionManager::Retry() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &eState : m_states) {
+    if (eState == SubscriptionState::Failed)
+      eState = SubscriptionState::None;
+  }
+  flush();
+}
+
+int SubscriptionManager::OnLogin() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_bLoggedIn = true;
+  return flush();
+}
+
+void SubscriptionManager::OnDisconnected() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_bLoggedIn = false;
+  // 前置上的订阅随连接失效，只保留期望集合与失败记录
+  for (auto &eState : m_states) {
+    if (eState != SubscriptionState::Failed)
+      eState = SubscriptionState::None;
+  }
+}
+
+void SubscriptionManager::OnRspSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, bool bIsLast) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (pSpecificInstrument) {
+    std::uint32_t nIndex = m_table.Find(pSpecificInstrument->InstrumentID);
+    if (nIndex != kInvalidInstrument &&
+        m_states[nIndex] == SubscriptionState::Pending) {
+      if (pRspInfo && pRspInfo->ErrorID != 0) {
+        CTP_LOG_ERROR("[Subscription] subscribe %s failed, ErrorID: %d, "
+                      "ErrorMsg: %s",
+                      pSpecificInstrument->InstrumentID, pRspInfo->ErrorID,
+                      pRspInfo->ErrorMsg);
+        m_states[nIndex] = SubscriptionState::Failed;
+      } else {
+        m_states[nIndex] = SubscriptionState::Active;
+      }
+    }
+  } else if (pRspInfo && pRspInfo->ErrorID != 0) {
+    // 不带合约的错误应答针对整个请求，最早未应答请求中的合约全部失败
+    std::size_t nFailed = completeOldestBatch(SubscriptionState::Pending,
+                                              SubscriptionState::Failed);
+    CTP_LOG_ERROR("[Subscription] subscribe request failed for %zu "
+                  "instruments, ErrorID: %d, ErrorMsg: %s",
+                  nFailed, pRspInfo->ErrorID, pRspInfo->ErrorMsg);
+  }
+  // 等待期间被移出期望集合的合约此时退订
+  if (bIsLast)
+    flush();
+}
+
+void SubscriptionManager::OnRspUnSubMarketData(
+    CThostFtdcSpecificInstrumentField *pSpecificInstrument,
+    CThostFtdcRspInfoField *pRspInfo, bool bIsLast) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (pSpecificInstrument) {
+    std::uint32_t nIndex = m_table.Find(pSpecificInstrument->InstrumentID);
+    if (nIndex != kInvalidInstrument &&
+        m_states[nIndex] == SubscriptionState::Unsubscribe) {
+      if (pRspInfo && pRspInfo->ErrorID != 0)
+        CTP_LOG_WARN("[Subscription] unsubscribe %s failed, ErrorID: %d",
+                     pSpecificInstrument->InstrumentID, pRspInfo->ErrorID);
+      m_states[nIndex] = SubscriptionState::None;
+    }
+  } else if (pRspInfo && pRspInfo->ErrorID != 0) {
+    std::size_t nDone = completeOldestBatch(SubscriptionState::Unsubscribe,
+                                            SubscriptionState::None);
+    CTP_LOG_WARN("[Subscription] unsubscribe request failed for %zu "
+                 "instruments, ErrorID: %d",
+                 nDone, pRspInfo->ErrorID);
+  }
+  if (bIsLast)
+    flush();
+}
+
+SubscriptionState
+SubscriptionManager::GetState(const char *pszInstrumentID) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::uint32_t nIndex = m_table.Find(pszInstrumentID);
+  return nIndex == kInvalidInstrument ? SubscriptionState::None
+                                      : m_states[nIndex];
+}
+
+SubscriptionStats SubscriptionManager::GetStats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  SubscriptionStats stats{};
+  for (std::size_t i = 0; i < m_states.size(); ++i) {
+    if (m_desired[i])
+      ++stats.nDesired;
+    switch (m_states[i]) {
+    case SubscriptionState::Active:
+      ++stats.nActive;
+      break;
+    case SubscriptionState::Pending:
+      ++stats.nPending;
+      break;
+    case SubscriptionState::Failed:
+      ++stats.nFailed;
+      break;
+    default:
+      break;
+    }
+  }
+  stats.nBatches = m_nBatches;
+  return stats;
+}
+
+bool SubscriptionManager::add(const char *pszInstrumentID) {
+  if (!pszInstrumentID || !pszInstrumentID[0])
+    return false;
+  std::uint32_t nIndex = m_table.Add(pszInstrumentID);
+  if (nIndex == kInvalidInstrument) {
+    CTP_LOG_WARN("[Subscription] pool full, %s not added", pszInstrumentID);
+    return false;
+  }
+  if (nIndex == m_states.size()) {
+    std::strncpy(m_pIDs[nIndex], pszInstrumentID,
+                 sizeof(TThostFtdcInstrumentIDType) - 1);
+    m_desired.push_back(false);
+    m_states.push_back(SubscriptionState::None);
+    m_batchOf.push_back(0);
+  }
+  m_desired[nIndex] = true;
+  return true;
+}
+
+int SubscriptionManager::flush() {
+  if (!m_pApi || !m_bLoggedIn)
+    return 0;
+
+  // 先订阅期望但未在前置上的合约，再退订已不需要的合约
+  for (int nPass = 0; nPass < 2; ++nPass) {
+    const bool bSubscribe = nPass == 0;
+    for (std::uint32_t i = 0; i < m_states.size(); ++i) {
+      bool bSend = bSubscribe
+                       ? m_desired[i] && m_states[i] == SubscriptionState::None
+                       : !m_desired[i] &&
+                             m_states[i] == SubscriptionState::Active;
+      if (!bSend)
+        continue;
+      m_batch.push_back(m_pIDs[i]);
+      m_batchIndices.push_back(i);
+      if (m_batch.size() == m_options.nBatchSize) {
+        if (int nRet = sendBatch(bSubscribe))
+          return nRet;
+      }
+    }
+    if (!m_batch.empty()) {
+      if (int nRet = sendBatch(bSubscribe))
+        return nRet;
+    }
+  }
+  return 0;
+}
+
+int SubscriptionManager::sendBatch(bool bSubscribe) {
+  int nCount = static_cast<int>(m_batch.size());
+  int nRet = bSubscribe ? m_pApi->SubscribeMarketData(m_batch.data(), nCount)
+                        : m_pApi->UnSubscribeMarketData(m_batch.data(), nCount);
+  if (nRet == 0) {
+    const SubscriptionState eState = bSubscribe
+                                         ? SubscriptionState::Pending
+                                         : SubscriptionState::Unsubscribe;
+    for (std::uint32_t nIndex : m_batchIndices) {
+      m_states[nIndex] = eState;
+      m_batchOf[nIndex] = m_nBatches;
+    }
+    ++m_nBatches;
+    CTP_LOG_INFO("[Subscription] %s request sent for %d instruments",
+                 bSubscribe ? "subscribe" : "unsubscribe", nCount);
+  } else {
+    // 状态保持不变，下次登录或变更时重新发送
+    CTP_LOG_ERROR("[Subscription] %s request failed, ret = %d",
+                  bSubscribe ? "subscribe" : "unsubscribe", nRet);
+  }
+  m_batch.clear();
+  m_batchIndices.clear();
+  return nRet;
+}
+
+std::size_t
+SubscriptionManager::completeOldestBatch(SubscriptionState eFrom,
+                                         SubscriptionState eTo) {
+  std::uint64_t nOldest = m_nBatches;
+  for (std::size_t i = 0; i < m_states.size(); ++i) {
+    if (m_states[i] == eFrom && m_batchOf[i] < nOldest)
+      nOldest = m_batchOf[i];
+  }
+  std::size_t nCount = 0;
+  for (std::size_t i = 0; i < m_states.size(); ++i) {
+    if (m_states[i] == eFrom && m_batchOf[i] == nOldest) {
+      m_states[i] = eTo;
+      ++nCount;
+    }
+  }
+  return nCount;
+}
+
+} // namespace ctp
@@ -0,0 +1,379 @@
+#include "ctp_thread_placement.h"
+#include "ctp_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace ctp {
+
+bool ParseCpuList(const char *pszCpuList, std::vector<int> &cpus) {
+  cpus.clear();
+  if (!pszCpuList)
+    return false;
+  const char *p = pszCpuList;
+  while (*p) {
+    char *pEnd = nullptr;
+    long nFirst = std::strtol(p, &pEnd, 10);
+    if (pEnd == p || nFirst < 0)
+      return false;
+    long nLast = nFirst;
+    p = pEnd;
+    if (*p == '-') {
+      ++p;
+      nLast = std::strtol(p, &pEnd, 10);
+      if (pEnd == p || nLast < nFirst)
+        return false;
+      p = pEnd;
+    }
+    for (long n = nFirst; n <= nLast; ++n)
+      cpus.push_back(static_cast<int>(n));
+    if (*p == ',')
+      ++p;
+    else if (*p && *p != '\n')
+      return false;
+    else
+      break;
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return !cpus.empty();
+}
+
+#if defined(__linux__)
+
+namespace {
+
+const char *policyName(int nPolicy) {
+  switch (nPolicy) {
+  case SCHED_OTHER:
+    return "other";
+  case SCHED_FIFO:
+    return "fifo";
+  case SCHED_RR:
+    return "rr";
+#ifdef SCHED_BATCH
+  case SCHED_BATCH:
+    return "batch";
+#endif
+#ifdef SCHED_IDLE
+  case SCHED_IDLE:
+    return "idle";
+#endif
+  default:
+    return "unknown";
+  }
+}
+
+// 把CPU集合格式化为"0-3,8"
+std::string formatCpuSet(const cpu_set_t &set) {
+  std::string strCpus;
+  char szRange[32];
+  for (int n = 0; n < CPU_SETSIZE; ++n) {
+    if (!CPU_ISSET(n, &set))
+      continue;
+    int nLast = n;
+    while (nLast + 1 < CPU_SETSIZE && CPU_ISSET(nLast + 1, &set))
+      ++nLast;
+    if (nLast == n)
+      std::snprintf(szRange, sizeof(szRange), "%d", n);
+    else
+      std::snprintf(szRange, sizeof(szRange), "%d-%d", n, nLast);
+    if (!strCpus.empty())
+      strCpus += ',';
+    strCpus += szRange;
+    n = nLast;
+  }
+  return strCpus;
+}
+
+bool readFirstLine(const char *pszPath, char *pszBuffer, std::size_t nSize) {
+  std::FILE *pFile = std::fopen(pszPath, "r");
+  if (!pFile)
+    return false;
+  bool bOk = std::fgets(pszBuffer, static_cast<int>(nSize), pFile) != nullptr;
+  std::fclose(pFile);
+  if (bOk)
+    pszBuffer[std::strcspn(pszBuffer, "\n")] = '\0';
+  return bOk;
+}
+
+// /proc/self/task/<tid>/stat的第39个字段：最近一次运行所在的CPU
+int lastCpuOfThread(int nTid) {
+  char szPath[64];
+  char szStat[1024];
+  std::snprintf(szPath, sizeof(szPath), "/proc/self/task/%d/stat", nTid);
+  if (!readFirstLine(szPath, szStat, sizeof(szStat)))
+    return -1;
+  // comm字段可能含空格，从最后一个')'之后开始数（该处为第3个字段）
+  const char *p = std::strrchr(szStat, ')');
+  if (!p)
+    return -1;
+  int nField = 2;
+  while (*p && nField < 39) {
+    if (*p == ' ')
+      ++nField;
+    ++p;
+  }
+  return nField == 39 ? std::atoi(p) : -1;
+}
+
+// set_mempolicy/mbind的常量，避免依赖libnuma的头文件
+constexpr int kMpolBind = 2;
+constexpr unsigned kMpolMfMove = 1u << 1;
+
+} // namespace
+
+int GetOsThreadId() { return static_cast<int>(::syscall(SYS_gettid)); }
+
+std::vector<int> ListProcessThreads() {
+  std::vector<int> tids;
+  DIR *pDir = ::opendir("/proc/self/task");
+  if (!pDir)
+    return tids;
+  while (const dirent *pEntry = ::readdir(pDir)) {
+    if (pEntry->d_name[0] >= '0' && pEntry->d_name[0] <= '9')
+      tids.push_back(std::atoi(pEntry->d_name));
+  }
+  ::closedir(pDir);
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+bool ApplyThreadPlacement(int nTid, const ThreadPlacement &placement,
+                          const char *pszLabel) {
+  if (nTid == 0)
+    nTid = GetOsThreadId();
+  bool bOk = true;
+
+  if (!placement.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int nCpu : placement.cpus) {
+      if (nCpu >= 0 && nCpu < CPU_SETSIZE)
+        CPU_SET(nCpu, &set);
+    }
+    if (::sched_setaffinity(nTid, sizeof(set), &set) != 0) {
+      CTP_LOG_WARN("[Placement] %s tid=%d sched_setaffinity failed: %s",
+                   pszLabel, nTid, std::strerror(errno));
+      bOk = false;
+    }
+  }
+
+  if (placement.ePolicy != ThreadSchedPolicy::Inherit) {
+    int nPolicy = SCHED_OTHER;
+    sched_param param;
+    param.sched_priority = 0;
+    if (placement.ePolicy == ThreadSchedPolicy::Fifo ||
+        placement.ePolicy == ThreadSchedPolicy::RoundRobin) {
+      nPolicy = placement.ePolicy == ThreadSchedPolicy::Fifo ? SCHED_FIFO
+                                                              : SCHED_RR;
+      int nMin = ::sched_get_priority_min(nPolicy);
+      int nMax = ::sched_get_priority_max(nPolicy);
+      param.sched_priority =
+          std::min(std::max(placement.nPriority, nMin), nMax);
+    }
+    if (::sched_setscheduler(nTid, nPolicy, &param) != 0) {
+      CTP_LOG_WARN("[Placement] %s tid=%d sched_setscheduler(%s) failed: %s",
+                   pszLabel, nTid, policyName(nPolicy), std::strerror(errno));
+      bOk = false;
+    }
+  }
+
+  LogThreadPlacement(nTid, pszLabel);
+  return bOk;
+}
+
+std::string DescribeThreadPlacement(int nTid) {
+  if (nTid == 0)
+    nTid = GetOsThreadId();
+
+  char szPath[64];
+  char szName[32] = "?";
+  std::snprintf(szPath, sizeof(szPath), "/proc/self/task/%d/comm", nTid);
+  readFirstLine(szPath, szName, sizeof(szName));
+
+  std::string strCpus = "?";
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(nTid, sizeof(set), &set) == 0)
+    strCpus = formatCpuSet(set);
+
+  int nPolicy = ::sched_getscheduler(nTid);
+  sched_param param;
+  param.sched_priority = 0;
+  ::sched_getparam(nTid, &param);
+
+  int nCpu = lastCpuOfThread(nTid);
+  char szResult[256];
+  std::snprintf(szResult, sizeof(szResult),
+                "tid=%d name=%s cpus=%s policy=%s prio=%d cpu=%d node=%d",
+                nTid, szName, strCpus.c_str(),
+                nPolicy < 0 ? "?" : policyName(nPolicy), param.sched_priority,
+                nCpu, nCpu < 0 ? -1 : GetNumaNodeOfCpu(nCpu));
+  return szResult;
+}
+
+int GetNumaNodeOfCpu(int nCpu) {
+  char szPath[64];
+  std::snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu%d", nCpu);
+  DIR *pDir = ::opendir(szPath);
+  if (!pDir)
+    return -1;
+  int nNode = -1;
+  while (const dirent *pEntry = ::readdir(pDir)) {
+    if (std::strncmp(pEntry->d_name, "node", 4) == 0 &&
+        pEntry->d_name[4] >= '0' && pEntry->d_name[4] <= '9') {
+      nNode = std::atoi(pEntry->d_name + 4);
+      break;
+    }
+  }
+  ::closedir(pDir);
+  return nNode;
+}
+
+int GetNumaNodeCount() {
+  char szOnline[256];
+  std::vector<int> nodes;
+  if (!readFirstLine("/sys/devices/system/node/online", szOnline,
+                     sizeof(szOnline)) ||
+      !ParseCpuList(szOnline, nodes))
+    return 1;
+  return static_cast<int>(nodes.size());
+}
+
+int GetCurrentNumaNode() {
+  unsigned nCpu = 0;
+  unsigned nNode = 0;
+  if (::syscall(SYS_getcpu, &nCpu, &nNode, nullptr) != 0)
+    return -1;
+  return static_cast<int>(nNode);
+}
+
+bool BindMemoryToNumaNode(void *pMemory, std::size_t nBytes, int nNode) {
+  if (!pMemory || nNode < 0 || nNode >= 64)
+    return false;
+  const std::uintptr_t nPage =
+      static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+  std::uintptr_t nBegin = reinterpret_cast<std::uintptr_t>(pMemory);
+  std::uintptr_t nEnd = nBegin + nBytes;
+  nBegin = (nBegin + nPage - 1) & ~(nPage - 1);
+  nEnd &= ~(nPage - 1);
+  if (nEnd <= nBegin)
+    return true;
+
+  unsigned long nMask = 1ul << nNode;
+  if (::syscall(SYS_mbind, nBegin, nEnd - nBegin, kMpolBind, &nMask,
+                sizeof(nMask) * 8, kMpolMfMove) != 0) {
+    CTP_LOG_WARN("[Placement] mbind(node=%d, %zu bytes) failed: %s", nNode,
+                 static_cast<std::size_t>(nEnd - nBegin),
+                 std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+#else
+
+// 其他平台只提供线程ID，放置与NUMA接口均返回失败
+#if defined(_WIN32)
+int GetOsThreadId() { return static_cast<int>(::GetCurrentThreadId()); }
+#else
+int GetOsThreadId() { return 0; }
+#endif
+
+std::vector<int> ListProcessThreads() { return {}; }
+
+bool ApplyThreadPlacement(int nTid, const ThreadPlacement &placement,
+                          const char *pszLabel) {
+  if (placement.Empty())
+    return true;
+  CTP_LOG_WARN("[Placement] %s tid=%d: thread placement is not supported",
+               pszLabel, nTid);
+  return false;
+}
+
+std::string DescribeThreadPlacement(int nTid) {
+  return "tid=" + std::to_string(nTid);
+}
+
+int GetNumaNodeOfCpu(int) { return -1; }
+
+int GetNumaNodeCount() { return 1; }
+
+int GetCurrentNumaNode() { return -1; }
+
+bool BindMemoryToNumaNode(void *, std::size_t, int) { return false; }
+
+#endif
+
+std::size_t ApplyThreadPlacement(const std::vector<int> &tids,
+                                 const ThreadPlacement &placement,
+                                 const char *pszLabel) {
+  std::size_t nApplied = 0;
+  for (int nTid : tids) {
+    if (ApplyThreadPlacement(nTid, placement, pszLabel))
+      ++nApplied;
+  }
+  return nApplied;
+}
+
+void LogThreadPlacement(int nTid, const char *pszLabel) {
+  CTP_LOG_INFO("[Placement] %s %s", pszLabel,
+               DescribeThreadPlacement(nTid).c_str());
+}
+
+int GetNumaNodeOfPlacement(const ThreadPlacement &placement) {
+  int nNode = -1;
+  for (int nCpu : placement.cpus) {
+    int nCpuNode = GetNumaNodeOfCpu(nCpu);
+    if (nCpuNode < 0 || (nNode >= 0 && nCpuNode != nNode))
+      return -1;
+    nNode = nCpuNode;
+  }
+  return nNode;
+}
+
+ThreadSnapshot::ThreadSnapshot() : m_tids(ListProcessThreads()) {}
+
+std::vector<int> ThreadSnapshot::GetNewThreads(int nSettleMs,
+                                               int nTimeoutMs) const {
+  using Clock = std::chrono::steady_clock;
+  const auto deadline = Clock::now() + std::chrono::milliseconds(nTimeoutMs);
+  std::vector<int> newTids;
+  auto lastChange = Clock::now();
+  for (;;) {
+    std::vector<int> current = ListProcessThreads();
+    std::vector<int> diff;
+    std::set_difference(current.begin(), current.end(), m_tids.begin(),
+                        m_tids.end(), std::back_inserter(diff));
+    auto now = Clock::now();
+    if (diff != newTids) {
+      newTids.swap(diff);
+      lastChange = now;
+    }
+    if (now - lastChange >= std::chrono::milliseconds(nSettleMs) ||
+        now >= deadline)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return newTids;
+}
+
+} // namespace ctp
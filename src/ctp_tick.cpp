@@ -0,0 +1,78 @@
+#include "ctp_tick.h"
+
+#include <cmath>
+
+namespace ctp {
+
+namespace {
+
+// 超过该值的价格视为无效（CTP以DBL_MAX填充空值）
+constexpr double kMaxValidPrice = 1e12;
+
+inline std::int32_t priceToTicks(double dPrice, double dInvPriceTick) {
+  if (!(dPrice > -kMaxValidPrice && dPrice < kMaxValidPrice) ||
+      dInvPriceTick == 0.0)
+    return kInvalidTicks;
+  return static_cast<std::int32_t>(std::lround(dPrice * dInvPriceTick));
+}
+
+} // namespace
+
+bool TickNormalizer::Normalize(const CThostFtdcDepthMarketDataField &src,
+                               CompactTick &dst) const {
+  std::uint32_t nInstrument = m_table.Find(src.InstrumentID);
+  if (nInstrument == kInvalidInstrument)
+    return false;
+  Normalize(nInstrument, src, dst);
+  return true;
+}
+
+void TickNormalizer::Normalize(std::uint32_t nInstrument,
+                               const CThostFtdcDepthMarketDataField &src,
+                               CompactTick &dst) const {
+  const double dInv = m_table.GetInversePriceTick(nInstrument);
+
+  dst.nInstrument = nInstrument;
+  dst.nTime = TradingTimeKey(src.UpdateTime, src.UpdateMillisec);
+  dst.nLastPrice = priceToTicks(src.LastPrice, dInv);
+  dst.nUpperLimitPrice = priceToTicks(src.UpperLimitPrice, dInv);
+  dst.nLowerLimitPrice = priceToTicks(src.LowerLimitPrice, dInv);
+  dst.nVolume = src.Volume;
+  dst.dTurnover = src.Turnover;
+  dst.nOpenInterest = static_cast<std::int64_t>(src.OpenInterest);
+
+  dst.nBidPrice[0] = priceToTicks(src.BidPrice1, dInv);
+  dst.nBidPrice[1] = priceToTicks(src.BidPrice2, dInv);
+  dst.nBidPrice[2] = priceToTicks(src.BidPrice3, dInv);
+  dst.nBidPrice[3] = priceToTicks(src.BidPrice4, dInv);
+  dst.nBidPrice[4] = priceToTicks(src.BidPrice5, dInv);
+  dst.nAskPrice[0] = priceToTicks(src.AskPrice1, dInv);
+  dst.nAskPrice[1] = priceToTicks(src.AskPrice2, dInv);
+  dst.nAskPrice[2] = priceToTicks(src.AskPrice3, dInv);
+  dst.nAskPrice[3] = priceToTicks(src.AskPrice4, dInv);
+  dst.nAskPrice[4] = priceToTicks(src.AskPrice5, dInv);
+  dst.nBidVolume[0] = src.BidVolume1;
+  dst.nBidVolume[1] = src.BidVolume2;
+  dst.nBidVolume[2] = src.BidVolume3;
+  dst.nBidVolume[3] = src.BidVolume4;
+  dst.nBidVolume[4] = src.BidVolume5;
+  dst.nAskVolume[0] = src.AskVolume1;
+  dst.nAskVolume[1] = src.AskVolume2;
+  dst.nAskVolume[2] = src.AskVolume3;
+  dst.nAskVolume[3] = src.AskVolume4;
+  dst.nAskVolume[4] = src.AskVolume5;
+}
+
+std::int32_t TickNormalizer::ToTicks(std::uint32_t nInstrument,
+                                     double dPrice) const {
+  return priceToTicks(dPrice, m_table.GetInversePriceTick(nInstrument));
+}
+
+double TickNormalizer::ToPrice(std::uint32_t nInstrument,
+                               std::int32_t nTicks) const {
+  if (nTicks == kInvalidTicks)
+    return 0.0;
+  return nTicks * m_table.GetPriceTick(nInstrument);
+}
+
+} // namespace ctp
@@ -0,0 +1,581 @@
+#include "ctp_tick_archive.h"
+#include "ctp_log.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::size_t kArchiveHeaderSize = 4096;
+// 小块内的交错路数，每路kLaneValues个值
+constexpr std::uint32_t kLanes = 4;
+constexpr std::uint32_t kLaneValues = kTickArchiveMiniBlock / kLanes;
+// 成交额以0.01为单位保存
+constexpr double kTurnoverScale = 100.0;
+
+std::size_t align8(std::size_t nSize) { return (nSize + 7) & ~std::size_t(7); }
+
+std::uint64_t zigzagEncode(std::int64_t nValue) {
+  return (static_cast<std::uint64_t>(nValue) << 1) ^
+         static_cast<std::uint64_t>(nValue >> 63);
+}
+
+std::uint64_t zigzagDecode(std::uint64_t nValue) {
+  return (nValue >> 1) ^ (~(nValue & 1) + 1);
+}
+
+std::int64_t loadColumn(const CompactTick &tick, std::uint32_t nColumn) {
+  switch (nColumn) {
+  case kTickColumnTime:
+    return tick.nTime;
+  case kTickColumnLastPrice:
+    return tick.nLastPrice;
+  case kTickColumnUpperLimitPrice:
+    return tick.nUpperLimitPrice;
+  case kTickColumnLowerLimitPrice:
+    return tick.nLowerLimitPrice;
+  case kTickColumnVolume:
+    return tick.nVolume;
+  case kTickColumnTurnover:
+    // CTP以DBL_MAX等表示无效值，按0保存
+    return std::fabs(tick.dTurnover) < 1e15
+               ? std::llround(tick.dTurnover * kTurnoverScale)
+               : 0;
+  case kTickColumnOpenInterest:
+    return tick.nOpenInterest;
+  default:
+    break;
+  }
+  std::uint32_t nLevel = (nColumn - kTickColumnBidPrice) % kTickDepth;
+  if (nColumn < kTickColumnAskPrice)
+    return tick.nBidPrice[nLevel];
+  if (nColumn < kTickColumnBidVolume)
+    return tick.nAskPrice[nLevel];
+  if (nColumn < kTickColumnAskVolume)
+    return tick.nBidVolume[nLevel];
+  return tick.nAskVolume[nLevel];
+}
+
+template <typename Fn>
+void scatter(const std::int64_t *pValues, std::uint32_t nCount,
+             CompactTick *pOut, Fn fn) {
+  for (std::uint32_t i = 0; i < nCount; ++i)
+    fn(pOut[i], pValues[i]);
+}
+
+void storeColumn(std::uint32_t nColumn, const std::int64_t *pValues,
+                 std::uint32_t nCount, CompactTick *pOut) {
+  using I = std::int64_t;
+  using T = CompactTick;
+  switch (nColumn) {
+  case kTickColumnTime:
+    scatter(pValues, nCount, pOut,
+            [](T &t, I n) { t.nTime = static_cast<std::int32_t>(n); });
+    return;
+  case kTickColumnLastPrice:
+    scatter(pValues, nCount, pOut,
+            [](T &t, I n) { t.nLastPrice = static_cast<std::int32_t>(n); });
+    return;
+  case kTickColumnUpperLimitPrice:
+    scatter(pValues, nCount, pOut, [](T &t, I n) {
+      t.nUpperLimitPrice = static_cast<std::int32_t>(n);
+    });
+    return;
+  case kTickColumnLowerLimitPrice:
+    scatter(pValues, nCount, pOut, [](T &t, I n) {
+      t.nLowerLimitPrice = static_cast<std::int32_t>(n);
+    });
+    return;
+  case kTickColumnVolume:
+    scatter(pValues, nCount, pOut,
+            [](T &t, I n) { t.nVolume = static_cast<std::int32_t>(n); });
+    return;
+  case kTickColumnTurnover:
+    scatter(pValues, nCount, pOut, [](T &t, I n) {
+      t.dTurnover = static_cast<double>(n) / kTurnoverScale;
+    });
+    return;
+  case kTickColumnOpenInterest:
+    scatter(pValues, nCount, pOut, [](T &t, I n) { t.nOpenInterest = n; });
+    return;
+  default:
+    break;
+  }
+  // 盘口各列按字段偏移以记录为步长写入
+  std::size_t nFieldOffset;
+  if (nColumn < kTickColumnAskPrice)
+    nFieldOffset = offsetof(CompactTick, nBidPrice);
+  else if (nColumn < kTickColumnBidVolume)
+    nFieldOffset = offsetof(CompactTick, nAskPrice);
+  else if (nColumn < kTickColumnAskVolume)
+    nFieldOffset = offsetof(CompactTick, nBidVolume);
+  else
+    nFieldOffset = offsetof(CompactTick, nAskVolume);
+  nFieldOffset +=
+      (nColumn - kTickColumnBidPrice) % kTickDepth * sizeof(std::int32_t);
+  char *p = reinterpret_cast<char *>(pOut) + nFieldOffset;
+  for (std::uint32_t i = 0; i < nCount; ++i, p += sizeof(CompactTick))
+    *reinterpret_cast<std::int32_t *>(p) =
+        static_cast<std::int32_t>(pValues[i]);
+}
+
+// 按位宽nBits把kTickArchiveMiniBlock个值打包为kLanes * nBits个字
+void packMiniBlock(const std::uint64_t *pValues, unsigned nBits,
+                   std::uint64_t *pOut) {
+  for (std::uint32_t j = 0; j < kLaneValues; ++j) {
+    unsigned nBit = j * nBits;
+    std::uint64_t *pWord = pOut + (nBit >> 6) * kLanes;
+    unsigned nShift = nBit & 63;
+    for (std::uint32_t l = 0; l < kLanes; ++l) {
+      std::uint64_t nValue = pValues[j * kLanes + l];
+      pWord[l] |= nValue << nShift;
+      if (nShift + nBits > 64)
+        pWord[kLanes + l] |= nValue >> (64 - nShift);
+    }
+  }
+}
+
+// 解包并做zigzag解码
+// 位宽为编译期常量，外层循环完全展开后移位量都是常数，内层kLanes路使用相同
+// 的移位量，可以被向量化
+template <unsigned nBits>
+void unpackMiniBlock(const std::uint64_t *pIn, std::uint64_t *pOut) {
+  if constexpr (nBits == 0) {
+    std::fill(pOut, pOut + kTickArchiveMiniBlock, 0);
+  } else {
+    constexpr std::uint64_t nMask =
+        nBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << nBits) - 1;
+#pragma GCC unroll 64
+    for (std::uint32_t j = 0; j < kLaneValues; ++j) {
+      const unsigned nBit = j * nBits;
+      const std::uint64_t *pWord = pIn + (nBit >> 6) * kLanes;
+      const unsigned nShift = nBit & 63;
+      std::uint64_t *pDst = pOut + j * kLanes;
+      if (nShift + nBits > 64) {
+        for (std::uint32_t l = 0; l < kLanes; ++l)
+          pDst[l] = zigzagDecode(((pWord[l] >> nShift) |
+                                  (pWord[kLanes + l] << (64 - nShift))) &
+                                 nMask);
+      } else {
+        for (std::uint32_t l = 0; l < kLanes; ++l)
+          pDst[l] = zigzagDecode((pWord[l] >> nShift) & nMask);
+      }
+    }
+  }
+}
+
+using UnpackFunc = void (*)(const std::uint64_t *, std::uint64_t *);
+
+template <std::size_t... nBits>
+constexpr std::array<UnpackFunc, sizeof...(nBits)>
+makeUnpackTable(std::index_sequence<nBits...>) {
+  return {{&unpackMiniBlock<nBits>...}};
+}
+
+constexpr std::array<UnpackFunc, 65> kUnpack =
+    makeUnpackTable(std::make_index_sequence<65>());
+
+bool writeAll(int fd, const void *pData, std::size_t nSize) {
+  const char *p = static_cast<const char *>(pData);
+  while (nSize > 0) {
+    ssize_t nWritten = ::write(fd, p, nSize);
+    if (nWritten <= 0)
+      return false;
+    p += nWritten;
+    nSize -= static_cast<std::size_t>(nWritten);
+  }
+  return true;
+}
+
+} // namespace
+
+TickArchiveWriter::TickArchiveWriter(const TickNormalizer &normalizer,
+                                     const TickArchiveOptions &options)
+    : m_normalizer(normalizer), m_options(options), m_nTicks(0),
+      m_nSkipped(0) {
+  m_options.nTicksPerBlock =
+      std::max<std::uint32_t>(m_options.nTicksPerBlock / kTickArchiveMiniBlock,
+                              1) *
+      kTickArchiveMiniBlock;
+}
+
+std::string TickArchiveWriter::MakePath(const std::string &strDirectory,
+                                        const char *pszTradingDay) {
+  std::string strPath = strDirectory;
+  if (!strPath.empty() && strPath.back() != '/')
+    strPath += '/';
+  return strPath + "ticks_" + pszTradingDay + ".arc";
+}
+
+bool TickArchiveWriter::Write(const TickJournalReader &journal,
+                              const std::string &strPath) {
+  m_nTicks = 0;
+  m_nSkipped = 0;
+  m_blocks.clear();
+  if (!journal.IsOpen())
+    return false;
+
+  // 按合约分组记录序号，保持日志中的先后顺序
+  const InstrumentTable &table = m_normalizer.GetInstrumentTable();
+  std::vector<std::vector<std::uint64_t>> vecRecords(table.Size());
+  for (std::uint64_t i = 0; i < journal.GetRecordCount(); ++i) {
+    std::uint32_t nIndex =
+        table.Find(journal.GetRecord(i).tick.InstrumentID);
+    if (nIndex == kInvalidInstrument || !(table.GetPriceTick(nIndex) > 0)) {
+      ++m_nSkipped;
+      continue;
+    }
+    vecRecords[nIndex].push_back(i);
+  }
+
+  int fd = ::open(strPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    CTP_LOG_ERROR("[Archive] failed to create %s", strPath.c_str());
+    return false;
+  }
+
+  // 文件头最后写入，中途失败的文件不会被当作有效归档
+  std::vector<char> vecPage(kArchiveHeaderSize, 0);
+  bool bOk = writeAll(fd, vecPage.data(), vecPage.size());
+  std::uint64_t nOffset = kArchiveHeaderSize;
+  std::vector<TickArchiveInstrument> vecInstruments;
+  for (std::uint32_t nIndex = 0; bOk && nIndex < vecRecords.size(); ++nIndex) {
+    const std::vector<std::uint64_t> &vecIndex = vecRecords[nIndex];
+    if (vecIndex.empty())
+      continue;
+    TickArchiveInstrument instrument;
+    std::memset(&instrument, 0, sizeof(instrument));
+    std::memcpy(instrument.szInstrumentID, table.GetInstrumentID(nIndex),
+                sizeof(instrument.szInstrumentID));
+    instrument.dPriceTick = table.GetPriceTick(nIndex);
+    instrument.nTicks = vecIndex.size();
+    instrument.nFirstBlock = static_cast<std::uint32_t>(m_blocks.size());
+    for (std::size_t i = 0; bOk && i < vecIndex.size();
+         i += m_options.nTicksPerBlock) {
+      std::uint32_t nCount = static_cast<std::uint32_t>(std::min<std::size_t>(
+          m_options.nTicksPerBlock, vecIndex.size() - i));
+      bOk = writeBlock(fd, journal, vecIndex.data() + i, nCount, nIndex,
+                       nOffset);
+      m_blocks.back().nInstrument =
+          static_cast<std::uint32_t>(vecInstruments.size());
+    }
+    instrument.nBlocks =
+        static_cast<std::uint32_t>(m_blocks.size()) - instrument.nFirstBlock;
+    vecInstruments.push_back(instrument);
+    m_nTicks += vecIndex.size();
+  }
+
+  TickArchiveHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.nMagic = kTickArchiveMagic;
+  header.nVersion = kTickArchiveVersion;
+  header.nHeaderSize = kArchiveHeaderSize;
+  header.nColumns = kTickColumnCount;
+  header.nTicksPerBlock = m_options.nTicksPerBlock;
+  std::strncpy(header.szTradingDay, journal.GetTradingDay(),
+               sizeof(header.szTradingDay) - 1);
+  header.nInstruments = vecInstruments.size();
+  header.nBlocks = m_blocks.size();
+  header.nTicks = m_nTicks;
+  header.nInstrumentOffset = nOffset;
+  header.nBlockOffset =
+      nOffset + vecInstruments.size() * sizeof(TickArchiveInstrument);
+  header.nFileSize =
+      header.nBlockOffset + m_blocks.size() * sizeof(TickArchiveBlock);
+  bOk = bOk &&
+        writeAll(fd, vecInstruments.data(),
+                 vecInstruments.size() * sizeof(TickArchiveInstrument)) &&
+        writeAll(fd, m_blocks.data(),
+                 m_blocks.size() * sizeof(TickArchiveBlock)) &&
+        ::pwrite(fd, &header, sizeof(header), 0) ==
+            static_cast<ssize_t>(sizeof(header));
+  bOk = ::close(fd) == 0 && bOk;
+  if (!bOk) {
+    CTP_LOG_ERROR("[Archive] failed to write %s", strPath.c_str());
+    ::unlink(strPath.c_str());
+    return false;
+  }
+
+  std::uint64_t nJournalSize =
+      journal.GetRecordCount() * sizeof(TickJournalRecord);
+  CTP_LOG_INFO("[Archive] %s: %llu ticks of %zu instruments, %llu bytes, "
+               "%.1fx smaller than the journal, %llu skipped",
+               strPath.c_str(), static_cast<unsigned long long>(m_nTicks),
+               vecInstruments.size(),
+               static_cast<unsigned long long>(header.nFileSize),
+               static_cast<double>(nJournalSize) / header.nFileSize,
+               static_cast<unsigned long long>(m_nSkipped));
+  return true;
+}
+
+bool TickArchiveWriter::writeBlock(int fd, const TickJournalReader &journal,
+                                   const std::uint64_t *pRecords,
+                                   std::uint32_t nCount,
+                                   std::uint32_t nInstrument,
+                                   std::uint64_t &nOffset) {
+  m_ticks.resize(nCount);
+  for (std::uint32_t i = 0; i < nCount; ++i)
+    m_normalizer.Normalize(nInstrument, journal.GetRecord(pRecords[i]).tick,
+                           m_ticks[i]);
+
+  TickArchiveBlock block;
+  std::memset(&block, 0, sizeof(block));
+  block.nOffset = nOffset;
+  block.nCount = nCount;
+  block.nFirstTime = m_ticks.front().nTime;
+  block.nLastTime = m_ticks.back().nTime;
+
+  std::uint32_t nMiniBlocks =
+      (nCount + kTickArchiveMiniBlock - 1) / kTickArchiveMiniBlock;
+  std::size_t nWidthWords = align8(nMiniBlocks) / 8;
+  std::uint64_t nValues[kTickArchiveMiniBlock];
+  m_words.clear();
+  for (std::uint32_t nColumn = 0; nColumn < kTickColumnCount; ++nColumn) {
+    block.nColumnOffset[nColumn] =
+        static_cast<std::uint32_t>(m_words.size() * 8);
+    std::size_t nWidthPos = m_words.size();
+    m_words.resize(m_words.size() + nWidthWords, 0);
+
+    // 每路与同一路的上一个值做差分，解码时kLanes路的前缀和可以并行
+    std::int64_t nBase = loadColumn(m_ticks[0], nColumn);
+    block.nBase[nColumn] = nBase;
+    std::int64_t nPrev[kLanes] = {nBase, nBase, nBase, nBase};
+    for (std::uint32_t m = 0; m < nMiniBlocks; ++m) {
+      std::uint64_t nBits = 0;
+      for (std::uint32_t i = 0; i < kTickArchiveMiniBlock; ++i) {
+        std::uint32_t nTick = m * kTickArchiveMiniBlock + i;
+        if (nTick < nCount) {
+          std::int64_t nValue = loadColumn(m_ticks[nTick], nColumn);
+          nValues[i] = zigzagEncode(static_cast<std::int64_t>(
+              static_cast<std::uint64_t>(nValue) -
+              static_cast<std::uint64_t>(nPrev[i % kLanes])));
+          nPrev[i % kLanes] = nValue;
+        } else {
+          nValues[i] = 0;
+        }
+        nBits |= nValues[i];
+      }
+      unsigned nWidth = nBits ? 64 - __builtin_clzll(nBits) : 0;
+      reinterpret_cast<std::uint8_t *>(m_words.data() + nWidthPos)[m] =
+          static_cast<std::uint8_t>(nWidth);
+      std::size_t nPos = m_words.size();
+      m_words.resize(nPos + kLanes * nWidth, 0);
+      if (nWidth)
+        packMiniBlock(nValues, nWidth, m_words.data() + nPos);
+    }
+  }
+  block.nColumnOffset[kTickColumnCount] =
+      static_cast<std::uint32_t>(m_words.size() * 8);
+  m_blocks.push_back(block);
+  nOffset += m_words.size() * 8;
+  return writeAll(fd, m_words.data(), m_words.size() * 8);
+}
+
+TickArchiveReader::TickArchiveReader()
+    : m_pBase(nullptr), m_nMappedSize(0), m_pInstruments(nullptr),
+      m_pBlocks(nullptr) {}
+
+TickArchiveReader::~TickArchiveReader() { Close(); }
+
+void TickArchiveReader::Close() {
+  if (m_pBase) {
+    ::munmap(const_cast<char *>(m_pBase), m_nMappedSize);
+    m_pBase = nullptr;
+  }
+  m_nMappedSize = 0;
+  m_pInstruments = nullptr;
+  m_pBlocks = nullptr;
+}
+
+bool TickArchiveReader::Open(const std::string &strPath) {
+  Close();
+
+  int fd = ::open(strPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(kArchiveHeaderSize)) {
+    ::close(fd);
+    return false;
+  }
+  std::size_t nSize = static_cast<std::size_t>(st.st_size);
+  void *pMapped = ::mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  const TickArchiveHeader *pHeader =
+      static_cast<const TickArchiveHeader *>(pMapped);
+  if (pHeader->nMagic != kTickArchiveMagic ||
+      pHeader->nVersion != kTickArchiveVersion ||
+      pHeader->nHeaderSize != kArchiveHeaderSize ||
+      pHeader->nColumns != kTickColumnCount ||
+      pHeader->nTicksPerBlock % kTickArchiveMiniBlock != 0 ||
+      pHeader->nFileSize != nSize ||
+      pHeader->nBlockOffset !=
+          pHeader->nInstrumentOffset +
+              pHeader->nInstruments * sizeof(TickArchiveInstrument) ||
+      pHeader->nFileSize !=
+          pHeader->nBlockOffset +
+              pHeader->nBlocks * sizeof(TickArchiveBlock)) {
+    CTP_LOG_WARN("[Archive] %s is not a valid tick archive", strPath.c_str());
+    ::munmap(pMapped, nSize);
+    return false;
+  }
+
+  m_pBase = static_cast<const char *>(pMapped);
+  m_nMappedSize = nSize;
+  m_pInstruments = reinterpret_cast<const TickArchiveInstrument *>(
+      m_pBase + pHeader->nInstrumentOffset);
+  m_pBlocks = reinterpret_cast<const TickArchiveBlock *>(
+      m_pBase + pHeader->nBlockOffset);
+
+  // 目录只有几千项，打开时检查一遍，解码时不再做边界检查：
+  // 各块的行情数之和须等于合约的nTicks（调用方按它分配输出缓冲区），
+  // 各列按位宽解包的字数不能超出列的长度
+  bool bValid = true;
+  std::uint64_t nTotal = 0;
+  for (std::uint64_t i = 0; bValid && i < pHeader->nInstruments; ++i) {
+    const TickArchiveInstrument &instrument = m_pInstruments[i];
+    bValid = std::uint64_t(instrument.nFirstBlock) + instrument.nBlocks <=
+             pHeader->nBlocks;
+    std::uint64_t nTicks = 0;
+    for (std::uint32_t j = 0; bValid && j < instrument.nBlocks; ++j) {
+      const TickArchiveBlock &block = m_pBlocks[instrument.nFirstBlock + j];
+      bValid = block.nInstrument == i;
+      nTicks += block.nCount;
+    }
+    bValid = bValid && nTicks == instrument.nTicks;
+    nTotal += nTicks;
+  }
+  bValid = bValid && nTotal == pHeader->nTicks;
+  for (std::uint64_t i = 0; bValid && i < pHeader->nBlocks; ++i) {
+    const TickArchiveBlock &block = m_pBlocks[i];
+    bValid = block.nCount <= pHeader->nTicksPerBlock &&
+             block.nOffset % 8 == 0 &&
+             block.nOffset + block.nColumnOffset[kTickColumnCount] <=
+                 pHeader->nInstrumentOffset &&
+             validBlock(block);
+  }
+  if (!bValid) {
+    CTP_LOG_WARN("[Archive] %s has a corrupt directory", strPath.c_str());
+    Close();
+    return false;
+  }
+  return true;
+}
+
+std::uint32_t TickArchiveReader::Find(const char *pszInstrumentID) const {
+  for (std::size_t i = 0; i < GetInstrumentCount(); ++i) {
+    if (std::strncmp(m_pInstruments[i].szInstrumentID, pszInstrumentID,
+                     sizeof(TThostFtdcInstrumentIDType)) == 0)
+      return static_cast<std::uint32_t>(i);
+  }
+  return kInvalidInstrument;
+}
+
+bool TickArchiveReader::validBlock(const TickArchiveBlock &block) const {
+  std::uint32_t nMiniBlocks =
+      (block.nCount + kTickArchiveMiniBlock - 1) / kTickArchiveMiniBlock;
+  for (std::uint32_t nColumn = 0; nColumn < kTickColumnCount; ++nColumn) {
+    std::uint32_t nBegin = block.nColumnOffset[nColumn];
+    std::uint32_t nEnd = block.nColumnOffset[nColumn + 1];
+    if (nBegin > nEnd || nBegin % 8 != 0)
+      return false;
+    const std::uint8_t *pWidths =
+        reinterpret_cast<const std::uint8_t *>(m_pBase + block.nOffset) +
+        nBegin;
+    std::uint64_t nSize = align8(nMiniBlocks);
+    for (std::uint32_t m = 0; m < nMiniBlocks; ++m)
+      nSize += kLanes * std::min<unsigned>(pWidths[m], 64) *
+               sizeof(std::uint64_t);
+    if (nSize > nEnd - nBegin)
+      return false;
+  }
+  return true;
+}
+
+void TickArchiveReader::decodeColumn(const TickArchiveBlock &block,
+                                     std::uint32_t nColumn,
+                                     std::int64_t *pOut) const {
+  const char *pColumn =
+      m_pBase + block.nOffset + block.nColumnOffset[nColumn];
+  std::uint32_t nMiniBlocks =
+      (block.nCount + kTickArchiveMiniBlock - 1) / kTickArchiveMiniBlock;
+  const std::uint8_t *pWidths = reinterpret_cast<const std::uint8_t *>(pColumn);
+  const std::uint64_t *pWords =
+      reinterpret_cast<const std::uint64_t *>(pColumn + align8(nMiniBlocks));
+
+  alignas(64) std::uint64_t nValues[kTickArchiveMiniBlock];
+  std::uint64_t nBase = static_cast<std::uint64_t>(block.nBase[nColumn]);
+  std::uint64_t nPrev[kLanes] = {nBase, nBase, nBase, nBase};
+  for (std::uint32_t m = 0; m < nMiniBlocks; ++m) {
+    unsigned nWidth = std::min<unsigned>(pWidths[m], 64);
+    kUnpack[nWidth](pWords, nValues);
+    pWords += kLanes * nWidth;
+    std::uint32_t nCount = std::min(kTickArchiveMiniBlock,
+                                    block.nCount - m * kTickArchiveMiniBlock);
+    // 按路累加，每次处理kLanes个值
+    std::uint32_t nFull = nCount / kLanes * kLanes;
+    for (std::uint32_t i = 0; i < nFull; i += kLanes) {
+      for (std::uint32_t l = 0; l < kLanes; ++l) {
+        nPrev[l] += nValues[i + l];
+        pOut[i + l] = static_cast<std::int64_t>(nPrev[l]);
+      }
+    }
+    for (std::uint32_t i = nFull; i < nCount; ++i)
+      pOut[i] = static_cast<std::int64_t>(nPrev[i % kLanes] + nValues[i]);
+    pOut += nCount;
+  }
+}
+
+bool TickArchiveReader::ReadColumn(std::uint32_t nInstrument,
+                                   std::uint32_t nColumn,
+                                   std::int64_t *pOut) const {
+  if (!m_pBase || nInstrument >= GetInstrumentCount() ||
+      nColumn >= kTickColumnCount)
+    return false;
+  const TickArchiveInstrument &instrument = m_pInstruments[nInstrument];
+  for (std::uint32_t i = 0; i < instrument.nBlocks; ++i) {
+    const TickArchiveBlock &block = m_pBlocks[instrument.nFirstBlock + i];
+    decodeColumn(block, nColumn, pOut);
+    pOut += block.nCount;
+  }
+  return true;
+}
+
+bool TickArchiveReader::ReadTicks(std::uint32_t nInstrument,
+                                  std::uint32_t nColumnMask,
+                                  CompactTick *pOut) const {
+  if (!m_pBase || nInstrument >= GetInstrumentCount())
+    return false;
+  const TickArchiveInstrument &instrument = m_pInstruments[nInstrument];
+  std::vector<std::int64_t> vecValues(header().nTicksPerBlock);
+  for (std::uint32_t i = 0; i < instrument.nBlocks; ++i) {
+    const TickArchiveBlock &block = m_pBlocks[instrument.nFirstBlock + i];
+    for (std::uint32_t nColumn = 0; nColumn < kTickColumnCount; ++nColumn) {
+      if (nColumnMask & TickColumnBit(nColumn)) {
+        decodeColumn(block, nColumn, vecValues.data());
+        storeColumn(nColumn, vecValues.data(), block.nCount, pOut);
+      }
+    }
+    for (std::uint32_t j = 0; j < block.nCount; ++j)
+      pOut[j].nInstrument = nInstrument;
+    pOut += block.nCount;
+  }
+  return true;
+}
+
+} // namespace ctp
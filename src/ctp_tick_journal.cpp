@@ -0,0 +1,414 @@
+#include "ctp_tick_journal.h"
+#include "ctp_tick.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::size_t kJournalHeaderSize = 4096;
+
+std::size_t pageSize() {
+  static const std::size_t nPageSize =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return nPageSize;
+}
+
+std::int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// 文件头中的块布局必须与本版本一致，否则后续的除法和偏移计算都不可信
+bool validLayout(const TickJournalHeader &header) {
+  return header.nMagic == kTickJournalMagic &&
+         header.nVersion == kTickJournalVersion &&
+         header.nHeaderSize == kJournalHeaderSize &&
+         header.nRecordSize == sizeof(TickJournalRecord) &&
+         header.nRecordsPerBlock > 0 &&
+         header.nBlockSize ==
+             sizeof(TickJournalBlockHeader) +
+                 static_cast<std::uint64_t>(header.nRecordsPerBlock) *
+                     sizeof(TickJournalRecord);
+}
+
+} // namespace
+
+TickJournalWriter::TickJournalWriter()
+    : m_fd(-1), m_pBase(nullptr), m_nMappedSize(0), m_nBlockSize(0),
+      m_nRecordCount(0), m_nSyncedRecord(0), m_nFileSize(0),
+      m_nRecordCapacity(0), m_bGrowRequested(false), m_bStop(false) {}
+
+TickJournalWriter::~TickJournalWriter() { Close(); }
+
+std::string TickJournalWriter::MakePath(const std::string &strDirectory,
+                                        const char *pszTradingDay) {
+  std::string strPath = strDirectory;
+  if (!strPath.empty() && strPath.back() != '/')
+    strPath += '/';
+  return strPath + "ticks_" + pszTradingDay + ".jnl";
+}
+
+std::size_t TickJournalWriter::offsetOfRecord(std::uint64_t nRecord) const {
+  std::uint64_t nBlock = nRecord / m_options.nRecordsPerBlock;
+  std::uint64_t nSlot = nRecord % m_options.nRecordsPerBlock;
+  return kJournalHeaderSize + nBlock * m_nBlockSize +
+         sizeof(TickJournalBlockHeader) + nSlot * sizeof(TickJournalRecord);
+}
+
+std::size_t
+TickJournalWriter::fileSizeForRecords(std::uint64_t nRecords) const {
+  std::uint64_t nBlocks =
+      (nRecords + m_options.nRecordsPerBlock - 1) / m_options.nRecordsPerBlock;
+  std::size_t nSize = kJournalHeaderSize + nBlocks * m_nBlockSize;
+  return (nSize + pageSize() - 1) / pageSize() * pageSize();
+}
+
+bool TickJournalWriter::Open(const std::string &strPath,
+                             const char *pszTradingDay,
+                             const TickJournalOptions &options) {
+  Close();
+  m_options = options;
+  if (m_options.nRecordsPerBlock == 0)
+    m_options.nRecordsPerBlock = 1;
+  m_nBlockSize = sizeof(TickJournalBlockHeader) +
+                 m_options.nRecordsPerBlock * sizeof(TickJournalRecord);
+
+  m_fd = ::open(strPath.c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0)
+    return false;
+
+  struct stat st;
+  if (::fstat(m_fd, &st) != 0) {
+    Close();
+    return false;
+  }
+
+  if (st.st_size >= static_cast<off_t>(kJournalHeaderSize)) {
+    // 继续追加已存在的文件，块大小以文件头为准
+    TickJournalHeader header;
+    if (::pread(m_fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header)) ||
+        !validLayout(header) ||
+        std::strncmp(header.szTradingDay, pszTradingDay,
+                     sizeof(header.szTradingDay)) != 0) {
+      Close();
+      return false;
+    }
+    m_options.nRecordsPerBlock = header.nRecordsPerBlock;
+    m_nBlockSize = header.nBlockSize;
+    if (!mapFile(static_cast<std::size_t>(st.st_size))) {
+      Close();
+      return false;
+    }
+    m_nRecordCount = reinterpret_cast<TickJournalHeader *>(m_pBase)
+                         ->nRecordCount.load(std::memory_order_acquire);
+    // 记录数超出文件长度说明文件被截断或损坏
+    if (m_nRecordCount > m_nRecordCapacity.load(std::memory_order_relaxed)) {
+      Close();
+      return false;
+    }
+    m_nSyncedRecord = m_nRecordCount;
+  } else {
+    std::size_t nSize = fileSizeForRecords(
+        std::max<std::uint64_t>(m_options.nInitialRecords, 1));
+    // 预先分配磁盘空间，避免写入映射区时因磁盘满触发SIGBUS
+    if (::ftruncate(m_fd, static_cast<off_t>(nSize)) != 0 ||
+        ::posix_fallocate(m_fd, 0, static_cast<off_t>(nSize)) != 0 ||
+        !mapFile(nSize)) {
+      Close();
+      return false;
+    }
+    TickJournalHeader *pHeader = reinterpret_cast<TickJournalHeader *>(m_pBase);
+    pHeader->nMagic = kTickJournalMagic;
+    pHeader->nVersion = kTickJournalVersion;
+    pHeader->nHeaderSize = static_cast<std::uint32_t>(kJournalHeaderSize);
+    pHeader->nRecordSize = sizeof(TickJournalRecord);
+    pHeader->nRecordsPerBlock = m_options.nRecordsPerBlock;
+    pHeader->nBlockSize = static_cast<std::uint32_t>(m_nBlockSize);
+    std::strncpy(pHeader->szTradingDay, pszTradingDay,
+                 sizeof(pHeader->szTradingDay) - 1);
+    pHeader->nRecordCount.store(0, std::memory_order_release);
+    ::msync(m_pBase, kJournalHeaderSize, MS_SYNC);
+  }
+  m_bStop = false;
+  m_grower = std::thread(&TickJournalWriter::run, this);
+  return true;
+}
+
+bool TickJournalWriter::mapFile(std::size_t nFileSize) {
+  // 一次性保留足够的地址空间，超出文件长度的部分在扩容前不会被访问
+  std::size_t nMappedSize =
+      std::max(nFileSize, fileSizeForRecords(m_options.nMaxRecords));
+  void *pMapped = ::mmap(nullptr, nMappedSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, m_fd, 0);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  m_pBase = static_cast<char *>(pMapped);
+  m_nMappedSize = nMappedSize;
+  m_nFileSize = nFileSize;
+  std::size_t nBlocks = (nFileSize - kJournalHeaderSize) / m_nBlockSize;
+  m_nRecordCapacity.store(nBlocks * m_options.nRecordsPerBlock,
+                          std::memory_order_release);
+  populate(0, nFileSize);
+  return true;
+}
+
+void TickJournalWriter::populate(std::size_t nFrom, std::size_t nTo) {
+  // 预先建立可写的页表项，写入时不再缺页；旧内核不支持时退化为预读
+#if defined(MADV_POPULATE_WRITE)
+  if (::madvise(m_pBase + nFrom, nTo - nFrom, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  ::madvise(m_pBase + nFrom, nTo - nFrom, MADV_WILLNEED);
+}
+
+void TickJournalWriter::requestGrow() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_bGrowRequested.store(true, std::memory_order_relaxed);
+  m_cond.notify_one();
+}
+
+void TickJournalWriter::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_cond.wait(lock, [this] {
+      return m_bStop || m_bGrowRequested.load(std::memory_order_relaxed);
+    });
+    if (m_bStop)
+      return;
+    lock.unlock();
+    bool bGrown = grow();
+    lock.lock();
+    // 失败时保留请求标志，写入方不会再请求扩容
+    if (bGrown)
+      m_bGrowRequested.store(false, std::memory_order_release);
+    else
+      m_cond.wait(lock, [this] { return m_bStop; });
+  }
+}
+
+bool TickJournalWriter::grow() {
+  std::size_t nOldSize = m_nFileSize;
+  std::size_t nNewSize = std::min(
+      fileSizeForRecords(m_nRecordCapacity.load(std::memory_order_relaxed) +
+                         m_options.nGrowRecords),
+      m_nMappedSize);
+  // 保留的地址空间已用完
+  if (nNewSize <= nOldSize)
+    return false;
+  // 先分配磁盘空间再发布容量，避免写入映射区时因磁盘满触发SIGBUS
+  if (::ftruncate(m_fd, static_cast<off_t>(nNewSize)) != 0 ||
+      ::posix_fallocate(m_fd, static_cast<off_t>(nOldSize),
+                        static_cast<off_t>(nNewSize - nOldSize)) != 0)
+    return false;
+  populate(nOldSize, nNewSize);
+  m_nFileSize = nNewSize;
+  std::size_t nBlocks = (nNewSize - kJournalHeaderSize) / m_nBlockSize;
+  m_nRecordCapacity.store(nBlocks * m_options.nRecordsPerBlock,
+                          std::memory_order_release);
+  return true;
+}
+
+bool TickJournalWriter::Append(const CThostFtdcDepthMarketDataField &tick,
+                               std::int64_t nRecvTime) {
+  if (!m_pBase)
+    return false;
+
+  // 剩余空间低于半个扩展量时通知后台线程扩容，本线程不做系统调用。
+  // 先读请求标志再读容量：标志被清除时一定能看到扩容后的容量
+  if (!m_bGrowRequested.load(std::memory_order_acquire) &&
+      m_nRecordCount + m_options.nGrowRecords / 2 >=
+          m_nRecordCapacity.load(std::memory_order_relaxed))
+    requestGrow();
+  if (m_nRecordCount >= m_nRecordCapacity.load(std::memory_order_acquire))
+    return false;
+
+  const std::uint64_t nRecord = m_nRecordCount;
+  const std::uint32_t nSlot =
+      static_cast<std::uint32_t>(nRecord % m_options.nRecordsPerBlock);
+  const std::int32_t nTime =
+      TradingTimeKey(tick.UpdateTime, tick.UpdateMillisec);
+
+  TickJournalRecord *pRecord =
+      reinterpret_cast<TickJournalRecord *>(m_pBase + offsetOfRecord(nRecord));
+  pRecord->nRecvTime = nRecvTime ? nRecvTime : nowNanos();
+  pRecord->nTime = nTime;
+  pRecord->nReserved = 0;
+  std::memcpy(&pRecord->tick, &tick, sizeof(tick));
+
+  TickJournalBlockHeader *pBlock = reinterpret_cast<TickJournalBlockHeader *>(
+      reinterpret_cast<char *>(pRecord) - sizeof(TickJournalBlockHeader) -
+      nSlot * sizeof(TickJournalRecord));
+  if (nSlot == 0) {
+    pBlock->nFirstRecord = nRecord;
+    pBlock->nFirstTime = nTime;
+    pBlock->nMaxTime = nTime;
+  } else if (nTime > pBlock->nMaxTime) {
+    pBlock->nMaxTime = nTime;
+  }
+  pBlock->nCount = nSlot + 1;
+
+  m_nRecordCount = nRecord + 1;
+  reinterpret_cast<TickJournalHeader *>(m_pBase)->nRecordCount.store(
+      m_nRecordCount, std::memory_order_release);
+
+  if (m_nRecordCount - m_nSyncedRecord >= m_options.nSyncInterval)
+    syncRange(m_nSyncedRecord, m_nRecordCount, false);
+  return true;
+}
+
+void TickJournalWriter::syncRange(std::uint64_t nFromRecord,
+                                  std::uint64_t nToRecord, bool bWait) {
+  // 从所在块的块头开始，保证索引项与记录一起落盘
+  std::size_t nBegin =
+      kJournalHeaderSize +
+      nFromRecord / m_options.nRecordsPerBlock * m_nBlockSize;
+  nBegin -= nBegin % pageSize();
+  std::size_t nEnd = std::min(offsetOfRecord(nToRecord), m_nMappedSize);
+  int nFlags = bWait ? MS_SYNC : MS_ASYNC;
+  ::msync(m_pBase + nBegin, nEnd - nBegin, nFlags);
+  // 文件头中的记录数单独同步
+  ::msync(m_pBase, kJournalHeaderSize, nFlags);
+  m_nSyncedRecord = nToRecord;
+}
+
+void TickJournalWriter::Flush() {
+  if (m_pBase && m_nRecordCount > 0)
+    syncRange(m_nSyncedRecord < m_nRecordCount ? m_nSyncedRecord
+                                               : m_nRecordCount - 1,
+              m_nRecordCount, true);
+}
+
+void TickJournalWriter::Close() {
+  if (m_grower.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bStop = true;
+    }
+    m_cond.notify_all();
+    m_grower.join();
+  }
+  if (m_pBase) {
+    Flush();
+    ::munmap(m_pBase, m_nMappedSize);
+    m_pBase = nullptr;
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_nMappedSize = 0;
+  m_nFileSize = 0;
+  m_nRecordCapacity.store(0, std::memory_order_relaxed);
+  m_nRecordCount = 0;
+  m_nSyncedRecord = 0;
+  m_bGrowRequested.store(false, std::memory_order_relaxed);
+}
+
+TickJournalReader::TickJournalReader()
+    : m_pBase(nullptr), m_nMappedSize(0), m_nRecordCount(0),
+      m_nRecordsPerBlock(1), m_nHeaderSize(0), m_nBlockSize(0) {}
+
+TickJournalReader::~TickJournalReader() { Close(); }
+
+bool TickJournalReader::Open(const std::string &strPath) {
+  Close();
+
+  int fd = ::open(strPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(kJournalHeaderSize)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *pMapped = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                         PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  const TickJournalHeader *pHeader =
+      static_cast<const TickJournalHeader *>(pMapped);
+  if (!validLayout(*pHeader)) {
+    ::munmap(pMapped, static_cast<std::size_t>(st.st_size));
+    return false;
+  }
+
+  m_pBase = static_cast<const char *>(pMapped);
+  m_nMappedSize = static_cast<std::size_t>(st.st_size);
+  m_nHeaderSize = pHeader->nHeaderSize;
+  m_nBlockSize = pHeader->nBlockSize;
+  m_nRecordsPerBlock = pHeader->nRecordsPerBlock;
+
+  // 记录数不能超出当前映射范围（写入方可能仍在扩容）
+  std::uint64_t nMappedRecords =
+      (m_nMappedSize - m_nHeaderSize) / m_nBlockSize * m_nRecordsPerBlock;
+  m_nRecordCount = std::min<std::uint64_t>(
+      pHeader->nRecordCount.load(std::memory_order_acquire), nMappedRecords);
+  ::madvise(const_cast<char *>(m_pBase), m_nMappedSize, MADV_SEQUENTIAL);
+  return true;
+}
+
+void TickJournalReader::Close() {
+  if (m_pBase) {
+    ::munmap(const_cast<char *>(m_pBase), m_nMappedSize);
+    m_pBase = nullptr;
+  }
+  m_nMappedSize = 0;
+  m_nRecordCount = 0;
+}
+
+const char *TickJournalReader::GetTradingDay() const {
+  if (!m_pBase)
+    return "";
+  return reinterpret_cast<const TickJournalHeader *>(m_pBase)->szTradingDay;
+}
+
+std::uint64_t TickJournalReader::Seek(std::int32_t nTime) const {
+  if (m_nRecordCount == 0)
+    return 0;
+
+  // 各块的nMaxTime只反映本块，行情基本按时间写入时近似单调：
+  // 二分找到第一个nMaxTime >= nTime的块，再在块内顺序扫描
+  std::uint64_t nBlocks =
+      (m_nRecordCount + m_nRecordsPerBlock - 1) / m_nRecordsPerBlock;
+  std::uint64_t nLow = 0, nHigh = nBlocks;
+  while (nLow < nHigh) {
+    std::uint64_t nMid = nLow + (nHigh - nLow) / 2;
+    if (blockHeader(nMid).nMaxTime < nTime)
+      nLow = nMid + 1;
+    else
+      nHigh = nMid;
+  }
+  if (nLow == nBlocks)
+    return m_nRecordCount;
+
+  std::uint64_t nRecord = nLow * m_nRecordsPerBlock;
+  for (; nRecord < m_nRecordCount; ++nRecord) {
+    if (GetRecord(nRecord).nTime >= nTime)
+      break;
+  }
+  return nRecord;
+}
+
+std::uint64_t TickJournalReader::Seek(const char *pszUpdateTime,
+                                      int nUpdateMillisec) const {
+  return Seek(TradingTimeKey(pszUpdateTime, nUpdateMillisec));
+}
+
+} // namespace ctp
@@ -0,0 +1,774 @@
+#include "ctp_trader_checkpoint.h"
+#include "ctp_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ctp {
+
+namespace {
+
+constexpr std::size_t kLogHeaderSize = 4096;
+
+std::size_t pageSize() {
+  static const std::size_t nPageSize =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return nPageSize;
+}
+
+// 容纳nRecords条记录的日志文件长度，按页对齐
+std::size_t logSizeForRecords(std::uint64_t nRecords) {
+  std::size_t nSize = kLogHeaderSize + static_cast<std::size_t>(
+                                           nRecords * sizeof(PrivateLogRecord));
+  return (nSize + pageSize() - 1) / pageSize() * pageSize();
+}
+
+// 预先建立可写的页表项，写入时不再缺页；旧内核不支持时退化为预读
+void populate(char *pBase, std::size_t nFrom, std::size_t nTo) {
+#if defined(MADV_POPULATE_WRITE)
+  if (::madvise(pBase + nFrom, nTo - nFrom, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  ::madvise(pBase + nFrom, nTo - nFrom, MADV_WILLNEED);
+}
+
+std::int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string makePath(const std::string &strDirectory, const char *pszPrefix,
+                     const char *pszTradingDay, const char *pszSuffix) {
+  std::string strPath = strDirectory;
+  if (!strPath.empty() && strPath.back() != '/')
+    strPath += '/';
+  return strPath + pszPrefix + pszTradingDay + pszSuffix;
+}
+
+// 文件名形如<prefix><8位交易日><suffix>时取出交易日
+bool parseTradingDay(const char *pszName, const char *pszPrefix,
+                     const char *pszSuffix, std::string &strDay) {
+  std::size_t nPrefix = std::strlen(pszPrefix);
+  std::size_t nSuffix = std::strlen(pszSuffix);
+  if (std::strlen(pszName) != nPrefix + 8 + nSuffix ||
+      std::strncmp(pszName, pszPrefix, nPrefix) != 0 ||
+      std::strcmp(pszName + nPrefix + 8, pszSuffix) != 0)
+    return false;
+  strDay.assign(pszName + nPrefix, 8);
+  return true;
+}
+
+// rename之后fsync所在目录，使新的目录项落盘
+bool syncDirectory(const std::string &strPath) {
+  std::string::size_type nSlash = strPath.rfind('/');
+  std::string strDirectory =
+      nSlash == std::string::npos ? "." : strPath.substr(0, nSlash + 1);
+  int fd = ::open(strDirectory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    return false;
+  bool bOk = ::fsync(fd) == 0;
+  ::close(fd);
+  return bOk;
+}
+
+bool writeAll(int fd, const void *pData, std::size_t nSize) {
+  const char *p = static_cast<const char *>(pData);
+  while (nSize > 0) {
+    ssize_t nWritten = ::write(fd, p, nSize);
+    if (nWritten <= 0)
+      return false;
+    p += nWritten;
+    nSize -= static_cast<std::size_t>(nWritten);
+  }
+  return true;
+}
+
+} // namespace
+
+TraderCheckpoint::TraderCheckpoint(OrderStateEngine &engine,
+                                   InstrumentTable &table,
+                                   const TraderCheckpointOptions &options)
+    : m_engine(engine), m_table(table), m_options(options), m_szTradingDay(),
+      m_fd(-1), m_pLog(nullptr), m_nLogMappedSize(0), m_nLogFileSize(0),
+      m_nLogCapacity(0),
+      m_nLogRecords(0), m_nCheckpointRecords(0), m_nSinceCheckpoint(0),
+      m_nLoadedOrders(0), m_nReplayed(0),
+      m_vecDirty(engine.GetOrderCapacity(), 0), m_bFullSnapshot(true),
+      m_nStagedInstruments(0), m_nStagedTrades(0), m_writing(), m_pending(),
+      m_nStagedSeq(0), m_nWrittenSeq(0), m_bWriteOk(true),
+      m_bGrowRequested(false), m_bGrowing(false), m_bGrowFailed(false),
+      m_bStop(false) {
+  if (m_options.nLogGrowRecords == 0)
+    m_options.nLogGrowRecords = 1;
+  m_vecDirtyOrders.reserve(engine.GetOrderCapacity());
+  m_writer = std::thread(&TraderCheckpoint::run, this);
+}
+
+TraderCheckpoint::~TraderCheckpoint() {
+  Close();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bStop = true;
+  }
+  m_cond.notify_all();
+  m_writer.join();
+}
+
+std::string
+TraderCheckpoint::MakeCheckpointPath(const std::string &strDirectory,
+                                     const char *pszTradingDay) {
+  return makePath(strDirectory, "checkpoint_", pszTradingDay, ".bin");
+}
+
+std::string TraderCheckpoint::MakeLogPath(const std::string &strDirectory,
+                                          const char *pszTradingDay) {
+  return makePath(strDirectory, "private_", pszTradingDay, ".log");
+}
+
+THOST_TE_RESUME_TYPE TraderCheckpoint::Open(const std::string &strDirectory,
+                                            const char *pszTradingDay) {
+  Close();
+  m_strDirectory = strDirectory;
+  m_szTradingDay[0] = '\0';
+  m_nLoadedOrders = 0;
+  m_nReplayed = 0;
+  m_nLogRecords = 0;
+  m_nCheckpointRecords = 0;
+
+  // 最近一个留有检查点或日志的交易日
+  std::string strDay;
+  if (DIR *pDir =
+          ::opendir(strDirectory.empty() ? "." : strDirectory.c_str())) {
+    std::string strName;
+    while (struct dirent *pEntry = ::readdir(pDir)) {
+      if ((parseTradingDay(pEntry->d_name, "checkpoint_", ".bin", strName) ||
+           parseTradingDay(pEntry->d_name, "private_", ".log", strName)) &&
+          strName > strDay)
+        strDay = strName;
+    }
+    ::closedir(pDir);
+  }
+  if (strDay.empty()) {
+    CTP_LOG_INFO("[Checkpoint] no checkpoint in %s, private topic restarts",
+                 strDirectory.c_str());
+    return THOST_TERT_RESTART;
+  }
+
+  auto tStart = std::chrono::steady_clock::now();
+  std::strncpy(m_szTradingDay, strDay.c_str(), sizeof(m_szTradingDay) - 1);
+  std::uint64_t nFrom = 0;
+  if (!loadCheckpoint(MakeCheckpointPath(strDirectory, m_szTradingDay),
+                      nFrom))
+    nFrom = 0;
+  m_nCheckpointRecords = nFrom;
+  m_nLogRecords = nFrom;
+  std::uint64_t nCount =
+      replayLog(MakeLogPath(strDirectory, m_szTradingDay), nFrom);
+  if (nCount > m_nLogRecords)
+    m_nLogRecords = nCount;
+  // 引擎已整体替换，下一个检查点从头重建写线程的副本
+  m_bFullSnapshot = true;
+
+  long long nMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - tStart)
+                      .count();
+  CTP_LOG_INFO("[Checkpoint] restored %s: %zu orders from checkpoint, "
+               "%llu log records replayed in %lld ms",
+               m_szTradingDay, m_nLoadedOrders,
+               static_cast<unsigned long long>(m_nReplayed), nMs);
+  // 之前交易日的API流文件不能用于续接当日的私有流
+  if (!pszTradingDay ||
+      std::strncmp(m_szTradingDay, pszTradingDay, sizeof(m_szTradingDay)) !=
+          0) {
+    CTP_LOG_INFO("[Checkpoint] checkpoint is for %s, expected %s, private "
+                 "topic restarts",
+                 m_szTradingDay, pszTradingDay ? pszTradingDay : "unknown");
+    return THOST_TERT_RESTART;
+  }
+  return THOST_TERT_RESUME;
+}
+
+bool TraderCheckpoint::loadCheckpoint(const std::string &strPath,
+                                      std::uint64_t &nLogRecords) {
+  int fd = ::open(strPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(sizeof(TraderCheckpointHeader))) {
+    ::close(fd);
+    return false;
+  }
+  std::size_t nSize = static_cast<std::size_t>(st.st_size);
+  void *pMapped = ::mmap(nullptr, nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED)
+    return false;
+
+  const char *pBase = static_cast<const char *>(pMapped);
+  const TraderCheckpointHeader &header =
+      *reinterpret_cast<const TraderCheckpointHeader *>(pBase);
+  const std::size_t nIDSize = sizeof(TThostFtdcInstrumentIDType);
+  bool bValid =
+      header.nMagic == kTraderCheckpointMagic &&
+      header.nVersion == kTraderCheckpointVersion &&
+      header.nHeaderSize == sizeof(TraderCheckpointHeader) &&
+      header.nOrderSize == sizeof(OrderState) &&
+      header.nPositionSize == sizeof(PositionState) &&
+      header.nTradeSize == sizeof(TradeKey) &&
+      nSize == sizeof(TraderCheckpointHeader) +
+                   header.nInstruments * (nIDSize + sizeof(PositionState)) +
+                   header.nOrders * sizeof(OrderState) +
+                   header.nTrades * sizeof(TradeKey);
+  if (!bValid) {
+    CTP_LOG_WARN("[Checkpoint] %s is invalid, ignored", strPath.c_str());
+    ::munmap(pMapped, nSize);
+    return false;
+  }
+
+  // 合约代码长度为奇数，其后的数组不满足对齐要求，逐项memcpy
+  const char *pIDs = pBase + sizeof(TraderCheckpointHeader);
+  const char *pPositions = pIDs + header.nInstruments * nIDSize;
+  const char *pOrders =
+      pPositions + header.nInstruments * sizeof(PositionState);
+  const char *pTrades = pOrders + header.nOrders * sizeof(OrderState);
+
+  // 检查点中的合约下标按当前InstrumentTable重新映射
+  OrderStateEngine &engine = m_engine;
+  std::vector<std::uint32_t> vecIndex(header.nInstruments, kInvalidInstrument);
+  for (std::uint64_t i = 0; i < header.nInstruments; ++i) {
+    const char *pszID = pIDs + i * nIDSize;
+    if (!pszID[0])
+      continue;
+    std::uint32_t nIndex = m_table.Add(pszID);
+    if (nIndex == kInvalidInstrument || nIndex >= engine.m_nInstruments)
+      continue;
+    vecIndex[i] = nIndex;
+    std::memcpy(static_cast<void *>(&engine.m_pPositions[nIndex]),
+                pPositions + i * sizeof(PositionState), sizeof(PositionState));
+  }
+
+  // 重建报单池及其两张索引表
+  std::size_t nBytes = sizeof(std::uint32_t) * (engine.m_nBucketMask + 1);
+  std::memset(engine.m_pOrderBuckets, 0xFF, nBytes);
+  std::memset(engine.m_pSysBuckets, 0xFF, nBytes);
+  engine.m_nOrders = 0;
+  std::uint64_t nOrders =
+      std::min<std::uint64_t>(header.nOrders, engine.m_nMaxOrders);
+  for (std::uint64_t i = 0; i < nOrders; ++i) {
+    OrderState &order = engine.m_pOrders[i];
+    std::memcpy(static_cast<void *>(&order), pOrders + i * sizeof(OrderState),
+                sizeof(OrderState));
+    if (order.nInstrument < header.nInstruments)
+      order.nInstrument = vecIndex[order.nInstrument];
+    // 按当前规则重新计算OrderRef键
+    order.nOrderRef = OrderStateEngine::parseOrderRef(order.szOrderRef);
+    std::size_t nBucket;
+    engine.findOrder(order.nFrontID, order.nSessionID, order.nOrderRef,
+                     order.szOrderRef, nBucket);
+    engine.m_pOrderBuckets[nBucket] = static_cast<std::uint32_t>(i);
+    if (order.szOrderSysID[0] &&
+        engine.findSysOrder(order.szExchangeID, order.szOrderSysID,
+                            nBucket) == kInvalidOrder)
+      engine.m_pSysBuckets[nBucket] = static_cast<std::uint32_t>(i);
+  }
+  engine.m_nOrders = nOrders;
+
+  engine.m_nTrades = 0;
+  // 暂存待记入报单的成交不进检查点，恢复时清空
+  engine.m_nUnmatched = 0;
+  std::memset(engine.m_pTradeBuckets, 0xFF,
+              sizeof(std::uint32_t) * (engine.m_nTradeBucketMask + 1));
+  for (std::uint64_t i = 0; i < header.nTrades; ++i)
+    engine.addTrade(
+        *reinterpret_cast<const TradeKey *>(pTrades + i * sizeof(TradeKey)));
+
+  if (nOrders < header.nOrders)
+    CTP_LOG_WARN("[Checkpoint] order pool too small, %llu orders dropped",
+                 static_cast<unsigned long long>(header.nOrders - nOrders));
+  m_nLoadedOrders = nOrders;
+  nLogRecords = header.nLogRecords;
+  ::munmap(pMapped, nSize);
+  return true;
+}
+
+std::uint64_t TraderCheckpoint::replayLog(const std::string &strPath,
+                                          std::uint64_t nFrom) {
+  int fd = ::open(strPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(kLogHeaderSize)) {
+    ::close(fd);
+    return 0;
+  }
+  std::size_t nSize = static_cast<std::size_t>(st.st_size);
+  void *pMapped = ::mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (pMapped == MAP_FAILED)
+    return 0;
+
+  const char *pBase = static_cast<const char *>(pMapped);
+  const PrivateLogHeader &header =
+      *reinterpret_cast<const PrivateLogHeader *>(pBase);
+  std::uint64_t nCount = 0;
+  if (header.nMagic == kPrivateLogMagic &&
+      header.nVersion == kTraderCheckpointVersion &&
+      header.nRecordSize == sizeof(PrivateLogRecord)) {
+    nCount = std::min<std::uint64_t>(
+        header.nRecordCount,
+        (nSize - kLogHeaderSize) / sizeof(PrivateLogRecord));
+    ::madvise(pMapped, nSize, MADV_SEQUENTIAL);
+    const PrivateLogRecord *pRecords =
+        reinterpret_cast<const PrivateLogRecord *>(pBase + kLogHeaderSize);
+    for (std::uint64_t i = nFrom; i < nCount; ++i) {
+      const PrivateLogRecord &record = pRecords[i];
+      if (record.nType == PrivateLogRecord::Order) {
+        m_table.Add(record.order.InstrumentID);
+        m_engine.OnRtnOrder(record.order);
+      } else if (record.nType == PrivateLogRecord::Trade) {
+        m_table.Add(record.trade.InstrumentID);
+        m_engine.OnRtnTrade(record.trade);
+      }
+      ++m_nReplayed;
+    }
+  } else {
+    CTP_LOG_WARN("[Checkpoint] %s is invalid, ignored", strPath.c_str());
+  }
+  ::munmap(pMapped, nSize);
+  return nCount;
+}
+
+bool TraderCheckpoint::OnLogin(const char *pszTradingDay) {
+  if (!pszTradingDay || !pszTradingDay[0])
+    return false;
+  if (m_pLog && std::strncmp(m_szTradingDay, pszTradingDay,
+                             sizeof(m_szTradingDay)) == 0)
+    return true; // 断线重连后再次登录
+
+  closeLog();
+  bool bNewDay = std::strncmp(m_szTradingDay, pszTradingDay,
+                              sizeof(m_szTradingDay)) != 0;
+  if (bNewDay) {
+    if (m_szTradingDay[0]) {
+      CTP_LOG_INFO("[Checkpoint] trading day changed %s -> %s",
+                   m_szTradingDay, pszTradingDay);
+      m_engine.Reset();
+      m_bFullSnapshot = true;
+    }
+    std::strncpy(m_szTradingDay, pszTradingDay, sizeof(m_szTradingDay) - 1);
+    m_nLogRecords = 0;
+    m_nCheckpointRecords = 0;
+  }
+  if (!openLog(pszTradingDay))
+    return false;
+  // 新交易日先落一个检查点，保存换日后的持仓
+  return bNewDay ? Checkpoint() : true;
+}
+
+bool TraderCheckpoint::openLog(const char *pszTradingDay) {
+  std::string strPath = MakeLogPath(m_strDirectory, pszTradingDay);
+  m_fd = ::open(strPath.c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) {
+    CTP_LOG_ERROR("[Checkpoint] failed to open %s", strPath.c_str());
+    return false;
+  }
+
+  struct stat st;
+  PrivateLogHeader header;
+  if (::fstat(m_fd, &st) == 0 &&
+      st.st_size >= static_cast<off_t>(kLogHeaderSize) &&
+      ::pread(m_fd, &header, sizeof(header), 0) ==
+          static_cast<ssize_t>(sizeof(header)) &&
+      header.nMagic == kPrivateLogMagic &&
+      header.nVersion == kTraderCheckpointVersion &&
+      header.nRecordSize == sizeof(PrivateLogRecord) &&
+      std::strncmp(header.szTradingDay, pszTradingDay,
+                   sizeof(header.szTradingDay)) == 0) {
+    // 同一交易日重启：在已重放的日志末尾继续追加
+    if (mapLog(static_cast<std::size_t>(st.st_size))) {
+      m_nLogRecords = std::min<std::uint64_t>(
+          header.nRecordCount,
+          m_nLogCapacity.load(std::memory_order_relaxed));
+      return true;
+    }
+  } else {
+    std::size_t nSize = logSizeForRecords(m_options.nLogGrowRecords);
+    std::memset(static_cast<void *>(&header), 0, sizeof(header));
+    header.nMagic = kPrivateLogMagic;
+    header.nVersion = kTraderCheckpointVersion;
+    header.nRecordSize = sizeof(PrivateLogRecord);
+    std::strncpy(header.szTradingDay, pszTradingDay,
+                 sizeof(header.szTradingDay) - 1);
+    // 预先分配磁盘空间，避免写入映射区时因磁盘满触发SIGBUS
+    if (::ftruncate(m_fd, 0) == 0 &&
+        ::ftruncate(m_fd, static_cast<off_t>(nSize)) == 0 &&
+        ::posix_fallocate(m_fd, 0, static_cast<off_t>(nSize)) == 0 &&
+        ::pwrite(m_fd, &header, sizeof(header), 0) ==
+            static_cast<ssize_t>(sizeof(header)) &&
+        mapLog(nSize)) {
+      m_nLogRecords = 0;
+      return true;
+    }
+  }
+  CTP_LOG_ERROR("[Checkpoint] failed to map %s", strPath.c_str());
+  closeLog();
+  return false;
+}
+
+bool TraderCheckpoint::mapLog(std::size_t nFileSize) {
+  // 一次性保留足够的地址空间，扩展文件时映射地址不变，超出文件长度的部分
+  // 在扩展前不会被访问
+  std::size_t nMappedSize =
+      std::max(nFileSize, logSizeForRecords(m_options.nLogMaxRecords));
+  void *pMapped = ::mmap(nullptr, nMappedSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, m_fd, 0);
+  if (pMapped == MAP_FAILED)
+    return false;
+  m_pLog = static_cast<char *>(pMapped);
+  m_nLogMappedSize = nMappedSize;
+  m_nLogFileSize = nFileSize;
+  m_nLogCapacity.store((nFileSize - kLogHeaderSize) / sizeof(PrivateLogRecord),
+                       std::memory_order_release);
+  populate(m_pLog, 0, nFileSize);
+  return true;
+}
+
+void TraderCheckpoint::closeLog() {
+  {
+    // 等写线程完成进行中的扩展再关闭文件，并撤销未处理的请求
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this] { return !m_bGrowing; });
+    m_bGrowRequested.store(false, std::memory_order_relaxed);
+    m_bGrowFailed = false;
+  }
+  if (m_pLog) {
+    ::msync(m_pLog, m_nLogMappedSize, MS_ASYNC);
+    ::munmap(m_pLog, m_nLogMappedSize);
+    m_pLog = nullptr;
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_nLogMappedSize = 0;
+  m_nLogFileSize = 0;
+  m_nLogCapacity.store(0, std::memory_order_relaxed);
+}
+
+void TraderCheckpoint::requestGrow() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bGrowRequested.store(true, std::memory_order_relaxed);
+  }
+  m_cond.notify_all();
+}
+
+bool TraderCheckpoint::waitForGrow() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this] {
+    return !m_bGrowRequested.load(std::memory_order_relaxed) || m_bGrowFailed;
+  });
+  return m_nLogRecords < m_nLogCapacity.load(std::memory_order_acquire);
+}
+
+bool TraderCheckpoint::growLog() {
+  std::size_t nOldSize = m_nLogFileSize;
+  std::size_t nNewSize = std::min(
+      logSizeForRecords(m_nLogCapacity.load(std::memory_order_relaxed) +
+                        m_options.nLogGrowRecords),
+      m_nLogMappedSize);
+  // 保留的地址空间已用完
+  if (nNewSize <= nOldSize)
+    return false;
+  // 先分配磁盘空间再发布容量，避免写入映射区时因磁盘满触发SIGBUS
+  if (::ftruncate(m_fd, static_cast<off_t>(nNewSize)) != 0 ||
+      ::posix_fallocate(m_fd, static_cast<off_t>(nOldSize),
+                        static_cast<off_t>(nNewSize - nOldSize)) != 0)
+    return false;
+  populate(m_pLog, nOldSize, nNewSize);
+  m_nLogFileSize = nNewSize;
+  m_nLogCapacity.store((nNewSize - kLogHeaderSize) / sizeof(PrivateLogRecord),
+                       std::memory_order_release);
+  return true;
+}
+
+void TraderCheckpoint::Close() {
+  if (m_pLog) {
+    if (m_nLogRecords != m_nCheckpointRecords)
+      Checkpoint();
+    closeLog();
+  }
+}
+
+bool TraderCheckpoint::append(PrivateLogRecord::Type eType, const void *pField,
+                              std::size_t nSize) {
+  if (!m_pLog)
+    return false;
+  // 剩余空间低于半个扩展量时通知写线程扩展，本线程不做系统调用。
+  // 先读请求标志再读容量：标志被清除时一定能看到扩展后的容量
+  if (!m_bGrowRequested.load(std::memory_order_acquire) &&
+      m_nLogRecords + m_options.nLogGrowRecords / 2 >=
+          m_nLogCapacity.load(std::memory_order_relaxed))
+    requestGrow();
+  // 写线程落后半个扩展量时才等待，回报不能丢
+  if (m_nLogRecords >= m_nLogCapacity.load(std::memory_order_acquire) &&
+      !waitForGrow()) {
+    CTP_LOG_ERROR("[Checkpoint] failed to grow private log");
+    return false;
+  }
+  PrivateLogRecord *pRecord = reinterpret_cast<PrivateLogRecord *>(
+      m_pLog + kLogHeaderSize + m_nLogRecords * sizeof(PrivateLogRecord));
+  pRecord->nType = eType;
+  pRecord->nReserved = 0;
+  std::memcpy(&pRecord->order, pField, nSize);
+  // 记录写完后才推进记录数，进程在两者之间崩溃只会丢掉这条未处理的回报。
+  // API在回调之前已推进流文件，这条回报以RESUME重启时不会再推送
+  reinterpret_cast<PrivateLogHeader *>(m_pLog)->nRecordCount =
+      ++m_nLogRecords;
+  return true;
+}
+
+const OrderState *
+TraderCheckpoint::OnRtnOrder(const CThostFtdcOrderField &order) {
+  append(PrivateLogRecord::Order, &order, sizeof(order));
+  m_table.Add(order.InstrumentID);
+  const OrderState *pState = m_engine.OnRtnOrder(order);
+  markOrder(pState);
+  afterUpdate();
+  return pState;
+}
+
+bool TraderCheckpoint::OnRtnTrade(const CThostFtdcTradeField &trade) {
+  append(PrivateLogRecord::Trade, &trade, sizeof(trade));
+  m_table.Add(trade.InstrumentID);
+  bool bApplied = m_engine.OnRtnTrade(trade);
+  // 成交累计到对应报单上
+  if (bApplied)
+    markOrder(m_engine.FindOrder(trade.ExchangeID, trade.OrderSysID));
+  afterUpdate();
+  return bApplied;
+}
+
+void TraderCheckpoint::markOrder(const OrderState *pState) {
+  if (!pState)
+    return;
+  std::size_t nOrder = static_cast<std::size_t>(pState - m_engine.m_pOrders);
+  if (!m_vecDirty[nOrder]) {
+    m_vecDirty[nOrder] = 1;
+    m_vecDirtyOrders.push_back(static_cast<std::uint32_t>(nOrder));
+  }
+}
+
+void TraderCheckpoint::afterUpdate() {
+  if (m_options.nCheckpointInterval != 0 &&
+      ++m_nSinceCheckpoint >= m_options.nCheckpointInterval) {
+    m_nSinceCheckpoint = 0;
+    if (m_szTradingDay[0])
+      stage();
+  }
+}
+
+bool TraderCheckpoint::Checkpoint() {
+  m_nSinceCheckpoint = 0;
+  if (!m_szTradingDay[0])
+    return false;
+  std::uint64_t nSeq = stage();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this, nSeq] { return m_nWrittenSeq >= nSeq; });
+  return m_bWriteOk;
+}
+
+std::uint64_t TraderCheckpoint::stage() {
+  const OrderStateEngine &engine = m_engine;
+  const std::size_t nIDSize = sizeof(TThostFtdcInstrumentIDType);
+  std::size_t nInstruments = std::min(m_table.Size(), engine.m_nInstruments);
+
+  std::uint64_t nSeq;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Snapshot &snapshot = m_pending;
+    if (m_bFullSnapshot) {
+      snapshot.bReady = false;
+      snapshot.bFull = true;
+      m_nStagedInstruments = 0;
+      m_nStagedTrades = 0;
+    }
+    if (!snapshot.bReady) {
+      snapshot.nInstrumentFrom = m_nStagedInstruments;
+      snapshot.nTradeFrom = m_nStagedTrades;
+      snapshot.vecInstrumentIDs.clear();
+      snapshot.vecOrders.clear();
+      snapshot.vecTrades.clear();
+    }
+    snapshot.strPath = MakeCheckpointPath(m_strDirectory, m_szTradingDay);
+    std::memcpy(snapshot.szTradingDay, m_szTradingDay, sizeof(m_szTradingDay));
+    snapshot.nLogRecords = m_nLogRecords;
+    snapshot.nOrders = engine.m_nOrders;
+
+    // 合约代码登记后不再改变，只追加新登记的
+    for (std::size_t i = m_nStagedInstruments; i < nInstruments; ++i) {
+      const char *pszID =
+          m_table.GetInstrumentID(static_cast<std::uint32_t>(i));
+      std::size_t nOffset = snapshot.vecInstrumentIDs.size();
+      snapshot.vecInstrumentIDs.resize(nOffset + nIDSize, '\0');
+      std::memcpy(&snapshot.vecInstrumentIDs[nOffset], pszID,
+                  strnlen(pszID, nIDSize - 1));
+    }
+    m_nStagedInstruments = nInstruments;
+    // 持仓还会被行情和LoadPosition()更新，每次整体复制
+    snapshot.vecPositions.assign(engine.m_pPositions,
+                                 engine.m_pPositions + nInstruments);
+    if (m_bFullSnapshot) {
+      for (std::size_t i = 0; i < engine.m_nOrders; ++i)
+        snapshot.vecOrders.emplace_back(static_cast<std::uint32_t>(i),
+                                        engine.m_pOrders[i]);
+    } else {
+      for (std::uint32_t nOrder : m_vecDirtyOrders)
+        snapshot.vecOrders.emplace_back(nOrder, engine.m_pOrders[nOrder]);
+    }
+    snapshot.vecTrades.insert(snapshot.vecTrades.end(),
+                              engine.m_pTrades + m_nStagedTrades,
+                              engine.m_pTrades + engine.m_nTrades);
+    m_nStagedTrades = engine.m_nTrades;
+    snapshot.bReady = true;
+    nSeq = ++m_nStagedSeq;
+  }
+  m_cond.notify_all();
+
+  for (std::uint32_t nOrder : m_vecDirtyOrders)
+    m_vecDirty[nOrder] = 0;
+  m_vecDirtyOrders.clear();
+  m_bFullSnapshot = false;
+  m_nCheckpointRecords = m_nLogRecords;
+  return nSeq;
+}
+
+void TraderCheckpoint::run() {
+  const std::size_t nIDSize = sizeof(TThostFtdcInstrumentIDType);
+  for (;;) {
+    std::uint64_t nSeq;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] {
+        return m_bStop || m_pending.bReady ||
+               (m_bGrowRequested.load(std::memory_order_relaxed) &&
+                !m_bGrowFailed);
+      });
+      // 日志扩展优先于写检查点，回调线程可能在等待
+      if (m_bGrowRequested.load(std::memory_order_relaxed) && !m_bGrowFailed) {
+        m_bGrowing = true;
+        lock.unlock();
+        bool bGrown = growLog();
+        lock.lock();
+        m_bGrowing = false;
+        // 失败时保留请求标志，回调线程不会再请求扩展
+        if (bGrown)
+          m_bGrowRequested.store(false, std::memory_order_release);
+        else
+          m_bGrowFailed = true;
+        lock.unlock();
+        m_cond.notify_all();
+        continue;
+      }
+      if (!m_pending.bReady)
+        return;
+      // 交换后m_pending保留上一轮清空的容量，稳定后不再分配
+      std::swap(m_writing, m_pending);
+      m_pending.bReady = false;
+      m_pending.bFull = false;
+      nSeq = m_nStagedSeq;
+    }
+
+    // 把增量合并到副本
+    const Snapshot &snapshot = m_writing;
+    if (snapshot.bFull) {
+      m_mirrorIDs.clear();
+      m_mirrorOrders.clear();
+      m_mirrorTrades.clear();
+    }
+    m_mirrorIDs.resize(snapshot.nInstrumentFrom * nIDSize);
+    m_mirrorIDs.insert(m_mirrorIDs.end(), snapshot.vecInstrumentIDs.begin(),
+                       snapshot.vecInstrumentIDs.end());
+    m_mirrorOrders.resize(snapshot.nOrders);
+    for (const auto &order : snapshot.vecOrders) {
+      if (order.first < m_mirrorOrders.size())
+        m_mirrorOrders[order.first] = order.second;
+    }
+    m_mirrorTrades.resize(snapshot.nTradeFrom);
+    m_mirrorTrades.insert(m_mirrorTrades.end(), snapshot.vecTrades.begin(),
+                          snapshot.vecTrades.end());
+    bool bOk = write(snapshot);
+
+    m_writing.vecInstrumentIDs.clear();
+    m_writing.vecOrders.clear();
+    m_writing.vecTrades.clear();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_nWrittenSeq = nSeq;
+      m_bWriteOk = bOk;
+    }
+    m_cond.notify_all();
+  }
+}
+
+bool TraderCheckpoint::write(const Snapshot &snapshot) {
+  const std::size_t nIDSize = sizeof(TThostFtdcInstrumentIDType);
+  const std::size_t nInstruments = snapshot.vecPositions.size();
+  TraderCheckpointHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.nMagic = kTraderCheckpointMagic;
+  header.nVersion = kTraderCheckpointVersion;
+  header.nHeaderSize = sizeof(TraderCheckpointHeader);
+  header.nOrderSize = sizeof(OrderState);
+  header.nPositionSize = sizeof(PositionState);
+  header.nTradeSize = sizeof(TradeKey);
+  std::memcpy(header.szTradingDay, snapshot.szTradingDay,
+              sizeof(header.szTradingDay));
+  header.nInstruments = nInstruments;
+  header.nOrders = m_mirrorOrders.size();
+  header.nTrades = m_mirrorTrades.size();
+  header.nLogRecords = snapshot.nLogRecords;
+  header.nCreateTime = nowNanos();
+
+  // 先写临时文件并fsync再rename，最后fsync目录：崩溃时旧检查点保持完整，
+  // rename之后的新检查点也不会因掉电而只剩目录项
+  const std::string &strPath = snapshot.strPath;
+  std::string strTemp = strPath + ".tmp";
+  int fd = ::open(strTemp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    CTP_LOG_ERROR("[Checkpoint] failed to create %s", strTemp.c_str());
+    return false;
+  }
+  bool bOk = m_mirrorIDs.size() == nInstruments * nIDSize &&
+             writeAll(fd, &header, sizeof(header)) &&
+             writeAll(fd, m_mirrorIDs.data(), m_mirrorIDs.size()) &&
+             writeAll(fd, snapshot.vecPositions.data(),
+                      nInstruments * sizeof(PositionState)) &&
+             writeAll(fd, m_mirrorOrders.data(),
+                      m_mirrorOrders.size() * sizeof(OrderState)) &&
+             writeAll(fd, m_mirrorTrades.data(),
+                      m_mirrorTrades.size() * sizeof(TradeKey)) &&
+             ::fsync(fd) == 0;
+  bOk = ::close(fd) == 0 && bOk;
+  if (!bOk || ::rename(strTemp.c_str(), strPath.c_str()) != 0) {
+    CTP_LOG_ERROR("[Checkpoint] failed to write %s", strPath.c_str());
+    ::unlink(strTemp.c_str());
+    return false;
+  }
+  if (!syncDirectory(strPath))
+    CTP_LOG_WARN("[Checkpoint] failed to sync the directory of %s",
+                 strPath.c_str());
+  return true;
+}
+
+} // namespace ctp